@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <getopt.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "childprocess.hpp"
+#include "flatjson.hpp"
+
+constexpr const double DefaultTolerance{0.10};
+constexpr const int ListenerTimeoutMilliseconds{5000};
+
+// the corpus shape is fixed so that results stay comparable with the baseline; only its size can change
+constexpr const std::string_view CorpusHosts{"500"};
+constexpr const std::string_view CorpusServices{"20"};
+constexpr const std::string_view CorpusItems{"1-8"};
+constexpr const std::string_view CorpusEscapeRate{"0.05"};
+
+struct Measure
+{
+	std::string_view Name;
+	bool HigherIsBetter;
+};
+
+constexpr const Measure Measures[]{
+	 {"lines_per_second", true},
+	 {"points_per_second", true},
+	 {"cpu_seconds", false},
+	 {"peak_rss_kb", false},
+	 {"write_latency_p50_ms", false},
+	 {"write_latency_p99_ms", false}};
+
+struct BenchSettings
+{
+	std::string Daemon{"./xlatnagiosdatad"};
+	std::string LoadGenerator{"./xlatnagiosdata-loadgen"};
+	std::string Mock{"./xlatnagiosdata-mockinflux"};
+	std::string Replay{"./xlatnagiosdata-replay"};
+	std::string Corpus{}; // capture archive replayed instead of the generated corpus
+	std::string WorkDirectory{(std::filesystem::temp_directory_path() / "xlatnagiosdata-bench-e2e").string()};
+	unsigned long Lines{1000000};
+	unsigned long Rotations{20};
+	unsigned long Runs{3};
+	int Port{18086};
+	std::string Latency{"0"};
+};
+
+// helper functions
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr,
+					 "usage: %s [options]\n"
+					 "Drains a generated spool corpus into the mock InfluxDB endpoint with xlatnagiosdatad --once, measures the run,\n"
+					 "and compares the median of several runs against a baseline. Exits 1 if any measure regressed beyond its tolerance.\n"
+					 "\n"
+					 "  --daemon PATH           daemon to measure (default ./xlatnagiosdatad)\n"
+					 "  --loadgen PATH          load generator (default ./xlatnagiosdata-loadgen)\n"
+					 "  --mock PATH             mock InfluxDB endpoint (default ./xlatnagiosdata-mockinflux)\n"
+					 "  --corpus DIRECTORY      replay this capture archive (see [capture]) instead of generating a corpus.\n"
+					 "                          --lines and --rotations are ignored; compare only with a baseline of the same archive\n"
+					 "  --replay PATH           replay tool for --corpus (default ./xlatnagiosdata-replay)\n"
+					 "  --work-dir DIRECTORY    scratch directory, emptied before each run (default $TMPDIR/xlatnagiosdata-bench-e2e)\n"
+					 "  --lines N               corpus lines per run (default 1000000)\n"
+					 "  --rotations N           times the corpus is moved into the spool, each adding a host and a service file (default 20)\n"
+					 "  --runs N                runs to take the median of (default 3)\n"
+					 "  --port PORT             port for the mock endpoint (default 18086)\n"
+					 "  --latency MIN[-MAX]     milliseconds the mock adds to each response (default 0)\n"
+					 "  --baseline FILE         JSON baseline to compare against\n"
+					 "  --tolerance FRACTION    allowed regression for every measure, overriding the baseline's own (default %.2f)\n"
+					 "  --update-baseline       write the results to the baseline file instead of comparing\n"
+					 "  --output FILE           write the results as JSON\n",
+					 ProgramName, DefaultTolerance);
+}
+
+static bool WriteDaemonConfiguration(const BenchSettings &Settings, const std::filesystem::path &Path)
+{
+	std::FILE *File{std::fopen(Path.c_str(), "w")};
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::fprintf(File,
+					 "[logging]\nlevel = \"warn\"\ndirectory = \"%s\"\n\n"
+					 "[daemon]\nself_monitoring_interval = 0\nlag_threshold = 0\n\n"
+					 "[influx]\nhost = \"127.0.0.1\"\nport = %d\n\n"
+					 "[nagios]\nspool_directory = \"%s\"\n",
+					 (std::filesystem::path{Settings.WorkDirectory} / "log").c_str(), Settings.Port, (std::filesystem::path{Settings.WorkDirectory} / "spool").c_str());
+	return std::fclose(File) == 0;
+}
+
+// the daemon prints its metrics as one perfdata line, label=value[unit] separated by spaces
+static std::optional<double> GetPerfValue(const std::string_view &Line, const std::string_view &Label)
+{
+	for (size_t Position{Line.find(Label)}; Position != std::string_view::npos; Position = Line.find(Label, Position + 1))
+	{
+		bool Starts{Position > 0 && (Line[Position - 1] == ' ' || Line[Position - 1] == '\t')};
+		size_t ValueStart{Position + Label.size()};
+		if (Starts && ValueStart < Line.size() && Line[ValueStart] == '=')
+		{
+			return std::strtod(std::string{Line.substr(ValueStart + 1, 32)}.c_str(), nullptr);
+		}
+	}
+	return std::nullopt;
+}
+
+static std::string ReadLastLine(const std::filesystem::path &Path)
+{
+	std::string Line{};
+	std::FILE *File{std::fopen(Path.c_str(), "r")};
+	if (File == nullptr)
+	{
+		return Line;
+	}
+	std::string Current{};
+	int Character{0};
+	while ((Character = std::fgetc(File)) != EOF)
+	{
+		if (Character == '\n')
+		{
+			if (!Current.empty())
+			{
+				Line = std::move(Current);
+			}
+			Current.clear();
+		}
+		else
+		{
+			Current.push_back(static_cast<char>(Character));
+		}
+	}
+	std::fclose(File);
+	return Current.empty() ? Line : Current;
+}
+
+static bool GenerateCorpus(const BenchSettings &Settings)
+{
+	const std::filesystem::path Work{Settings.WorkDirectory};
+	if (!Settings.Corpus.empty())
+	{
+		ChildProcess Replay{};
+		if (!Replay.Start({Settings.Replay, "--corpus", Settings.Corpus, "--spool", (Work / "spool").string(), "--work-dir", (Work / "loadgen").string(), "--speed", "0"},
+								{}, (Work / "replay.log").string()))
+		{
+			return false;
+		}
+		if (Replay.Wait().ExitStatus != 0)
+		{
+			std::fprintf(stderr, "Replay failed, see \"%s\"\n", (Work / "replay.log").c_str());
+			return false;
+		}
+		return true;
+	}
+	const std::string LinesPerRotation{std::to_string(Settings.Lines / Settings.Rotations)};
+	for (unsigned long Rotation{0}; Rotation < Settings.Rotations; Rotation++)
+	{
+		ChildProcess Generator{};
+		if (!Generator.Start({Settings.LoadGenerator, "--spool", (Work / "spool").string(), "--work-dir", (Work / "loadgen").string(), "--hosts", std::string{CorpusHosts},
+									 "--services", std::string{CorpusServices}, "--items", std::string{CorpusItems}, "--escape-rate", std::string{CorpusEscapeRate}, "--rate", "0", "--rotate", "86400",
+									 "--lines", LinesPerRotation, "--seed", "1"},
+									{}, (Work / "loadgen.log").string()))
+		{
+			return false;
+		}
+		if (Generator.Wait().ExitStatus != 0)
+		{
+			std::fprintf(stderr, "Load generator failed, see \"%s\"\n", (Work / "loadgen.log").c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+// one complete run: fresh corpus, mock up, daemon drains the spool, mock down
+static std::optional<FlatJson> RunOnce(const BenchSettings &Settings)
+{
+	const std::filesystem::path Work{Settings.WorkDirectory};
+	std::error_code FSErrorCode{};
+	std::filesystem::remove_all(Work, FSErrorCode);
+	for (const auto *Directory : {"spool", "loadgen", "log", "lock"})
+	{
+		std::filesystem::create_directories(Work / Directory, FSErrorCode);
+	}
+	if (FSErrorCode)
+	{
+		std::fprintf(stderr, "Failed to create \"%s\": %s\n", Work.c_str(), FSErrorCode.message().c_str());
+		return std::nullopt;
+	}
+	if (!WriteDaemonConfiguration(Settings, Work / "xlatnagiosdatad.toml") || !GenerateCorpus(Settings))
+	{
+		return std::nullopt;
+	}
+
+	ChildProcess Mock{};
+	if (!Mock.Start({Settings.Mock, "--port", std::to_string(Settings.Port), "--database", "nagiosrecords", "--latency", Settings.Latency, "--report", "0",
+						  "--summary", (Work / "mock.json").string()},
+						 {}, (Work / "mock.log").string()))
+	{
+		return std::nullopt;
+	}
+	if (!WaitForListener(Settings.Port, ListenerTimeoutMilliseconds))
+	{
+		std::fprintf(stderr, "Mock endpoint did not start listening on port %d, see \"%s\"\n", Settings.Port, (Work / "mock.log").c_str());
+		return std::nullopt;
+	}
+
+	ChildProcess Daemon{};
+	if (!Daemon.Start({Settings.Daemon, "--config", (Work / "xlatnagiosdatad.toml").string(), "--lock-dir", (Work / "lock").string(), "--once"}, (Work / "daemon.out").string()))
+	{
+		return std::nullopt;
+	}
+	ProcessUsage Usage{Daemon.Wait()};
+	if (Mock.Stop(SIGINT).ExitStatus != 0)
+	{
+		std::fprintf(stderr, "Mock endpoint failed, see \"%s\"\n", (Work / "mock.log").c_str());
+		return std::nullopt;
+	}
+	if (Usage.ExitStatus != 0)
+	{
+		std::fprintf(stderr, "Daemon exited with status %d without delivering everything, see \"%s\"\n", Usage.ExitStatus, (Work / "log").c_str());
+		return std::nullopt;
+	}
+
+	std::string Metrics{ReadLastLine(Work / "daemon.out")};
+	auto LinesRead{GetPerfValue(Metrics, "lines_read")};
+	auto LatencyP50{GetPerfValue(Metrics, "http_request_p50")};
+	auto LatencyP99{GetPerfValue(Metrics, "http_request_p99")};
+	FlatJson MockSummary{};
+	if (!LinesRead || !LatencyP50 || !LatencyP99 || !ReadFlatJson((Work / "mock.json").string(), MockSummary))
+	{
+		std::fprintf(stderr, "Daemon metrics missing from \"%s\"\n", (Work / "daemon.out").c_str());
+		return std::nullopt;
+	}
+	const double ExpectedLines{Settings.Corpus.empty() ? static_cast<double>(Settings.Lines / Settings.Rotations * Settings.Rotations) : *LinesRead};
+	if (*LinesRead != ExpectedLines || *LinesRead <= 0 || MockSummary["points"] <= 0 || MockSummary["rejected_points"] > 0)
+	{
+		std::fprintf(stderr, "Daemon read %.0f of %.0f lines and the mock stored %.0f points, rejecting %.0f\n", *LinesRead, ExpectedLines, MockSummary["points"], MockSummary["rejected_points"]);
+		return std::nullopt;
+	}
+
+	FlatJson Result{};
+	Result["lines_per_second"] = *LinesRead / Usage.WallSeconds;
+	Result["points_per_second"] = MockSummary["points"] / Usage.WallSeconds;
+	Result["cpu_seconds"] = Usage.CpuSeconds;
+	Result["peak_rss_kb"] = static_cast<double>(Usage.PeakRssKilobytes);
+	Result["write_latency_p50_ms"] = *LatencyP50 / 1000.0;
+	Result["write_latency_p99_ms"] = *LatencyP99 / 1000.0;
+	Result["wall_seconds"] = Usage.WallSeconds;
+	Result["points"] = MockSummary["points"];
+	Result["lines"] = *LinesRead;
+	return Result;
+}
+
+static double Median(std::vector<double> Values)
+{
+	std::sort(Values.begin(), Values.end());
+	size_t Middle{Values.size() / 2};
+	return Values.size() % 2 == 1 ? Values[Middle] : (Values[Middle - 1] + Values[Middle]) / 2;
+}
+
+static double GetTolerance(const FlatJson &Baseline, const std::string_view &Name, const std::optional<double> &Override)
+{
+	if (Override)
+	{
+		return *Override;
+	}
+	if (auto Own{Baseline.find(std::string{Name}.append("_tolerance"))}; Own != Baseline.end())
+	{
+		return Own->second;
+	}
+	if (auto Shared{Baseline.find("tolerance")}; Shared != Baseline.end())
+	{
+		return Shared->second;
+	}
+	return DefaultTolerance;
+}
+
+// returns the number of measures that regressed beyond their tolerance
+static size_t Compare(const FlatJson &Baseline, const FlatJson &Results, const std::optional<double> &ToleranceOverride)
+{
+	size_t Regressions{0};
+	std::printf("%-22s %14s %14s %9s %9s\n", "measure", "baseline", "result", "change", "allowed");
+	for (const auto &[Name, HigherIsBetter] : Measures)
+	{
+		auto Expected{Baseline.find(Name)};
+		double Result{Results.find(Name)->second};
+		if (Expected == Baseline.end() || Expected->second <= 0)
+		{
+			std::printf("%-22s %14s %14.3f\n", std::string{Name}.c_str(), "-", Result);
+			continue;
+		}
+		double Change{(Result - Expected->second) / Expected->second};
+		double Tolerance{GetTolerance(Baseline, Name, ToleranceOverride)};
+		bool Regressed{HigherIsBetter ? Change < -Tolerance : Change > Tolerance};
+		Regressions += Regressed ? 1 : 0;
+		std::printf("%-22s %14.3f %14.3f %+8.1f%% %8.0f%%%s\n", std::string{Name}.c_str(), Expected->second, Result, Change * 100, Tolerance * 100, Regressed ? "  REGRESSED" : "");
+	}
+	return Regressions;
+}
+
+int main(int argc, char **argv)
+{
+	BenchSettings Settings{};
+	std::string BaselinePath{};
+	std::string OutputPath{};
+	std::optional<double> ToleranceOverride{};
+	bool UpdateBaseline{false};
+
+	const option Options[]{
+		 {"daemon", required_argument, nullptr, 'D'},
+		 {"loadgen", required_argument, nullptr, 'L'},
+		 {"mock", required_argument, nullptr, 'M'},
+		 {"corpus", required_argument, nullptr, 'c'},
+		 {"replay", required_argument, nullptr, 'R'},
+		 {"work-dir", required_argument, nullptr, 'W'},
+		 {"lines", required_argument, nullptr, 'l'},
+		 {"rotations", required_argument, nullptr, 'r'},
+		 {"runs", required_argument, nullptr, 'n'},
+		 {"port", required_argument, nullptr, 'p'},
+		 {"latency", required_argument, nullptr, 'a'},
+		 {"baseline", required_argument, nullptr, 'b'},
+		 {"tolerance", required_argument, nullptr, 't'},
+		 {"update-baseline", no_argument, nullptr, 'u'},
+		 {"output", required_argument, nullptr, 'o'},
+		 {"help", no_argument, nullptr, 'h'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'D':
+			Settings.Daemon = optarg;
+			break;
+		case 'L':
+			Settings.LoadGenerator = optarg;
+			break;
+		case 'M':
+			Settings.Mock = optarg;
+			break;
+		case 'c':
+			Settings.Corpus = optarg;
+			break;
+		case 'R':
+			Settings.Replay = optarg;
+			break;
+		case 'W':
+			Settings.WorkDirectory = optarg;
+			break;
+		case 'l':
+			Settings.Lines = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'r':
+			Settings.Rotations = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'n':
+			Settings.Runs = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'p':
+			Settings.Port = static_cast<int>(std::strtol(optarg, nullptr, 10));
+			break;
+		case 'a':
+			Settings.Latency = optarg;
+			break;
+		case 'b':
+			BaselinePath = optarg;
+			break;
+		case 't':
+			ToleranceOverride = std::strtod(optarg, nullptr);
+			break;
+		case 'u':
+			UpdateBaseline = true;
+			break;
+		case 'o':
+			OutputPath = optarg;
+			break;
+		case 'h':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (Settings.Rotations == 0 || Settings.Lines < Settings.Rotations || Settings.Runs == 0 || (UpdateBaseline && BaselinePath.empty()))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	for (auto *Path : {&Settings.Daemon, &Settings.LoadGenerator, &Settings.Mock, &Settings.Replay, &Settings.Corpus, &Settings.WorkDirectory})
+	{
+		*Path = Path->empty() ? *Path : std::filesystem::absolute(*Path).string();
+	}
+
+	FlatJson Baseline{};
+	if (!BaselinePath.empty() && !UpdateBaseline)
+	{
+		if (!ReadFlatJson(BaselinePath, Baseline))
+		{
+			return 1;
+		}
+		if (Settings.Corpus.empty() && (Baseline["corpus_lines"] != static_cast<double>(Settings.Lines) || Baseline["corpus_rotations"] != static_cast<double>(Settings.Rotations)))
+		{
+			std::fprintf(stderr, "Baseline \"%s\" was recorded with %.0f lines in %.0f rotations, not %lu in %lu\n", BaselinePath.c_str(), Baseline["corpus_lines"],
+							 Baseline["corpus_rotations"], Settings.Lines, Settings.Rotations);
+			return 1;
+		}
+	}
+
+	std::vector<FlatJson> Runs{};
+	for (unsigned long Run{1}; Run <= Settings.Runs; Run++)
+	{
+		auto Result{RunOnce(Settings)};
+		if (!Result)
+		{
+			return 1;
+		}
+		std::fprintf(stderr, "run %lu: %.0f lines/s, %.0f points/s, %.2f CPU s, %.0f KB peak RSS, write p50 %.3f ms p99 %.3f ms\n", Run, (*Result)["lines_per_second"],
+						 (*Result)["points_per_second"], (*Result)["cpu_seconds"], (*Result)["peak_rss_kb"], (*Result)["write_latency_p50_ms"], (*Result)["write_latency_p99_ms"]);
+		Runs.push_back(std::move(*Result));
+	}
+	std::error_code FSErrorCode{};
+	std::filesystem::remove_all(Settings.WorkDirectory, FSErrorCode);
+
+	FlatJson Results{};
+	for (const auto &[Name, Value] : Runs.front())
+	{
+		std::vector<double> Values{};
+		for (const auto &Run : Runs)
+		{
+			Values.push_back(Run.at(Name));
+		}
+		Results[Name] = Median(Values);
+	}
+	Results["corpus_lines"] = Settings.Corpus.empty() ? static_cast<double>(Settings.Lines) : Results["lines"];
+	Results["corpus_rotations"] = Settings.Corpus.empty() ? static_cast<double>(Settings.Rotations) : 0;
+	Results["runs"] = static_cast<double>(Settings.Runs);
+
+	size_t Regressions{0};
+	if (UpdateBaseline)
+	{
+		FlatJson Previous{};
+		if (std::filesystem::exists(BaselinePath))
+		{
+			ReadFlatJson(BaselinePath, Previous);
+		}
+		FlatJson NewBaseline{Results};
+		for (const auto &[Name, Value] : Previous) // tolerances are chosen by hand, keep them
+		{
+			if (std::string_view{Name}.ends_with("tolerance"))
+			{
+				NewBaseline[Name] = Value;
+			}
+		}
+		if (!WriteFlatJson(BaselinePath, NewBaseline))
+		{
+			return 1;
+		}
+		std::printf("baseline written to %s\n", BaselinePath.c_str());
+	}
+	else if (!Baseline.empty())
+	{
+		Regressions = Compare(Baseline, Results, ToleranceOverride);
+	}
+	else
+	{
+		Compare(FlatJson{}, Results, ToleranceOverride);
+	}
+	if (!OutputPath.empty())
+	{
+		Results["regressions"] = static_cast<double>(Regressions);
+		if (!WriteFlatJson(OutputPath, Results))
+		{
+			return 1;
+		}
+	}
+	return Regressions > 0 ? 1 : 0;
+}
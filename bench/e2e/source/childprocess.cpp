@@ -0,0 +1,121 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "childprocess.hpp"
+
+// helper functions
+static double GetMonotonicSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void RedirectOrExit(const std::string &Path, const int Descriptor)
+{
+	int File{::open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+	if (File < 0 || ::dup2(File, Descriptor) < 0)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		::_exit(127);
+	}
+}
+
+// public functions
+ChildProcess::~ChildProcess()
+{
+	if (Pid > 0)
+	{
+		Stop(SIGKILL);
+	}
+}
+
+bool ChildProcess::Start(const std::vector<std::string> &Arguments, const std::string &OutputPath, const std::string &ErrorPath)
+{
+	std::vector<char *> Argv{};
+	for (const auto &Argument : Arguments)
+	{
+		Argv.push_back(const_cast<char *>(Argument.c_str()));
+	}
+	Argv.push_back(nullptr);
+
+	std::fflush(nullptr);
+	Started = GetMonotonicSeconds();
+	Pid = ::fork();
+	if (Pid < 0)
+	{
+		std::fprintf(stderr, "Failed to start \"%s\": %s\n", Arguments.front().c_str(), std::strerror(errno));
+		return false;
+	}
+	if (Pid == 0)
+	{
+		RedirectOrExit(OutputPath.empty() ? std::string{"/dev/null"} : OutputPath, STDOUT_FILENO);
+		if (!ErrorPath.empty())
+		{
+			RedirectOrExit(ErrorPath, STDERR_FILENO);
+		}
+		::execv(Argv.front(), Argv.data());
+		std::fprintf(stderr, "Failed to run \"%s\": %s\n", Argv.front(), std::strerror(errno));
+		::_exit(127);
+	}
+	return true;
+}
+
+ProcessUsage ChildProcess::Wait()
+{
+	ProcessUsage Usage{};
+	if (Pid <= 0)
+	{
+		return Usage;
+	}
+	int Status{0};
+	rusage Resources{};
+	while (::wait4(Pid, &Status, 0, &Resources) < 0 && errno == EINTR)
+	{
+	}
+	Pid = -1;
+	Usage.WallSeconds = GetMonotonicSeconds() - Started;
+	Usage.ExitStatus = WIFEXITED(Status) ? WEXITSTATUS(Status) : 128 + WTERMSIG(Status);
+	Usage.CpuSeconds = static_cast<double>(Resources.ru_utime.tv_sec + Resources.ru_stime.tv_sec) + static_cast<double>(Resources.ru_utime.tv_usec + Resources.ru_stime.tv_usec) / 1e6;
+	Usage.PeakRssKilobytes = Resources.ru_maxrss;
+	return Usage;
+}
+
+ProcessUsage ChildProcess::Stop(const int Signal)
+{
+	if (Pid > 0)
+	{
+		::kill(Pid, Signal);
+	}
+	return Wait();
+}
+
+bool WaitForListener(const int Port, const int TimeoutMilliseconds)
+{
+	auto Deadline{std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeoutMilliseconds)};
+	do
+	{
+		int Socket{::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+		sockaddr_in Address{};
+		Address.sin_family = AF_INET;
+		Address.sin_port = htons(static_cast<uint16_t>(Port));
+		Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bool Connected{::connect(Socket, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) == 0};
+		::close(Socket);
+		if (Connected)
+		{
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	} while (std::chrono::steady_clock::now() < Deadline);
+	return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/// @brief What a finished child cost, from wait4
+struct ProcessUsage
+{
+	int ExitStatus{-1}; // 128 + signal number if the child was killed
+	double WallSeconds{0};
+	double CpuSeconds{0}; // user and system
+	long PeakRssKilobytes{0};
+};
+
+/// @brief One program run by the benchmark, with its output sent to files
+class ChildProcess
+{
+private:
+	pid_t Pid{-1};
+	double Started{0};
+
+public:
+	ChildProcess() = default;
+	~ChildProcess();
+	ChildProcess(const ChildProcess &) = delete;
+	ChildProcess &operator=(const ChildProcess &) = delete;
+	ChildProcess(ChildProcess &&) = delete;
+	ChildProcess &operator=(ChildProcess &&) = delete;
+
+	/// @param Arguments Program path followed by its arguments
+	/// @param OutputPath Receives standard output, or /dev/null if empty
+	/// @param ErrorPath Receives standard error, or inherits ours if empty
+	/// @return False if the program could not be started, which has been reported
+	bool Start(const std::vector<std::string> &Arguments, const std::string &OutputPath = {}, const std::string &ErrorPath = {});
+
+	/// @brief Waits for the child to exit
+	ProcessUsage Wait();
+
+	/// @brief Sends Signal, then waits for the child to exit
+	ProcessUsage Stop(const int Signal);
+};
+
+/// @brief Waits up to TimeoutMilliseconds for something to accept TCP connections on 127.0.0.1:Port
+bool WaitForListener(const int Port, const int TimeoutMilliseconds);
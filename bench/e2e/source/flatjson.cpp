@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "flatjson.hpp"
+
+// helper functions
+static void SkipSpace(const std::string_view &Text, size_t &Position)
+{
+	while (Position < Text.size() && (Text[Position] == ' ' || Text[Position] == '\t' || Text[Position] == '\r' || Text[Position] == '\n'))
+	{
+		Position++;
+	}
+}
+
+static bool ReadString(const std::string_view &Text, size_t &Position, std::string &Value)
+{
+	if (Position >= Text.size() || Text[Position] != '"')
+	{
+		return false;
+	}
+	for (Position++; Position < Text.size() && Text[Position] != '"'; Position++)
+	{
+		if (Text[Position] == '\\' && Position + 1 < Text.size())
+		{
+			Position++;
+		}
+		Value.push_back(Text[Position]);
+	}
+	return Position++ < Text.size();
+}
+
+static bool ParseFlatJson(const std::string_view &Text, FlatJson &Values)
+{
+	size_t Position{0};
+	SkipSpace(Text, Position);
+	if (Position >= Text.size() || Text[Position++] != '{')
+	{
+		return false;
+	}
+	SkipSpace(Text, Position);
+	if (Position < Text.size() && Text[Position] == '}')
+	{
+		return true;
+	}
+	while (true)
+	{
+		SkipSpace(Text, Position);
+		std::string Key{};
+		if (!ReadString(Text, Position, Key))
+		{
+			return false;
+		}
+		SkipSpace(Text, Position);
+		if (Position >= Text.size() || Text[Position++] != ':')
+		{
+			return false;
+		}
+		SkipSpace(Text, Position);
+		if (Position < Text.size() && Text[Position] == '"')
+		{
+			std::string Ignored{};
+			if (!ReadString(Text, Position, Ignored))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			std::string Number{Text.substr(Position, Text.find_first_of(",} \t\r\n", Position) - Position)};
+			char *End{nullptr};
+			double Value{std::strtod(Number.c_str(), &End)};
+			if (End == Number.c_str())
+			{
+				if (Number != "true" && Number != "false" && Number != "null")
+				{
+					return false;
+				}
+			}
+			else
+			{
+				Values[Key] = Value;
+			}
+			Position += Number.size();
+		}
+		SkipSpace(Text, Position);
+		if (Position >= Text.size())
+		{
+			return false;
+		}
+		char Separator{Text[Position++]};
+		if (Separator == '}')
+		{
+			return true;
+		}
+		if (Separator != ',')
+		{
+			return false;
+		}
+	}
+}
+
+// public functions
+bool ReadFlatJson(const std::string &Path, FlatJson &Values)
+{
+	std::FILE *File{std::fopen(Path.c_str(), "r")};
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::string Text{};
+	char Chunk[4096];
+	size_t Read{0};
+	while ((Read = std::fread(Chunk, 1, sizeof(Chunk), File)) > 0)
+	{
+		Text.append(Chunk, Read);
+	}
+	std::fclose(File);
+	if (!ParseFlatJson(Text, Values))
+	{
+		std::fprintf(stderr, "Failed to parse \"%s\": expected an object of numbers\n", Path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool WriteFlatJson(const std::string &Path, const FlatJson &Values)
+{
+	std::FILE *File{std::fopen(Path.c_str(), "w")};
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::fputs("{\n", File);
+	size_t Remaining{Values.size()};
+	for (const auto &[Key, Value] : Values)
+	{
+		std::fprintf(File, "  \"%s\": %.10g%s\n", Key.c_str(), Value, --Remaining > 0 ? "," : "");
+	}
+	std::fputs("}\n", File);
+	if (std::fclose(File) != 0)
+	{
+		std::fprintf(stderr, "Failed to write \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	return true;
+}
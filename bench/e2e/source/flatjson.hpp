@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+/// @brief A JSON object of numbers, the shape of the baseline, the results and the mock's summary
+using FlatJson = std::map<std::string, double, std::less<>>;
+
+/// @brief Reads a JSON object whose members are numbers. Members of other types are skipped; nested objects and arrays are not supported.
+/// @return False if the file could not be read or parsed, which has been reported
+bool ReadFlatJson(const std::string &Path, FlatJson &Values);
+
+/// @return False if the file could not be written, which has been reported
+bool WriteFlatJson(const std::string &Path, const FlatJson &Values);
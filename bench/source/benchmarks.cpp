@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "harness.hpp"
+#include "influxescape.hpp"
+#include "influxtranslator.hpp"
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+#include "perfdatainputs.hpp"
+#include "utility.hpp"
+
+constexpr const size_t LinesPerShape{1024}; // enough distinct lines to defeat the branch predictor, few enough to stay in cache
+constexpr const Bench::PerfDataShape Shapes[]{Bench::PerfDataShape::Single, Bench::PerfDataShape::Typical, Bench::PerfDataShape::Large, Bench::PerfDataShape::Escaped, Bench::PerfDataShape::Sparse};
+
+// helper functions
+static const std::map<const std::string, const std::string> &GetUnitConversionMap()
+{
+	static const std::map<const std::string, const std::string> UnitConversionMap{
+		 {"%", "percent"}, {"s", "seconds"}, {"ms", "ms"}, {"B", "bytes"}, {"KB", "deckbytes"}, {"MB", "decmbytes"}, {"c", "none"}};
+	return UnitConversionMap;
+}
+
+static size_t GetAverageSize(const std::vector<std::string> &Strings)
+{
+	size_t Total{0};
+	for (const auto &String : Strings)
+	{
+		Total += String.size();
+	}
+	return Strings.empty() ? 0 : Total / Strings.size();
+}
+
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr, "usage: %s [--filter TEXT] [--min-time MILLISECONDS] [--output FILE]\n", ProgramName);
+	std::fprintf(stderr, "  runs each benchmark whose name contains TEXT for at least MILLISECONDS (default 500),\n");
+	std::fprintf(stderr, "  and writes JSON results to FILE (default stdout) and a summary to stderr\n");
+}
+
+static void RunUtilityBenchmarks(Bench::BenchmarkRunner &Runner, const Bench::PerfDataShape Shape, const std::vector<std::string> &Lines, const std::vector<NagiosPerformanceRecord> &Records)
+{
+	std::string ShapeName{Bench::GetShapeName(Shape)};
+	size_t Next{0};
+
+	Runner.Run("find_first_unescaped/" + ShapeName, GetAverageSize(Lines), [&]
+				  {
+					  Bench::DoNotOptimize(Utility::FindFirstUnescaped(Lines[Next++ % Lines.size()], '\n')); // absent, so every call scans the whole line
+				  });
+
+	Runner.Run("delimited_block_processor/" + ShapeName, GetAverageSize(Lines), [&]
+				  {
+					  size_t Blocks{0};
+					  Utility::DelimitedBlockProcessor Fields{Lines[Next++ % Lines.size()], '\t'};
+					  while (Fields.More())
+					  {
+						  Utility::DelimitedBlockProcessor Items{Fields.GetNextBlock(), ' '};
+						  while (Items.More())
+						  {
+							  Bench::DoNotOptimize(Items.GetNextBlock());
+							  Blocks++;
+						  }
+					  }
+					  Bench::DoNotOptimize(Blocks);
+				  });
+
+	// the values and value-plus-unit strings the parser and translator actually feed these functions
+	std::vector<std::string> Values{};
+	std::vector<std::string> ValuesWithUnits{};
+	std::vector<std::string> Labels{};
+	for (const auto &Record : Records)
+	{
+		for (const auto &Item : Record.PerfData)
+		{
+			Values.push_back(Item.Value);
+			Values.push_back(Item.Warn);
+			ValuesWithUnits.push_back(Item.Value + Item.Unit);
+			Labels.push_back(Item.Label);
+		}
+	}
+
+	Runner.Run("is_number/" + ShapeName, GetAverageSize(Values), [&]
+				  { Bench::DoNotOptimize(Utility::IsNumber(Values[Next++ % Values.size()])); });
+
+	Runner.Run("get_first_non_numeric_position/" + ShapeName, GetAverageSize(ValuesWithUnits), [&]
+				  { Bench::DoNotOptimize(Utility::GetFirstNonNumericPosition(ValuesWithUnits[Next++ % ValuesWithUnits.size()])); });
+
+	// every kernel this CPU can run: labels as tag values, and whole lines as a long string field with little to escape
+	std::string Escaped{};
+	for (const auto Kernel : {InfluxEscape::Kernel::Scalar, InfluxEscape::Kernel::SSE42, InfluxEscape::Kernel::AVX2})
+	{
+		if (!InfluxEscape::SetKernel(Kernel))
+		{
+			continue;
+		}
+		std::string KernelName{InfluxEscape::GetKernelName(Kernel)};
+		Runner.Run("escape_tag/" + KernelName + "/" + ShapeName, GetAverageSize(Labels), [&]
+					  {
+						  Escaped.clear();
+						  InfluxEscape::AppendEscaped(Escaped, Labels[Next++ % Labels.size()], InfluxEscape::Context::Tag);
+						  Bench::DoNotOptimize(Escaped);
+					  });
+		Runner.Run("escape_field_string/" + KernelName + "/" + ShapeName, GetAverageSize(Lines), [&]
+					  {
+						  Escaped.clear();
+						  InfluxEscape::AppendEscaped(Escaped, Lines[Next++ % Lines.size()], InfluxEscape::Context::FieldString);
+						  Bench::DoNotOptimize(Escaped);
+					  });
+	}
+	InfluxEscape::SetKernel(InfluxEscape::GetBestKernel());
+}
+
+int main(int argc, char **argv)
+{
+	std::string Filter{};
+	long MinimumTime{500};
+	const char *OutputPath{nullptr};
+	for (int Argument{1}; Argument < argc; Argument++)
+	{
+		if (std::strcmp(argv[Argument], "--filter") == 0 && Argument + 1 < argc)
+		{
+			Filter = argv[++Argument];
+		}
+		else if (std::strcmp(argv[Argument], "--min-time") == 0 && Argument + 1 < argc)
+		{
+			MinimumTime = std::max(1L, std::strtol(argv[++Argument], nullptr, 10));
+		}
+		else if (std::strcmp(argv[Argument], "--output") == 0 && Argument + 1 < argc)
+		{
+			OutputPath = argv[++Argument];
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	PassiveLogWriter Log{};
+	NagiosPerfDataParser Parser{Log};
+	Bench::BenchmarkRunner Runner{std::chrono::milliseconds(MinimumTime), Filter};
+	for (const auto Shape : Shapes)
+	{
+		std::string ShapeName{Bench::GetShapeName(Shape)};
+		const auto Lines{Bench::MakePerfDataLines(Shape, LinesPerShape)};
+		std::vector<NagiosPerformanceRecord> Records{};
+		for (const auto &Line : Lines)
+		{
+			auto Record{Parser.ParseNagiosPerformanceRecord(Line)};
+			if (Record.has_value())
+			{
+				Records.push_back(std::move(Record.value()));
+			}
+		}
+		if (Records.size() != Lines.size())
+		{
+			std::fprintf(stderr, "%s: %zu of %zu lines failed to parse\n", ShapeName.c_str(), Lines.size() - Records.size(), Lines.size());
+			return 1;
+		}
+
+		RunUtilityBenchmarks(Runner, Shape, Lines, Records);
+
+		size_t Next{0};
+		Runner.Run("parse_nagios_performance_record/" + ShapeName, GetAverageSize(Lines), [&]
+					  { Bench::DoNotOptimize(Parser.ParseNagiosPerformanceRecord(Lines[Next++ % Lines.size()])); });
+
+		InfluxTranslator Translator{Log, "nagios", GetUnitConversionMap()};
+		Runner.Run("translate_nagios_data/" + ShapeName, GetAverageSize(Lines), [&]
+					  { Bench::DoNotOptimize(Translator.TranslateNagiosData(Records[Next++ % Records.size()])); });
+	}
+
+	std::FILE *Output{OutputPath != nullptr ? std::fopen(OutputPath, "w") : stdout};
+	if (Output == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", OutputPath, std::strerror(errno));
+		return 1;
+	}
+	Runner.WriteJson(Output);
+	if (Output != stdout)
+	{
+		std::fclose(Output);
+	}
+	return 0;
+}
@@ -0,0 +1,26 @@
+#include <cstdio>
+#include "allocstats.hpp"
+#include "harness.hpp"
+
+uint64_t Bench::GetAllocationCount()
+{
+	uint64_t Allocations{0};
+	for (size_t Stage{0}; Stage < AllocationStats::StageCount; Stage++)
+	{
+		Allocations += AllocationStats::GetTotals(static_cast<AllocationStage>(Stage)).Allocations;
+	}
+	return Allocations;
+}
+
+void Bench::BenchmarkRunner::WriteJson(std::FILE *Output) const
+{
+	std::fprintf(Output, "{\n  \"benchmarks\": [");
+	bool First{true};
+	for (const auto &Result : Results)
+	{
+		std::fprintf(Output, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"bytes_per_second\": %.0f, \"allocs_per_op\": %.3f}",
+						 First ? "" : ",", Result.Name.c_str(), static_cast<unsigned long long>(Result.Iterations), Result.NanosecondsPerOperation, Result.BytesPerSecond, Result.AllocationsPerOperation);
+		First = false;
+	}
+	std::fprintf(Output, "\n  ]\n}\n");
+}
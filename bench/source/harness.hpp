@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bench
+{
+	/// @brief Allocations made through global operator new since the program started, counted by the daemon's allocation hooks (allochooks.cpp)
+	uint64_t GetAllocationCount();
+
+	/// @brief Keeps the compiler from discarding a result that is otherwise unused
+	template <typename T>
+	inline void DoNotOptimize(const T &Value)
+	{
+		asm volatile("" : : "g"(&Value) : "memory");
+	}
+
+	struct BenchmarkResult
+	{
+		std::string Name{};
+		uint64_t Iterations{0};
+		double NanosecondsPerOperation{0};
+		double BytesPerSecond{0}; // 0 when the benchmark has no meaningful input size
+		double AllocationsPerOperation{0};
+	};
+
+	/// @brief Times each benchmark for at least MinimumTime after a calibration pass, then reports per-operation figures
+	class BenchmarkRunner
+	{
+	private:
+		const std::chrono::nanoseconds MinimumTime;
+		const std::string Filter;
+		std::vector<BenchmarkResult> Results{};
+
+	public:
+		BenchmarkRunner(const std::chrono::milliseconds MinimumTime, const std::string_view &Filter) : MinimumTime{MinimumTime}, Filter{Filter} {}
+		BenchmarkRunner(const BenchmarkRunner &) = delete;
+		BenchmarkRunner &operator=(const BenchmarkRunner &) = delete;
+		BenchmarkRunner(BenchmarkRunner &&) = delete;
+		BenchmarkRunner &operator=(BenchmarkRunner &&) = delete;
+
+		/// @param BytesPerOperation Input bytes one call of Operation processes, for bytes/s. 0 leaves throughput out.
+		template <typename OperationType>
+		void Run(const std::string_view &Name, const size_t BytesPerOperation, OperationType &&Operation)
+		{
+			if (!Filter.empty() && Name.find(Filter) == std::string_view::npos)
+			{
+				return;
+			}
+			Operation(); // warm caches and any lazily built state
+			uint64_t Iterations{1};
+			std::chrono::nanoseconds Elapsed{0};
+			while (true) // calibrate: double until a pass takes a tenth of the minimum time
+			{
+				auto Started{std::chrono::steady_clock::now()};
+				for (uint64_t Iteration{0}; Iteration < Iterations; Iteration++)
+				{
+					Operation();
+				}
+				Elapsed = std::chrono::steady_clock::now() - Started;
+				if (Elapsed * 10 >= MinimumTime || Iterations >= (uint64_t{1} << 40))
+				{
+					break;
+				}
+				Iterations *= 2;
+			}
+			Iterations = std::max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(Iterations) * static_cast<double>(MinimumTime.count()) / static_cast<double>(std::max<int64_t>(Elapsed.count(), 1))));
+
+			uint64_t AllocationsBefore{GetAllocationCount()};
+			auto Started{std::chrono::steady_clock::now()};
+			for (uint64_t Iteration{0}; Iteration < Iterations; Iteration++)
+			{
+				Operation();
+			}
+			Elapsed = std::chrono::steady_clock::now() - Started;
+			uint64_t Allocations{GetAllocationCount() - AllocationsBefore};
+
+			BenchmarkResult &Result{Results.emplace_back()};
+			Result.Name = Name;
+			Result.Iterations = Iterations;
+			Result.NanosecondsPerOperation = static_cast<double>(Elapsed.count()) / static_cast<double>(Iterations);
+			Result.BytesPerSecond = BytesPerOperation > 0 ? static_cast<double>(BytesPerOperation) * 1e9 / Result.NanosecondsPerOperation : 0;
+			Result.AllocationsPerOperation = static_cast<double>(Allocations) / static_cast<double>(Iterations);
+			std::fprintf(stderr, "%-48s %12.1f ns/op %10.1f MB/s %8.2f allocs/op\n", Result.Name.c_str(), Result.NanosecondsPerOperation, Result.BytesPerSecond / 1e6, Result.AllocationsPerOperation);
+		}
+
+		const std::vector<BenchmarkResult> &GetResults() const { return Results; }
+
+		/// @brief Writes {"benchmarks":[{"name","iterations","ns_per_op","bytes_per_second","allocs_per_op"}...]}
+		void WriteJson(std::FILE *Output) const;
+	};
+}
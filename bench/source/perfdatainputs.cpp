@@ -0,0 +1,141 @@
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "perfdatainputs.hpp"
+
+constexpr const std::array<std::string_view, 8> ServiceNames{"CPU Load", "Disk Usage", "PING", "Memory", "HTTP", "Swap", "Network eth0", "Current Users"};
+constexpr const std::array<std::string_view, 10> PlainLabels{"load1", "load5", "load15", "rta", "pl", "used", "/var", "/home", "time", "size"};
+constexpr const std::array<std::string_view, 6> EscapedLabels{"disk\\ used", "C:\\ Label", "if\\,eth0", "q\\=1", "/srv/data\\ 01", "total\\ time"};
+constexpr const std::array<std::string_view, 8> Units{"", "%", "ms", "s", "B", "KB", "MB", "c"};
+
+// helper functions
+// small, fast and deterministic, which is all the inputs need
+static uint32_t NextRandom(uint32_t &State)
+{
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
+
+static void AppendValue(std::string &Line, uint32_t &State)
+{
+	Line.append(std::to_string(NextRandom(State) % 1000));
+	if (NextRandom(State) % 2 == 0)
+	{
+		Line.append(1, '.').append(std::to_string(NextRandom(State) % 100));
+	}
+}
+
+static void AppendSparseItem(std::string &Line, uint32_t &State)
+{
+	Line.append(PlainLabels[NextRandom(State) % PlainLabels.size()]).append(1, '=');
+	AppendValue(Line, State);
+	switch (NextRandom(State) % 3)
+	{
+	case 0: // no warn, so crit follows two semicolons
+		Line.append(";;");
+		AppendValue(Line, State);
+		break;
+	case 1: // warn and nothing else, with the semicolon some plugins leave behind
+		Line.append(1, ';');
+		AppendValue(Line, State);
+		Line.append(1, ';');
+		break;
+	default: // crit and max, every other field empty
+		Line.append(";;");
+		AppendValue(Line, State);
+		Line.append(";;1000");
+		break;
+	}
+}
+
+static void AppendItem(std::string &Line, const bool Escaped, uint32_t &State)
+{
+	if (Escaped && NextRandom(State) % 2 == 0)
+	{
+		Line.append(EscapedLabels[NextRandom(State) % EscapedLabels.size()]);
+	}
+	else
+	{
+		Line.append(PlainLabels[NextRandom(State) % PlainLabels.size()]);
+	}
+	Line.append(1, '=');
+	AppendValue(Line, State);
+	Line.append(Units[NextRandom(State) % Units.size()]);
+	switch (NextRandom(State) % 4)
+	{
+	case 0: // value only
+		break;
+	case 1: // warn and crit as ranges, which are not numbers and travel as strings
+		Line.append(";~:80;@90:100");
+		break;
+	default: // warn, crit, min, max
+		Line.append(1, ';');
+		AppendValue(Line, State);
+		Line.append(1, ';');
+		AppendValue(Line, State);
+		Line.append(";0;1000");
+		break;
+	}
+}
+
+// public functions
+std::string_view Bench::GetShapeName(const PerfDataShape Shape)
+{
+	switch (Shape)
+	{
+	case PerfDataShape::Single:
+		return "single";
+	case PerfDataShape::Typical:
+		return "typical";
+	case PerfDataShape::Large:
+		return "large";
+	case PerfDataShape::Escaped:
+		return "escaped";
+	default:
+		return "sparse";
+	}
+}
+
+std::vector<std::string> Bench::MakePerfDataLines(const PerfDataShape Shape, const size_t Count, const uint32_t Seed)
+{
+	uint32_t State{Seed != 0 ? Seed : 1};
+	std::vector<std::string> Lines{};
+	Lines.reserve(Count);
+	for (size_t Index{0}; Index < Count; Index++)
+	{
+		size_t Items{1};
+		switch (Shape)
+		{
+		case PerfDataShape::Single:
+			break;
+		case PerfDataShape::Large:
+			Items = 20 + NextRandom(State) % 11;
+			break;
+		default:
+			Items = 3 + NextRandom(State) % 6;
+			break;
+		}
+		std::string &Line{Lines.emplace_back()};
+		Line.append(std::to_string(1700000000 + Index)).append(1, '\t');
+		Line.append("web-").append(std::to_string(NextRandom(State) % 500)).append(".dc1.example.com\t");
+		Line.append(ServiceNames[NextRandom(State) % ServiceNames.size()]).append(1, '\t');
+		for (size_t Item{0}; Item < Items; Item++)
+		{
+			if (Shape == PerfDataShape::Sparse)
+			{
+				AppendSparseItem(Line, State);
+				Line.append(NextRandom(State) % 2 == 0 ? "  " : " "); // the last one leaves a trailing separator
+				continue;
+			}
+			if (Item > 0)
+			{
+				Line.append(1, ' ');
+			}
+			AppendItem(Line, Shape == PerfDataShape::Escaped, State);
+		}
+	}
+	return Lines;
+}
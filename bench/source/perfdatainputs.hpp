@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Bench
+{
+	enum class PerfDataShape
+	{
+		Single,	// one item, as from check_ping's packet loss or a single counter
+		Typical, // three to eight items with thresholds, the bulk of a real spool
+		Large,	// twenty to thirty items, as from check_disk across many mounts or SNMP interface checks
+		Escaped, // typical item counts with escaped spaces, commas and equals signs in labels
+		Sparse	// typical item counts with empty thresholds, doubled separators and trailing ones, as in "load=1;;5; "
+	};
+
+	std::string_view GetShapeName(const PerfDataShape Shape);
+
+	/// @brief Builds tab-separated Nagios perfdata lines ($TIMET$, $HOSTNAME$, $SERVICEDESC$, $SERVICEPERFDATA$). The same seed always gives the same lines.
+	std::vector<std::string> MakePerfDataLines(const PerfDataShape Shape, const size_t Count, const uint32_t Seed = 1);
+}
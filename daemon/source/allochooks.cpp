@@ -0,0 +1,42 @@
+#include <cstdlib>
+#include <new>
+#include "allocstats.hpp"
+
+// counting replacements for the global allocation functions, see allocstats.hpp. Linked into the daemon only when built
+// with ALLOC_STATS=1, and always into the microbenchmarks, which read the totals; the aligned and nothrow forms are left
+// to the library
+void *operator new(size_t Size)
+{
+	AllocationStats::Record(Size);
+	void *Allocated{std::malloc(Size > 0 ? Size : 1)};
+	if (Allocated == nullptr)
+	{
+		std::abort(); // built without exceptions, so there is no bad_alloc to throw
+	}
+	return Allocated;
+}
+
+void *operator new[](size_t Size)
+{
+	return operator new(Size);
+}
+
+void operator delete(void *Allocated) noexcept
+{
+	std::free(Allocated);
+}
+
+void operator delete[](void *Allocated) noexcept
+{
+	std::free(Allocated);
+}
+
+void operator delete(void *Allocated, size_t) noexcept
+{
+	std::free(Allocated);
+}
+
+void operator delete[](void *Allocated, size_t) noexcept
+{
+	std::free(Allocated);
+}
@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <vector>
+#include "allocstats.hpp"
+#include "metrics.hpp"
+
+// helper functions
+static double Divide(const uint64_t Value, const uint64_t Units)
+{
+	return Units > 0 ? static_cast<double>(Value) / static_cast<double>(Units) : 0;
+}
+
+static AllocationStats::StageReport MakeStageReport(const std::string_view &Name, const AllocationStats::Totals &Counted, const uint64_t Lines, const uint64_t Points)
+{
+	return {Name, Counted, Divide(Counted.Allocations, Lines), Divide(Counted.Bytes, Lines), Divide(Counted.Allocations, Points), Divide(Counted.Bytes, Points)};
+}
+
+// public functions
+std::vector<AllocationStats::StageReport> AllocationStats::GetReport()
+{
+	auto &Metrics{MetricsRegistry::Get()};
+	const uint64_t Lines{Metrics.GetCounter(MetricCounters::LinesRead)};
+	uint64_t Points{Metrics.GetCounter(MetricCounters::PointsTranslated)};
+	if (Points == 0)
+	{
+		Points = Metrics.GetCounter(MetricCounters::SinkPointsDelivered);
+	}
+
+	std::vector<StageReport> Report{};
+	Report.reserve(StageCount + 1);
+	Totals AllStages{};
+	for (size_t Index{0}; Index < StageCount; Index++)
+	{
+		Totals Counted{GetTotals(static_cast<AllocationStage>(Index))};
+		AllStages.Allocations += Counted.Allocations;
+		AllStages.Bytes += Counted.Bytes;
+		Report.push_back(MakeStageReport(StageNames[Index], Counted, Lines, Points));
+	}
+	Report.push_back(MakeStageReport("total", AllStages, Lines, Points));
+	return Report;
+}
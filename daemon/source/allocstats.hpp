@@ -0,0 +1,106 @@
+#pragma once
+
+// Allocation accounting by pipeline stage, for verifying and guarding allocation-elimination work. Built in with
+// ALLOC_STATS=1 (-DXLAT_ALLOC_STATS), which replaces the global operator new and delete (allochooks.cpp) with versions that
+// count every allocation and its size against the stage the allocating thread is in. Otherwise AllocationScope is empty
+// and nothing is counted.
+//
+// stage      entered by
+// read       FileDataCollector: listing the spool directory, reading files and splitting them into lines
+// parse      NagiosPerfDataParser::ParseNagiosPerformanceRecord
+// translate  BatchingSink::Submit: each sink's translation of a record and its queueing for the next request
+// send       BatchingSink::Flush: building and sending a request (curl allocates with malloc, which is not counted)
+// log        the log writer thread; entries are formatted there, so deferred log arguments count here
+// other      everything else, such as building reader batches and the status server
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum class AllocationStage : size_t
+{
+	Other,
+	Read,
+	Parse,
+	Translate,
+	Send,
+	Log,
+	Count
+};
+
+namespace AllocationStats
+{
+#ifdef XLAT_ALLOC_STATS
+	constexpr const bool Enabled{true};
+#else
+	constexpr const bool Enabled{false};
+#endif
+	constexpr const size_t StageCount{static_cast<size_t>(AllocationStage::Count)};
+	constexpr const std::array<std::string_view, StageCount> StageNames{"other", "read", "parse", "translate", "send", "log"};
+
+	struct alignas(64) StageCounters
+	{
+		std::atomic<uint64_t> Allocations{0};
+		std::atomic<uint64_t> Bytes{0};
+	};
+
+	// constant-initialized, so they are usable from operator new before any constructor has run
+	inline std::array<StageCounters, StageCount> Counters{};
+	inline thread_local AllocationStage CurrentStage{AllocationStage::Other};
+
+	inline void Record(const size_t Size)
+	{
+		auto &Stage{Counters[static_cast<size_t>(CurrentStage)]};
+		Stage.Allocations.fetch_add(1, std::memory_order_relaxed);
+		Stage.Bytes.fetch_add(Size, std::memory_order_relaxed);
+	}
+
+	struct Totals
+	{
+		uint64_t Allocations{0};
+		uint64_t Bytes{0};
+	};
+
+	inline Totals GetTotals(const AllocationStage Stage)
+	{
+		const auto &Counted{Counters[static_cast<size_t>(Stage)]};
+		return {Counted.Allocations.load(std::memory_order_relaxed), Counted.Bytes.load(std::memory_order_relaxed)};
+	}
+
+	struct StageReport
+	{
+		std::string_view Name{};
+		Totals Counted{};
+		double AllocationsPerLine{0};
+		double BytesPerLine{0};
+		double AllocationsPerPoint{0};
+		double BytesPerPoint{0};
+	};
+
+	/// @brief Every stage's totals, divided by the lines read and by the points translated (the Influx translator's count, or
+	/// the points sinks delivered when it is not in use), followed by a row named "total" for all stages together
+	std::vector<StageReport> GetReport();
+}
+
+/// @brief Counts the calling thread's allocations against Stage until destroyed, then goes back to the previous stage
+class AllocationScope
+{
+#ifdef XLAT_ALLOC_STATS
+private:
+	AllocationStage Previous;
+
+public:
+	explicit AllocationScope(const AllocationStage Stage) : Previous{AllocationStats::CurrentStage} { AllocationStats::CurrentStage = Stage; }
+	~AllocationScope() { AllocationStats::CurrentStage = Previous; }
+#else
+public:
+	explicit AllocationScope(const AllocationStage) {}
+#endif
+	AllocationScope(const AllocationScope &) = delete;
+	AllocationScope &operator=(const AllocationScope &) = delete;
+	AllocationScope(AllocationScope &&) = delete;
+	AllocationScope &operator=(AllocationScope &&) = delete;
+};
@@ -8,12 +8,11 @@
 bool AppLock::operator()()
 {
 	std::error_code ErrorCode{};
-	std::filesystem::path LockPath{"/var/run"};
-	LockPath /= ConfigConstants::appname;
+	std::filesystem::path LockPath{LockDirectory};
 
 	if (!std::filesystem::exists(LockPath, ErrorCode))
 	{
-		std::filesystem::create_directory(LockPath, ErrorCode);
+		std::filesystem::create_directories(LockPath, ErrorCode);
 	}
 
 	if (ErrorCode.value() != 0)
@@ -21,7 +20,14 @@ bool AppLock::operator()()
 		std::fprintf(stderr, "Failed to create lock directory: %s\n", ErrorCode.message().c_str());
 		return false;
 	}
-	LockPath /= ConfigConstants::DaemonLockFileName;
+	if (Instance.empty())
+	{
+		LockPath /= ConfigConstants::DaemonLockFileName;
+	}
+	else
+	{
+		LockPath /= std::string{ConfigConstants::InstanceLockFilePrefix} + Instance + ".lock";
+	}
 	LockFile = std::fopen(LockPath.c_str(), "w");
 	if (LockFile == nullptr)
 	{
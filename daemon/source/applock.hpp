@@ -1,12 +1,19 @@
 #pragma once
 
+#include <string>
+#include <string_view>
+
 class AppLock
 {
 private:
 	void *LockFile{nullptr};
+	std::string LockDirectory;
+	std::string Instance;
 
 public:
-	AppLock() = default;
+	/// @param LockDirectory Holds the lock file, created if missing
+	/// @param Instance Locks only this named instance, so several can run on one host, or the whole daemon if empty
+	explicit AppLock(const std::string_view &LockDirectory, const std::string_view &Instance = "") : LockDirectory{LockDirectory}, Instance{Instance} {}
 	~AppLock();
 	AppLock(const AppLock &) = delete;
 	AppLock &operator=(const AppLock &) = delete;
@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <filesystem>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <set>
+#include <thread>
 #include "config_constants.hpp"
 #include "config.hpp"
 #include "logwriter.hpp"
@@ -9,8 +12,8 @@
 #define TOML_EXCEPTIONS 0
 #include "tomlplusplus/include/toml++/toml.hpp"
 
-constexpr const std::string_view config_file{"/etc/" __XLATPERF_PACKAGE_NAME__ "/" __XLATPERF_PACKAGE_NAME__ "d.toml"};
 constexpr const std::string_view ConfigurationLoaded{"Configuration loaded"};
+constexpr const std::string_view UnknownPrecision{"Unknown Influx timestamp precision, using default"};
 
 // log levels
 static const std::map<const std::string_view, const LogLevels> LogLevelsMap{
@@ -20,6 +23,13 @@ static const std::map<const std::string_view, const LogLevels> LogLevelsMap{
 	 {ConfigConstants::Values::error, LogLevels::Error},
 	 {ConfigConstants::Values::fatal, LogLevels::Fatal}};
 
+// timestamp precisions
+static const std::set<std::string_view> PrecisionsSet{
+	 ConfigConstants::Values::precisionSeconds,
+	 ConfigConstants::Values::precisionMilliseconds,
+	 ConfigConstants::Values::precisionMicroseconds,
+	 ConfigConstants::Values::precisionNanoseconds};
+
 template <typename T>
 concept has_size = requires(T t) {
 	{ t.size() } -> std::convertible_to<std::size_t>;
@@ -167,21 +177,29 @@ static std::unique_ptr<ILogWriter> GetLog(const toml::table &TomlConfig)
 		{
 			WritesFailedFileName = "";
 		}
-		return LogWriterFactory::CreateLogWriter(LogLevel, ConfigConstants::LogRootPath, ConfigConstants::DaemonLogFileName, WritesFailedFileName, LogFailedWrites);
+		const std::string LogOutputString{GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::output, ConfigConstants::DefaultValues::logOutput)};
+		LogOutputs LogOutput{LogOutputString == ConfigConstants::Values::outputJournal ? LogOutputs::Journal : LogOutputs::File};
+		const std::string JournalSocketPath{GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::journalSocket, ConfigConstants::DefaultValues::journalSocket)};
+		const std::string LogDirectory{GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::directory, ConfigConstants::DefaultValues::logDirectory)};
+		FailedWritesSettings FailedWritesStorage{
+			 static_cast<size_t>(std::max(0L, GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::failedWritesSegmentSize, ConfigConstants::DefaultValues::failedWritesSegmentSize))) * 1024 * 1024,
+			 std::chrono::seconds{std::max(0L, GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::failedWritesSegmentAge, ConfigConstants::DefaultValues::failedWritesSegmentAge))},
+			 GetConfigurationValueOrDefault(TomlLogConfig, ConfigConstants::Fields::failedWritesCompress, ConfigConstants::DefaultValues::failedWritesCompress)};
+		return LogWriterFactory::CreateLogWriter(LogLevel, LogDirectory, ConfigConstants::DaemonLogFileName, WritesFailedFileName, LogFailedWrites, FailedWritesStorage, LogOutput, JournalSocketPath);
 	}
 
 	return LogWriterFactory::CreateEmptyLogWriter();
 }
 
-std::unique_ptr<ILogWriter> Configuration::Load()
+std::unique_ptr<ILogWriter> Configuration::Load(const std::string_view &ConfigurationFile)
 {
 	toml::table TomlConfig;
-	if (std::filesystem::exists(config_file))
+	if (std::filesystem::exists(ConfigurationFile))
 	{
-		auto TomlParseResult{toml::parse_file(config_file)};
+		auto TomlParseResult{toml::parse_file(ConfigurationFile)};
 		if (!TomlParseResult)
 		{
-			std::cerr << "Unable to parse configuration file (" << config_file << "): " << TomlParseResult.error() << std::endl;
+			std::cerr << "Unable to parse configuration file (" << ConfigurationFile << "): " << TomlParseResult.error() << std::endl;
 		}
 		else
 		{
@@ -197,17 +215,86 @@ std::unique_ptr<ILogWriter> Configuration::Load()
 
 	auto DaemonConfigTable{TomlConfig.contains(ConfigConstants::Headers::daemon) ? *TomlConfig[ConfigConstants::Headers::daemon].as_table() : toml::table{}};
 	DataReadDelay = GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::delay, ConfigConstants::DefaultValues::dataReadDelay);
+	RetryDelay = std::max(1, GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::retryDelay, ConfigConstants::DefaultValues::retryDelay));
+	SelfMonitoringInterval = std::max(0, GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::selfMonitoringInterval, ConfigConstants::DefaultValues::selfMonitoringInterval));
+	LagThreshold = std::max(0, GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::lagThreshold, ConfigConstants::DefaultValues::lagThreshold));
+	CatchUpThreshold = std::max(0, GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::catchUpThreshold, ConfigConstants::DefaultValues::catchUpThreshold));
+	CatchUpWorkers = GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::catchUpWorkers, ConfigConstants::DefaultValues::catchUpWorkers);
+	if (CatchUpWorkers <= 0)
+	{
+		CatchUpWorkers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	}
+	CatchUpBatchScale = std::max(1, GetConfigurationValueOrDefault(DaemonConfigTable, ConfigConstants::Fields::catchUpBatchScale, ConfigConstants::DefaultValues::catchUpBatchScale));
 
 	auto InfluxConfigTable{TomlConfig.contains(ConfigConstants::Headers::influx) ? *TomlConfig[ConfigConstants::Headers::influx].as_table() : toml::table{}};
-	InfluxHostName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::host, ConfigConstants::DefaultValues::influxHostName);
-	InfluxDatabaseName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::database, ConfigConstants::DefaultValues::influxDatabaseName);
-	InfluxMeasurementName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::measurement, ConfigConstants::DefaultValues::influxMetricName);
-	InfluxPort = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::port, ConfigConstants::DefaultValues::influxPort);
+	Influx.Enabled = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::enabled, ConfigConstants::DefaultValues::influxEnabled);
+	Influx.HostName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::host, ConfigConstants::DefaultValues::influxHostName);
+	Influx.DatabaseName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::database, ConfigConstants::DefaultValues::influxDatabaseName);
+	Influx.MeasurementName = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::measurement, ConfigConstants::DefaultValues::influxMetricName);
+	Influx.Port = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::port, ConfigConstants::DefaultValues::influxPort);
+	Influx.ApiVersion = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::version, ConfigConstants::DefaultValues::influxVersion) >= 2 ? InfluxApiVersion::V2 : InfluxApiVersion::V1;
+	Influx.Organization = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::organization, ConfigConstants::DefaultValues::influxOrganization);
+	Influx.Bucket = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::bucket, ConfigConstants::DefaultValues::influxBucket);
+	if (Influx.Bucket.empty())
+	{
+		Influx.Bucket = Influx.DatabaseName;
+	}
+	Influx.Token = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::token, ConfigConstants::DefaultValues::influxToken);
+	Influx.Precision = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::precision, ConfigConstants::DefaultValues::influxPrecision);
+	if (!PrecisionsSet.contains(Influx.Precision))
+	{
+		Log->WriteWarnAnnotated(UnknownPrecision, Influx.Precision, ConfigConstants::DefaultValues::influxPrecision);
+		Influx.Precision = std::string{ConfigConstants::DefaultValues::influxPrecision};
+	}
+	Influx.BatchSize = std::max(1L, GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::batchSize, ConfigConstants::DefaultValues::influxBatchSize));
+	Influx.MaxPending = std::max(0L, GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::maxPending, ConfigConstants::DefaultValues::maxPending));
+	Influx.SuppressUnchangedThresholds = GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::suppressUnchangedThresholds, ConfigConstants::DefaultValues::suppressUnchangedThresholds);
+	Influx.ThresholdRefresh = std::max(0L, GetConfigurationValueOrDefault(InfluxConfigTable, ConfigConstants::Fields::thresholdRefresh, ConfigConstants::DefaultValues::thresholdRefresh));
 	// todo: protocol
-	// todo: user/pass
+
+	auto InfluxUdpConfigTable{TomlConfig.contains(ConfigConstants::Headers::influxUdp) ? *TomlConfig[ConfigConstants::Headers::influxUdp].as_table() : toml::table{}};
+	InfluxUdp.Enabled = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::enabled, ConfigConstants::DefaultValues::influxUdpEnabled);
+	InfluxUdp.HostName = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::host, ConfigConstants::DefaultValues::influxHostName);
+	InfluxUdp.Port = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::port, ConfigConstants::DefaultValues::influxUdpPort);
+	InfluxUdp.MeasurementName = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::measurement, ConfigConstants::DefaultValues::influxMetricName);
+	InfluxUdp.Precision = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::precision, ConfigConstants::DefaultValues::influxUdpPrecision);
+	if (!PrecisionsSet.contains(InfluxUdp.Precision))
+	{
+		Log->WriteWarnAnnotated(UnknownPrecision, InfluxUdp.Precision, ConfigConstants::DefaultValues::influxUdpPrecision);
+		InfluxUdp.Precision = std::string{ConfigConstants::DefaultValues::influxUdpPrecision};
+	}
+	InfluxUdp.Mtu = std::max(0L, GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::mtu, ConfigConstants::DefaultValues::influxUdpMtu));
+	InfluxUdp.Burst = std::max(1L, GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::burst, ConfigConstants::DefaultValues::influxUdpBurst));
+	InfluxUdp.SuppressUnchangedThresholds = GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::suppressUnchangedThresholds, ConfigConstants::DefaultValues::suppressUnchangedThresholds);
+	InfluxUdp.ThresholdRefresh = std::max(0L, GetConfigurationValueOrDefault(InfluxUdpConfigTable, ConfigConstants::Fields::thresholdRefresh, ConfigConstants::DefaultValues::thresholdRefresh));
+
+	auto PrometheusConfigTable{TomlConfig.contains(ConfigConstants::Headers::prometheus) ? *TomlConfig[ConfigConstants::Headers::prometheus].as_table() : toml::table{}};
+	Prometheus.Enabled = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::enabled, ConfigConstants::DefaultValues::prometheusEnabled);
+	Prometheus.HostName = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::host, ConfigConstants::DefaultValues::prometheusHostName);
+	Prometheus.Port = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::port, ConfigConstants::DefaultValues::prometheusPort);
+	Prometheus.Path = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::path, ConfigConstants::DefaultValues::prometheusPath);
+	Prometheus.MetricPrefix = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::metricPrefix, ConfigConstants::DefaultValues::prometheusMetricPrefix);
+	Prometheus.BatchSize = std::max(1L, GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::batchSize, ConfigConstants::DefaultValues::prometheusBatchSize));
+	Prometheus.MaxPending = std::max(0L, GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::maxPending, ConfigConstants::DefaultValues::maxPending));
+	Prometheus.BearerToken = GetConfigurationValueOrDefault(PrometheusConfigTable, ConfigConstants::Fields::bearerToken, ConfigConstants::DefaultValues::prometheusBearerToken);
+
+	auto StatusConfigTable{TomlConfig.contains(ConfigConstants::Headers::status) ? *TomlConfig[ConfigConstants::Headers::status].as_table() : toml::table{}};
+	Status.Enabled = GetConfigurationValueOrDefault(StatusConfigTable, ConfigConstants::Fields::enabled, ConfigConstants::DefaultValues::statusEnabled);
+	Status.HostName = GetConfigurationValueOrDefault(StatusConfigTable, ConfigConstants::Fields::host, ConfigConstants::DefaultValues::statusHostName);
+	Status.Port = GetConfigurationValueOrDefault(StatusConfigTable, ConfigConstants::Fields::port, ConfigConstants::DefaultValues::statusPort);
+	Status.SocketPath = GetConfigurationValueOrDefault(StatusConfigTable, ConfigConstants::Fields::socket, ConfigConstants::DefaultValues::statusSocket);
+
+	auto CaptureConfigTable{TomlConfig.contains(ConfigConstants::Headers::capture) ? *TomlConfig[ConfigConstants::Headers::capture].as_table() : toml::table{}};
+	Capture.Enabled = GetConfigurationValueOrDefault(CaptureConfigTable, ConfigConstants::Fields::enabled, ConfigConstants::DefaultValues::captureEnabled);
+	Capture.Directory = GetConfigurationValueOrDefault(CaptureConfigTable, ConfigConstants::Fields::directory, ConfigConstants::DefaultValues::captureDirectory);
+	Capture.MaxBytes = static_cast<size_t>(std::max(1L, GetConfigurationValueOrDefault(CaptureConfigTable, ConfigConstants::Fields::maxSize, ConfigConstants::DefaultValues::captureMaxSize))) * 1024 * 1024;
+	Capture.Key = GetConfigurationValueOrDefault(CaptureConfigTable, ConfigConstants::Fields::key, ConfigConstants::DefaultValues::captureKey);
 
 	auto NagiosConfigTable{TomlConfig.contains(ConfigConstants::Headers::nagios) ? *TomlConfig[ConfigConstants::Headers::nagios].as_table() : toml::table{}};
 	NagiosSpoolDirectory = GetConfigurationValueOrDefault(NagiosConfigTable, ConfigConstants::Fields::spoolDirectory, ConfigConstants::DefaultValues::nagiosSpoolDirectory);
+	ClaimLimit = std::max(0, GetConfigurationValueOrDefault(NagiosConfigTable, ConfigConstants::Fields::claimLimit, ConfigConstants::DefaultValues::claimLimit));
+	SharedSpool = GetConfigurationValueOrDefault(NagiosConfigTable, ConfigConstants::Fields::shared, ConfigConstants::DefaultValues::sharedSpool);
+	ClaimExpiry = std::max(ConfigConstants::DefaultValues::minimumClaimExpiry, GetConfigurationValueOrDefault(NagiosConfigTable, ConfigConstants::Fields::claimExpiry, ConfigConstants::DefaultValues::claimExpiry));
 
 	UnitConversionMap = GetConfigurationValueOrDefault(TomlConfig, ConfigConstants::Headers::unitConversionMap, std::function(GetDefaultConversionMap));
 	Log->WriteInfo(ConfigurationLoaded);
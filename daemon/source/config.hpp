@@ -7,21 +7,102 @@
 
 #include <iostream>
 
+enum class InfluxApiVersion
+{
+	V1, // /query and /write?db=
+	V2	 // /api/v2/write?org=&bucket=, also accepted by InfluxDB 3.x
+};
+
+class InfluxConfiguration
+{
+public:
+	bool Enabled{true};
+	std::string HostName{};
+	long Port{};
+	InfluxApiVersion ApiVersion{InfluxApiVersion::V1};
+	std::string DatabaseName{};
+	std::string MeasurementName{};
+	std::string Organization{};
+	std::string Bucket{};
+	std::string Token{};
+	std::string Precision{};
+	size_t BatchSize{};
+	size_t MaxPending{};
+	bool SuppressUnchangedThresholds{false};
+	long ThresholdRefresh{};
+};
+
+class InfluxUdpConfiguration
+{
+public:
+	bool Enabled{false};
+	std::string HostName{};
+	long Port{};
+	std::string MeasurementName{};
+	std::string Precision{};
+	size_t Mtu{};
+	size_t Burst{};
+	bool SuppressUnchangedThresholds{false};
+	long ThresholdRefresh{};
+};
+
+class PrometheusConfiguration
+{
+public:
+	bool Enabled{false};
+	std::string HostName{};
+	long Port{};
+	std::string Path{};
+	std::string MetricPrefix{};
+	size_t BatchSize{};
+	size_t MaxPending{};
+	std::string BearerToken{};
+};
+
+class StatusConfiguration
+{
+public:
+	bool Enabled{false};
+	std::string HostName{};
+	long Port{};
+	std::string SocketPath{}; // listens on this Unix socket instead of TCP when set
+};
+
+class CaptureConfiguration
+{
+public:
+	bool Enabled{false};
+	std::string Directory{};
+	size_t MaxBytes{};
+	std::string Key{}; // 32 hex digits, empty to use a key generated on first use
+};
+
 class Configuration
 {
 public:
 	int DataReadDelay{0};
+	int RetryDelay{0};
+	int SelfMonitoringInterval{0}; // seconds, 0 disables
+	int LagThreshold{0};			  // seconds, 0 disables
+	int CatchUpThreshold{0};	  // spool files, 0 disables catch-up mode
+	int CatchUpWorkers{0};		  // files read at once in catch-up mode
+	int CatchUpBatchScale{0};	  // multiplies the reader batch and each sink's batch_size and max_pending in catch-up mode
 	std::map<const std::string, const std::string> UnitConversionMap{};
-	std::string InfluxHostName{};
-	long InfluxPort{};
-	std::string InfluxDatabaseName{};
-	std::string InfluxMeasurementName{};
+	InfluxConfiguration Influx{};
+	InfluxUdpConfiguration InfluxUdp{};
+	PrometheusConfiguration Prometheus{};
+	StatusConfiguration Status{};
+	CaptureConfiguration Capture{};
 	std::string NagiosSpoolDirectory{};
+	int ClaimLimit{0}; // spool files taken per collection cycle, 0 for all of them
+	bool SharedSpool{false}; // other daemons drain the same spool, claim files before reading them
+	int ClaimExpiry{0};		 // seconds without lease renewal before a daemon's claims go back to the spool
 
 	Configuration() = default;
 	~Configuration() = default;
 
 	/// @brief Loads the current configuration from disk, if available. Otherwise, loads defaults. Generates a log writer based on the loaded configuration.
+	/// @param ConfigurationFile TOML file to read
 	/// @return std::unique_ptr<ILogWriter> The log writer to use for the duration of the program.
-	std::unique_ptr<ILogWriter> Load();
+	std::unique_ptr<ILogWriter> Load(const std::string_view &ConfigurationFile);
 };
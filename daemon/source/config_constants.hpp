@@ -9,17 +9,27 @@ namespace ConfigConstants
 {
 	constexpr const std::string_view packagename{__XLATPERF_PACKAGE_NAME__};
 	constexpr const std::string_view appname{__XLATPERF_PACKAGE_NAME__ "d\0"}; // used in C APIs, do not assume NUL-termination
+	constexpr const std::string_view ConfigurationFile{"/etc/" __XLATPERF_PACKAGE_NAME__ "/" __XLATPERF_PACKAGE_NAME__ "d.toml"};
 	constexpr const std::string_view LogRootPath{"/var/log/" __XLATPERF_PACKAGE_NAME__};
+	constexpr const std::string_view LockRootPath{"/var/run/" __XLATPERF_PACKAGE_NAME__ "d"};
+	constexpr const std::string_view StateRootPath{"/var/lib/" __XLATPERF_PACKAGE_NAME__};
+	constexpr const std::string_view ThresholdSnapshotExtension{".thresholds"};
 	constexpr const std::string_view DaemonLogFileName{"daemon.log"};
 	constexpr const std::string_view DaemonLockFileName{"daemon.lock"};
+	constexpr const std::string_view InstanceLockFilePrefix{"daemon-"}; // followed by the instance name and .lock
 	constexpr const std::string_view FailedWritesFileName{"failed_writes.log"};
+	constexpr const std::string_view CaptureKeyFileName{"capture.key"};
 
 	namespace Headers
 	{
 		constexpr const std::string_view daemon{"daemon"};
 		constexpr const std::string_view logging{"logging"};
 		constexpr const std::string_view influx{"influx"};
+		constexpr const std::string_view influxUdp{"influx_udp"};
 		constexpr const std::string_view nagios{"nagios"};
+		constexpr const std::string_view prometheus{"prometheus"};
+		constexpr const std::string_view status{"status"};
+		constexpr const std::string_view capture{"capture"};
 		constexpr const std::string_view unitConversionMap{"unit_conversion_map"};
 	};
 
@@ -28,14 +38,46 @@ namespace ConfigConstants
 		constexpr const std::string_view delay{"delay"};
 		constexpr const std::string_view enabled{"enabled"};
 		constexpr const std::string_view level{"level"};
+		constexpr const std::string_view directory{"directory"};
 		constexpr const std::string_view save_failed_writes{"save_failed_writes"};
 		constexpr const std::string_view failed_writes_failback{"failed_writes_fallback"};
+		constexpr const std::string_view output{"output"};
+		constexpr const std::string_view failedWritesSegmentSize{"failed_writes_segment_mb"};
+		constexpr const std::string_view failedWritesSegmentAge{"failed_writes_segment_age"};
+		constexpr const std::string_view failedWritesCompress{"failed_writes_compress"};
+		constexpr const std::string_view journalSocket{"journal_socket"};
 		constexpr const std::string_view host{"host"};
 		constexpr const std::string_view port{"port"};
 		constexpr const std::string_view database{"database"};
 		constexpr const std::string_view measurement{"measurement"};
 		constexpr const std::string_view protocol{"protocol"};
+		constexpr const std::string_view version{"version"};
+		constexpr const std::string_view organization{"org"};
+		constexpr const std::string_view bucket{"bucket"};
+		constexpr const std::string_view token{"token"};
+		constexpr const std::string_view precision{"precision"};
+		constexpr const std::string_view path{"path"};
+		constexpr const std::string_view metricPrefix{"metric_prefix"};
+		constexpr const std::string_view batchSize{"batch_size"};
+		constexpr const std::string_view bearerToken{"bearer_token"};
+		constexpr const std::string_view maxPending{"max_pending"};
+		constexpr const std::string_view retryDelay{"retry_delay"};
+		constexpr const std::string_view selfMonitoringInterval{"self_monitoring_interval"};
+		constexpr const std::string_view lagThreshold{"lag_threshold"};
+		constexpr const std::string_view catchUpThreshold{"catchup_threshold"};
+		constexpr const std::string_view catchUpWorkers{"catchup_workers"};
+		constexpr const std::string_view catchUpBatchScale{"catchup_batch_scale"};
+		constexpr const std::string_view suppressUnchangedThresholds{"suppress_unchanged_thresholds"};
+		constexpr const std::string_view thresholdRefresh{"threshold_refresh"};
+		constexpr const std::string_view mtu{"mtu"};
+		constexpr const std::string_view burst{"burst"};
 		constexpr const std::string_view spoolDirectory{"spool_directory"};
+		constexpr const std::string_view claimLimit{"claim_limit"};
+		constexpr const std::string_view shared{"shared"};
+		constexpr const std::string_view claimExpiry{"claim_expiry"};
+		constexpr const std::string_view socket{"socket"};
+		constexpr const std::string_view maxSize{"max_mb"};
+		constexpr const std::string_view key{"key"};
 	};
 
 	namespace Values
@@ -45,17 +87,69 @@ namespace ConfigConstants
 		constexpr const std::string_view warn{"warn"};
 		constexpr const std::string_view error{"error"};
 		constexpr const std::string_view fatal{"fatal"};
+		constexpr const std::string_view outputFile{"file"};
+		constexpr const std::string_view outputJournal{"journal"};
 		constexpr const std::string_view protocol{"http"};
+		constexpr const std::string_view precisionSeconds{"s"};
+		constexpr const std::string_view precisionMilliseconds{"ms"};
+		constexpr const std::string_view precisionMicroseconds{"us"};
+		constexpr const std::string_view precisionNanoseconds{"ns"};
 	};
 
 	namespace DefaultValues
 	{
 		constexpr const int dataReadDelay{30};
+		constexpr const int retryDelay{5};
+		constexpr const int selfMonitoringInterval{60};
+		constexpr const int lagThreshold{300};
+		constexpr const int catchUpThreshold{200};
+		constexpr const int catchUpWorkers{0}; // one per CPU
+		constexpr const int catchUpBatchScale{4};
+		constexpr const long maxPending{0};
 		constexpr const std::string_view logLevel{Values::info};
+		constexpr const std::string_view logOutput{Values::outputFile};
+		constexpr const std::string_view logDirectory{LogRootPath};
+		constexpr const std::string_view journalSocket{"/run/systemd/journal/socket"};
+		constexpr const long failedWritesSegmentSize{64}; // MiB
+		constexpr const long failedWritesSegmentAge{3600};
+		constexpr const bool failedWritesCompress{true};
+		constexpr const bool influxEnabled{true};
 		constexpr const std::string_view influxHostName{"localhost"};
 		constexpr const long influxPort{8086};
 		constexpr const std::string_view influxDatabaseName{"nagiosrecords"};
 		constexpr const std::string_view influxMetricName{"perfdata"};
+		constexpr const long influxVersion{1};
+		constexpr const long influxBatchSize{5000};
+		constexpr const bool suppressUnchangedThresholds{false};
+		constexpr const long thresholdRefresh{3600};
+		constexpr const std::string_view influxOrganization{""};
+		constexpr const std::string_view influxBucket{""}; // empty means use the database name
+		constexpr const std::string_view influxToken{""};
+		constexpr const std::string_view influxPrecision{Values::precisionSeconds};
+		constexpr const bool influxUdpEnabled{false};
+		constexpr const long influxUdpPort{8089};
+		constexpr const std::string_view influxUdpPrecision{Values::precisionNanoseconds}; // UDP listeners do not take a precision per request, and default to nanoseconds
+		constexpr const long influxUdpMtu{1500};
+		constexpr const long influxUdpBurst{64};
+		constexpr const bool prometheusEnabled{false};
+		constexpr const std::string_view prometheusHostName{"localhost"};
+		constexpr const long prometheusPort{9090};
+		constexpr const std::string_view prometheusPath{"api/v1/write"};
+		constexpr const std::string_view prometheusMetricPrefix{"nagios_"};
+		constexpr const long prometheusBatchSize{5000};
+		constexpr const std::string_view prometheusBearerToken{""};
 		constexpr const std::string_view nagiosSpoolDirectory{"/usr/local/nagios/var/spool/" __XLATPERF_PACKAGE_NAME__};
+		constexpr const int claimLimit{0}; // every file
+		constexpr const bool sharedSpool{false};
+		constexpr const int claimExpiry{600};
+		constexpr const int minimumClaimExpiry{180}; // NFS caches attributes for up to 60 s by default, so a shorter lease can look stale while renewed
+		constexpr const bool statusEnabled{false};
+		constexpr const std::string_view statusHostName{"127.0.0.1"};
+		constexpr const long statusPort{9464};
+		constexpr const std::string_view statusSocket{""};
+		constexpr const bool captureEnabled{false};
+		constexpr const std::string_view captureDirectory{"/var/lib/" __XLATPERF_PACKAGE_NAME__ "/capture"};
+		constexpr const long captureMaxSize{1024}; // MiB
+		constexpr const std::string_view captureKey{""};
 	};
 }
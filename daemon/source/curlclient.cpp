@@ -1,6 +1,8 @@
 #include <curl/curl.h>
 #include <memory>
 #include "curlclient.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
 
 // helper functions
 static long GetResponseCode(CURL *CurlHandle)
@@ -62,12 +64,25 @@ static CurlResponse SendRequest(CURL *CurlHandle, const std::string_view &HostNa
 		curl_easy_setopt(CurlHandle, CURLOPT_WRITEFUNCTION, nullptr);
 	}
 
-	Response.CurlResult = curl_easy_perform(CurlHandle);
+	auto &Metrics{MetricsRegistry::Get()};
+	Metrics.Increment(MetricCounters::HttpRequests);
+	size_t BodyBytes{Request.GetPostDataOpt().has_value() ? Request.GetPostDataOpt()->size() : 0};
+	Metrics.Increment(MetricCounters::HttpBytesSent, BodyBytes);
+	XLAT_PROBE2(http_request_start, Url.c_str(), BodyBytes);
+	{
+		MetricTimer RequestTimer{MetricHistograms::HttpRequestMicroseconds};
+		Response.CurlResult = curl_easy_perform(CurlHandle);
+	}
 
 	if (Request.RequestedInformation.WantResponseCode)
 	{
 		Response.ResponseCode = GetResponseCode(CurlHandle);
 	}
+	XLAT_PROBE3(http_request_finish, Url.c_str(), static_cast<int>(Response.CurlResult), Response.ResponseCode);
+	if (Response.CurlResult != CURLE_OK || (Request.RequestedInformation.WantResponseCode && (Response.ResponseCode < 200 || Response.ResponseCode >= 300)))
+	{
+		Metrics.Increment(MetricCounters::HttpFailures);
+	}
 	return Response;
 }
 
@@ -105,13 +120,17 @@ CurlClient::CurlClient(ILogWriter &LogWriter, const std::string_view &HostName,
 	curl_easy_setopt(CurlHandle.get(), CURLOPT_DEFAULT_PROTOCOL, "http");
 	curl_easy_setopt(CurlHandle.get(), CURLOPT_PORT, Port);
 	curl_easy_setopt(CurlHandle.get(), CURLOPT_FOLLOWLOCATION, 1L);
-	// RequestHeaders = curl_slist_append(RequestHeaders, "Accept: application/csv");	// not currently used
-	// curl_easy_setopt(CurlHandle, CURLOPT_HTTPHEADER, RequestHeaders);	//not currently used
 }
 
 CurlClient::~CurlClient()
 {
-	// curl_slist_free_all(RequestHeaders);	// not currently used
+	curl_slist_free_all(RequestHeaders);
+}
+
+void CurlClient::AddHeader(const std::string_view &Header)
+{
+	RequestHeaders = curl_slist_append(RequestHeaders, std::string{Header}.c_str()); // curl copies the string
+	curl_easy_setopt(CurlHandle.get(), CURLOPT_HTTPHEADER, RequestHeaders);
 }
 
 CurlResponse CurlClient::Get(const CurlRequest &Request)
@@ -38,6 +38,7 @@ public:
 	void AddQueryParameter(const std::string_view &Parameter, const std::string_view &Value = std::string_view{});
 	void SetPostData(std::string &&NewPostData) { PostData = std::move(NewPostData); } // this could be a large string, so move it. caller can make their own copy if they want one
 	void ClearPostData() { PostData.reset(); }
+	std::string ReleasePostData() { return std::move(PostData).value_or(std::string{}); } // hands a large body back to the caller without copying
 	const std::optional<std::string> &GetPostDataOpt() const { return PostData; }
 };
 
@@ -48,6 +49,10 @@ public:
 	long ResponseCode{-1};
 	std::optional<std::string> Header;
 	std::optional<std::string> Body;
+
+	/// @brief Whether a failed request may succeed if sent again: a transport error, a server error (5xx),
+	/// 408 Request Timeout or 429 Too Many Requests. Any other failure is the request's own fault.
+	bool IsTransientFailure() const { return CurlResult != CURLE_OK || ResponseCode >= 500 || ResponseCode == 408 || ResponseCode == 429; }
 };
 
 class CurlClient
@@ -55,7 +60,7 @@ class CurlClient
 private:
 	ILogWriter &Log;
 	std::unique_ptr<CURL, void (*)(CURL *)> CurlHandle;
-	// curl_slist *RequestHeaders{nullptr};	// not currently used
+	curl_slist *RequestHeaders{nullptr};
 
 public:
 	CurlClient(ILogWriter &LogWriter, const std::string_view &HostName, const long Port = 80);
@@ -68,6 +73,9 @@ public:
 	std::string HostName;
 	long Port;
 
+	/// @brief Adds a header that accompanies every request sent by this client
+	/// @param Header Complete header line, such as "Authorization: Token abc"
+	void AddHeader(const std::string_view &Header);
 	CurlResponse Get(const CurlRequest &Request);
 	CurlResponse Post(const CurlRequest &Request);
 };
\ No newline at end of file
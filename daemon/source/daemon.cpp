@@ -1,28 +1,300 @@
 #include <condition_variable>
+#include <algorithm>
 #include <curl/curl.h>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <unistd.h>
+#include "allocstats.hpp"
+#include "config_constants.hpp"
 #include "config.hpp"
 #include "daemon.hpp"
-#include "influxclient.hpp"
 #include "filedatacollector.hpp"
+#include "influxescape.hpp"
+#include "metrics.hpp"
+#include "nagiosparser.hpp"
+#include "probes.hpp"
 #include "signalhandler.hpp"
+#include "sink.hpp"
 
 // service logging constants
 constexpr const std::string_view DaemonStarted{"Daemon started"};
 constexpr const std::string_view DaemonStopped{"Daemon stopped"};
+constexpr const std::string_view EscapeKernelSelected{"Line protocol escaping kernel"};
 constexpr const std::string_view SignalHandlerStarted{"Signal handler started"};
 constexpr const std::string_view ProcessingConfigReloadRequest{"Processing configuration reload request"};
+constexpr const std::string_view NoSinksEnabled{"No sinks enabled, nothing will be collected"};
+constexpr const std::string_view SinkAcknowledged{"Sink acknowledged points"};
+constexpr const std::string_view SinkBackpressure{"Sink saturated, pausing reader until it accepts data"};
+constexpr const std::string_view AllocationReport{"Heap allocations by pipeline stage"};
+constexpr const std::string_view SinkRecordsLate{"Sink accepted records later than the lag threshold, count and worst lag in milliseconds"};
+constexpr const std::string_view CatchUpStarted{"Spool backlog over the catch-up threshold, reading files concurrently, files and workers"};
+constexpr const std::string_view CatchUpFinished{"Catch-up finished, returning to steady-state reading, seconds"};
+constexpr const std::string_view SharedSpoolWorker{"Sharing the spool directory, claiming files as"};
+
+constexpr const size_t ReaderBatchSize{1024}; // records handed to the sinks at a time
+
+// helper functions
+static std::string GetLocalHostName()
+{
+	char HostName[256]{};
+	if (::gethostname(HostName, sizeof(HostName) - 1) != 0)
+	{
+		return "localhost";
+	}
+	return HostName;
+}
+
+// adds the daemon's own metrics to the batch when they are due, so they reach every sink the same way Nagios data does
+static void AddSelfMonitoringRecord(SinkBatch &Batch, NagiosPerfDataParser &Parser, const int Interval, std::chrono::steady_clock::time_point &NextReport)
+{
+	auto Now{std::chrono::steady_clock::now()};
+	if (Interval <= 0 || Now < NextReport)
+	{
+		return;
+	}
+	NextReport = Now + std::chrono::seconds(Interval);
+	static const std::string HostName{GetLocalHostName()};
+	std::string SourceLine{MetricsRegistry::Get().FormatNagiosRecord(std::time(nullptr), HostName, ConfigConstants::appname)};
+	auto PerfRecord{Parser.ParseNagiosPerformanceRecord(SourceLine)};
+	if (PerfRecord.has_value())
+	{
+		Batch.push_back(SinkRecord{std::move(PerfRecord.value()), std::move(SourceLine)});
+	}
+}
+
+// the freshness the SLO is defined on: from the record's Nagios timestamp to the sink's destination accepting it
+static void RecordDeliveryLag(const SinkAcknowledgement &Acknowledgement, ILogWriter &Log, const int LagThreshold)
+{
+	auto &Metrics{MetricsRegistry::Get()};
+	auto &SinkLag{Metrics.GetSinkDeliveryLag(Acknowledgement.SinkName)};
+	const int64_t Now{std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()};
+	const int64_t Threshold{int64_t{LagThreshold} * 1000};
+	size_t LateRecords{0};
+	int64_t WorstLag{0};
+	for (const auto RecordTime : Acknowledgement.RecordTimestamps)
+	{
+		int64_t Lag{std::max<int64_t>(Now - int64_t{RecordTime} * 1000, 0)}; // Nagios clocks ahead of ours count as on time
+		Metrics.Record(MetricHistograms::DeliveryLagMilliseconds, static_cast<uint64_t>(Lag));
+		SinkLag.Record(static_cast<uint64_t>(Lag));
+		if (Threshold > 0 && Lag > Threshold)
+		{
+			LateRecords++;
+			WorstLag = std::max(WorstLag, Lag);
+		}
+	}
+	if (LateRecords > 0)
+	{
+		Metrics.Increment(MetricCounters::DeliveryLagExceeded, LateRecords);
+		Log.WriteWarnLazy(SinkRecordsLate, Acknowledgement.SinkName, LogJoin(LateRecords, WorstLag));
+	}
+}
+
+// built with ALLOC_STATS=1 only, see allocstats.hpp
+static void LogAllocationReport(ILogWriter &Log)
+{
+	for (const auto &Stage : AllocationStats::GetReport())
+	{
+		char Summary[192];
+		std::snprintf(Summary, sizeof(Summary), "%llu allocations, %llu bytes; per line %.2f allocations, %.1f bytes; per point %.2f allocations, %.1f bytes",
+						  static_cast<unsigned long long>(Stage.Counted.Allocations), static_cast<unsigned long long>(Stage.Counted.Bytes),
+						  Stage.AllocationsPerLine, Stage.BytesPerLine, Stage.AllocationsPerPoint, Stage.BytesPerPoint);
+		Log.WriteInfoLazy(AllocationReport, Stage.Name, std::string_view{Summary});
+	}
+}
+
+// one sink being down must not starve the others; it saves what it is handed until it is back
+static bool OpenSinks(std::vector<std::unique_ptr<ISink>> &Sinks)
+{
+	bool AnyOpen{false};
+	for (auto &Sink : Sinks)
+	{
+		AnyOpen = Sink->Open() || AnyOpen; // open every sink, even after a success, so each one logs its state
+	}
+	return AnyOpen;
+}
+
+static void SubmitBatch(std::vector<std::unique_ptr<ISink>> &Sinks, SinkBatch &Batch)
+{
+	if (!Batch.empty())
+	{
+		XLAT_PROBE1(batch_built, Batch.size());
+		for (auto &Sink : Sinks)
+		{
+			Sink->Submit(Batch);
+		}
+		Batch.clear();
+	}
+}
+
+// holds the reader back until every sink can take more data, or the daemon is stopping
+static void ApplyBackpressure(std::vector<std::unique_ptr<ISink>> &Sinks, ILogWriter &Log, SystemSignalHandler &SignalHandler, std::condition_variable &DaemonAttentionRequiredCondition, std::mutex &DaemonMutex, const int RetryDelay)
+{
+	for (auto &Sink : Sinks)
+	{
+		while (Sink->Saturated() && !Sink->Flush() && !SignalHandler.StopRequested)
+		{
+			Log.WriteWarnAnnotated(SinkBackpressure, Sink->GetName());
+			std::unique_lock DaemonLock{DaemonMutex};
+			DaemonAttentionRequiredCondition.wait_for(DaemonLock, std::chrono::seconds(RetryDelay), [&SignalHandler]
+																	{ return SignalHandler.StopRequested.load(); });
+		}
+	}
+}
+
+// the files of one catch-up round, parsed by the worker that read each file
+struct CatchUpRound
+{
+	std::vector<SinkBatch> FileBatches{};
+	size_t Files{0};
+};
+
+static void ReadCatchUpRound(FileDataCollector &Collector, ILogWriter &Log, const size_t Workers, CatchUpRound &Round)
+{
+	Round.FileBatches.resize(Workers);
+	Round.Files = Collector.ProcessNextFiles(Workers, [&Round, &Log](const size_t Slot, std::vector<std::string> &Lines)
+														  {
+		NagiosPerfDataParser FileParser{Log};
+		auto &FileBatch{Round.FileBatches[Slot]};
+		FileBatch.clear();
+		FileBatch.reserve(Lines.size());
+		for (auto &Line : Lines)
+		{
+			auto PerfRecord{FileParser.ParseNagiosPerformanceRecord(Line)};
+			if (PerfRecord.has_value())
+			{
+				FileBatch.push_back(SinkRecord{std::move(PerfRecord.value()), std::move(Line)});
+			}
+		} });
+}
+
+// private functions
+void N2IDaemon::CatchUp(FileDataCollector &Collector, SinkBatch &Batch, SystemSignalHandler &SignalHandler, std::condition_variable &DaemonAttentionRequiredCondition, std::mutex &DaemonMutex)
+{
+	const auto Started{std::chrono::steady_clock::now()};
+	const auto Workers{static_cast<size_t>(Config.CatchUpWorkers)};
+	const size_t BatchSize{ReaderBatchSize * static_cast<size_t>(Config.CatchUpBatchScale)};
+	Log->WriteInfoLazy(CatchUpStarted, LogJoin(Collector.GetPendingFileCount(), Workers));
+	MetricsRegistry::Get().Increment(MetricCounters::CatchUpCycles);
+	for (auto &Sink : Sinks)
+	{
+		Sink->SetBatchScale(static_cast<size_t>(Config.CatchUpBatchScale));
+	}
+
+	// the next round's files are read and parsed while this thread hands the current round to the sinks. every file
+	// read is submitted even after a stop request, because read files are deleted once the cycle ends
+	CatchUpRound Current{};
+	CatchUpRound Next{};
+	ReadCatchUpRound(Collector, *Log, Workers, Current);
+	while (Current.Files > 0)
+	{
+		std::jthread Reader{};
+		Next.Files = 0;
+		if (Collector.More() && !SignalHandler.StopRequested)
+		{
+			Reader = std::jthread{[this, &Collector, &Next, Workers]
+										 { ReadCatchUpRound(Collector, *Log, Workers, Next); }};
+		}
+		for (size_t Slot{0}; Slot < Current.Files; Slot++)
+		{
+			for (auto &Record : Current.FileBatches[Slot])
+			{
+				Batch.push_back(std::move(Record));
+				if (Batch.size() >= BatchSize)
+				{
+					SubmitBatch(Sinks, Batch);
+					ApplyBackpressure(Sinks, *Log, SignalHandler, DaemonAttentionRequiredCondition, DaemonMutex, Config.RetryDelay);
+				}
+			}
+		}
+		if (Reader.joinable())
+		{
+			Reader.join();
+		}
+		std::swap(Current, Next);
+	}
+	SubmitBatch(Sinks, Batch);
+	for (auto &Sink : Sinks)
+	{
+		Sink->Flush();
+		Sink->SetBatchScale(1);
+	}
+	Log->WriteInfoLazy(CatchUpFinished, std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - Started).count());
+}
+
+void N2IDaemon::CloseSinks()
+{
+	for (auto &Sink : Sinks)
+	{
+		Sink->Close();
+	}
+	Sinks.clear();
+}
 
 void N2IDaemon::LoadConfiguration()
 {
-	Log = Config.Load();
+	CloseSinks(); // sinks and the status server hold a reference to the log writer that is about to be replaced
+	Server.reset();
+	Capture.reset();
+	Claims.reset();
+	Scanner.reset();
+	Log = Config.Load(ConfigurationFile);
+	Sinks = SinkFactory::CreateSinks(*Log, Config);
+	Scanner = std::make_unique<SpoolScanner>(*Log, Config.NagiosSpoolDirectory);
+	if (Config.SharedSpool)
+	{
+		std::string Worker{GetLocalHostName()};
+		if (!Instance.empty())
+		{
+			Worker.append("-").append(Instance);
+		}
+		Claims = std::make_unique<SpoolClaims>(*Log, Config.NagiosSpoolDirectory, Worker, std::chrono::seconds(Config.ClaimExpiry));
+		Log->WriteInfoLazy(SharedSpoolWorker, Worker);
+	}
+	Status.SetSpoolDirectory(Config.NagiosSpoolDirectory);
+	Status.UpdateSinks(Sinks);
+	if (Config.Status.Enabled)
+	{
+		Server = std::make_unique<StatusServer>(*Log, Config.Status, Status);
+		if (!Server->Start())
+		{
+			Server.reset();
+		}
+	}
+	if (Config.Capture.Enabled)
+	{
+		Capture = std::make_unique<SpoolCapture>(*Log, Config.Capture);
+		if (!Capture->Start())
+		{
+			Capture.reset();
+		}
+	}
+	if (Sinks.empty())
+	{
+		Log->WriteWarn(NoSinksEnabled);
+	}
+	for (auto &Sink : Sinks)
+	{
+		Sink->SetAckCallback([this](const SinkAcknowledgement &Acknowledgement)
+									{
+										Status.RecordAcknowledgement(Acknowledgement);
+										RecordDeliveryLag(Acknowledgement, *Log, Config.LagThreshold);
+										Log->WriteDebugLazy(SinkAcknowledged, Acknowledgement.SinkName, Acknowledgement.Points); });
+	}
 }
 
-void N2IDaemon::Run()
+// public functions
+N2IDaemon::~N2IDaemon()
+{
+	Server.reset();
+	CloseSinks();
+}
+
+bool N2IDaemon::Run()
 {
 	std::atomic<bool> DaemonProcessing{true};
 
@@ -31,7 +303,8 @@ void N2IDaemon::Run()
 	curl_global_init(CURL_GLOBAL_ALL);
 
 	LoadConfiguration();
-	Log->WriteInfoAnnotated(DaemonStarted, std::to_string(getpid()));
+	Log->WriteInfoLazy(DaemonStarted, getpid());
+	Log->WriteInfoLazy(EscapeKernelSelected, InfluxEscape::GetKernelName(InfluxEscape::GetKernel()));
 
 	std::condition_variable DaemonAttentionRequiredCondition;
 	SystemSignalHandler SignalHandler{};
@@ -39,8 +312,13 @@ void N2IDaemon::Run()
 	Log->WriteDebug(SignalHandlerStarted);
 
 	std::mutex DaemonMutex;
+	bool Drained{true};
+	const uint64_t UploadErrorsAtStart{MetricsRegistry::Get().GetCounter(MetricCounters::UploadErrorsSaved)};
+	auto NextSelfMonitoringReport{std::chrono::steady_clock::now() + std::chrono::seconds(Config.SelfMonitoringInterval)};
 	do
 	{
+		bool CaughtUp{true};
+		bool Unclaimed{false};
 		if (SignalHandler.ReloadRequested)
 		{
 			Log->WriteDebug(ProcessingConfigReloadRequest);
@@ -48,24 +326,63 @@ void N2IDaemon::Run()
 			SignalHandler.ReloadRequested = false;
 		}
 
-		InfluxClient Influx{*Log, Config.InfluxHostName, Config.InfluxPort, Config.InfluxDatabaseName, Config.InfluxMeasurementName, Config.UnitConversionMap};
-		if (Influx.TestConnection() && Influx.CreateDatabaseIfNotExists())
+		bool AnySinkOpen{OpenSinks(Sinks)};
+		bool SpoolReady{!Claims || Claims->Prepare()}; // reading a shared spool without claiming could read files twice
+		if (AnySinkOpen && SpoolReady)
 		{
-			FileDataCollector Collector{Config.NagiosSpoolDirectory, *Log};
+			FileDataCollector Collector{*Scanner, *Log, static_cast<size_t>(Config.ClaimLimit), std::chrono::seconds(Config.LagThreshold), Capture.get(), Claims.get()};
+			Unclaimed = Scanner->GetUnclaimedFileCount() > 0 || (Claims && Claims->GetUnclaimedFileCount() > 0);
+			if (Unclaimed)
+			{
+				CaughtUp = false; // the claim limit left files for the next cycle
+			}
 			NagiosPerfDataParser Parser{*Log};
-			std::string SourceLine;
+			SinkBatch Batch{};
+			Batch.reserve(ReaderBatchSize);
+			if (Config.CatchUpThreshold > 0 && Collector.GetPendingFileCount() >= static_cast<size_t>(Config.CatchUpThreshold))
+			{
+				CatchUp(Collector, Batch, SignalHandler, DaemonAttentionRequiredCondition, DaemonMutex);
+				CaughtUp = false; // more files may have arrived during a long backlog, look again without waiting
+			}
 			while (Collector.More() && !SignalHandler.StopRequested)
 			{
-				SourceLine = Collector.GetNextLine();
+				if (Batch.empty())
+				{
+					ApplyBackpressure(Sinks, *Log, SignalHandler, DaemonAttentionRequiredCondition, DaemonMutex, Config.RetryDelay);
+				}
+				std::string SourceLine{Collector.GetNextLine()};
 				auto PerfRecord{Parser.ParseNagiosPerformanceRecord(SourceLine)};
 				if (PerfRecord.has_value())
 				{
-					Influx.TransmitNagiosLine(PerfRecord.value(), std::move(SourceLine));
+					Batch.push_back(SinkRecord{std::move(PerfRecord.value()), std::move(SourceLine)});
+					if (Batch.size() >= ReaderBatchSize)
+					{
+						SubmitBatch(Sinks, Batch);
+					}
 				}
 			}
+			AddSelfMonitoringRecord(Batch, Parser, Config.SelfMonitoringInterval, NextSelfMonitoringReport);
+			SubmitBatch(Sinks, Batch);
+			for (auto &Sink : Sinks)
+			{
+				Sink->FlushOrSave(); // retained records must not outlive the spool files the collector is about to delete
+			}
+			while (Collector.HasBufferedLines()) // stopped early, the files behind these lines are about to be deleted
+			{
+				Log->WriteUploadError(Collector.GetNextLine());
+			}
+		}
+		Status.UpdateSinks(Sinks);
+		if (Once && (!Unclaimed || !AnySinkOpen || SignalHandler.StopRequested))
+		{
+			// a sink that gives up on a batch saves it to the failed writes store
+			Drained = AnySinkOpen && SpoolReady && !SignalHandler.StopRequested && MetricsRegistry::Get().GetCounter(MetricCounters::UploadErrorsSaved) == UploadErrorsAtStart &&
+						 std::none_of(Sinks.begin(), Sinks.end(), [](const auto &Sink)
+										  { return Sink->GetPendingRecords() > 0; });
+			break;
 		}
 		DaemonProcessing = !SignalHandler.StopRequested;
-		if (!SignalHandler.StopRequested)
+		if (!SignalHandler.StopRequested && CaughtUp)
 		{
 			std::unique_lock DaemonLock{DaemonMutex};
 			DaemonAttentionRequiredCondition.wait_for(DaemonLock, std::chrono::seconds(Config.DataReadDelay), [&SignalHandler]
@@ -73,6 +390,17 @@ void N2IDaemon::Run()
 		}
 	} while (!SignalHandler.StopRequested);
 
+	Server.reset();
+	CloseSinks();
 	curl_global_cleanup();
+	if constexpr (AllocationStats::Enabled)
+	{
+		LogAllocationReport(*Log);
+	}
 	Log->WriteInfo(DaemonStopped);
+	if (Once)
+	{
+		std::printf("%s\n", MetricsRegistry::Get().FormatNagiosRecord(std::time(nullptr), GetLocalHostName(), ConfigConstants::appname).c_str());
+	}
+	return Drained;
 }
\ No newline at end of file
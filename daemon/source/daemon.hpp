@@ -1,23 +1,54 @@
 #pragma once
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "config.hpp"
+#include "filedatacollector.hpp"
 #include "logwriter.hpp"
+#include "sink.hpp"
+#include "spoolcapture.hpp"
+#include "spoolclaims.hpp"
+#include "spoolscanner.hpp"
+#include "statusserver.hpp"
+
+class SystemSignalHandler;
 
 class N2IDaemon
 {
 private:
+	std::string ConfigurationFile;
+	bool Once;
+	std::string Instance;
 	Configuration Config{};
 	std::unique_ptr<ILogWriter> Log{nullptr};
+	std::vector<std::unique_ptr<ISink>> Sinks{};
+	DaemonStatus Status{};
+	std::unique_ptr<StatusServer> Server{nullptr};
+	std::unique_ptr<SpoolCapture> Capture{nullptr};
+	std::unique_ptr<SpoolScanner> Scanner{nullptr};
+	std::unique_ptr<SpoolClaims> Claims{nullptr};
 
 	void LoadConfiguration();
+	void CloseSinks();
+
+	/// @brief Reads the collector's files on concurrent workers, with larger batches, until none are pending
+	void CatchUp(FileDataCollector &Collector, SinkBatch &Batch, SystemSignalHandler &SignalHandler, std::condition_variable &DaemonAttentionRequiredCondition, std::mutex &DaemonMutex);
 
 public:
-	N2IDaemon() = default;
-	~N2IDaemon() = default;
+	/// @param ConfigurationFile TOML file read at start and on every reload
+	/// @param Once Drain the spool directory a single time and return, instead of running until stopped
+	/// @param Instance Tells apart daemons on one host that share a spool, empty if there is only one
+	N2IDaemon(const std::string_view &ConfigurationFile, const bool Once, const std::string_view &Instance = "") : ConfigurationFile{ConfigurationFile}, Once{Once}, Instance{Instance} {}
+	~N2IDaemon();
 	N2IDaemon(const N2IDaemon &) = delete;
 	N2IDaemon &operator=(const N2IDaemon &) = delete;
 	N2IDaemon(N2IDaemon &&) = default;
 	N2IDaemon &operator=(N2IDaemon &&) = default;
 
-	void Run();
+	/// @return False if a single pass could not deliver everything it read. A daemon run until stopped returns true.
+	bool Run();
 };
\ No newline at end of file
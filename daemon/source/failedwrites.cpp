@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <zlib.h>
+#include "failedwrites.hpp"
+
+constexpr const std::string_view IndexExtension{".idx"};
+constexpr const std::string_view CompressedExtension{".gz"};
+constexpr const size_t CompressionBufferSize{256 * 1024};
+
+// helper functions
+static bool IsSegmentName(const std::string_view &Name, const std::string_view &Stem, const std::string_view &Extension)
+{
+	// failed_writes.<start time>.log, never the active failed_writes.log
+	return !Stem.empty() && Name.size() > Stem.size() + Extension.size() + 1 && Name.starts_with(Stem) && Name[Stem.size()] == '.' && Name.ends_with(Extension);
+}
+
+static bool CompressFile(const std::string &SourcePath, const std::string &TargetPath)
+{
+	std::FILE *Source{std::fopen(SourcePath.c_str(), "rb")};
+	if (Source == nullptr)
+	{
+		return false;
+	}
+	gzFile Target{::gzopen(TargetPath.c_str(), "wb6")};
+	bool Succeeded{Target != nullptr};
+	if (Succeeded)
+	{
+		::gzbuffer(Target, CompressionBufferSize);
+		std::string Buffer(CompressionBufferSize, '\0');
+		size_t BytesRead;
+		while (Succeeded && (BytesRead = std::fread(Buffer.data(), 1, Buffer.size(), Source)) > 0)
+		{
+			Succeeded = ::gzwrite(Target, Buffer.data(), static_cast<unsigned int>(BytesRead)) == static_cast<int>(BytesRead);
+		}
+		Succeeded = ::gzclose(Target) == Z_OK && Succeeded && !std::ferror(Source);
+	}
+	std::fclose(Source);
+	if (!Succeeded)
+	{
+		std::remove(TargetPath.c_str());
+	}
+	return Succeeded;
+}
+
+// private functions
+std::string FailedWritesStore::GetArchivePath(const std::time_t Started) const
+{
+	std::tm TimeInfo{};
+	::localtime_r(&Started, &TimeInfo);
+	char TimeBuffer[32];
+	std::strftime(TimeBuffer, sizeof(TimeBuffer), "%Y%m%dT%H%M%S", &TimeInfo);
+
+	std::filesystem::path ArchiveBase{DirectoryName};
+	ArchiveBase /= FileStem;
+	std::string Base{ArchiveBase.string()};
+	Base.append(1, '.').append(TimeBuffer);
+	std::string Candidate{Base + FileExtension};
+	std::error_code ErrorCode{};
+	for (int Sequence{1}; std::filesystem::exists(Candidate, ErrorCode) || std::filesystem::exists(Candidate + std::string{CompressedExtension}, ErrorCode); Sequence++)
+	{
+		Candidate = Base + "-" + std::to_string(Sequence) + FileExtension; // two rotations within one second
+	}
+	return Candidate;
+}
+
+int FailedWritesStore::RotateIfDue(const size_t IncomingBytes)
+{
+	if (SegmentSize == 0)
+	{
+		return 0;
+	}
+	std::time_t Now{std::time(nullptr)};
+	bool TooLarge{Settings.SegmentBytes > 0 && SegmentSize + IncomingBytes > Settings.SegmentBytes};
+	bool TooOld{Settings.SegmentAge.count() > 0 && Now - SegmentStarted >= Settings.SegmentAge.count()};
+	if (!TooLarge && !TooOld)
+	{
+		return 0;
+	}
+
+	std::string ArchivePath{GetArchivePath(SegmentStarted)};
+	int Result{ActiveSegment.Archive(ArchivePath)};
+	if (Result == 0)
+	{
+		SegmentSize = 0;
+		{
+			std::scoped_lock QueueLock{ClosedSegmentsMutex};
+			ClosedSegments.push_back(std::move(ArchivePath));
+		}
+		ClosedSegmentsCondition.notify_one();
+	}
+	return Result;
+}
+
+void FailedWritesStore::QueueLeftoverSegments()
+{
+	// segments closed by an earlier run that stopped before indexing them
+	std::error_code ErrorCode{};
+	std::scoped_lock QueueLock{ClosedSegmentsMutex};
+	for (const auto &Entry : std::filesystem::directory_iterator(DirectoryName, ErrorCode))
+	{
+		std::string Name{Entry.path().filename().string()};
+		if (Entry.is_regular_file(ErrorCode) && IsSegmentName(Name, FileStem, FileExtension))
+		{
+			ClosedSegments.push_back(Entry.path().string());
+		}
+	}
+	std::sort(ClosedSegments.begin(), ClosedSegments.end());
+}
+
+void FailedWritesStore::IndexSegment(const std::string &SegmentPath)
+{
+	// failed records are Nagios lines: TIMET, host, service, perfdata separated by tabs
+	long FirstTime{0};
+	long LastTime{0};
+	size_t Lines{0};
+	std::set<std::string> Hosts{};
+	std::ifstream Segment{SegmentPath};
+	std::string Line{};
+	while (std::getline(Segment, Line))
+	{
+		Lines++;
+		auto TimeEnd{Line.find('\t')};
+		long RecordTime{0};
+		if (TimeEnd == std::string::npos || std::from_chars(Line.data(), Line.data() + TimeEnd, RecordTime).ec != std::errc{})
+		{
+			continue;
+		}
+		FirstTime = FirstTime == 0 ? RecordTime : std::min(FirstTime, RecordTime);
+		LastTime = std::max(LastTime, RecordTime);
+		auto HostEnd{Line.find('\t', TimeEnd + 1)};
+		Hosts.emplace(Line.substr(TimeEnd + 1, HostEnd == std::string::npos ? std::string::npos : HostEnd - TimeEnd - 1));
+	}
+	Segment.close();
+
+	std::string DataPath{SegmentPath};
+	if (Settings.Compress)
+	{
+		DataPath.append(CompressedExtension);
+		if (!CompressFile(SegmentPath, DataPath))
+		{
+			DataPath = SegmentPath; // keep the plain segment and index it as-is
+		}
+	}
+
+	std::filesystem::path IndexPath{SegmentPath};
+	IndexPath.replace_extension(IndexExtension);
+	std::string TemporaryPath{IndexPath.string() + ".tmp"};
+	{
+		std::ofstream Index{TemporaryPath, std::ios::trunc};
+		Index << "segment=" << std::filesystem::path{DataPath}.filename().string() << '\n'
+				<< "first=" << FirstTime << '\n'
+				<< "last=" << LastTime << '\n'
+				<< "lines=" << Lines << '\n';
+		for (const auto &Host : Hosts)
+		{
+			Index << "host=" << Host << '\n';
+		}
+	}
+	std::rename(TemporaryPath.c_str(), IndexPath.c_str());
+	if (DataPath != SegmentPath)
+	{
+		std::remove(SegmentPath.c_str()); // last, so a crash before this point just redoes the work next start
+	}
+}
+
+void FailedWritesStore::RunCompressor(std::stop_token StopToken)
+{
+	for (;;)
+	{
+		std::string SegmentPath{};
+		{
+			std::unique_lock QueueLock{ClosedSegmentsMutex};
+			ClosedSegmentsCondition.wait(QueueLock, StopToken, [this]
+												  { return !ClosedSegments.empty(); });
+			if (StopToken.stop_requested())
+			{
+				return; // whatever is left is picked up on the next start
+			}
+			SegmentPath = std::move(ClosedSegments.front());
+			ClosedSegments.pop_front();
+		}
+		IndexSegment(SegmentPath);
+	}
+}
+
+// public functions
+FailedWritesStore::FailedWritesStore(const std::string_view &DirectoryName, const std::string_view &FileName, const FailedWritesSettings &Settings)
+	 : DirectoryName{DirectoryName},
+		FileStem{std::filesystem::path{FileName}.stem().string()},
+		FileExtension{std::filesystem::path{FileName}.extension().string()},
+		Settings{Settings},
+		ActiveSegment{std::string{DirectoryName}, std::string{FileName}, OutputFileMode::Buffered}
+{
+	struct stat FileStatus{};
+	if (::stat(ActiveSegment.GetFilePath().c_str(), &FileStatus) == 0 && FileStatus.st_size > 0)
+	{
+		SegmentSize = static_cast<size_t>(FileStatus.st_size); // carry on with the segment an earlier run left open
+		SegmentStarted = FileStatus.st_mtime;
+	}
+	QueueLeftoverSegments();
+	Compressor = std::jthread([this](std::stop_token StopToken)
+									  { RunCompressor(StopToken); });
+}
+
+FailedWritesStore::~FailedWritesStore()
+{
+	Compressor.request_stop();
+	Compressor.join();
+}
+
+int FailedWritesStore::Write(const std::string &Record)
+{
+	RotateIfDue(Record.size() + 1);
+	if (SegmentSize == 0)
+	{
+		SegmentStarted = std::time(nullptr);
+	}
+	int Result{ActiveSegment.Write(Record)};
+	if (Result == 0)
+	{
+		SegmentSize += Record.size() + 1;
+	}
+	return Result;
+}
+
+int FailedWritesStore::Flush(std::string &Dropped, const bool Final)
+{
+	int Result{ActiveSegment.Flush(Dropped, Final)};
+	return Result ? Result : RotateIfDue(0);
+}
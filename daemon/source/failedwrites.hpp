@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "outputfile.hpp"
+
+struct FailedWritesSettings
+{
+	size_t SegmentBytes;					// rotate once the active segment reaches this size, 0 to disable
+	std::chrono::seconds SegmentAge; // rotate once the active segment is this old, 0 to disable
+	bool Compress;							// gzip closed segments in the background
+};
+
+/// @brief Segmented store for records that could not be delivered.
+/// New records go to the active file (e.g. failed_writes.log). When it grows too large or too old it is renamed to
+/// failed_writes.<start time>.log and handed to a background thread that gzips it and writes failed_writes.<start time>.idx,
+/// which lists the time range, line count and hosts in the segment so that tools/failedwrites can skip segments without
+/// reading them.
+class FailedWritesStore
+{
+private:
+	std::string DirectoryName;
+	std::string FileStem;
+	std::string FileExtension;
+	FailedWritesSettings Settings;
+	OutputFile ActiveSegment;
+	size_t SegmentSize{0};
+	std::time_t SegmentStarted{0};
+	int RotateIfDue(const size_t IncomingBytes);
+	std::string GetArchivePath(const std::time_t Started) const;
+
+	std::mutex ClosedSegmentsMutex;
+	std::condition_variable_any ClosedSegmentsCondition;
+	std::deque<std::string> ClosedSegments{};
+	void QueueLeftoverSegments();
+	void IndexSegment(const std::string &SegmentPath);
+	void RunCompressor(std::stop_token StopToken);
+	std::jthread Compressor{}; // keep last
+
+public:
+	FailedWritesStore(const std::string_view &DirectoryName, const std::string_view &FileName, const FailedWritesSettings &Settings);
+	~FailedWritesStore();
+	FailedWritesStore(const FailedWritesStore &) = delete;
+	FailedWritesStore &operator=(const FailedWritesStore &) = delete;
+	FailedWritesStore(FailedWritesStore &&) = delete;
+	FailedWritesStore &operator=(FailedWritesStore &&) = delete;
+
+	std::string GetFilePath() const { return ActiveSegment.GetFilePath(); }
+	/// @return 0 or errno, see OutputFile::Write
+	int Write(const std::string &Record);
+	/// @brief Flushes the active segment and rotates it if it has aged out
+	/// @param Dropped Receives the records the active segment gave up on, see OutputFile::Flush
+	int Flush(std::string &Dropped, const bool Final = false);
+};
@@ -1,16 +1,25 @@
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
 #include <filesystem>
+#include <functional>
 #include <limits>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
 #include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
 #include <vector>
+#include "allocstats.hpp"
 #include "filedatacollector.hpp"
 #include "logwriter.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
 #include "utility.hpp"
 
 constexpr const size_t MaxFileSize{std::numeric_limits<long>::max()};
@@ -21,14 +30,13 @@ constexpr const size_t MaxBlockSize{1024}; // 1024 lines per block
 constexpr const std::string_view AddedPerfFileForProcessing{"Added file for perfdata processing"};
 constexpr const std::string_view DeleteFile{"Delete file"};
 constexpr const std::string_view FileRead{"Read file"};
-constexpr const std::string_view FileSeek{"Move to position in file"};
 constexpr const std::string_view FileTooLarge{"File too large to process"};
-constexpr const std::string_view SpoolDirectory{"Locating spool directory"};
 constexpr const std::string_view ExtractedLine{"Extracted cleaned line"};
 constexpr const std::string_view GettingNextBlock{"Getting next data block from disk"};
 constexpr const std::string_view NoMoreLines{"No more lines to process"};
 constexpr const std::string_view OpenFile{"Open file"};
 constexpr const std::string_view SkippedEmpty{"Skipped empty file"};
+constexpr const std::string_view SpoolFilesLate{"Spool files read later than the lag threshold, count and worst lag in milliseconds"};
 
 // returns true if it had to log error, false if it logged a debug message
 static bool LogIOError(ILogWriter &Log, const std::string_view &Activity, const std::string_view &Item, FILE *CurrentFile)
@@ -40,7 +48,7 @@ static bool LogIOError(ILogWriter &Log, const std::string_view &Activity, const
 	}
 	if (ErrorCode != 0)
 	{
-		Log.WriteErrorAnnotated(Activity, Item, std::strerror(ErrorCode));
+		Log.WriteErrorStructured({.FilePath = Item, .ErrorNumber = ErrorCode}, Activity, Item, std::strerror(ErrorCode));
 		errno = 0;
 		if (CurrentFile)
 		{
@@ -48,116 +56,173 @@ static bool LogIOError(ILogWriter &Log, const std::string_view &Activity, const
 		}
 		return true;
 	}
-	Log.WriteDebugAnnoted(Activity, Item);
+	Log.WriteDebugLazy(Activity, Item);
 	return false;
 }
 
-static void GetNextLineBlock(std::queue<std::string> &UnprocessedLines, std::queue<PendingFile> &PendingFiles, std::queue<std::string> &CompletedFiles, ILogWriter &Log)
+static void RecordSpoolLag(SpoolLagSummary &SpoolLag, const std::filesystem::file_time_type Modified)
 {
-	if (!PendingFiles.empty())
+	auto Lag{std::max(std::chrono::duration_cast<std::chrono::milliseconds>(std::filesystem::file_time_type::clock::now() - Modified), std::chrono::milliseconds{0})};
+	auto &Metrics{MetricsRegistry::Get()};
+	Metrics.Record(MetricHistograms::SpoolLagMilliseconds, static_cast<uint64_t>(Lag.count()));
+	if (SpoolLag.Threshold.count() > 0 && Lag > SpoolLag.Threshold)
 	{
-		errno = 0;
-		std::vector<char> Buffer{};
-		while (!PendingFiles.empty() && UnprocessedLines.size() < MaxBlockSize)
+		Metrics.Increment(MetricCounters::SpoolLagExceeded);
+		SpoolLag.LateFiles++;
+		SpoolLag.WorstLag = std::max(SpoolLag.WorstLag, Lag);
+	}
+}
+
+// reads the whole file into Buffer. Complete is set when the file can be deleted once its lines are delivered.
+// The listed size only sizes the buffer: the file is read to its end, so a file that grew, or that reuses a name and
+// an inode the scanner has cached, is never cut short
+static size_t ReadSpoolFile(const PendingFile &File, std::vector<char> &Buffer, bool &Complete, ILogWriter &Log)
+{
+	MetricTimer FileReadTimer{MetricHistograms::FileReadMicroseconds};
+	errno = 0;
+	bool FileInErrorState{false};
+
+	XLAT_PROBE1(file_open, File.FileName.c_str());
+	auto CurrentFile{fopen(File.FileName.c_str(), "r")};
+	FileInErrorState = LogIOError(Log, OpenFile, File.FileName, CurrentFile);
+	size_t CharactersRead{0};
+	if (CurrentFile)
+	{
+		struct stat Opened{};
+		size_t Expected{File.FileSize};
+		if (::fstat(fileno(CurrentFile), &Opened) == 0)
 		{
-			bool FileInErrorState{false};
-			auto const &[FileName, FileSize]{PendingFiles.front()};
-			if (Buffer.size() < FileSize)
+			Expected = static_cast<size_t>(Opened.st_size);
+		}
+		if (Buffer.size() <= Expected)
+		{
+			Buffer.resize(Expected + 1, '\0'); // one spare byte, so reading a file of the expected size also reaches end of file
+		}
+		while (!std::feof(CurrentFile) && !std::ferror(CurrentFile))
+		{
+			if (CharactersRead == Buffer.size())
 			{
-				Buffer.resize(FileSize, '\0');
+				Buffer.resize(Buffer.size() * 2, '\0');
 			}
+			CharactersRead += std::fread(Buffer.data() + CharactersRead, sizeof(char), Buffer.size() - CharactersRead, CurrentFile);
+		}
+		FileInErrorState = LogIOError(Log, FileRead, File.FileName, CurrentFile);
+	}
+	XLAT_PROBE2(file_read, File.FileName.c_str(), CharactersRead);
+
+	Complete = CurrentFile && !FileInErrorState && std::feof(CurrentFile);
+	if (CurrentFile != nullptr)
+	{
+		std::fclose(CurrentFile);
+	}
+	auto &Metrics{MetricsRegistry::Get()};
+	Metrics.Increment(MetricCounters::FilesRead);
+	Metrics.Increment(MetricCounters::BytesRead, CharactersRead);
+	return CharactersRead;
+}
 
-			auto CurrentFile{fopen(PendingFiles.front().FileName.c_str(), "r")};
-			FileInErrorState = LogIOError(Log, OpenFile, PendingFiles.front().FileName, CurrentFile);
-			size_t CharactersRead{0};
-			if (CurrentFile)
+// hands every non-empty line, stripped of non-printable characters, to AddLine
+template <typename LineConsumer>
+static size_t ExtractCleanedLines(const std::string_view &Contents, ILogWriter &Log, LineConsumer &&AddLine)
+{
+	size_t Lines{0};
+	Utility::DelimitedBlockProcessor RawDataProcessor{Contents, '\n'};
+	while (RawDataProcessor.More())
+	{
+		auto Line{RawDataProcessor.GetNextBlock()};
+		if (!Line.empty())
+		{
+			std::string CleanedLine{};
+			CleanedLine.reserve(Line.size());
+			for (const auto &c : Line)
 			{
-				FileInErrorState = LogIOError(Log, FileSeek, PendingFiles.front().FileName, CurrentFile);
-				if (!std::feof(CurrentFile) && !std::ferror(CurrentFile) && CharactersRead < FileSize)
+				if (std::isprint(c) || c == '\t')
 				{
-					CharactersRead += std::fread(Buffer.data(), sizeof(char), FileSize, CurrentFile);
-					FileInErrorState = LogIOError(Log, FileRead, PendingFiles.front().FileName, CurrentFile);
+					CleanedLine.push_back(c);
 				}
 			}
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wparentheses"
-			if ((CurrentFile && !FileInErrorState) && ((CharactersRead == PendingFiles.front().FileSize)) || std::feof(CurrentFile))
+			if (!CleanedLine.empty())
 			{
-				CompletedFiles.push(std::move(PendingFiles.front().FileName));
+				Log.WriteDebugLazy(ExtractedLine, CleanedLine);
+				XLAT_PROBE1(line_extracted, CleanedLine.size());
+				AddLine(std::move(CleanedLine));
+				Lines++;
 			}
-			PendingFiles.pop();
-#pragma GCC diagnostic pop
+		}
+	}
+	MetricsRegistry::Get().Increment(MetricCounters::LinesRead, Lines);
+	return Lines;
+}
 
-			if (CurrentFile != nullptr)
+static void GetNextLineBlock(std::queue<std::string> &UnprocessedLines, std::queue<PendingFile> &PendingFiles, std::queue<std::string> &CompletedFiles, SpoolLagSummary &SpoolLag, SpoolCapture *Capture, ILogWriter &Log)
+{
+	std::vector<char> Buffer{};
+	while (!PendingFiles.empty() && UnprocessedLines.size() < MaxBlockSize)
+	{
+		auto &File{PendingFiles.front()};
+		RecordSpoolLag(SpoolLag, File.Modified);
+		bool Complete{false};
+		size_t CharactersRead{ReadSpoolFile(File, Buffer, Complete, Log)};
+		[[maybe_unused]] size_t Lines{0}; // for the file_complete probe
+		if (CharactersRead > 0)
+		{
+			std::string_view BufferView{Buffer.data(), CharactersRead};
+			if (Capture != nullptr)
 			{
-				std::fclose(CurrentFile);
+				Capture->Archive(File.FileName, BufferView, File.Modified);
 			}
+			Lines = ExtractCleanedLines(BufferView, Log, [&UnprocessedLines](std::string &&Line)
+												 { UnprocessedLines.push(std::move(Line)); });
+		}
+		XLAT_PROBE2(file_complete, File.FileName.c_str(), Lines);
 
-			if (CharactersRead > 0)
-			{
-				std::string_view BufferView{Buffer.data(), CharactersRead};
-				Utility::DelimitedBlockProcessor RawDataProcessor{BufferView, '\n'};
-				while (RawDataProcessor.More())
-				{
-					auto Line{RawDataProcessor.GetNextBlock()};
-					if (!Line.empty())
-					{
-						std::string CleanedLine{};
-						CleanedLine.reserve(Line.size());
-						for (const auto &c : Line)
-						{
-							if (std::isprint(c) || c == '\t')
-							{
-								CleanedLine.push_back(c);
-							}
-						}
-						if (!CleanedLine.empty())
-						{
-							Log.WriteDebugAnnoted(ExtractedLine, CleanedLine);
-							UnprocessedLines.push(std::move(CleanedLine));
-						}
-					}
-				}
-			}
+		// the file name moves out of the pending queue here, so this comes after everything that uses it
+		if (Complete)
+		{
+			CompletedFiles.push(std::move(File.FileName));
 		}
+		PendingFiles.pop();
 	}
 }
 
-FileDataCollector::FileDataCollector(const std::string &SourcePath, ILogWriter &Log) : SourcePath{SourcePath}, Log{Log}
+FileDataCollector::FileDataCollector(SpoolScanner &Scanner, ILogWriter &Log, const size_t ClaimLimit, const std::chrono::seconds LagThreshold, SpoolCapture *Capture, SpoolClaims *Claims) : SourcePath{Scanner.GetDirectory()}, Log{Log}, Scanner{Scanner}, Claims{Claims}, Capture{Capture}
 {
-	std::error_code FSErrorCode{};
-	if (std::filesystem::exists(SourcePath, FSErrorCode))
+	AllocationScope ReadScope{AllocationStage::Read};
+	SpoolLag.Threshold = LagThreshold;
+	std::vector<PendingFile> Files{};
+	if (Claims != nullptr)
 	{
-		for (const auto &direntry : std::filesystem::directory_iterator(SourcePath, FSErrorCode))
+		Files = Claims->GetClaimedFiles(ClaimLimit); // already this daemon's, and older than anything still in the spool
+		if (ClaimLimit == 0 || Files.size() < ClaimLimit) // otherwise the spool waits, and the scanner's count from its last scan stands
 		{
-			std::string FilePath{direntry.path().string()};
-			if (direntry.is_regular_file())
+			for (auto &File : Scanner.Scan(ClaimLimit == 0 ? 0 : ClaimLimit - Files.size(), [Claims](PendingFile &Candidate)
+													 { return Claims->Claim(Candidate); }))
 			{
-				if (direntry.file_size() == 0)
-				{
-					Log.WriteDebugAnnoted(SkippedEmpty, FilePath);
-					CompletedFiles.emplace(std::move(FilePath));
-				}
-				else
-				{
-					Log.WriteDebugAnnoted(AddedPerfFileForProcessing, FilePath);
-					PendingFile NextFile{std::move(FilePath), direntry.file_size()};
-					if (direntry.file_size() > MaxFileSize)
-					{
-						Log.WriteErrorAnnotated(FileTooLarge, NextFile.FileName, std::to_string(direntry.file_size()));
-					}
-					else
-					{
-						PendingFiles.push(std::move(NextFile));
-					}
-				}
+				Files.push_back(std::move(File));
 			}
 		}
 	}
-	if (FSErrorCode.value() != 0)
+	else
 	{
-		Log.WriteErrorAnnotated(SpoolDirectory, SourcePath, FSErrorCode.message());
+		Files = Scanner.Scan(ClaimLimit);
+	}
+	for (auto &File : Files)
+	{
+		std::error_code FSErrorCode{};
+		if (File.FileSize == 0 && std::filesystem::file_size(File.FileName, FSErrorCode) == 0 && !FSErrorCode) // the listed size may be cached
+		{
+			Log.WriteDebugLazy(SkippedEmpty, File.FileName);
+			CompletedFiles.emplace(std::move(File.FileName));
+		}
+		else if (File.FileSize > MaxFileSize)
+		{
+			Log.WriteErrorStructured({.FilePath = File.FileName}, FileTooLarge, File.FileName, File.FileSize);
+		}
+		else
+		{
+			Log.WriteDebugLazy(AddedPerfFileForProcessing, File.FileName);
+			PendingFiles.push(std::move(File));
+		}
 	}
 }
 
@@ -166,15 +231,65 @@ bool FileDataCollector::More() const
 	return !PendingFiles.empty() || !UnprocessedLines.empty();
 }
 
+size_t FileDataCollector::ProcessNextFiles(const size_t Count, const std::function<void(const size_t, std::vector<std::string> &)> &Process)
+{
+	std::vector<PendingFile> Files{};
+	while (!PendingFiles.empty() && Files.size() < Count)
+	{
+		RecordSpoolLag(SpoolLag, PendingFiles.front().Modified);
+		Files.push_back(std::move(PendingFiles.front()));
+		PendingFiles.pop();
+	}
+	std::vector<char> Completed(Files.size(), false); // not vector<bool>, whose elements share bytes between threads
+	{
+		std::vector<std::jthread> Workers{};
+		Workers.reserve(Files.size());
+		for (size_t Slot{0}; Slot < Files.size(); Slot++)
+		{
+			Workers.emplace_back([this, &Files, &Completed, &Process, Slot]
+										{
+				AllocationScope ReadScope{AllocationStage::Read};
+				const auto &File{Files[Slot]};
+				std::vector<char> Buffer{};
+				std::vector<std::string> Lines{};
+				bool Complete{false};
+				size_t CharactersRead{ReadSpoolFile(File, Buffer, Complete, Log)};
+				if (CharactersRead > 0)
+				{
+					std::string_view BufferView{Buffer.data(), CharactersRead};
+					if (Capture != nullptr)
+					{
+						std::lock_guard CaptureLock{CaptureMutex};
+						Capture->Archive(File.FileName, BufferView, File.Modified);
+					}
+					ExtractCleanedLines(BufferView, Log, [&Lines](std::string &&Line)
+											  { Lines.push_back(std::move(Line)); });
+				}
+				XLAT_PROBE2(file_complete, File.FileName.c_str(), Lines.size());
+				Completed[Slot] = Complete;
+				Process(Slot, Lines); });
+		}
+	}
+	for (size_t Slot{0}; Slot < Files.size(); Slot++)
+	{
+		if (Completed[Slot])
+		{
+			CompletedFiles.push(std::move(Files[Slot].FileName));
+		}
+	}
+	return Files.size();
+}
+
 std::string FileDataCollector::GetNextLine()
 {
+	AllocationScope ReadScope{AllocationStage::Read};
 	std::string ReturnLine;
 	if (UnprocessedLines.empty())
 	{
 		Log.WriteDebug(GettingNextBlock);
 		while (!PendingFiles.empty() && UnprocessedLines.size() < MaxBlockSize)
 		{
-			GetNextLineBlock(UnprocessedLines, PendingFiles, CompletedFiles, Log);
+			GetNextLineBlock(UnprocessedLines, PendingFiles, CompletedFiles, SpoolLag, Capture, Log);
 		}
 	}
 	if (UnprocessedLines.empty())
@@ -192,10 +307,20 @@ std::string FileDataCollector::GetNextLine()
 
 FileDataCollector::~FileDataCollector()
 {
+	if (SpoolLag.LateFiles > 0)
+	{
+		Log.WriteWarnLazy(SpoolFilesLate, SourcePath, LogJoin(SpoolLag.LateFiles, SpoolLag.WorstLag.count()));
+	}
 	while (!CompletedFiles.empty())
 	{
 		std::remove(CompletedFiles.front().c_str());
 		LogIOError(Log, DeleteFile, CompletedFiles.front(), nullptr);
+		// a later file under the same name may get the same inode back, and must not inherit this one's size
+		Scanner.Forget(CompletedFiles.front());
+		if (Claims != nullptr)
+		{
+			Claims->Forget(CompletedFiles.front());
+		}
 		CompletedFiles.pop();
 	}
 }
@@ -1,15 +1,24 @@
 #pragma once
 
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
+#include <vector>
 #include "logwriter.hpp"
+#include "spoolcapture.hpp"
+#include "spoolclaims.hpp"
+#include "spoolscanner.hpp"
 
-struct PendingFile
+/// @brief Spool files read later than the lag threshold during one collection cycle
+struct SpoolLagSummary
 {
-	PendingFile(std::string FileName, size_t FileSize) : FileName{FileName}, FileSize{FileSize} {}
-	std::string FileName;
-	size_t FileSize;
+	std::chrono::milliseconds Threshold{0}; // 0 disables
+	size_t LateFiles{0};
+	std::chrono::milliseconds WorstLag{0};
 };
 
 class FileDataCollector
@@ -17,12 +26,22 @@ class FileDataCollector
 private:
 	std::string SourcePath{};
 	ILogWriter &Log;
+	SpoolScanner &Scanner;
+	SpoolClaims *Claims{nullptr};
 	std::queue<PendingFile> PendingFiles{};
 	std::queue<std::string> CompletedFiles{};
 	std::queue<std::string> UnprocessedLines{};
+	SpoolLagSummary SpoolLag{};
+	SpoolCapture *Capture{nullptr};
+	std::mutex CaptureMutex{}; // workers in ProcessNextFiles share the archive
 
 public:
-	FileDataCollector(const std::string &SourcePath, ILogWriter &Log);
+	/// @param Scanner Lists the spool directory; kept across cycles for its index of files already seen
+	/// @param ClaimLimit Files to take this cycle, oldest first, 0 for all of them
+	/// @param LagThreshold Warn about files read longer than this after their last modification, 0 disables
+	/// @param Capture Receives a copy of every file read, if set
+	/// @param Claims Claims every file before it is read, and adds the files claimed before, if the spool is shared
+	FileDataCollector(SpoolScanner &Scanner, ILogWriter &Log, const size_t ClaimLimit = 0, const std::chrono::seconds LagThreshold = std::chrono::seconds{0}, SpoolCapture *Capture = nullptr, SpoolClaims *Claims = nullptr);
 	~FileDataCollector(); // assumes Log outlives this object and it is not moved or copied
 	FileDataCollector(const FileDataCollector &other) = delete;
 	FileDataCollector(FileDataCollector &&other) = delete;
@@ -30,5 +49,12 @@ public:
 	FileDataCollector &operator=(FileDataCollector &&other) = delete;
 
 	bool More() const;
+	size_t GetPendingFileCount() const { return PendingFiles.size(); }
+
+	/// @brief Reads the next Count files, oldest first, on one thread per file, for catching up on a backlog. Each thread
+	/// hands its file's cleaned lines to Process along with the file's position among the Count files.
+	/// @return Number of files read, 0 once none are pending
+	size_t ProcessNextFiles(const size_t Count, const std::function<void(const size_t Slot, std::vector<std::string> &Lines)> &Process);
+	bool HasBufferedLines() const { return !UnprocessedLines.empty(); } // lines from files that will be deleted, even if they were never handed out
 	std::string GetNextLine();
 };
\ No newline at end of file
@@ -11,34 +11,90 @@
 constexpr const std::string_view CommandPing{"ping"};
 constexpr const std::string_view CommandQuery{"query"};
 constexpr const std::string_view CommandWrite{"write"};
+constexpr const std::string_view CommandV2Write{"api/v2/write"};
+constexpr const std::string_view CommandV2Buckets{"api/v2/buckets"};
 
 // used as query parameters in the URL
 constexpr const std::string_view InfluxDatabaseParameter("db");
 constexpr const std::string_view InfluxQueryParameter("q");
+constexpr const std::string_view InfluxPrecisionParameter("precision");
+constexpr const std::string_view InfluxOrganizationParameter("org");
+constexpr const std::string_view InfluxBucketParameter("bucket");
+constexpr const std::string_view InfluxNameParameter("name");
+
+// used as headers
+constexpr const std::string_view AuthorizationHeader{"Authorization: Token "};
+constexpr const std::string_view ContentTypeHeader{"Content-Type: text/plain; charset=utf-8"};
 
 // log messages
 constexpr const std::string_view CheckHealth{"Checking Influx connectivity"};
 constexpr const std::string_view ListingDatabases{"Listing Influx databases"};
 constexpr const std::string_view InfluxDatabaseExists{"Influx database exists"};
 constexpr const std::string_view CreatingDatabase{"Creating Influx database"};
+constexpr const std::string_view ListingBuckets{"Listing Influx buckets"};
+constexpr const std::string_view InfluxBucketExists{"Influx bucket exists"};
+constexpr const std::string_view InfluxBucketMissing{"Influx bucket not found, create it before starting the daemon"};
+constexpr const std::string_view InfluxOrganizationMissing{"Influx organization or bucket not found, check org and bucket in the [influx] section"};
+constexpr const std::string_view InfluxBucketsUnsupported{"Influx 3.x server does not list buckets, assuming it creates them on write"};
 constexpr const std::string_view Write{"Writing to Influx"};
 
 static bool LogInfluxError(const CurlResponse &Response, ILogWriter &Log, const std::string_view &Activity)
 {
 	if (Response.CurlResult != CURLE_OK)
 	{
-		Log.WriteErrorAnnotated(Activity, std::to_string(Response.CurlResult), curl_easy_strerror(Response.CurlResult));
+		Log.WriteErrorStructured({.CurlCode = static_cast<int>(Response.CurlResult)}, Activity, static_cast<int>(Response.CurlResult), curl_easy_strerror(Response.CurlResult));
 		return true;
 	}
 	if (Response.ResponseCode < 200 || Response.ResponseCode >= 300)
 	{
-		Log.WriteErrorAnnotated(Activity, std::to_string(Response.ResponseCode), Response.Body.value_or(std::string{}));
+		Log.WriteErrorStructured({.HttpStatus = Response.ResponseCode}, Activity, Response.ResponseCode, [&Response]
+							  { return Response.Body ? std::string_view{*Response.Body} : std::string_view{}; });
 		return true;
 	}
-	Log.WriteDebugAnnoted(Activity, std::to_string(Response.ResponseCode), "Success");
+	Log.WriteDebugLazy(Activity, Response.ResponseCode, "Success");
 	return false;
 }
 
+constexpr const std::string_view JsonWhitespace{" \t\r\n"};
+
+// the position just past Key's colon in a JSON object, or npos. Good for the flat, known responses read here, not for
+// arbitrary JSON: it does not tell keys from string values that look like them
+static size_t FindJsonValue(const std::string_view &Json, const std::string_view &Key)
+{
+	const std::string QuotedKey{std::string{"\""}.append(Key).append(1, '"')};
+	for (size_t Position{Json.find(QuotedKey)}; Position != std::string_view::npos; Position = Json.find(QuotedKey, Position + 1))
+	{
+		const size_t Colon{Json.find_first_not_of(JsonWhitespace, Position + QuotedKey.size())};
+		if (Colon != std::string_view::npos && Json[Colon] == ':')
+		{
+			return Json.find_first_not_of(JsonWhitespace, Colon + 1);
+		}
+	}
+	return std::string_view::npos;
+}
+
+static bool IsJsonArrayNonEmpty(const std::string_view &Json, const std::string_view &Key)
+{
+	const size_t Value{FindJsonValue(Json, Key)};
+	if (Value == std::string_view::npos || Json[Value] != '[')
+	{
+		return false;
+	}
+	const size_t First{Json.find_first_not_of(JsonWhitespace, Value + 1)};
+	return First != std::string_view::npos && Json[First] != ']';
+}
+
+static std::string_view GetJsonString(const std::string_view &Json, const std::string_view &Key)
+{
+	const size_t Value{FindJsonValue(Json, Key)};
+	if (Value == std::string_view::npos || Json[Value] != '"')
+	{
+		return {};
+	}
+	const size_t End{Json.find('"', Value + 1)};
+	return End == std::string_view::npos ? std::string_view{} : Json.substr(Value + 1, End - Value - 1);
+}
+
 static CurlRequest GetInfluxRequest(const std::string_view &Path, const bool WantHeaders = false, const bool WantBody = true)
 {
 	CurlRequest InfluxRequest{WantHeaders, WantBody, true};
@@ -65,13 +121,62 @@ static CurlResponse CreateDatabase(CurlClient &Curl, const std::string_view &Dat
 	return Curl.Post(CreateDatabaseRequest);
 }
 
-InfluxClient::InfluxClient(ILogWriter &Log, std::string HostName, const long Port, std::string DatabaseName, std::string MeasurementName, std::map<const std::string, const std::string> &UnitConversionMap)
-	 : Log{Log}, HostName{HostName}, DatabaseName{DatabaseName}, Curl{CurlClient{Log, std::string{HostName}, Port}}, Translator{Log, MeasurementName, UnitConversionMap} {}
+// v1 spells microseconds and nanoseconds differently than v2
+static std::string_view GetV1Precision(const std::string_view &Precision)
+{
+	if (Precision == "us")
+	{
+		return "u";
+	}
+	if (Precision == "ns")
+	{
+		return "n";
+	}
+	return Precision;
+}
+
+InfluxClient::InfluxClient(ILogWriter &Log, const InfluxConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap)
+	 : BatchingSink{Log, Settings.BatchSize, Settings.MaxPending}, Settings{Settings}, Curl{Log, Settings.HostName, Settings.Port}, Translator{Log, Settings.MeasurementName, UnitConversionMap, Settings.Precision}
+{
+	if (!Settings.Token.empty())
+	{
+		Curl.AddHeader(std::string{AuthorizationHeader}.append(Settings.Token));
+	}
+	Curl.AddHeader(ContentTypeHeader);
+
+	// the write target never changes for the life of the client, so build it once instead of on every line
+	CurlRequest QueryBuilder{};
+	if (Settings.ApiVersion == InfluxApiVersion::V2)
+	{
+		WritePath = CommandV2Write;
+		QueryBuilder.AddQueryParameter(InfluxOrganizationParameter, Settings.Organization);
+		QueryBuilder.AddQueryParameter(InfluxBucketParameter, Settings.Bucket);
+		QueryBuilder.AddQueryParameter(InfluxPrecisionParameter, Settings.Precision);
+	}
+	else
+	{
+		WritePath = CommandWrite;
+		QueryBuilder.AddQueryParameter(InfluxDatabaseParameter, Settings.DatabaseName);
+		QueryBuilder.AddQueryParameter(InfluxPrecisionParameter, GetV1Precision(Settings.Precision));
+	}
+	WriteQuery = QueryBuilder.GetQuery();
+
+	if (Settings.SuppressUnchangedThresholds)
+	{
+		Translator.SuppressUnchangedThresholds(GetThresholdSnapshotPath(GetName()), Settings.ThresholdRefresh);
+	}
+}
 
 bool InfluxClient::TestConnection()
 {
-	auto PingResult{GetInfluxRequest(CommandPing)};
-	return !LogInfluxError(Curl.Get(PingResult), Log, CheckHealth);
+	auto PingResult{Curl.Get(GetInfluxRequest(CommandPing))};
+	if (LogInfluxError(PingResult, Log, CheckHealth))
+	{
+		return false;
+	}
+	// 1.x and 2.x answer 204 with no body, 3.x answers with its version
+	ServerIsV3 = GetJsonString(PingResult.Body.value_or(std::string{}), "version").starts_with('3');
+	return true;
 }
 
 bool InfluxClient::CreateDatabaseIfNotExists()
@@ -79,76 +184,91 @@ bool InfluxClient::CreateDatabaseIfNotExists()
 	auto DatabaseList{ShowDatabases(Curl)};
 	if (!LogInfluxError(DatabaseList, Log, ListingDatabases))
 	{
-		if (DatabaseList.Body->find(std::string{"[\""}.append(DatabaseName).append("\"]")) != std::string::npos)
+		if (DatabaseList.Body->find(std::string{"[\""}.append(Settings.DatabaseName).append("\"]")) != std::string::npos)
 		{
 			Log.WriteDebug(InfluxDatabaseExists);
 			return true;
 		}
-		auto CreateDatabaseResult(CreateDatabase(Curl, DatabaseName));
+		auto CreateDatabaseResult(CreateDatabase(Curl, Settings.DatabaseName));
 		return !LogInfluxError(CreateDatabaseResult, Log, CreatingDatabase);
 	}
 	return false;
 }
 
-void InfluxClient::TransmitNagiosLine(const NagiosPerformanceRecord &NagiosData, std::string &&SourceLine)
+bool InfluxClient::VerifyBucketExists()
 {
-	auto WriteLineRequest{GetInfluxRequest(CommandWrite)};
-	for (auto &line : Translator.TranslateNagiosData(NagiosData))
+	if (ServerIsV3)
+	{
+		Log.WriteInfo(InfluxBucketsUnsupported); // 3.x serves the v2 write API but not its management API
+		return true;
+	}
+	auto BucketListRequest{GetInfluxRequest(CommandV2Buckets)};
+	BucketListRequest.AddQueryParameter(InfluxOrganizationParameter, Settings.Organization);
+	BucketListRequest.AddQueryParameter(InfluxNameParameter, Settings.Bucket);
+	auto BucketList{Curl.Get(BucketListRequest)};
+	if (BucketList.CurlResult == CURLE_OK && BucketList.ResponseCode == 404) // 2.x's answer for an unknown org or bucket name
 	{
-		WriteLineRequest.ClearQuery();
-		WriteLineRequest.AddQueryParameter(InfluxDatabaseParameter, DatabaseName);
-		WriteLineRequest.AddQueryParameter("precision", "s");
-		WriteLineRequest.SetPostData(std::move(line));
-		auto WriteResult{Curl.Post(WriteLineRequest)};
-		if (LogInfluxError(WriteResult, Log, Write))
+		Log.WriteErrorStructured({.HttpStatus = BucketList.ResponseCode}, InfluxOrganizationMissing, LogJoin(Settings.Organization, Settings.Bucket), [&BucketList]
+										 { return BucketList.Body ? std::string_view{*BucketList.Body} : std::string_view{}; });
+		return false;
+	}
+	if (!LogInfluxError(BucketList, Log, ListingBuckets))
+	{
+		// the server filtered by name, so any bucket in the list is the one asked for
+		if (IsJsonArrayNonEmpty(BucketList.Body.value_or(std::string{}), "buckets"))
 		{
-			Log.WriteUploadError(SourceLine);
-			break;
+			Log.WriteDebug(InfluxBucketExists);
+			return true;
 		}
+		Log.WriteErrorAnnotated(InfluxBucketMissing, Settings.Bucket);
 	}
+	return false;
 }
 
-//** Following code works, but almost certainly uses more memory than it's worth and needs refinement (no great way to catch lines that influx didn't like)
-//** Resurrect if bulk inserts become necessary
-// constexpr const size_t InitialRecordsSize{1024 * 1024}; // start with a 1MB buffer. the service will learn as it goes to make more appropriate sizes
-// constexpr const size_t RecordsSizePadding{512};			  // after the first pass, uses a buffer sized by previous experience. add a bit of padding to reduce odds of reallocation
-// size_t InfluxClient::LongestLineSeen{0};
-// void InfluxClient::TransmitNagiosBlock(std::queue<NagiosPerformanceRecord> &NagiosData, size_t &LineCount)
-// {
-// 	std::string RecordsString{};
-// 	if (LongestLineSeen == 0)
-// 	{
-// 		RecordsString.reserve(InitialRecordsSize);
-// 	}
-// 	else
-// 	{
-// 		RecordsString.reserve((LongestLineSeen * LineCount) + LineCount + RecordsSizePadding);
-// 	}
-// 	while (!NagiosData.empty())
-// 	{
-// 		auto &NagiosRecord{NagiosData.front()};
-// 		for (auto &line : Translator.TranslateNagiosData(NagiosRecord))
-// 		{
-// 			if (line.size() > LongestLineSeen)
-// 			{
-// 				LongestLineSeen = line.size();
-// 			}
-// 			RecordsString.append(std::move(line)).append(1, '\n');
-// 		}
-// 		NagiosData.pop();
-// 	}
-
-// 	auto WriteLineRequest{CurlRequest{false, false, true}};
-// 	WriteLineRequest.SetPath(CommandWrite);
-// 	WriteLineRequest.AddQueryParameter(InfluxDatabaseParameter, DatabaseName);
-// 	WriteLineRequest.SetPostData(std::move(RecordsString));
-// 	auto PostResult{Curl.Post(WriteLineRequest)};
-// 	if (PostResult.CurlResult == CURLE_OK)
-// 	{
-// 		Log.WriteDebug(InfluxWriteSucceeded);
-// 	}
-// 	else
-// 	{
-// 		Log.WriteErrorAnnotated(InfluxWriteFailed, std::to_string(PostResult.CurlResult), curl_easy_strerror(PostResult.CurlResult));
-// 	}
-// }
\ No newline at end of file
+bool InfluxClient::PrepareDestination()
+{
+	if (Settings.ApiVersion == InfluxApiVersion::V2)
+	{
+		return VerifyBucketExists();
+	}
+	return CreateDatabaseIfNotExists();
+}
+
+size_t InfluxClient::AppendRecord(const NagiosPerformanceRecord &NagiosData)
+{
+	size_t Points{0};
+	for (auto &Line : Translator.TranslateNagiosData(NagiosData))
+	{
+		PendingBody.append(Line).push_back('\n');
+		Points++;
+	}
+	return Points;
+}
+
+SendResult InfluxClient::SendPending()
+{
+	auto WriteRequest{GetInfluxRequest(WritePath)};
+	WriteRequest.SetQuery(WriteQuery);
+	WriteRequest.SetPostData(std::move(PendingBody));
+	auto WriteResult{Curl.Post(WriteRequest)};
+	PendingBody = WriteRequest.ReleasePostData(); // the body must survive a failed attempt for a retry
+	if (LogInfluxError(WriteResult, Log, Write))
+	{
+		return WriteResult.IsTransientFailure() ? SendResult::Retry : SendResult::Rejected;
+	}
+	Translator.CommitThresholds();
+	Translator.SaveThresholdSnapshot();
+	return SendResult::Delivered;
+}
+
+void InfluxClient::ClearPending()
+{
+	PendingBody.clear();
+	Translator.DiscardThresholds(); // already committed if the request was delivered
+}
+
+void InfluxClient::Close()
+{
+	BatchingSink::Close();
+	Translator.SaveThresholdSnapshot(true);
+}
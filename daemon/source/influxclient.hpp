@@ -2,31 +2,44 @@
 
 #include <curl/curl.h>
 #include <map>
-#include <queue>
 #include <string_view>
+#include "config.hpp"
+#include "config_constants.hpp"
 #include "curlclient.hpp"
 #include "influxtranslator.hpp"
 #include "logwriter.hpp"
 #include "nagiosparser.hpp"
+#include "sink.hpp"
 
-class InfluxClient
+class InfluxClient : public BatchingSink
 {
 private:
-	ILogWriter &Log;
-	const std::string HostName;
-	const std::string DatabaseName;
+	const InfluxConfiguration Settings;
 	CurlClient Curl;
 	InfluxTranslator Translator;
-
-public:
-	InfluxClient(ILogWriter &Log, std::string HostName, long Port, std::string DatabaseName, std::string MeasurementName, std::map<const std::string, const std::string> &UnitConversionMap);
-	~InfluxClient() = default;
-	InfluxClient(const InfluxClient &) = delete;
-	InfluxClient &operator=(const InfluxClient &) = delete;
-	InfluxClient(InfluxClient &&) = delete;
-	InfluxClient &operator=(InfluxClient &&) = delete;
+	std::string WritePath{};
+	std::string WriteQuery{};
+	std::string PendingBody{}; // newline-separated lines of the next write request
+	bool ServerIsV3{false};		// from the last ping
 
 	bool TestConnection();
 	bool CreateDatabaseIfNotExists();
-	void TransmitNagiosLine(const NagiosPerformanceRecord &NagiosData, std::string &&SourceLine);
-};
+	bool VerifyBucketExists();
+
+	/// @brief Makes sure the write destination exists. Creates the 1.x database if missing. Checks the 2.x bucket, which the daemon will not create on its own.
+	/// @return True if writes can proceed
+	bool PrepareDestination();
+
+protected:
+	virtual bool Connect() override { return TestConnection() && PrepareDestination(); }
+	virtual size_t AppendRecord(const NagiosPerformanceRecord &NagiosData) override;
+	virtual SendResult SendPending() override;
+	virtual void ClearPending() override;
+
+public:
+	InfluxClient(ILogWriter &Log, const InfluxConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap);
+	virtual ~InfluxClient() = default;
+
+	virtual void Close() override;
+	virtual std::string_view GetName() const override { return ConfigConstants::Headers::influx; }
+};
\ No newline at end of file
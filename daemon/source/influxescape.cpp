@@ -0,0 +1,231 @@
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XLAT_ESCAPE_X86
+#endif
+#include "influxescape.hpp"
+
+// the characters one context escapes, as a lookup table for the scalar kernel and as needles for the vector kernels
+struct EscapeSet
+{
+	std::array<bool, 256> Table{};
+	alignas(16) std::array<char, 16> Needles{};
+	int Count{0};
+};
+
+using FindFunction = size_t (*)(const char *Data, const size_t Size, const EscapeSet &Set);
+
+// helper functions
+static constexpr EscapeSet MakeEscapeSet(const std::string_view &Characters)
+{
+	EscapeSet Set{};
+	for (const auto Character : Characters)
+	{
+		Set.Table[static_cast<unsigned char>(Character)] = true;
+		Set.Needles[static_cast<size_t>(Set.Count++)] = Character;
+	}
+	for (size_t Padding{Characters.size()}; Padding < Set.Needles.size(); Padding++)
+	{
+		Set.Needles[Padding] = Characters[0]; // repeats a needle, so the AVX2 kernel can always compare four
+	}
+	return Set;
+}
+
+static constexpr const EscapeSet MeasurementSet{MakeEscapeSet(", \\")};
+static constexpr const EscapeSet TagSet{MakeEscapeSet(",= \\")};
+static constexpr const EscapeSet FieldStringSet{MakeEscapeSet("\"\\")};
+static_assert(MeasurementSet.Count <= 4 && TagSet.Count <= 4 && FieldStringSet.Count <= 4, "the AVX2 kernel compares four needles");
+
+static const EscapeSet &GetEscapeSet(const InfluxEscape::Context Where)
+{
+	switch (Where)
+	{
+	case InfluxEscape::Context::Measurement:
+		return MeasurementSet;
+	case InfluxEscape::Context::FieldString:
+		return FieldStringSet;
+	default:
+		return TagSet;
+	}
+}
+
+static size_t FindScalar(const char *Data, const size_t Size, const EscapeSet &Set)
+{
+	size_t Position{0};
+	while (Position < Size && !Set.Table[static_cast<unsigned char>(Data[Position])])
+	{
+		Position++;
+	}
+	return Position;
+}
+
+#ifdef XLAT_ESCAPE_X86
+// PCMPESTRI compares each of 16 bytes against every needle at once; the tail shorter than a block is left to the table
+__attribute__((target("sse4.2"))) static size_t FindSSE42(const char *Data, const size_t Size, const EscapeSet &Set)
+{
+	const __m128i Needles{_mm_load_si128(reinterpret_cast<const __m128i *>(Set.Needles.data()))};
+	size_t Position{0};
+	for (; Position + 16 <= Size; Position += 16)
+	{
+		const __m128i Block{_mm_loadu_si128(reinterpret_cast<const __m128i *>(Data + Position))};
+		const int Index{_mm_cmpestri(Needles, Set.Count, Block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT)};
+		if (Index < 16)
+		{
+			return Position + static_cast<size_t>(Index);
+		}
+	}
+	return Position + FindScalar(Data + Position, Size - Position, Set);
+}
+
+// one byte-wise compare per needle over 32 bytes, then once over 16, so labels of 16 to 31 bytes are vectorised too
+__attribute__((target("avx2"))) static size_t FindAVX2(const char *Data, const size_t Size, const EscapeSet &Set)
+{
+	size_t Position{0};
+	if (Size >= 32)
+	{
+		const __m256i Needle0{_mm256_set1_epi8(Set.Needles[0])};
+		const __m256i Needle1{_mm256_set1_epi8(Set.Needles[1])};
+		const __m256i Needle2{_mm256_set1_epi8(Set.Needles[2])};
+		const __m256i Needle3{_mm256_set1_epi8(Set.Needles[3])};
+		for (; Position + 32 <= Size; Position += 32)
+		{
+			const __m256i Block{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(Data + Position))};
+			const __m256i Matches{_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(Block, Needle0), _mm256_cmpeq_epi8(Block, Needle1)),
+															  _mm256_or_si256(_mm256_cmpeq_epi8(Block, Needle2), _mm256_cmpeq_epi8(Block, Needle3)))};
+			const auto Mask{static_cast<uint32_t>(_mm256_movemask_epi8(Matches))};
+			if (Mask != 0)
+			{
+				return Position + static_cast<size_t>(std::countr_zero(Mask));
+			}
+		}
+	}
+	if (Position + 16 <= Size)
+	{
+		const __m128i Block{_mm_loadu_si128(reinterpret_cast<const __m128i *>(Data + Position))};
+		const __m128i Matches{_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Block, _mm_set1_epi8(Set.Needles[0])), _mm_cmpeq_epi8(Block, _mm_set1_epi8(Set.Needles[1]))),
+													  _mm_or_si128(_mm_cmpeq_epi8(Block, _mm_set1_epi8(Set.Needles[2])), _mm_cmpeq_epi8(Block, _mm_set1_epi8(Set.Needles[3]))))};
+		const auto Mask{static_cast<uint32_t>(_mm_movemask_epi8(Matches))};
+		if (Mask != 0)
+		{
+			return Position + static_cast<size_t>(std::countr_zero(Mask));
+		}
+		Position += 16;
+	}
+	return Position + FindScalar(Data + Position, Size - Position, Set);
+}
+#endif
+
+static bool IsSupported(const InfluxEscape::Kernel Which)
+{
+#ifdef XLAT_ESCAPE_X86
+	__builtin_cpu_init(); // may run from a static initializer, before libgcc has filled in the CPU model
+	switch (Which)
+	{
+	case InfluxEscape::Kernel::AVX2:
+		return __builtin_cpu_supports("avx2");
+	case InfluxEscape::Kernel::SSE42:
+		return __builtin_cpu_supports("sse4.2");
+	default:
+		return true;
+	}
+#else
+	return Which == InfluxEscape::Kernel::Scalar;
+#endif
+}
+
+static FindFunction GetFindFunction(const InfluxEscape::Kernel Which)
+{
+	switch (Which)
+	{
+#ifdef XLAT_ESCAPE_X86
+	case InfluxEscape::Kernel::AVX2:
+		return FindAVX2;
+	case InfluxEscape::Kernel::SSE42:
+		return FindSSE42;
+#endif
+	default:
+		return FindScalar;
+	}
+}
+
+// constant-initialized to the scalar kernel, so escaping from another file's static initializer is still safe
+static InfluxEscape::Kernel SelectedKernel{InfluxEscape::Kernel::Scalar};
+static FindFunction SelectedFind{FindScalar};
+[[maybe_unused]] static const bool BestKernelSelected{InfluxEscape::SetKernel(InfluxEscape::GetBestKernel())};
+
+// public functions
+size_t InfluxEscape::FindEscaped(const std::string_view &Value, const size_t Start, const Context Where)
+{
+	if (Start >= Value.size())
+	{
+		return Value.size();
+	}
+	return Start + SelectedFind(Value.data() + Start, Value.size() - Start, GetEscapeSet(Where));
+}
+
+void InfluxEscape::AppendEscaped(std::string &Target, const std::string_view &Value, const Context Where)
+{
+	const EscapeSet &Set{GetEscapeSet(Where)};
+	size_t Escaped{SelectedFind(Value.data(), Value.size(), Set)};
+	if (Escaped == Value.size())
+	{
+		Target.append(Value);
+		return;
+	}
+	size_t Start{0};
+	while (Escaped < Value.size())
+	{
+		Target.append(Value.substr(Start, Escaped - Start)).push_back('\\');
+		Target.push_back(Value[Escaped]);
+		Start = Escaped + 1;
+		Escaped = Start + SelectedFind(Value.data() + Start, Value.size() - Start, Set);
+	}
+	Target.append(Value.substr(Start));
+}
+
+InfluxEscape::Kernel InfluxEscape::GetKernel()
+{
+	return SelectedKernel;
+}
+
+bool InfluxEscape::SetKernel(const Kernel Replacement)
+{
+	if (!IsSupported(Replacement))
+	{
+		return false;
+	}
+	SelectedKernel = Replacement;
+	SelectedFind = GetFindFunction(Replacement);
+	return true;
+}
+
+InfluxEscape::Kernel InfluxEscape::GetBestKernel()
+{
+	if (IsSupported(Kernel::AVX2))
+	{
+		return Kernel::AVX2;
+	}
+	if (IsSupported(Kernel::SSE42))
+	{
+		return Kernel::SSE42;
+	}
+	return Kernel::Scalar;
+}
+
+std::string_view InfluxEscape::GetKernelName(const Kernel Which)
+{
+	switch (Which)
+	{
+	case Kernel::AVX2:
+		return "avx2";
+	case Kernel::SSE42:
+		return "sse4.2";
+	default:
+		return "scalar";
+	}
+}
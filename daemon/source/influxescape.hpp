@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Line protocol escaping. The scan for characters that need a backslash runs 32 (AVX2) or 16 (SSE4.2) bytes at a time
+// where the CPU supports it, picked once at startup, and falls back to a table lookup elsewhere and for short tails.
+namespace InfluxEscape
+{
+	enum class Context
+	{
+		Measurement, // comma, space and backslash
+		Tag,			 // tag keys, tag values and field keys: comma, equals sign, space and backslash
+		FieldString	 // inside a double-quoted string field value: double quote and backslash
+	};
+
+	enum class Kernel
+	{
+		Scalar,
+		SSE42,
+		AVX2
+	};
+
+	/// @return Position of the first character at or after Start that Where escapes, or Value.size() if there is none
+	size_t FindEscaped(const std::string_view &Value, const size_t Start, const Context Where);
+
+	/// @brief Appends Value to Target with a backslash before every character Where escapes. Values that need no escaping,
+	/// nearly all of them, are appended in one copy.
+	void AppendEscaped(std::string &Target, const std::string_view &Value, const Context Where);
+
+	/// @return The kernel selected at startup, or by SetKernel
+	Kernel GetKernel();
+
+	/// @brief Replaces the selected kernel, for benchmarks. Call before other threads escape anything.
+	/// @return False, leaving the selection alone, if this CPU cannot run Replacement
+	bool SetKernel(const Kernel Replacement);
+
+	/// @return The best kernel this CPU can run
+	Kernel GetBestKernel();
+
+	std::string_view GetKernelName(const Kernel Which);
+}
@@ -1,15 +1,37 @@
+#include <charconv>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 #include "logwriter.hpp"
+#include "influxescape.hpp"
 #include "influxtranslator.hpp"
+#include "metrics.hpp"
 #include "utility.hpp"
 
 constexpr const std::string_view ExpectedVsActualFinalStringSize{"Expected number of chars vs actual number of chars"};
+static const std::string EmptyValue{};
 
 // helper functions
+static std::string_view GetTimestampSuffix(const std::string_view &Precision)
+{
+	if (Precision == "ms")
+	{
+		return "000";
+	}
+	if (Precision == "us")
+	{
+		return "000000";
+	}
+	if (Precision == "ns")
+	{
+		return "000000000";
+	}
+	return "";
+}
+
 const std::string ConvertFromNagiosUnit(const std::string &NagiosUnit, const std::map<const std::string, const std::string> &UnitTranslationMap)
 {
 	auto unitsearch{UnitTranslationMap.find(NagiosUnit)};
@@ -20,51 +42,35 @@ const std::string ConvertFromNagiosUnit(const std::string &NagiosUnit, const std
 	return unitsearch->second;
 }
 
-std::string EscapeInfluxString(const std::string &InfluxString, const bool Enquote)
+static std::string EscapeMeasurementName(const std::string_view &MeasurementName)
 {
-	std::string EscapedString{};
-	EscapedString.reserve(InfluxString.size() + (Enquote * 2) + 5); // +5 is a magic number to over-account for the probability of escaping characters
-
-	if (Enquote)
-		EscapedString.push_back('"'); // only non-numeric fields require quoting, but cheaper for us to quote everything and let influxdb's parser worry about it
-	for (const auto &Character : InfluxString)
-	{
-		switch (Character)
-		{
-		case ' ':
-			[[fallthrough]];
-		case ',':
-			[[fallthrough]];
-		case '=':
-			EscapedString.push_back('\\');
-			break;
-		default:
-			break;
-		}
-		EscapedString.push_back(Character);
-	}
-	if (Enquote)
-		EscapedString.push_back('"');
-	return EscapedString;
+	std::string Escaped{};
+	InfluxEscape::AppendEscaped(Escaped, MeasurementName, InfluxEscape::Context::Measurement);
+	return Escaped;
 }
 
-size_t SetItem(std::map<std::string, std::string> &TargetMap, const std::string &Key, const std::string &Value, const bool IsField)
+// escapes in place of the previous record's value, so the map's strings keep their capacity and rarely allocate
+size_t SetItem(std::map<std::string, std::string> &TargetMap, const std::string &Key, const std::string &Value, const InfluxEscape::Context Where, const bool Enquote)
 {
 	if (Value.empty())
 	{
 		TargetMap.erase(Key);
 		return 0;
 	}
-	std::string FinalValue;
+	std::string &FinalValue{TargetMap[Key]};
+	FinalValue.clear();
 	if (Utility::IsNumber(Value))
 	{
-		FinalValue = Value;
+		FinalValue.append(Value);
 	}
 	else
 	{
-		FinalValue = EscapeInfluxString(Value, IsField);
+		if (Enquote)
+			FinalValue.push_back('"'); // only non-numeric fields require quoting
+		InfluxEscape::AppendEscaped(FinalValue, Value, Where);
+		if (Enquote)
+			FinalValue.push_back('"');
 	}
-	TargetMap[Key] = FinalValue;
 	return Key.size() + FinalValue.size() + 1; // +1 for = sign
 }
 
@@ -100,32 +106,85 @@ std::string InfluxTranslator::TranslateLine(size_t LineStart)
 }
 
 // public functions
-InfluxTranslator::InfluxTranslator(ILogWriter &Log, const std::string_view &MeasurementName, const std::map<const std::string, const std::string> TranslationMap)
-	 : Log{Log}, MeasurementName{MeasurementName}, UnitTranslationMap{std::move(TranslationMap)}
+InfluxTranslator::InfluxTranslator(ILogWriter &Log, const std::string_view &MeasurementName, const std::map<const std::string, const std::string> TranslationMap, const std::string_view &Precision)
+	 : Log{Log}, MeasurementName{EscapeMeasurementName(MeasurementName)}, UnitTranslationMap{std::move(TranslationMap)}, TimestampSuffix{GetTimestampSuffix(Precision)}
 {
-	LineLengthBase = MeasurementName.size() + 1; // +1 for comma after name
+	LineLengthBase = this->MeasurementName.size() + 1; // the escaped name, +1 for comma after name
 }
 
 std::vector<std::string> InfluxTranslator::TranslateNagiosData(const NagiosPerformanceRecord &NagiosData)
 {
+	MetricTimer TranslateTimer{MetricHistograms::TranslateNanoseconds};
 	std::vector<std::string> TranslatedData{};
 	TranslatedData.reserve(NagiosData.PerfData.size());
+	size_t SuppressedThresholds{0};
 	size_t BaseLineLength{0};
-	BaseLineLength += SetItem(Tags, "host", NagiosData.HostName, false);
-	BaseLineLength += SetItem(Tags, "service", NagiosData.ServiceName, false);
+	BaseLineLength += SetItem(Tags, "host", NagiosData.HostName, InfluxEscape::Context::Tag, false);
+	BaseLineLength += SetItem(Tags, "service", NagiosData.ServiceName, InfluxEscape::Context::Tag, false);
 	Timestamp = NagiosData.Timestamp;
+	Timestamp.append(TimestampSuffix);
 	BaseLineLength += Timestamp.size();
+	int64_t RecordTime{0};
+	if (Thresholds)
+	{
+		std::from_chars(NagiosData.Timestamp.data(), NagiosData.Timestamp.data() + NagiosData.Timestamp.size(), RecordTime); // the parser already rejected non-numeric timestamps
+	}
 	for (const auto &PerfData : NagiosData.PerfData)
 	{
+		bool EmitThresholds{!Thresholds || Thresholds->ShouldEmit(NagiosData, PerfData, RecordTime)};
+		SuppressedThresholds += EmitThresholds ? 0 : 1;
 		size_t LineLength{BaseLineLength};
-		LineLength += SetItem(Tags, "label", PerfData.Label, false);
-		LineLength += SetItem(Fields, "value", PerfData.Value, true);
-		LineLength += SetItem(Fields, "warn", PerfData.Warn, true);
-		LineLength += SetItem(Fields, "crit", PerfData.Crit, true);
-		LineLength += SetItem(Fields, "min", PerfData.Min, true);
-		LineLength += SetItem(Fields, "max", PerfData.Max, true);
-		LineLength += SetItem(Tags, "unit", ConvertFromNagiosUnit(PerfData.Unit, UnitTranslationMap), true);
+		LineLength += SetItem(Tags, "label", PerfData.Label, InfluxEscape::Context::Tag, false);
+		LineLength += SetItem(Fields, "value", PerfData.Value, InfluxEscape::Context::FieldString, true);
+		LineLength += SetItem(Fields, "warn", EmitThresholds ? PerfData.Warn : EmptyValue, InfluxEscape::Context::FieldString, true);
+		LineLength += SetItem(Fields, "crit", EmitThresholds ? PerfData.Crit : EmptyValue, InfluxEscape::Context::FieldString, true);
+		LineLength += SetItem(Fields, "min", EmitThresholds ? PerfData.Min : EmptyValue, InfluxEscape::Context::FieldString, true);
+		LineLength += SetItem(Fields, "max", EmitThresholds ? PerfData.Max : EmptyValue, InfluxEscape::Context::FieldString, true);
+		// units have always been written as quoted tag values; the quotes stay so existing series do not split
+		LineLength += SetItem(Tags, "unit", ConvertFromNagiosUnit(PerfData.Unit, UnitTranslationMap), InfluxEscape::Context::Tag, true);
 		TranslatedData.emplace_back(TranslateLine(LineLength));
 	}
+	auto &Metrics{MetricsRegistry::Get()};
+	Metrics.Increment(MetricCounters::PointsTranslated, TranslatedData.size());
+	if (SuppressedThresholds)
+	{
+		Metrics.Increment(MetricCounters::ThresholdsSuppressed, SuppressedThresholds);
+	}
 	return TranslatedData;
-}
\ No newline at end of file
+}
+
+void InfluxTranslator::SuppressUnchangedThresholds(const std::string &SnapshotPath, const int64_t RefreshInterval)
+{
+	Thresholds = std::make_unique<ThresholdCache>(Log, SnapshotPath, RefreshInterval);
+}
+
+void InfluxTranslator::CommitThresholds()
+{
+	if (Thresholds)
+	{
+		Thresholds->Commit();
+	}
+}
+
+void InfluxTranslator::DiscardThresholds()
+{
+	if (Thresholds)
+	{
+		Thresholds->Discard();
+	}
+}
+
+void InfluxTranslator::SaveThresholdSnapshot(const bool Force)
+{
+	if (Thresholds)
+	{
+		if (Force)
+		{
+			Thresholds->Save();
+		}
+		else
+		{
+			Thresholds->SaveIfDue();
+		}
+	}
+}
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include "logwriter.hpp"
 #include "nagiosparser.hpp"
+#include "thresholdcache.hpp"
 
 class InfluxTranslator
 {
@@ -13,13 +15,15 @@ private:
 	size_t LineLengthBase{0};
 	const std::string MeasurementName;
 	const std::map<const std::string, const std::string> UnitTranslationMap;
+	const std::string_view TimestampSuffix; // zeros that scale Nagios' seconds to the configured precision
 	std::string Timestamp{};
 	std::map<std::string, std::string> Tags{};
 	std::map<std::string, std::string> Fields{};
+	std::unique_ptr<ThresholdCache> Thresholds{nullptr}; // null unless unchanged thresholds are suppressed
 	std::string TranslateLine(size_t LineStart);
 
 public:
-	InfluxTranslator(ILogWriter &Log, const std::string_view &MeasurementName, const std::map<const std::string, const std::string> TranslationMap);
+	InfluxTranslator(ILogWriter &Log, const std::string_view &MeasurementName, const std::map<const std::string, const std::string> TranslationMap, const std::string_view &Precision = "s");
 	InfluxTranslator(const InfluxTranslator &) = delete;
 	InfluxTranslator &operator=(const InfluxTranslator &) = delete;
 	InfluxTranslator(InfluxTranslator &&) = delete;
@@ -27,4 +31,17 @@ public:
 	~InfluxTranslator() = default;
 
 	std::vector<std::string> TranslateNagiosData(const NagiosPerformanceRecord &NagiosData);
+
+	/// @brief Leaves warn, crit, min and max out of a point unless they changed or RefreshInterval seconds passed since they were last written
+	/// @param SnapshotPath File that remembers the last written thresholds across restarts
+	void SuppressUnchangedThresholds(const std::string &SnapshotPath, const int64_t RefreshInterval);
+
+	/// @brief Records the thresholds translated since the last call as written, once the request carrying them is delivered
+	void CommitThresholds();
+
+	/// @brief Forgets the thresholds translated since the last commit, after their request was dropped or saved instead
+	void DiscardThresholds();
+
+	/// @brief Persists suppression state. Pass true to write even if the snapshot interval has not passed.
+	void SaveThresholdSnapshot(const bool Force = false);
 };
\ No newline at end of file
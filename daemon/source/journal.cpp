@@ -0,0 +1,175 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include "config_constants.hpp"
+#include "journal.hpp"
+
+// helper functions
+static void AppendJournalField(std::string &Datagram, const std::string_view &Name, const std::string_view &Value)
+{
+	if (Value.find('\n') == std::string_view::npos)
+	{
+		Datagram.append(Name).append(1, '=').append(Value).append(1, '\n');
+		return;
+	}
+	// values with newlines use the binary form: name, newline, 64-bit little-endian length, value, newline
+	Datagram.append(Name).append(1, '\n');
+	uint64_t Length{Value.size()};
+	for (int Byte{0}; Byte < 8; Byte++)
+	{
+		Datagram.push_back(static_cast<char>((Length >> (Byte * 8)) & 0xff));
+	}
+	Datagram.append(Value).append(1, '\n');
+}
+
+static std::string_view GetJournalFieldName(const LogArgumentKind Kind)
+{
+	switch (Kind)
+	{
+	case LogArgumentKind::FilePath:
+		return "FILE_PATH";
+	case LogArgumentKind::Host:
+		return "HOST";
+	case LogArgumentKind::Service:
+		return "SERVICE";
+	case LogArgumentKind::ErrorNumber:
+		return "ERRNO";
+	case LogArgumentKind::CurlCode:
+		return "CURL_CODE";
+	case LogArgumentKind::HttpStatus:
+		return "HTTP_STATUS";
+	default:
+		return {}; // item and error text are part of MESSAGE
+	}
+}
+
+// private functions
+int JournalSocket::Connect()
+{
+	Socket = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (Socket < 0)
+	{
+		return errno;
+	}
+	sockaddr_un Address{};
+	Address.sun_family = AF_UNIX;
+	if (SocketPath.size() >= sizeof(Address.sun_path))
+	{
+		::close(Socket);
+		Socket = -1;
+		return ENAMETOOLONG;
+	}
+	SocketPath.copy(Address.sun_path, SocketPath.size());
+	if (::connect(Socket, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) != 0)
+	{
+		int ErrorCode{errno};
+		::close(Socket);
+		Socket = -1;
+		return ErrorCode;
+	}
+	return 0;
+}
+
+// public functions
+JournalSocket::JournalSocket(const std::string_view &SocketPath) : SocketPath{SocketPath}, Datagrams(MaxBatch), MessageTexts(MaxBatch)
+{
+	for (size_t Index{0}; Index < MaxBatch; Index++)
+	{
+		Datagrams[Index].reserve(LogRecord::ArgumentCapacity * 2);
+		MessageTexts[Index].reserve(LogRecord::ArgumentCapacity);
+	}
+}
+
+JournalSocket::~JournalSocket()
+{
+	Flush();
+	if (Socket >= 0)
+	{
+		::close(Socket);
+	}
+}
+
+int JournalSocket::Append(const LogRecord &Record)
+{
+	std::string &Datagram{Datagrams[QueuedDatagrams]};
+	std::string &MessageText{MessageTexts[QueuedDatagrams]};
+	Severities[QueuedDatagrams++] = Record.Severity;
+	Datagram.clear();
+	Datagram.append("PRIORITY=").append(std::to_string(GetSyslogPriority(Record.Severity))).append(1, '\n');
+	AppendJournalField(Datagram, "SYSLOG_IDENTIFIER", ConfigConstants::appname);
+	MessageText.clear();
+	Record.AppendText(MessageText);
+	AppendJournalField(Datagram, "MESSAGE", MessageText);
+	Record.VisitArguments([&Datagram](const LogArgumentKind Kind, const std::string_view &Value)
+								 {
+									auto FieldName{GetJournalFieldName(Kind)};
+									if (!FieldName.empty())
+									{
+										AppendJournalField(Datagram, FieldName, Value);
+									} });
+	return QueuedDatagrams == MaxBatch ? Flush() : 0;
+}
+
+int JournalSocket::Flush()
+{
+	if (QueuedDatagrams == 0)
+	{
+		return 0;
+	}
+	int Result{Socket < 0 ? Connect() : 0};
+	iovec Vectors[MaxBatch];
+	mmsghdr Messages[MaxBatch];
+	size_t &Sent{SentDatagrams}; // a retry after a partial send starts where that one stopped
+	while (Result == 0 && Sent < QueuedDatagrams)
+	{
+		size_t Batch{QueuedDatagrams - Sent};
+		for (size_t Index{0}; Index < Batch; Index++)
+		{
+			Vectors[Index].iov_base = Datagrams[Sent + Index].data();
+			Vectors[Index].iov_len = Datagrams[Sent + Index].size();
+			Messages[Index] = mmsghdr{};
+			Messages[Index].msg_hdr.msg_iov = &Vectors[Index];
+			Messages[Index].msg_hdr.msg_iovlen = 1;
+		}
+		int SendResult{::sendmmsg(Socket, Messages, static_cast<unsigned int>(Batch), 0)};
+		if (SendResult < 0)
+		{
+			if (errno != EINTR)
+			{
+				Result = errno;
+			}
+		}
+		else
+		{
+			Sent += static_cast<size_t>(SendResult);
+		}
+	}
+	if (Result == 0)
+	{
+		QueuedDatagrams = 0;
+		SentDatagrams = 0;
+	}
+	else if (Socket >= 0)
+	{
+		::close(Socket); // reconnect next time, journald may have restarted
+		Socket = -1;
+	}
+	return Result;
+}
+
+void JournalSocket::TakeUnsent(const std::function<void(const LogLevels Severity, const std::string &Message)> &Handle)
+{
+	for (size_t Index{SentDatagrams}; Index < QueuedDatagrams; Index++)
+	{
+		Handle(Severities[Index], MessageTexts[Index]);
+	}
+	QueuedDatagrams = 0;
+	SentDatagrams = 0;
+}
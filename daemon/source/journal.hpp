@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "logring.hpp"
+
+/// @brief Sends log records to systemd-journald using its native datagram protocol, with structured fields kept as journal fields.
+/// Records are encoded as they arrive and sent in batches with sendmmsg.
+class JournalSocket
+{
+private:
+	static constexpr const size_t MaxBatch{64};
+
+	std::string SocketPath;
+	int Socket{-1};
+	std::vector<std::string> Datagrams;
+	std::vector<std::string> MessageTexts; // each datagram's MESSAGE, for whoever takes it if the journal cannot
+	LogLevels Severities[MaxBatch]{};
+	size_t QueuedDatagrams{0};
+	size_t SentDatagrams{0};
+	int Connect();
+
+public:
+	explicit JournalSocket(const std::string_view &SocketPath);
+	~JournalSocket();
+	JournalSocket(const JournalSocket &) = delete;
+	JournalSocket &operator=(const JournalSocket &) = delete;
+	JournalSocket(JournalSocket &&) = delete;
+	JournalSocket &operator=(JournalSocket &&) = delete;
+
+	const std::string &GetSocketPath() const { return SocketPath; }
+	/// @brief Encodes the record into the current batch, sending the batch if it is full
+	/// @return 0 or errno of a failed send, after which the record is among those TakeUnsent returns
+	int Append(const LogRecord &Record);
+	/// @brief Sends whatever is batched
+	/// @return 0 or errno. After a failure, the unsent records stay queued until TakeUnsent is called.
+	int Flush();
+	/// @brief Hands the text of every record a failed send left queued to Handle, oldest first, and empties the batch.
+	/// Must follow a failed Append or Flush, before the next Append.
+	void TakeUnsent(const std::function<void(const LogLevels Severity, const std::string &Message)> &Handle);
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <syslog.h>
+
+enum class LogLevels
+{
+	None,
+	Debug,
+	Info,
+	Warn,
+	Error,
+	Fatal
+};
+
+inline int GetSyslogPriority(const LogLevels Severity)
+{
+	switch (Severity)
+	{
+	case LogLevels::Debug:
+		return LOG_DEBUG;
+	case LogLevels::Warn:
+		return LOG_WARNING;
+	case LogLevels::Error:
+		return LOG_ERR;
+	case LogLevels::Fatal:
+		return LOG_CRIT;
+	default:
+		return LOG_INFO;
+	}
+}
+
+/// @brief Kinds of variable text that travel with a log record. The writer thread decides how each one is formatted.
+/// Item and Error are part of the message text; the rest are structured fields that only some outputs keep.
+enum class LogArgumentKind : uint8_t
+{
+	Item,
+	Error,
+	FilePath,
+	Host,
+	Service,
+	ErrorNumber,
+	CurlCode,
+	HttpStatus
+};
+
+/// @brief Fixed-size log entry. Variable text is copied in (truncated if it does not fit) so the caller's buffers can die right after the call.
+/// The message itself is not copied: it must be a string literal or a constexpr constant.
+struct LogRecord
+{
+	static constexpr const size_t ArgumentCapacity{464}; // keeps the whole record at 512 bytes
+	static constexpr const size_t ArgumentHeaderSize{3}; // kind and 16-bit length
+
+	LogLevels Severity{LogLevels::None};
+	std::time_t Timestamp{0};
+	std::string_view Message{};
+	uint16_t ArgumentsLength{0};
+	char Arguments[ArgumentCapacity];
+
+	void AddArgument(const LogArgumentKind Kind, const std::string_view &Text)
+	{
+		if (ArgumentsLength + ArgumentHeaderSize > ArgumentCapacity)
+		{
+			return;
+		}
+		uint16_t Length{static_cast<uint16_t>(std::min(Text.size(), ArgumentCapacity - ArgumentsLength - ArgumentHeaderSize))};
+		Arguments[ArgumentsLength] = static_cast<char>(Kind);
+		Arguments[ArgumentsLength + 1] = static_cast<char>(Length & 0xff);
+		Arguments[ArgumentsLength + 2] = static_cast<char>(Length >> 8);
+		Text.copy(Arguments + ArgumentsLength + ArgumentHeaderSize, Length);
+		ArgumentsLength += ArgumentHeaderSize + Length;
+	}
+
+	/// @brief Appends the human-readable text: "Message (Item): Error"
+	void AppendText(std::string &Text) const
+	{
+		Text.append(Message);
+		VisitArguments([&Text](const LogArgumentKind Kind, const std::string_view &Argument)
+							{
+								if (Kind == LogArgumentKind::Item)
+								{
+									Text.append(" (").append(Argument).append(1, ')');
+								}
+								else if (Kind == LogArgumentKind::Error)
+								{
+									Text.append(": ").append(Argument);
+								} });
+	}
+
+	/// @brief Calls Visitor(LogArgumentKind, std::string_view) for each argument in the order they were added
+	template <typename VisitorType>
+	void VisitArguments(VisitorType &&Visitor) const
+	{
+		for (size_t Position{0}; Position + ArgumentHeaderSize <= ArgumentsLength;)
+		{
+			auto Kind{static_cast<LogArgumentKind>(Arguments[Position])};
+			size_t Length{static_cast<unsigned char>(Arguments[Position + 1]) | (static_cast<size_t>(static_cast<unsigned char>(Arguments[Position + 2])) << 8)};
+			Visitor(Kind, std::string_view{Arguments + Position + ArgumentHeaderSize, Length});
+			Position += ArgumentHeaderSize + Length;
+		}
+	}
+};
+
+/// @brief Bounded lock-free queue for many producers and one consumer (Dmitry Vyukov's bounded queue with per-cell sequence numbers).
+/// Producers never block: a push into a full ring fails and the caller decides what to do with the entry.
+template <typename T, size_t Capacity>
+class MpscRing
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+	static constexpr const size_t CacheLineSize{64};
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Value;
+	};
+
+	std::unique_ptr<Cell[]> Cells;
+	alignas(CacheLineSize) std::atomic<size_t> EnqueuePosition{0};
+	alignas(CacheLineSize) size_t DequeuePosition{0}; // only touched by the consumer
+
+public:
+	MpscRing() : Cells{std::make_unique<Cell[]>(Capacity)}
+	{
+		for (size_t Index{0}; Index < Capacity; Index++)
+		{
+			Cells[Index].Sequence.store(Index, std::memory_order_relaxed);
+		}
+	}
+	MpscRing(const MpscRing &) = delete;
+	MpscRing &operator=(const MpscRing &) = delete;
+	MpscRing(MpscRing &&) = delete;
+	MpscRing &operator=(MpscRing &&) = delete;
+
+	/// @brief Claims a slot and lets Filler(T &) write the entry in place
+	/// @return False if the ring is full
+	template <typename FillerType>
+	bool TryPush(FillerType &&Filler)
+	{
+		size_t Position{EnqueuePosition.load(std::memory_order_relaxed)};
+		Cell *Target;
+		for (;;)
+		{
+			Target = &Cells[Position & (Capacity - 1)];
+			size_t Sequence{Target->Sequence.load(std::memory_order_acquire)};
+			intptr_t Difference{static_cast<intptr_t>(Sequence) - static_cast<intptr_t>(Position)};
+			if (Difference == 0)
+			{
+				if (EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (Difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Position = EnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+		Filler(Target->Value);
+		Target->Sequence.store(Position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// @brief Hands the oldest entry to Consumer(const T &), then frees its slot
+	/// @return False if the ring is empty
+	template <typename ConsumerType>
+	bool TryPop(ConsumerType &&Consumer)
+	{
+		Cell *Source{&Cells[DequeuePosition & (Capacity - 1)]};
+		size_t Sequence{Source->Sequence.load(std::memory_order_acquire)};
+		if (static_cast<intptr_t>(Sequence) - static_cast<intptr_t>(DequeuePosition + 1) < 0)
+		{
+			return false;
+		}
+		Consumer(static_cast<const T &>(Source->Value));
+		Source->Sequence.store(DequeuePosition + Capacity, std::memory_order_release);
+		DequeuePosition++;
+		return true;
+	}
+
+	/// @brief Only meaningful on the consumer thread
+	bool Empty() const
+	{
+		const Cell &Source{Cells[DequeuePosition & (Capacity - 1)]};
+		return Source.Sequence.load(std::memory_order_acquire) != DequeuePosition + 1;
+	}
+};
@@ -1,196 +1,428 @@
-#include <condition_variable>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <cstring>
+#include <ctime>
 #include <mutex>
 #include <queue>
-#include <ranges>
 #include <string_view>
 #include <syslog.h>
 #include <thread>
 #include <utility>
+#include "allocstats.hpp"
 #include "config_constants.hpp"
+#include "journal.hpp"
 #include "logwriter.hpp"
-#include "threadtimer.hpp"
+#include "metrics.hpp"
+#include "probes.hpp"
 
 constexpr const std::string_view FailedOpenFile{"Failed to open file"};
 constexpr const std::string_view FailedWriteFile{"Failed to write file"};
 constexpr const std::string_view FailedUploadLine{"Failed to upload line: "};
+constexpr const std::string_view DroppedLogEntries{"Log buffer full, entries dropped"};
+constexpr const std::string_view ResumedLogOutput{"Log output working again, no longer writing to the syslog"};
 
-std::mutex ActiveLogWriter::WriterMutex;
+constexpr const std::chrono::seconds MinimumSyslogBackoff{1};
+constexpr const std::chrono::seconds MaximumSyslogBackoff{60};
 
 // helper functions
-std::string FormatMessage(const std::string_view &Message, const LogLevels Severity)
+static void AppendSeverityTag(std::string &FormattedMessage, const LogLevels Severity)
 {
-	std::string FormattedMessage;
 	switch (Severity)
 	{
 	case LogLevels::Debug:
-		FormattedMessage = "[DEBUG]";
+		FormattedMessage.append("[DEBUG] ");
 		break;
 	case LogLevels::Info:
-		FormattedMessage = "[INFO]";
+		FormattedMessage.append("[INFO] ");
 		break;
 	case LogLevels::Warn:
-		FormattedMessage = "[WARN]";
+		FormattedMessage.append("[WARN] ");
 		break;
 	case LogLevels::Error:
-		FormattedMessage = "[ERROR]";
+		FormattedMessage.append("[ERROR] ");
 		break;
 	case LogLevels::Fatal:
-		FormattedMessage = "[FATAL]";
+		FormattedMessage.append("[FATAL] ");
 		break;
 	default:
-		FormattedMessage = "[INFO]";
+		FormattedMessage.append("[INFO] ");
 		break;
 	}
-	FormattedMessage.push_back(' ');
+}
+
+std::string FormatMessage(const std::string_view &Message, const LogLevels Severity)
+{
+	std::string FormattedMessage;
+	AppendSeverityTag(FormattedMessage, Severity);
 	FormattedMessage.append(Message);
 	return FormattedMessage;
 }
 
+static void FormatRecord(std::string &FormattedMessage, const LogRecord &Record)
+{
+	FormattedMessage.clear();
+	AppendSeverityTag(FormattedMessage, Record.Severity);
+	Record.AppendText(FormattedMessage);
+}
+
+static void AddNumericArgument(LogRecord &Record, const LogArgumentKind Kind, const long Value)
+{
+	if (Value != 0)
+	{
+		char Digits[24];
+		auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value)};
+		Record.AddArgument(Kind, std::string_view{Digits, static_cast<size_t>(End - Digits)});
+	}
+}
+
+static void AddFieldArguments(LogRecord &Record, const LogFields &Fields)
+{
+	if (!Fields.FilePath.empty())
+	{
+		Record.AddArgument(LogArgumentKind::FilePath, Fields.FilePath);
+	}
+	if (!Fields.Host.empty())
+	{
+		Record.AddArgument(LogArgumentKind::Host, Fields.Host);
+	}
+	if (!Fields.Service.empty())
+	{
+		Record.AddArgument(LogArgumentKind::Service, Fields.Service);
+	}
+	AddNumericArgument(Record, LogArgumentKind::ErrorNumber, Fields.ErrorNumber);
+	AddNumericArgument(Record, LogArgumentKind::CurlCode, Fields.CurlCode);
+	AddNumericArgument(Record, LogArgumentKind::HttpStatus, Fields.HttpStatus);
+}
+
 static void WriteToSysLog(const std::string &Message, const LogLevels Severity)
 {
-	int SysLogLevel{0};
-	switch (Severity)
+	syslog(GetSyslogPriority(Severity), "%s", Message.c_str());
+}
+
+static void WriteLinesToSysLog(const std::string_view &Lines, const std::string &Prefix, const LogLevels Severity)
+{
+	std::string Message{};
+	for (size_t Start{0}; Start < Lines.size();)
 	{
-	case LogLevels::Debug:
-		SysLogLevel = LOG_DEBUG;
-		break;
-	case LogLevels::Info:
-		SysLogLevel = LOG_INFO;
-		break;
-	case LogLevels::Warn:
-		SysLogLevel = LOG_WARNING;
-		break;
-	case LogLevels::Error:
-		SysLogLevel = LOG_ERR;
-		break;
-	case LogLevels::Fatal:
-		SysLogLevel = LOG_CRIT;
-		break;
-	default:
-		SysLogLevel = LOG_INFO;
-		break;
+		size_t End{std::min(Lines.find('\n', Start), Lines.size())};
+		Message.assign(Prefix).append(Lines.substr(Start, End - Start));
+		WriteToSysLog(Message, Severity);
+		Start = End + 1;
 	}
-	syslog(SysLogLevel, "%s", Message.c_str());
 }
 
 // private functions
-ActiveLogWriter::ActiveLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog)
-	 : MinimumSeverity(MinimumSeverity),
-		LogDirectory{LogDirectory},
-		FailedWritesFileName{FailedWritesFileName},
-		FallbackFailedWritesToSyslog{FallbackFailedWritesToSyslog},
-		LogFile{std::string{LogDirectory}, std::string{LogFileName}},
-		UploadErrorsFile{std::string{LogDirectory}, std::string{FailedWritesFileName}}
+void ActiveLogWriter::Enqueue(const LogLevels Severity, const std::string_view &Message, const std::string_view *Item, const std::string_view &ErrorMessage, const LogFields *Fields)
 {
+	bool Queued{LogRing.TryPush([&](LogRecord &Record)
+										 {
+											Record.Severity = Severity;
+											Record.Timestamp = std::time(nullptr);
+											Record.Message = Message;
+											Record.ArgumentsLength = 0;
+											if (Fields != nullptr)
+											{
+												AddFieldArguments(Record, *Fields); // short, so they go first and are not truncated away by a long item
+											}
+											if (Item != nullptr)
+											{
+												Record.AddArgument(LogArgumentKind::Item, *Item);
+											}
+											if (!ErrorMessage.empty())
+											{
+												Record.AddArgument(LogArgumentKind::Error, ErrorMessage);
+											} })};
+	if (!Queued)
+	{
+		DroppedEntries.fetch_add(1, std::memory_order_relaxed);
+		MetricsRegistry::Get().Increment(MetricCounters::LogEntriesDropped);
+		XLAT_PROBE1(log_drop, static_cast<int>(Severity));
+	}
+	WakeWriter();
 }
 
-ActiveLogWriter::~ActiveLogWriter()
+void ActiveLogWriter::WakeWriter()
 {
-	WriterThread.request_stop();
-	SignalWriter(false);
+	std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in Writer() so that a sleeping writer cannot miss the entry just queued
+	if (WriterSleeping.load(std::memory_order_relaxed))
+	{
+		WakeSignal.fetch_add(1, std::memory_order_release);
+		WakeSignal.notify_one();
+	}
 }
 
-void ActiveLogWriter::Writer()
+bool ActiveLogWriter::HasPendingWork()
 {
-	WriteTimer.ResetTimeout();
-	bool UseSyslog{false};
-	int LogFileErrorCode{0};
-	while (!WriterThread.get_stop_token().stop_requested() && !WriteTimer.TimedOut())
+	if (!LogRing.Empty())
 	{
-		std::unique_lock WriterLock(WriterMutex);
-		WriterCondition.wait_for(WriterLock, WriteTimer.GetTimeoutLength(), [this]
-										 {
-											std::scoped_lock CheckLock{QueueMutex};
-											return WriterThread.get_stop_token().stop_requested() ||
-											!LogQueue.empty() ||
-											!UploadErrors.empty() ||
-											WriteTimer.TimedOut(); });
-		if (!UploadErrors.empty())
+		return true;
+	}
+	std::scoped_lock QueueLock{UploadErrorsMutex};
+	return !UploadErrors.empty();
+}
+
+bool ActiveLogWriter::UsingSyslog()
+{
+	return SyslogBackoff.count() > 0 && std::chrono::steady_clock::now() < SyslogUntil;
+}
+
+void ActiveLogWriter::FallBackToSyslog(const int LogFileErrorCode)
+{
+	std::string FailureMessage{FormatMessage(FailedWriteFile, LogLevels::Error)};
+	FailureMessage.append(" (").append(Journal ? Journal->GetSocketPath() : LogFile.GetFilePath()).append("): ").append(std::strerror(LogFileErrorCode));
+	WriteToSysLog(FailureMessage, LogLevels::Error);
+	SyslogBackoff = std::clamp(SyslogBackoff * 2, MinimumSyslogBackoff, MaximumSyslogBackoff);
+	SyslogUntil = std::chrono::steady_clock::now() + SyslogBackoff;
+	if (Journal)
+	{
+		Journal->TakeUnsent([](const LogLevels Severity, const std::string &Message)
+								  { WriteToSysLog(FormatMessage(Message, Severity), Severity); });
+	}
+}
+
+void ActiveLogWriter::LogOutputRecovered()
+{
+	std::string RecoveryMessage{FormatMessage(ResumedLogOutput, LogLevels::Info)};
+	RecoveryMessage.append(" (").append(Journal ? Journal->GetSocketPath() : LogFile.GetFilePath()).append(")");
+	WriteToSysLog(RecoveryMessage, LogLevels::Info);
+	SyslogBackoff = std::chrono::seconds{0};
+}
+
+void ActiveLogWriter::WriteFormatted(const std::string &FormattedMessage, const LogLevels Severity, const std::time_t Timestamp)
+{
+	if (!UsingSyslog())
+	{
+		int LogFileErrorCode{LogFile.WriteStamped(FormattedMessage, Timestamp)};
+		if (LogFileErrorCode == 0)
 		{
-			std::queue<std::string> LocalQueue{};
-			{
-				std::scoped_lock QueueLock{QueueMutex};
-				LocalQueue.swap(UploadErrors);
-			}
-			while (!LocalQueue.empty())
-			{
-				LogFileErrorCode = UploadErrorsFile.Write(LocalQueue.front());
-				if (LogFileErrorCode && FallbackFailedWritesToSyslog)
-				{
-					std::string UploadReportString{FormatMessage(FailedUploadLine, LogLevels::Error)};
-					UploadReportString.append(std::move(LocalQueue.front()));
-					WriteToSysLog(UploadReportString, LogLevels::Error);
-				}
-				LocalQueue.pop();
-			}
+			return;
+		}
+		FallBackToSyslog(LogFileErrorCode); // the file write error goes first, then the original entry follows it into the syslog
+	}
+	WriteToSysLog(FormattedMessage, Severity);
+}
+
+void ActiveLogWriter::WriteRecord(const LogRecord &Record, std::string &FormattedMessage)
+{
+	if (!Journal)
+	{
+		FormatRecord(FormattedMessage, Record);
+		WriteFormatted(FormattedMessage, Record.Severity, Record.Timestamp);
+		return;
+	}
+	if (UsingSyslog())
+	{
+		FormatRecord(FormattedMessage, Record);
+		WriteToSysLog(FormattedMessage, Record.Severity);
+		return;
+	}
+	int JournalErrorCode{Journal->Append(Record)};
+	if (JournalErrorCode)
+	{
+		FallBackToSyslog(JournalErrorCode); // this record was queued, so it follows the error into the syslog with the rest of the batch
+	}
+}
+
+int ActiveLogWriter::FlushLog(const bool Final)
+{
+	if (Journal)
+	{
+		return Journal->Flush();
+	}
+	std::string DroppedLines{};
+	int LogFileErrorCode{LogFile.Flush(DroppedLines, Final)};
+	WriteLinesToSysLog(DroppedLines, "", LogLevels::Warn); // already stamped and formatted
+	return LogFileErrorCode;
+}
+
+void ActiveLogWriter::FlushUploadErrors(const bool Final)
+{
+	if (!UploadErrorsFile)
+	{
+		return;
+	}
+	std::string DroppedLines{};
+	UploadErrorsFile->Flush(DroppedLines, Final);
+	if (!DroppedLines.empty() && FallbackFailedWritesToSyslog)
+	{
+		WriteLinesToSysLog(DroppedLines, FormatMessage(FailedUploadLine, LogLevels::Error), LogLevels::Error);
+	}
+}
+
+bool ActiveLogWriter::DrainUploadErrors()
+{
+	std::queue<std::string> LocalQueue{};
+	{
+		std::scoped_lock QueueLock{UploadErrorsMutex};
+		LocalQueue.swap(UploadErrors);
+	}
+	bool DidWork{!LocalQueue.empty()};
+	MetricsRegistry::Get().Increment(MetricCounters::UploadErrorsSaved, LocalQueue.size());
+	while (!LocalQueue.empty() && UploadErrorsFile) // with save_failed_writes off they are dropped, as the setting asks
+	{
+		int LogFileErrorCode{UploadErrorsFile->Write(LocalQueue.front())};
+		if (LogFileErrorCode && FallbackFailedWritesToSyslog)
+		{
+			std::string UploadReportString{FormatMessage(FailedUploadLine, LogLevels::Error)};
+			UploadReportString.append(std::move(LocalQueue.front()));
+			WriteToSysLog(UploadReportString, LogLevels::Error);
 		}
+		LocalQueue.pop();
+	}
+	return DidWork;
+}
 
-		if (!LogQueue.empty())
+bool ActiveLogWriter::DrainLogRing(std::string &FormattedMessage)
+{
+	bool DidWork{false};
+	size_t Written{0};
+	while (LogRing.TryPop([&](const LogRecord &Record)
+								 { WriteRecord(Record, FormattedMessage); }))
+	{
+		Written++;
+	}
+	if (Written)
+	{
+		MetricsRegistry::Get().Increment(MetricCounters::LogEntriesWritten, Written);
+		DidWork = true;
+	}
+
+	size_t Dropped{DroppedEntries.exchange(0, std::memory_order_relaxed)};
+	if (Dropped)
+	{
+		LogRecord DropReport{};
+		DropReport.Severity = LogLevels::Warn;
+		DropReport.Timestamp = std::time(nullptr);
+		DropReport.Message = DroppedLogEntries;
+		AddNumericArgument(DropReport, LogArgumentKind::Item, static_cast<long>(Dropped));
+		WriteRecord(DropReport, FormattedMessage);
+	}
+	return DidWork;
+}
+
+void ActiveLogWriter::Writer(std::stop_token StopToken)
+{
+	AllocationScope LogScope{AllocationStage::Log};
+	std::string FormattedMessage{};
+	FormattedMessage.reserve(LogRecord::ArgumentCapacity * 2);
+	for (;;)
+	{
+		bool DidWork{DrainUploadErrors()};
+		DidWork |= DrainLogRing(FormattedMessage);
+		if (DidWork)
 		{
-			std::queue<std::pair<LogLevels, std::string>> LocalQueue{};
+			continue;
+		}
+		if (StopToken.stop_requested())
+		{
+			break;
+		}
+		// caught up: push out what is buffered so entries show up promptly when the daemon is quiet
+		if (!UsingSyslog())
+		{
+			int LogFileErrorCode{FlushLog()};
+			if (LogFileErrorCode)
 			{
-				std::scoped_lock QueueLock{QueueMutex};
-				LocalQueue.swap(LogQueue);
+				FallBackToSyslog(LogFileErrorCode);
 			}
-			while (!LocalQueue.empty())
+			else if (SyslogBackoff.count() > 0)
 			{
-				auto [Severity, Message]{std::move(LocalQueue.front())};
-				std::string FormattedMessage{FormatMessage(Message, Severity)};
-				if (UseSyslog)
-				{
-					WriteToSysLog(FormattedMessage, Severity);
-				}
-				else
-				{
-					LogFileErrorCode = LogFile.Write(FormattedMessage, true);
-					if (LogFileErrorCode)
-					{
-						WriteErrorAnnotated(FailedWriteFile, LogFile.GetFilePath(), std::strerror(LogFileErrorCode));
-						UseSyslog = true;
-						continue; // skip the pop() so that the file write error happens first, then the original error goes into the syslog
-					}
-				}
-				LocalQueue.pop();
+				LogOutputRecovered();
 			}
-			WriteTimer.ResetTimeout();
 		}
+		FlushUploadErrors();
+
+		uint32_t Signal{WakeSignal.load(std::memory_order_acquire)};
+		WriterSleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!HasPendingWork() && !StopToken.stop_requested())
+		{
+			WakeSignal.wait(Signal, std::memory_order_acquire);
+		}
+		WriterSleeping.store(false, std::memory_order_relaxed);
 	}
-	WriterExited = true;
+	if (Journal && !UsingSyslog())
+	{
+		int JournalErrorCode{FlushLog()};
+		if (JournalErrorCode)
+		{
+			FallBackToSyslog(JournalErrorCode); // nothing retries after this, so the unsent batch goes to the syslog
+		}
+	}
+	else if (!Journal)
+	{
+		FlushLog(true); // likewise, whatever the file still refuses goes to the syslog
+	}
+	FlushUploadErrors(true);
 }
 
-void ActiveLogWriter::SignalWriter(const bool StartWriter)
+// public functions
+ActiveLogWriter::ActiveLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog, const FailedWritesSettings &FailedWritesStorage, const LogOutputs Output, const std::string_view &JournalSocketPath)
+	 : MinimumSeverity(MinimumSeverity),
+		LogDirectory{LogDirectory},
+		FailedWritesFileName{FailedWritesFileName},
+		FallbackFailedWritesToSyslog{FallbackFailedWritesToSyslog},
+		LogFile{std::string{LogDirectory}, std::string{LogFileName}, OutputFileMode::Buffered}
 {
-	if (WriterExited && StartWriter)
+	if (!FailedWritesFileName.empty())
+	{
+		UploadErrorsFile = std::make_unique<FailedWritesStore>(LogDirectory, FailedWritesFileName, FailedWritesStorage);
+	}
+	if (Output == LogOutputs::Journal)
 	{
-		WriterExited = false;
-		WriterThread = std::jthread(&ActiveLogWriter::Writer, this);
+		Journal = std::make_unique<JournalSocket>(JournalSocketPath);
 	}
-	WriterCondition.notify_one();
+	WriterThread = std::jthread([this](std::stop_token StopToken)
+										 { Writer(StopToken); });
+}
+
+ActiveLogWriter::~ActiveLogWriter()
+{
+	WriterThread.request_stop();
+	WakeSignal.fetch_add(1, std::memory_order_release);
+	WakeSignal.notify_one();
+	WriterThread.join(); // drains whatever is still queued before the files go away
 }
 
 void ActiveLogWriter::WriteEntry(const LogLevels Severity, const std::string_view &Message)
 {
 	if (ShouldWrite(Severity))
 	{
-		std::scoped_lock QueueLock(QueueMutex);
-		LogQueue.push(std::make_pair(Severity, std::move(std::string{Message})));
-		SignalWriter(true);
+		Enqueue(Severity, Message, nullptr, "", nullptr);
+	}
+}
+
+void ActiveLogWriter::WriteAnnotatedEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage)
+{
+	if (ShouldWrite(Severity))
+	{
+		Enqueue(Severity, ProcessMessage, &Item, ErrorMessage, nullptr);
+	}
+}
+
+void ActiveLogWriter::WriteStructuredEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage, const LogFields &Fields)
+{
+	if (ShouldWrite(Severity))
+	{
+		Enqueue(Severity, ProcessMessage, &Item, ErrorMessage, Journal ? &Fields : nullptr); // the file format has no place for fields
 	}
 }
 
 void ActiveLogWriter::WriteUploadError(const std::string &BadStrings)
 {
-	std::scoped_lock QueueLock(QueueMutex);
-	UploadErrors.push(BadStrings);
-	SignalWriter(true);
+	{
+		std::scoped_lock QueueLock(UploadErrorsMutex);
+		UploadErrors.push(BadStrings);
+	}
+	WakeWriter();
 }
 
-std::unique_ptr<ILogWriter> LogWriterFactory::CreateLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog)
+std::unique_ptr<ILogWriter> LogWriterFactory::CreateLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog, const FailedWritesSettings &FailedWritesStorage, const LogOutputs Output, const std::string_view &JournalSocketPath)
 {
 	if (MinimumSeverity != LogLevels::None) // should have caught a "none" setting in the config load, but enforce here because the config loader checks as a convenience. it's not its job and a future updater might remove that check for separation of concerns
 	{
-		return std::make_unique<ActiveLogWriter>(MinimumSeverity, LogDirectory, LogFileName, FailedWritesFileName, FallbackFailedWritesToSyslog);
+		return std::make_unique<ActiveLogWriter>(MinimumSeverity, LogDirectory, LogFileName, FailedWritesFileName, FallbackFailedWritesToSyslog, FailedWritesStorage, Output, JournalSocketPath);
 	}
 	return std::make_unique<PassiveLogWriter>();
 }
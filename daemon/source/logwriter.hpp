@@ -1,27 +1,111 @@
 #pragma once
 
-#include <condition_variable>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <string_view>
 #include <thread>
+#include <type_traits>
 #include <vector>
+#include "failedwrites.hpp"
+#include "logring.hpp"
 #include "outputfile.hpp"
-#include "threadtimer.hpp"
 
-enum class LogLevels
+#ifndef XLAT_LOG_MIN_LEVEL
+#define XLAT_LOG_MIN_LEVEL 1 // matches LogLevels::Debug, so nothing is compiled out
+#endif
+
+/// @brief Lowest severity that is compiled into the binary. Calls below it are removed entirely, arguments included when the lazy overloads are used.
+constexpr const LogLevels CompiledMinimumSeverity{static_cast<LogLevels>(XLAT_LOG_MIN_LEVEL)};
+
+constexpr bool IsCompiledIn(const LogLevels Severity) { return Severity >= CompiledMinimumSeverity; }
+
+/// @brief Holds the text form of a deferred log argument. Accepts anything convertible to std::string_view, integers (formatted without allocating), or a callable returning either.
+class LogArgument
+{
+private:
+	char Digits[24];
+	std::string Owned{};
+	std::string_view Text{};
+
+	template <typename T>
+	void Resolve(T &&Value)
+	{
+		using ValueType = std::remove_cvref_t<T>;
+		if constexpr (std::is_convertible_v<const ValueType &, std::string_view>)
+		{
+			Text = std::string_view{Value};
+		}
+		else if constexpr (std::is_integral_v<ValueType>)
+		{
+			auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value)};
+			Text = std::string_view{Digits, static_cast<size_t>(End - Digits)};
+		}
+		else if constexpr (std::is_invocable_v<ValueType &>)
+		{
+			using ResultType = std::remove_cvref_t<std::invoke_result_t<ValueType &>>;
+			if constexpr (std::is_same_v<ResultType, std::string>)
+			{
+				Owned = Value();
+				Text = Owned;
+			}
+			else
+			{
+				Resolve(Value()); // anything else must be a view or an integer, not a temporary string
+			}
+		}
+		else
+		{
+			static_assert(std::is_invocable_v<ValueType &>, "Log arguments must be text, an integer, or a callable returning one of those");
+		}
+	}
+
+public:
+	template <typename T>
+	explicit LogArgument(T &&Value) { Resolve(std::forward<T>(Value)); }
+	LogArgument(const LogArgument &) = delete;
+	LogArgument &operator=(const LogArgument &) = delete;
+	LogArgument(LogArgument &&) = delete;
+	LogArgument &operator=(LogArgument &&) = delete;
+	const std::string_view &View() const { return Text; }
+};
+
+/// @brief Builds a deferred argument that joins its parts with ", " when the entry is written, e.g. LogJoin(Sent, Failed)
+template <typename... T>
+auto LogJoin(const T &...Parts)
+{
+	return [Parts...]
+	{
+		std::string Joined{};
+		((Joined.append(Joined.empty() ? "" : ", ").append(LogArgument{Parts}.View())), ...);
+		return Joined;
+	};
+}
+
+/// @brief Machine-readable context for an entry. Empty strings and zero codes are left out. Outputs that only write text ignore these.
+struct LogFields
 {
-	None,
-	Debug,
-	Info,
-	Warn,
-	Error,
-	Fatal
+	std::string_view FilePath{};
+	std::string_view Host{};
+	std::string_view Service{};
+	int ErrorNumber{0};
+	int CurlCode{0};
+	long HttpStatus{0};
+};
+
+class JournalSocket;
+
+enum class LogOutputs
+{
+	File,
+	Journal
 };
 
-// TODO: Could improve by creating overloads that accept a callback for strings that need to be built/calculated. This would allow the log writer to only call the callback if the log level is enabled and alleviate the need for callers to check in advance. Shelved to avoid pre-emptive optimization, especially since the code already gives lots of hints for predictive CPUs to catch on.
-// TODO: Could improve with variadics that push string assembly into the writer's thread where it won't impact the caller's performance. Again, probably would burn more dev time than compute time saved.
 class ILogWriter
 {
 public:
@@ -32,15 +116,16 @@ public:
 	ILogWriter(ILogWriter &&) = default;
 	ILogWriter &operator=(ILogWriter &&) = default;
 	virtual bool ShouldWrite(const LogLevels Severity) const = 0;
+	/// @brief Queues a log entry. Message (and ProcessMessage in the annotated variants) must be a string literal or constexpr constant: writers may format it after the call returns. Variable text belongs in Item and ErrorMessage.
 	virtual void WriteEntry(const LogLevels, const std::string_view &Message) = 0;
-	void WriteDebug(const std::string_view &Message) { WriteEntry(LogLevels::Debug, Message); }
-	void WriteInfo(const std::string_view &Message) { WriteEntry(LogLevels::Info, Message); }
-	void WriteWarn(const std::string_view &Message) { WriteEntry(LogLevels::Warn, Message); }
-	void WriteError(const std::string_view &Message) { WriteEntry(LogLevels::Error, Message); }
-	void WriteFatal(const std::string_view &Message) { WriteEntry(LogLevels::Fatal, Message); }
+	void WriteDebug(const std::string_view &Message) { WriteCompiledEntry<LogLevels::Debug>(Message); }
+	void WriteInfo(const std::string_view &Message) { WriteCompiledEntry<LogLevels::Info>(Message); }
+	void WriteWarn(const std::string_view &Message) { WriteCompiledEntry<LogLevels::Warn>(Message); }
+	void WriteError(const std::string_view &Message) { WriteCompiledEntry<LogLevels::Error>(Message); }
+	void WriteFatal(const std::string_view &Message) { WriteCompiledEntry<LogLevels::Fatal>(Message); }
 	virtual void WriteUploadError(const std::string &BadStrings) = 0;
 
-	void WriteAnnotatedEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
+	virtual void WriteAnnotatedEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
 		if (ShouldWrite(Severity))
 		{
@@ -56,70 +141,147 @@ public:
 
 	void WriteDebugAnnoted(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
-		WriteAnnotatedEntry(LogLevels::Debug, ProcessMessage, Item, ErrorMessage);
+		WriteCompiledAnnotatedEntry<LogLevels::Debug>(ProcessMessage, Item, ErrorMessage);
 	}
 
 	void WriteInfoAnnotated(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
-		WriteAnnotatedEntry(LogLevels::Info, ProcessMessage, Item, ErrorMessage);
+		WriteCompiledAnnotatedEntry<LogLevels::Info>(ProcessMessage, Item, ErrorMessage);
 	}
 
 	void WriteWarnAnnotated(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
-		WriteAnnotatedEntry(LogLevels::Warn, ProcessMessage, Item, ErrorMessage);
+		WriteCompiledAnnotatedEntry<LogLevels::Warn>(ProcessMessage, Item, ErrorMessage);
 	}
 
 	void WriteErrorAnnotated(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
-		WriteAnnotatedEntry(LogLevels::Error, ProcessMessage, Item, ErrorMessage);
+		WriteCompiledAnnotatedEntry<LogLevels::Error>(ProcessMessage, Item, ErrorMessage);
 	}
 
 	void WriteFatalAnnotated(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "")
 	{
-		WriteAnnotatedEntry(LogLevels::Fatal, ProcessMessage, Item, ErrorMessage);
+		WriteCompiledAnnotatedEntry<LogLevels::Fatal>(ProcessMessage, Item, ErrorMessage);
+	}
+
+	/// @brief Annotated entry whose item and error text are only built once the severity is known to be written. See LogArgument for what can be passed.
+	/// @param ProcessMessage Constant describing the activity
+	/// @param Item Deferred item text
+	/// @param ErrorMessage Deferred error text, omitted when empty
+	template <LogLevels Severity, typename ItemType, typename ErrorType = std::string_view>
+	void WriteLazy(const std::string_view &ProcessMessage, ItemType &&Item, ErrorType &&ErrorMessage = std::string_view{})
+	{
+		if constexpr (IsCompiledIn(Severity))
+		{
+			if (ShouldWrite(Severity))
+			{
+				LogArgument ItemText{std::forward<ItemType>(Item)};
+				LogArgument ErrorText{std::forward<ErrorType>(ErrorMessage)};
+				WriteAnnotatedEntry(Severity, ProcessMessage, ItemText.View(), ErrorText.View());
+			}
+		}
+	}
+
+	/// @brief Like WriteAnnotatedEntry, plus structured fields for outputs that keep them
+	virtual void WriteStructuredEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage, const LogFields &)
+	{
+		WriteAnnotatedEntry(Severity, ProcessMessage, Item, ErrorMessage);
+	}
+
+	/// @brief Lazy annotated entry that also carries structured fields
+	template <LogLevels Severity, typename ItemType, typename ErrorType = std::string_view>
+	void WriteStructured(const LogFields &Fields, const std::string_view &ProcessMessage, ItemType &&Item, ErrorType &&ErrorMessage = std::string_view{})
+	{
+		if constexpr (IsCompiledIn(Severity))
+		{
+			if (ShouldWrite(Severity))
+			{
+				LogArgument ItemText{std::forward<ItemType>(Item)};
+				LogArgument ErrorText{std::forward<ErrorType>(ErrorMessage)};
+				WriteStructuredEntry(Severity, ProcessMessage, ItemText.View(), ErrorText.View(), Fields);
+			}
+		}
+	}
+
+	template <typename... T>
+	void WriteDebugLazy(const std::string_view &ProcessMessage, T &&...Arguments) { WriteLazy<LogLevels::Debug>(ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteInfoLazy(const std::string_view &ProcessMessage, T &&...Arguments) { WriteLazy<LogLevels::Info>(ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteWarnLazy(const std::string_view &ProcessMessage, T &&...Arguments) { WriteLazy<LogLevels::Warn>(ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteErrorLazy(const std::string_view &ProcessMessage, T &&...Arguments) { WriteLazy<LogLevels::Error>(ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteDebugStructured(const LogFields &Fields, const std::string_view &ProcessMessage, T &&...Arguments) { WriteStructured<LogLevels::Debug>(Fields, ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteWarnStructured(const LogFields &Fields, const std::string_view &ProcessMessage, T &&...Arguments) { WriteStructured<LogLevels::Warn>(Fields, ProcessMessage, std::forward<T>(Arguments)...); }
+	template <typename... T>
+	void WriteErrorStructured(const LogFields &Fields, const std::string_view &ProcessMessage, T &&...Arguments) { WriteStructured<LogLevels::Error>(Fields, ProcessMessage, std::forward<T>(Arguments)...); }
+
+private:
+	template <LogLevels Severity>
+	void WriteCompiledEntry(const std::string_view &Message)
+	{
+		if constexpr (IsCompiledIn(Severity))
+		{
+			WriteEntry(Severity, Message);
+		}
+	}
+
+	template <LogLevels Severity>
+	void WriteCompiledAnnotatedEntry(const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage)
+	{
+		if constexpr (IsCompiledIn(Severity))
+		{
+			WriteAnnotatedEntry(Severity, ProcessMessage, Item, ErrorMessage);
+		}
 	}
 };
 
 class ActiveLogWriter : public ILogWriter
 {
 private:
-	std::condition_variable WriterCondition;
-	std::mutex QueueMutex;
-	std::queue<std::pair<LogLevels, std::string>> LogQueue{};
+	static constexpr const size_t LogRingCapacity{4096};
+	MpscRing<LogRecord, LogRingCapacity> LogRing{};
+	std::atomic<size_t> DroppedEntries{0};
+	std::mutex UploadErrorsMutex;
 	std::queue<std::string> UploadErrors{};
-	void SignalWriter(const bool StartWriter);
+	std::atomic<uint32_t> WakeSignal{0};
+	std::atomic<bool> WriterSleeping{false};
+	void Enqueue(const LogLevels Severity, const std::string_view &Message, const std::string_view *Item, const std::string_view &ErrorMessage, const LogFields *Fields);
+	void WakeWriter();
+	bool HasPendingWork();
 
 	LogLevels MinimumSeverity;
 	std::string LogDirectory;
 	std::string FailedWritesFileName;
 	bool FallbackFailedWritesToSyslog{true};
 	OutputFile LogFile;
-	OutputFile UploadErrorsFile;
-	static std::mutex WriterMutex; // this app only creates one log class but future-proof
-	ThreadTimer WriteTimer{};
-	void Writer();
-	std::jthread WriterThread{};
-	std::atomic<bool> WriterExited{true};
+	std::unique_ptr<FailedWritesStore> UploadErrorsFile; // not created when failed writes are not saved
+	std::unique_ptr<JournalSocket> Journal; // replaces LogFile when set
+	// the syslog stands in for the log output after it fails, which is tried again after a backoff; only touched by the writer thread
+	std::chrono::steady_clock::time_point SyslogUntil{};
+	std::chrono::seconds SyslogBackoff{0};
+	bool UsingSyslog();
+	void FallBackToSyslog(const int LogFileErrorCode);
+	void LogOutputRecovered();
+	void WriteFormatted(const std::string &FormattedMessage, const LogLevels Severity, const std::time_t Timestamp);
+	void WriteRecord(const LogRecord &Record, std::string &FormattedMessage);
+	int FlushLog(const bool Final = false);
+	void FlushUploadErrors(const bool Final = false);
+	bool DrainUploadErrors();
+	bool DrainLogRing(std::string &FormattedMessage);
+	void Writer(std::stop_token StopToken);
+	std::jthread WriterThread{}; // keep last so that everything it touches is constructed first and destroyed after it joins
 
 public:
-	ActiveLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog);
+	ActiveLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog, const FailedWritesSettings &FailedWritesStorage, const LogOutputs Output = LogOutputs::File, const std::string_view &JournalSocketPath = "");
 	virtual ~ActiveLogWriter();
 	virtual bool ShouldWrite(const LogLevels Severity) const override { return Severity >= MinimumSeverity; }
 	virtual void WriteEntry(const LogLevels, const std::string_view &Message) override;
+	virtual void WriteAnnotatedEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage = "") override;
+	virtual void WriteStructuredEntry(const LogLevels Severity, const std::string_view &ProcessMessage, const std::string_view &Item, const std::string_view &ErrorMessage, const LogFields &Fields) override;
 	virtual void WriteUploadError(const std::string &BadStrings) override;
-
-	/// @brief Performs simple concatenation of the provided messages and then writes the log entry.
-	/// @tparam ...T Must be nothrow convertible to std::string_view.
-	/// @param LogLevel Severity of message.
-	/// @param ...Messages Message components to concatenate.
-	template <typename... T>
-		requires std::conjunction_v<std::is_nothrow_convertible<T, std::string_view>...>
-	void WriteLogEntry(const LogLevels LogLevel, const T &...Messages)
-	{
-		std::string ConcatenatedMessage{};
-		((ConcatenatedMessage.append(Messages)), ...);
-		WriteLogEntry(LogLevel, ConcatenatedMessage);
-	}
 };
 
 class PassiveLogWriter : public ILogWriter
@@ -139,5 +301,5 @@ private:
 
 public:
 	static std::unique_ptr<ILogWriter> CreateEmptyLogWriter() { return std::make_unique<PassiveLogWriter>(); }
-	static std::unique_ptr<ILogWriter> CreateLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog);
+	static std::unique_ptr<ILogWriter> CreateLogWriter(const LogLevels MinimumSeverity, const std::string_view &LogDirectory, const std::string_view &LogFileName, const std::string_view &FailedWritesFileName, const bool FallbackFailedWritesToSyslog, const FailedWritesSettings &FailedWritesStorage, const LogOutputs Output = LogOutputs::File, const std::string_view &JournalSocketPath = "");
 };
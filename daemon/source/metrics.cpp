@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "allocstats.hpp"
+#include "metrics.hpp"
+
+static const std::array<MetricDescription, static_cast<size_t>(MetricCounters::Count)> CounterDescriptions{{
+	 {"files_read", "Spool files read", "c", 0},
+	 {"bytes_read", "Bytes read from spool files", "c", 0},
+	 {"lines_read", "Non-empty lines extracted from spool files", "c", 0},
+	 {"records_parsed", "Perfdata lines parsed into records", "c", 0},
+	 {"parse_failures", "Perfdata lines rejected by the parser", "c", 0},
+	 {"points_translated", "Points produced by the Influx translator", "c", 0},
+	 {"thresholds_suppressed", "Unchanged warn/crit/min/max fields left out by the Influx translator", "c", 0},
+	 {"http_requests", "HTTP requests sent", "c", 0},
+	 {"http_failures", "HTTP requests that failed in curl or returned a non-2xx status", "c", 0},
+	 {"http_bytes_sent", "HTTP request body bytes sent", "c", 0},
+	 {"udp_datagrams_sent", "Influx UDP datagrams handed to the kernel", "c", 0},
+	 {"udp_bytes_sent", "Influx UDP payload bytes handed to the kernel", "c", 0},
+	 {"udp_send_errors", "Influx UDP datagrams dropped because sending them failed", "c", 0},
+	 {"udp_oversized_lines", "Lines dropped from the Influx UDP output because they do not fit in a datagram", "c", 0},
+	 {"sink_points_delivered", "Points acknowledged by sinks", "c", 0},
+	 {"sink_flush_failures", "Sink flushes that failed", "c", 0},
+	 {"log_entries_written", "Daemon log entries written", "c", 0},
+	 {"log_entries_dropped", "Daemon log entries dropped because the log buffer was full", "c", 0},
+	 {"upload_errors_saved", "Records saved to the failed writes store", "c", 0},
+	 {"output_lines_dropped", "Lines the daemon log or failed writes file gave up writing and sent to the syslog instead", "c", 0},
+	 {"spool_lag_exceeded", "Spool files read later than the lag threshold after their last modification", "c", 0},
+	 {"delivery_lag_exceeded", "Records accepted by a sink later than the lag threshold after their Nagios timestamp", "c", 0},
+	 {"capture_files_archived", "Spool files copied, anonymised, into the capture archive", "c", 0},
+	 {"capture_files_evicted", "Oldest capture archive files deleted to stay within its size limit", "c", 0},
+	 {"catchup_cycles", "Collection cycles that found more spool files than catchup_threshold and read them concurrently", "c", 0},
+	 {"spool_entries_listed", "Spool directory entries listed, counted once per collection cycle", "c", 0},
+	 {"spool_entries_statted", "Spool files whose metadata was read, once per file unless it is replaced under the same name", "c", 0},
+	 {"spool_claims_lost", "Spool files another daemon sharing the spool claimed first", "c", 0},
+	 {"spool_claims_released", "Spool files returned from the claims of a daemon whose lease expired", "c", 0},
+}};
+
+static const std::array<MetricDescription, static_cast<size_t>(MetricHistograms::Count)> HistogramDescriptions{{
+	 {"file_read", "Time to open and read one spool file", "us", 1000},
+	 {"translate", "Time to translate one record to line protocol", "ns", 1},
+	 {"http_request", "Time for one HTTP request, including connection setup", "us", 1000},
+	 {"sink_flush", "Time for one sink flush", "us", 1000},
+	 {"spool_lag", "Time from a spool file's last modification to the daemon reading it", "ms", 1000000},
+	 {"delivery_lag", "Time from a record's Nagios timestamp to a sink's destination accepting it", "ms", 1000000},
+}};
+
+// helper functions
+static void AppendNumber(std::string &Target, const uint64_t Value)
+{
+	char Digits[24];
+	auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value)};
+	Target.append(Digits, End);
+}
+
+static void AppendPerfItem(std::string &Target, const std::string_view &Label, const std::string_view &Suffix, const uint64_t Value, const std::string_view &Unit)
+{
+	if (Target.back() != '\t')
+	{
+		Target.push_back(' ');
+	}
+	Target.append(Label).append(Suffix).append(1, '=');
+	AppendNumber(Target, Value);
+	Target.append(Unit);
+}
+
+static void AppendPerfItem(std::string &Target, const std::string_view &Label, const std::string_view &Suffix, const double Value, const std::string_view &Unit)
+{
+	Target.push_back(' ');
+	Target.append(Label).append(Suffix).append(1, '=');
+	char Digits[32];
+	auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value, std::chars_format::fixed, 3)};
+	Target.append(Digits, End).append(Unit);
+}
+
+// MetricHistogram
+size_t MetricHistogram::GetBucketIndex(const uint64_t Value)
+{
+	if (Value < SubBucketCount)
+	{
+		return static_cast<size_t>(Value);
+	}
+	size_t Shift{static_cast<size_t>(std::bit_width(Value)) - 1 - SubBucketBits};
+	return (Shift + 1) * SubBucketCount + static_cast<size_t>((Value >> Shift) - SubBucketCount);
+}
+
+uint64_t MetricHistogram::GetBucketUpperBound(const size_t Index)
+{
+	if (Index < SubBucketCount)
+	{
+		return Index;
+	}
+	size_t Shift{Index / SubBucketCount - 1};
+	uint64_t SubBucket{Index % SubBucketCount + SubBucketCount};
+	return ((SubBucket + 1) << Shift) - 1;
+}
+
+void MetricHistogram::Record(const uint64_t Value)
+{
+	Buckets[GetBucketIndex(Value)].fetch_add(1, std::memory_order_relaxed);
+	Count.fetch_add(1, std::memory_order_relaxed);
+	Sum.fetch_add(Value, std::memory_order_relaxed);
+	uint64_t CurrentMax{Max.load(std::memory_order_relaxed)};
+	while (Value > CurrentMax && !Max.compare_exchange_weak(CurrentMax, Value, std::memory_order_relaxed))
+	{
+	}
+}
+
+MetricHistogram::Snapshot MetricHistogram::GetSnapshot() const
+{
+	Snapshot Result{};
+	for (size_t Index{0}; Index < BucketCount; Index++)
+	{
+		Result.Buckets[Index] = Buckets[Index].load(std::memory_order_relaxed);
+		Result.Count += Result.Buckets[Index]; // from the buckets, so quantiles stay consistent while writers are active
+	}
+	Result.Sum = Sum.load(std::memory_order_relaxed);
+	Result.Max = Max.load(std::memory_order_relaxed);
+	return Result;
+}
+
+uint64_t MetricHistogram::Snapshot::GetQuantile(const double Quantile) const
+{
+	if (Count == 0)
+	{
+		return 0;
+	}
+	uint64_t Target{std::max<uint64_t>(1, static_cast<uint64_t>(Quantile * static_cast<double>(Count) + 0.5))};
+	uint64_t Seen{0};
+	for (size_t Index{0}; Index < BucketCount; Index++)
+	{
+		Seen += Buckets[Index];
+		if (Seen >= Target)
+		{
+			return std::min(GetBucketUpperBound(Index), Max);
+		}
+	}
+	return Max;
+}
+
+// MetricsRegistry
+size_t MetricsRegistry::GetShardIndex()
+{
+	static std::atomic<size_t> NextShard{0};
+	thread_local const size_t ShardIndex{NextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount};
+	return ShardIndex;
+}
+
+MetricsRegistry &MetricsRegistry::Get()
+{
+	static MetricsRegistry Registry{};
+	return Registry;
+}
+
+const MetricDescription &MetricsRegistry::Describe(const MetricCounters Counter)
+{
+	return CounterDescriptions[static_cast<size_t>(Counter)];
+}
+
+const MetricDescription &MetricsRegistry::Describe(const MetricHistograms Histogram)
+{
+	return HistogramDescriptions[static_cast<size_t>(Histogram)];
+}
+
+MetricHistogram &MetricsRegistry::GetSinkDeliveryLag(const std::string_view &SinkName)
+{
+	std::scoped_lock SinkNamesLock{SinkNamesMutex};
+	for (size_t Index{0}; Index < SinkNamesInUse; Index++)
+	{
+		if (SinkNames[Index] == SinkName)
+		{
+			return SinkDeliveryLag[Index];
+		}
+	}
+	if (SinkNamesInUse == MaxSinkHistograms)
+	{
+		return SinkDeliveryLag[MaxSinkHistograms - 1];
+	}
+	SinkNames[SinkNamesInUse] = SinkName;
+	return SinkDeliveryLag[SinkNamesInUse++];
+}
+
+std::vector<std::pair<std::string, MetricHistogram::Snapshot>> MetricsRegistry::GetSinkDeliveryLagSnapshots() const
+{
+	std::vector<std::pair<std::string, MetricHistogram::Snapshot>> Snapshots{};
+	std::scoped_lock SinkNamesLock{SinkNamesMutex};
+	Snapshots.reserve(SinkNamesInUse);
+	for (size_t Index{0}; Index < SinkNamesInUse; Index++)
+	{
+		Snapshots.emplace_back(SinkNames[Index], SinkDeliveryLag[Index].GetSnapshot());
+	}
+	return Snapshots;
+}
+
+uint64_t MetricsRegistry::GetCounter(const MetricCounters Counter) const
+{
+	uint64_t Total{0};
+	for (const auto &Shard : CounterShards)
+	{
+		Total += Shard.Values[static_cast<size_t>(Counter)].load(std::memory_order_relaxed);
+	}
+	return Total;
+}
+
+std::string MetricsRegistry::FormatNagiosRecord(const std::time_t Timestamp, const std::string_view &HostName, const std::string_view &ServiceName) const
+{
+	std::string Record{};
+	AppendNumber(Record, static_cast<uint64_t>(Timestamp));
+	Record.append(1, '\t').append(HostName).append(1, '\t').append(ServiceName).append(1, '\t');
+	for (size_t Index{0}; Index < CounterCount; Index++)
+	{
+		const auto &Description{CounterDescriptions[Index]};
+		AppendPerfItem(Record, Description.Name, "", GetCounter(static_cast<MetricCounters>(Index)), Description.Unit);
+	}
+	for (size_t Index{0}; Index < HistogramCount; Index++)
+	{
+		const auto &Description{HistogramDescriptions[Index]};
+		auto Snapshot{GetHistogram(static_cast<MetricHistograms>(Index))};
+		AppendPerfItem(Record, Description.Name, "_count", Snapshot.Count, "c");
+		AppendPerfItem(Record, Description.Name, "_p50", Snapshot.GetQuantile(0.5), Description.Unit);
+		AppendPerfItem(Record, Description.Name, "_p99", Snapshot.GetQuantile(0.99), Description.Unit);
+		AppendPerfItem(Record, Description.Name, "_max", Snapshot.Max, Description.Unit);
+	}
+	const auto &LagUnit{Describe(MetricHistograms::DeliveryLagMilliseconds).Unit};
+	for (const auto &[SinkName, Snapshot] : GetSinkDeliveryLagSnapshots())
+	{
+		std::string Label{"delivery_lag_"};
+		Label.append(SinkName);
+		AppendPerfItem(Record, Label, "_p50", Snapshot.GetQuantile(0.5), LagUnit);
+		AppendPerfItem(Record, Label, "_p99", Snapshot.GetQuantile(0.99), LagUnit);
+		AppendPerfItem(Record, Label, "_max", Snapshot.Max, LagUnit);
+	}
+	if constexpr (AllocationStats::Enabled)
+	{
+		for (const auto &Stage : AllocationStats::GetReport())
+		{
+			std::string Label{"alloc_"};
+			Label.append(Stage.Name);
+			AppendPerfItem(Record, Label, "", Stage.Counted.Allocations, "c");
+			AppendPerfItem(Record, Label, "_bytes", Stage.Counted.Bytes, "B");
+			AppendPerfItem(Record, Label, "_per_line", Stage.AllocationsPerLine, "");
+			AppendPerfItem(Record, Label, "_bytes_per_line", Stage.BytesPerLine, "B");
+			AppendPerfItem(Record, Label, "_per_point", Stage.AllocationsPerPoint, "");
+			AppendPerfItem(Record, Label, "_bytes_per_point", Stage.BytesPerPoint, "B");
+		}
+	}
+	return Record;
+}
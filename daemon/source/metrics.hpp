@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class MetricCounters : size_t
+{
+	FilesRead,
+	BytesRead,
+	LinesRead,
+	RecordsParsed,
+	ParseFailures,
+	PointsTranslated,
+	ThresholdsSuppressed,
+	HttpRequests,
+	HttpFailures,
+	HttpBytesSent,
+	UdpDatagramsSent,
+	UdpBytesSent,
+	UdpSendErrors,
+	UdpOversizedLines,
+	SinkPointsDelivered,
+	SinkFlushFailures,
+	LogEntriesWritten,
+	LogEntriesDropped,
+	UploadErrorsSaved,
+	OutputLinesDropped,
+	SpoolLagExceeded,
+	DeliveryLagExceeded,
+	CaptureFilesArchived,
+	CaptureFilesEvicted,
+	CatchUpCycles,
+	SpoolEntriesListed,
+	SpoolEntriesStatted,
+	SpoolClaimsLost,
+	SpoolClaimsReleased,
+	Count
+};
+
+enum class MetricHistograms : size_t
+{
+	FileReadMicroseconds,
+	TranslateNanoseconds,
+	HttpRequestMicroseconds,
+	SinkFlushMicroseconds,
+	SpoolLagMilliseconds,
+	DeliveryLagMilliseconds,
+	Count
+};
+
+struct MetricDescription
+{
+	std::string_view Name;	// snake_case, used as the Nagios label and the Prometheus metric name
+	std::string_view Help;
+	std::string_view Unit;	// Nagios unit of measurement
+	uint64_t NanosecondsPerUnit; // histograms only
+};
+
+/// @brief Log-linear histogram in the style of HdrHistogram: eight sub-buckets per power of two, so any recorded value
+/// is reported within 12.5% of its true value. Recording is one relaxed atomic increment and never allocates.
+class MetricHistogram
+{
+public:
+	static constexpr const size_t SubBucketBits{3};
+	static constexpr const size_t SubBucketCount{1 << SubBucketBits};
+	static constexpr const size_t BucketCount{(64 - SubBucketBits + 1) * SubBucketCount};
+
+	struct Snapshot
+	{
+		uint64_t Count{0};
+		uint64_t Sum{0};
+		uint64_t Max{0};
+		std::array<uint64_t, BucketCount> Buckets{};
+		/// @param Quantile 0.0 to 1.0
+		/// @return Upper bound of the bucket that holds the quantile, capped at Max
+		uint64_t GetQuantile(const double Quantile) const;
+	};
+
+	static size_t GetBucketIndex(const uint64_t Value);
+	static uint64_t GetBucketUpperBound(const size_t Index);
+
+	void Record(const uint64_t Value);
+	Snapshot GetSnapshot() const;
+
+private:
+	std::array<std::atomic<uint64_t>, BucketCount> Buckets{};
+	std::atomic<uint64_t> Count{0};
+	std::atomic<uint64_t> Sum{0};
+	std::atomic<uint64_t> Max{0};
+};
+
+/// @brief Process-wide pipeline metrics. Counters are sharded by thread so that hot paths on different threads never share a cache line.
+class MetricsRegistry
+{
+private:
+	static constexpr const size_t ShardCount{16};
+	static constexpr const size_t CounterCount{static_cast<size_t>(MetricCounters::Count)};
+	static constexpr const size_t HistogramCount{static_cast<size_t>(MetricHistograms::Count)};
+	struct alignas(64) CounterShard
+	{
+		std::array<std::atomic<uint64_t>, CounterCount> Values{};
+	};
+	std::array<CounterShard, ShardCount> CounterShards{};
+	std::array<MetricHistogram, HistogramCount> Histograms{};
+	static size_t GetShardIndex();
+
+	// delivery lag broken down by sink; the set of sinks is small and only grows, so a fixed table keeps references stable
+	static constexpr const size_t MaxSinkHistograms{8};
+	std::array<MetricHistogram, MaxSinkHistograms> SinkDeliveryLag{};
+	std::array<std::string, MaxSinkHistograms> SinkNames{};
+	size_t SinkNamesInUse{0};
+	mutable std::mutex SinkNamesMutex;
+
+	MetricsRegistry() = default;
+
+public:
+	MetricsRegistry(const MetricsRegistry &) = delete;
+	MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+	MetricsRegistry(MetricsRegistry &&) = delete;
+	MetricsRegistry &operator=(MetricsRegistry &&) = delete;
+
+	static MetricsRegistry &Get();
+	static const MetricDescription &Describe(const MetricCounters Counter);
+	static const MetricDescription &Describe(const MetricHistograms Histogram);
+
+	void Increment(const MetricCounters Counter, const uint64_t Amount = 1)
+	{
+		CounterShards[GetShardIndex()].Values[static_cast<size_t>(Counter)].fetch_add(Amount, std::memory_order_relaxed);
+	}
+	void Record(const MetricHistograms Histogram, const uint64_t Value) { Histograms[static_cast<size_t>(Histogram)].Record(Value); }
+	uint64_t GetCounter(const MetricCounters Counter) const;
+	MetricHistogram::Snapshot GetHistogram(const MetricHistograms Histogram) const { return Histograms[static_cast<size_t>(Histogram)].GetSnapshot(); }
+
+	/// @brief Delivery lag histogram for one sink, in the unit of MetricHistograms::DeliveryLagMilliseconds. Sinks past the table's size share its last entry.
+	MetricHistogram &GetSinkDeliveryLag(const std::string_view &SinkName);
+	std::vector<std::pair<std::string, MetricHistogram::Snapshot>> GetSinkDeliveryLagSnapshots() const;
+
+	/// @brief Renders every metric as one Nagios perfdata line (TIMET, host, service, perfdata) so it can travel through the normal parser and sinks
+	std::string FormatNagiosRecord(const std::time_t Timestamp, const std::string_view &HostName, const std::string_view &ServiceName) const;
+};
+
+/// @brief Records the time between construction and destruction into a histogram, in the histogram's unit
+class MetricTimer
+{
+private:
+	MetricHistograms Histogram;
+	std::chrono::steady_clock::time_point Started;
+
+public:
+	explicit MetricTimer(const MetricHistograms Histogram) : Histogram{Histogram}, Started{std::chrono::steady_clock::now()} {}
+	~MetricTimer()
+	{
+		auto Elapsed{std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Started).count()};
+		MetricsRegistry::Get().Record(Histogram, static_cast<uint64_t>(Elapsed) / MetricsRegistry::Describe(Histogram).NanosecondsPerUnit);
+	}
+	MetricTimer(const MetricTimer &) = delete;
+	MetricTimer &operator=(const MetricTimer &) = delete;
+	MetricTimer(MetricTimer &&) = delete;
+	MetricTimer &operator=(MetricTimer &&) = delete;
+};
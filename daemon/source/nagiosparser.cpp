@@ -1,6 +1,9 @@
 #include <tuple>
 #include <vector>
+#include "allocstats.hpp"
+#include "metrics.hpp"
 #include "nagiosparser.hpp"
+#include "probes.hpp"
 #include "utility.hpp"
 
 constexpr const std::string_view InvalidTimestamp{"Timestamp is not a number."};
@@ -45,6 +48,10 @@ std::vector<NagiosPerformanceData> NagiosPerfDataParser::ParseNagiosPerformanceD
 	{
 		auto ParsedData{NagiosPerformanceData()};
 		auto PerfDataItem{PerfDataProcessor.GetNextBlock()};
+		if (PerfDataItem.empty())
+		{
+			continue; // doubled separator
+		}
 
 		Utility::DelimitedBlockProcessor PerfDataItemProcessor{PerfDataItem, ';'};
 		while (PerfDataItemProcessor.More())
@@ -79,6 +86,7 @@ std::vector<NagiosPerformanceData> NagiosPerfDataParser::ParseNagiosPerformanceD
 
 std::optional<NagiosPerformanceRecord> NagiosPerfDataParser::ParseNagiosPerformanceRecord(const std::string &NagiosPerfDataLine)
 {
+	AllocationScope ParseScope{AllocationStage::Parse};
 	NagiosPerformanceRecord Record{};
 	std::string LineComponent{};
 	size_t index{0};
@@ -91,7 +99,9 @@ std::optional<NagiosPerformanceRecord> NagiosPerfDataParser::ParseNagiosPerforma
 		case 0:
 			if (!Utility::IsDigitsOnly(LineComponent))
 			{
-				Log.WriteErrorAnnotated(InvalidTimestamp, LineComponent);
+				Log.WriteErrorLazy(InvalidTimestamp, LineComponent);
+				MetricsRegistry::Get().Increment(MetricCounters::ParseFailures);
+				XLAT_PROBE1(record_rejected, NagiosPerfDataLine.c_str());
 				Log.WriteUploadError(NagiosPerfDataLine);
 				return std::nullopt;
 			}
@@ -110,10 +120,12 @@ std::optional<NagiosPerformanceRecord> NagiosPerfDataParser::ParseNagiosPerforma
 			}
 			break;
 		default:
-			Log.WriteWarnAnnotated(ExtraneousData, LineComponent);
+			Log.WriteWarnLazy(ExtraneousData, LineComponent);
 			break;
 		}
 		index++;
 	}
+	MetricsRegistry::Get().Increment(MetricCounters::RecordsParsed);
+	XLAT_PROBE3(record_parsed, Record.HostName.c_str(), Record.ServiceName.c_str(), Record.PerfData.size());
 	return Record;
 }
\ No newline at end of file
@@ -1,121 +1,276 @@
-#include <cstdio>
+#include <algorithm>
+#include <cerrno>
 #include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
 #include <filesystem>
 #include <mutex>
+#include <queue>
 #include <string>
 #include <string_view>
-#include <queue>
+#include <sys/stat.h>
 #include <thread>
+#include <unistd.h>
+#include "metrics.hpp"
 #include "outputfile.hpp"
 
-OutputFile::~OutputFile()
+// private functions
+void OutputFile::AppendStamp(const std::time_t Timestamp)
 {
-	CleanupThread.request_stop();
-	CleanupWaitCondition.notify_one();
+	if (Timestamp != StampSecond) // localtime_r and strftime run once per second instead of once per line
+	{
+		std::tm TimeInfo{};
+		::localtime_r(&Timestamp, &TimeInfo);
+		StampLength = std::strftime(Stamp, sizeof(Stamp), "[%Y-%m-%d %H:%M:%S]: ", &TimeInfo);
+		StampSecond = Timestamp;
+	}
+	Buffer.append(Stamp, StampLength);
 }
 
-std::string OutputFile::GetFilePath() const
+int OutputFile::WriteLine(const std::string_view &Message, const std::time_t *Timestamp)
 {
-	std::filesystem::path FullPath{DirectoryName};
-	FullPath /= FileName;
-	return FullPath.string();
+	{
+		std::unique_lock BufferLock{BufferMutex};
+		if (Mode == OutputFileMode::Buffered && Buffer.size() >= MaxBufferedBytes)
+		{
+			int FlushError{LastError.load(std::memory_order_relaxed)};
+			if (FlushError)
+			{
+				return FlushError; // the file is failing and memory is capped; let the caller find another home for this message
+			}
+			BufferLock.unlock();
+			Flush(); // the flusher cannot keep up, so the caller pays for the write
+			BufferLock.lock();
+		}
+		if (Timestamp != nullptr)
+		{
+			AppendStamp(*Timestamp);
+		}
+		Buffer.append(Message).push_back('\n');
+		if (Mode == OutputFileMode::Buffered)
+		{
+			if (Buffer.size() >= FlushThreshold)
+			{
+				FlushCondition.notify_one();
+			}
+			return 0; // queued, and a failing file is retried on every flush, so this message is not the caller's to place elsewhere
+		}
+	}
+	return Flush();
 }
 
 int OutputFile::PrepareFile()
 {
 	std::error_code ErrorCode{};
 	std::filesystem::create_directory(DirectoryName, ErrorCode);
-	int ReturnValue{ErrorCode.value()};
-	if (ReturnValue == 0)
+	if (ErrorCode)
 	{
-		File = std::fopen(GetFilePath().c_str(), "a");
-		if (File == nullptr)
-		{
-			ReturnValue = errno;
-		}
+		return ErrorCode.value();
+	}
+	Descriptor = ::open(GetFilePath().c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+	if (Descriptor < 0)
+	{
+		return errno;
+	}
+	struct stat FileStatus{};
+	if (::fstat(Descriptor, &FileStatus) == 0)
+	{
+		FileDevice = FileStatus.st_dev;
+		FileInode = FileStatus.st_ino;
 	}
-	return ReturnValue;
+	return 0;
+}
+
+void OutputFile::CloseFile()
+{
+	if (Descriptor >= 0)
+	{
+		::close(Descriptor);
+		Descriptor = -1;
+	}
+}
+
+bool OutputFile::FileWasRotated()
+{
+	std::time_t Now{std::time(nullptr)};
+	if (Now == LastRotationCheck)
+	{
+		return false;
+	}
+	LastRotationCheck = Now;
+	struct stat FileStatus{};
+	if (::stat(GetFilePath().c_str(), &FileStatus) != 0)
+	{
+		return true; // moved or deleted by logrotate or an administrator
+	}
+	return FileStatus.st_dev != FileDevice || FileStatus.st_ino != FileInode;
 }
 
-void OutputFile::Cleanup()
+void OutputFile::RunFlusher(std::stop_token StopToken)
 {
-	std::unique_lock TimedLock{CleanupMutex};
-	std::unique_lock WriterLock{WriterMutex, std::defer_lock};
-	while (!CloseTimer.TimedOut() && !CleanupThread.get_stop_token().stop_requested())
+	while (!StopToken.stop_requested())
 	{
-		if (WriterLock.owns_lock())
 		{
-			WriterLock.unlock();
+			std::unique_lock BufferLock{BufferMutex};
+			FlushCondition.wait_for(BufferLock, StopToken, FlushInterval, [this]
+											{ return Buffer.size() >= FlushThreshold; });
 		}
-		CleanupWaitCondition.wait_for(TimedLock, CloseTimer.GetTimeoutLength(), [this]
-												{ return CleanupThread.get_stop_token().stop_requested() || CloseTimer.TimedOut(); });
-		WriterLock.lock(); // gives the writer a chance to wrap up in the event that we try to close the file right as it tries to signal the cleanup routine
+		Flush();
 	}
-	if (File != nullptr)
+}
+
+// public functions
+OutputFile::OutputFile(const std::string DirectoryName, const std::string FileName, const OutputFileMode Mode)
+	 : DirectoryName{std::move(DirectoryName)}, FileName{std::move(FileName)}, Mode{Mode}
+{
+	if (Mode == OutputFileMode::Buffered)
+	{
+		Buffer.reserve(FlushThreshold);
+		Flusher = std::jthread([this](std::stop_token StopToken)
+									  { RunFlusher(StopToken); });
+	}
+}
+
+OutputFile::~OutputFile()
+{
+	if (Flusher.joinable())
 	{
-		std::fclose(File);
+		Flusher.request_stop();
+		Flusher.join();
 	}
-	FileClosed = true;
-	File = nullptr;
+	Flush();
+	CloseFile();
+}
+
+std::string OutputFile::GetFilePath() const
+{
+	std::filesystem::path FullPath{DirectoryName};
+	FullPath /= FileName;
+	return FullPath.string();
 }
 
 int OutputFile::Write(const std::string &Message, const bool WithStamp)
 {
-	std::unique_lock WriterLock(WriterMutex);
+	if (WithStamp)
+	{
+		std::time_t CurrentTime{std::time(nullptr)};
+		return WriteLine(Message, &CurrentTime);
+	}
+	return WriteLine(Message, nullptr);
+}
 
-	int FileActionResult{0};
-	if (File == nullptr || FileClosed)
+int OutputFile::WriteStamped(const std::string &Message, const std::time_t Timestamp)
+{
+	return WriteLine(Message, &Timestamp);
+}
+
+int OutputFile::Write(std::queue<std::string> &Messages, const bool WithStamp)
+{
+	while (!Messages.empty())
 	{
-		FileActionResult = PrepareFile();
+		int Result{Write(Messages.front(), WithStamp)};
+		if (Result)
+		{
+			return Result;
+		}
+		Messages.pop();
 	}
+	return 0;
+}
 
-	if (FileActionResult == 0)
+int OutputFile::Flush()
+{
+	std::scoped_lock FileLock{FileMutex};
 	{
-		if (WithStamp)
+		std::scoped_lock BufferLock{BufferMutex};
+		if (Outgoing.empty())
 		{
-			FileActionResult = std::fputc('[', File);
-			std::time_t CurrentTime{std::time(nullptr)};
-			std::tm *TimeInfo{std::localtime(&CurrentTime)};
-			char TimeBuffer[128];
-			std::strftime(TimeBuffer, sizeof(TimeBuffer), "%Y-%m-%d %H:%M:%S", TimeInfo);
-			FileActionResult = std::fputs(TimeBuffer, File);
-			FileActionResult = std::fputs("]: ", File);
+			Outgoing.swap(Buffer);
 		}
-		FileActionResult = std::fputs(Message.c_str(), File);
-		if (FileActionResult != EOF)
+		else
 		{
-			FileActionResult = std::fputc('\n', File);
-			CloseTimer.ResetTimeout();
+			Outgoing.append(Buffer); // retry what failed last time ahead of anything newer
+			Buffer.clear();
 		}
+	}
+	if (Outgoing.empty())
+	{
+		LastError.store(0, std::memory_order_relaxed); // nothing left that failed
+		return 0;
+	}
 
-		if (FileActionResult == EOF)
+	if (Descriptor >= 0 && FileWasRotated())
+	{
+		CloseFile();
+	}
+	int Result{Descriptor < 0 ? PrepareFile() : 0};
+	size_t Written{0};
+	while (Result == 0 && Written < Outgoing.size())
+	{
+		ssize_t WriteResult{::write(Descriptor, Outgoing.data() + Written, Outgoing.size() - Written)};
+		if (WriteResult < 0)
 		{
-			FileActionResult = std::ferror(File);
+			if (errno != EINTR)
+			{
+				Result = errno;
+			}
 		}
 		else
 		{
-			FileActionResult = 0;
+			Written += static_cast<size_t>(WriteResult);
 		}
 	}
+	Outgoing.erase(0, Written);
+	if (Result)
+	{
+		CloseFile(); // reopen on the next attempt in case the file went away underneath us
+		if (Mode == OutputFileMode::Immediate)
+		{
+			Outgoing.clear(); // immediate callers already got the error and handle the message themselves
+		}
+		else if (Outgoing.size() > MaxBufferedBytes)
+		{
+			// stop retrying at the cap, and leave the lines for the owner to place elsewhere
+			MetricsRegistry::Get().Increment(MetricCounters::OutputLinesDropped, static_cast<uint64_t>(std::count(Outgoing.begin(), Outgoing.end(), '\n')));
+			Dropped.append(Outgoing);
+			Outgoing.clear();
+		}
+	}
+	LastError.store(Result, std::memory_order_relaxed);
+	return Result;
+}
 
-	if (File != nullptr && FileClosed)
+int OutputFile::Flush(std::string &DroppedLines, const bool Final)
+{
+	int Result{Flush()};
+	std::scoped_lock FileLock{FileMutex};
+	if (Result && Final && !Outgoing.empty())
 	{
-		FileClosed = false;
-		CleanupThread = std::jthread(&OutputFile::Cleanup, this);
+		MetricsRegistry::Get().Increment(MetricCounters::OutputLinesDropped, static_cast<uint64_t>(std::count(Outgoing.begin(), Outgoing.end(), '\n')));
+		Dropped.append(Outgoing);
+		Outgoing.clear();
 	}
-	return FileActionResult;
+	if (DroppedLines.empty())
+	{
+		DroppedLines.swap(Dropped);
+	}
+	else
+	{
+		DroppedLines.append(Dropped);
+		Dropped.clear();
+	}
+	return Result;
 }
 
-int OutputFile::Write(std::queue<std::string> &Messages, const bool WithStamp)
+int OutputFile::Archive(const std::string &ArchivePath)
 {
-	while (!Messages.empty())
+	int Result{Flush()};
+	std::scoped_lock FileLock{FileMutex};
+	if (Result == 0 && ::rename(GetFilePath().c_str(), ArchivePath.c_str()) != 0)
 	{
-		int Result{Write(Messages.front(), WithStamp)};
-		if (Result)
-		{
-			return Result;
-		}
-		Messages.pop();
+		Result = errno;
 	}
-	return 0;
+	CloseFile();
+	return Result;
 }
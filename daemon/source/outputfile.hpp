@@ -1,36 +1,59 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <cstdio>
+#include <ctime>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
 #include <thread>
-#include <time.h>
-#include "threadtimer.hpp"
+
+enum class OutputFileMode
+{
+	Immediate, // every Write reaches the file before returning
+	Buffered	  // writes collect in memory and a background flusher writes them out
+};
 
 class OutputFile
 {
 private:
+	static constexpr const size_t FlushThreshold{256 * 1024};
+	static constexpr const size_t MaxBufferedBytes{64 * 1024 * 1024};
+	static constexpr const std::chrono::milliseconds FlushInterval{1000};
+
 	std::string DirectoryName;
 	std::string FileName;
+	OutputFileMode Mode;
 
-	FILE *File{nullptr};
-	bool FallbackToProfile{false};
+	std::mutex BufferMutex;
+	std::string Buffer{};
+	std::time_t StampSecond{-1};
+	char Stamp[48];
+	size_t StampLength{0};
+	std::atomic<int> LastError{0};
+	void AppendStamp(const std::time_t Timestamp);
+	int WriteLine(const std::string_view &Message, const std::time_t *Timestamp);
 
+	std::mutex FileMutex; // guards everything below, held for the duration of a flush
+	int Descriptor{-1};
+	dev_t FileDevice{0};
+	ino_t FileInode{0};
+	std::time_t LastRotationCheck{0};
+	std::string Outgoing{};
+	std::string Dropped{}; // given up on at the buffer cap, until the next Flush(Dropped) takes them
 	int PrepareFile();
-	void Cleanup();
+	void CloseFile();
+	bool FileWasRotated();
 
-	std::condition_variable CleanupWaitCondition;
-	std::mutex CleanupMutex;
-	std::mutex WriterMutex;
-	ThreadTimer CloseTimer;
-	std::jthread CleanupThread{};
-	std::atomic<bool> FileClosed{true};
+	std::condition_variable_any FlushCondition;
+	std::jthread Flusher{}; // keep last so that it starts after and stops before everything it touches
+	void RunFlusher(std::stop_token StopToken);
 
 public:
-	OutputFile(const std::string DirectoryName, const std::string FileName) : DirectoryName{std::move(DirectoryName)}, FileName{std::move(FileName)} {}
+	OutputFile(const std::string DirectoryName, const std::string FileName, const OutputFileMode Mode = OutputFileMode::Immediate);
 	~OutputFile();
 	OutputFile(const OutputFile &other) = delete;
 	OutputFile(OutputFile &&other) = delete;
@@ -38,6 +61,22 @@ public:
 	OutputFile &operator=(OutputFile &&other) = delete;
 
 	std::string GetFilePath() const;
+	/// @return 0 or errno. In buffered mode, 0 once the message is queued; an errno only when the buffer is full and the file
+	/// is failing, in which case the message was not kept. Flush reports the state of the file itself.
 	int Write(const std::string &Message, const bool WithStamp = false);
+	/// @brief Writes the message prefixed with the provided time instead of the time of the write
+	int WriteStamped(const std::string &Message, const std::time_t Timestamp);
 	int Write(std::queue<std::string> &Messages, const bool WithStamp = false);
-};
\ No newline at end of file
+	/// @brief Writes out everything buffered so far with a single write where possible
+	/// @return 0 or errno
+	int Flush();
+	/// @brief Flush for the owner of a buffered file. While the file is failing, lines are retried until more than
+	/// MaxBufferedBytes are waiting; past that they are given up on and handed to the owner here, never discarded.
+	/// @param Dropped Receives the newline-terminated lines given up on since the last call, for the owner to place elsewhere
+	/// @param Final Give up on everything that cannot be written now, because nothing will retry it
+	/// @return 0 or errno
+	int Flush(std::string &Dropped, const bool Final = false);
+	/// @brief Flushes, then moves the current file to ArchivePath and closes it. The next write starts a fresh file.
+	/// @return 0 or errno
+	int Archive(const std::string &ArchivePath);
+};
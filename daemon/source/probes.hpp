@@ -0,0 +1,38 @@
+#pragma once
+
+// USDT (user-level statically defined tracing) probes for perf, bpftrace and systemtap. An idle probe is a single nop
+// and its arguments are already in registers, so they stay in release builds. Building without <sys/sdt.h>
+// (Debian/Ubuntu package systemtap-sdt-dev) or with NO_PROBES=1 compiles every probe out entirely.
+//
+// Provider: xlatnagiosdatad. List the probes in a binary with: bpftrace -l 'usdt:/usr/local/bin/xlatnagiosdatad:*'
+//
+// probe                 arguments
+// file_open             path (char *)
+// file_read             path (char *), bytes read
+// file_complete         path (char *), lines extracted
+// line_extracted        line length
+// record_parsed         host (char *), service (char *), perfdata items
+// record_rejected       line (char *)
+// batch_built           records handed to the sinks
+// http_request_start    url (char *), request body bytes
+// http_request_finish   url (char *), curl result code, HTTP status (-1 if not requested)
+// log_drop              severity (1 debug to 5 fatal, as in LOG_MIN_LEVEL)
+//
+// Strings are only valid while the probe fires; copy them in the probe action, e.g. str(arg0).
+// Scripts that use these probes are in tools/bpftrace.
+
+#if !defined(XLAT_NO_PROBES) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define XLAT_PROBES_ENABLED 1
+#define XLAT_PROBE1(Name, Argument1) DTRACE_PROBE1(xlatnagiosdatad, Name, Argument1)
+#define XLAT_PROBE2(Name, Argument1, Argument2) DTRACE_PROBE2(xlatnagiosdatad, Name, Argument1, Argument2)
+#define XLAT_PROBE3(Name, Argument1, Argument2, Argument3) DTRACE_PROBE3(xlatnagiosdatad, Name, Argument1, Argument2, Argument3)
+#else
+#define XLAT_PROBES_ENABLED 0
+#define XLAT_PROBE1(Name, Argument1) \
+	do                                \
+	{                                 \
+	} while (false)
+#define XLAT_PROBE2(Name, Argument1, Argument2) XLAT_PROBE1(Name, Argument1)
+#define XLAT_PROBE3(Name, Argument1, Argument2, Argument3) XLAT_PROBE1(Name, Argument1)
+#endif
@@ -0,0 +1,60 @@
+#include <map>
+#include <string>
+#include <string_view>
+#include <curl/curl.h>
+#include "curlclient.hpp"
+#include "logwriter.hpp"
+#include "prometheusclient.hpp"
+#include "snappy.hpp"
+
+// https://prometheus.io/docs/specs/remote_write_spec/
+constexpr const std::string_view ContentEncodingHeader{"Content-Encoding: snappy"};
+constexpr const std::string_view ContentTypeHeader{"Content-Type: application/x-protobuf"};
+constexpr const std::string_view RemoteWriteVersionHeader{"X-Prometheus-Remote-Write-Version: 0.1.0"};
+constexpr const std::string_view AuthorizationHeader{"Authorization: Bearer "};
+
+// log messages
+constexpr const std::string_view Write{"Writing to Prometheus remote-write receiver"};
+
+// helper functions
+static bool LogPrometheusError(const CurlResponse &Response, ILogWriter &Log, const std::string_view &Activity)
+{
+	if (Response.CurlResult != CURLE_OK)
+	{
+		Log.WriteErrorStructured({.CurlCode = static_cast<int>(Response.CurlResult)}, Activity, static_cast<int>(Response.CurlResult), curl_easy_strerror(Response.CurlResult));
+		return true;
+	}
+	if (Response.ResponseCode < 200 || Response.ResponseCode >= 300)
+	{
+		Log.WriteErrorStructured({.HttpStatus = Response.ResponseCode}, Activity, Response.ResponseCode, [&Response]
+							  { return Response.Body ? std::string_view{*Response.Body} : std::string_view{}; });
+		return true;
+	}
+	Log.WriteDebugLazy(Activity, Response.ResponseCode, "Success");
+	return false;
+}
+
+PrometheusClient::PrometheusClient(ILogWriter &Log, const PrometheusConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap)
+	 : BatchingSink{Log, Settings.BatchSize, Settings.MaxPending}, Settings{Settings}, Curl{Log, Settings.HostName, Settings.Port}, Translator{Log, Settings.MetricPrefix, UnitConversionMap}
+{
+	Curl.AddHeader(ContentEncodingHeader);
+	Curl.AddHeader(ContentTypeHeader);
+	Curl.AddHeader(RemoteWriteVersionHeader);
+	if (!Settings.BearerToken.empty())
+	{
+		Curl.AddHeader(std::string{AuthorizationHeader}.append(Settings.BearerToken));
+	}
+}
+
+SendResult PrometheusClient::SendPending()
+{
+	CurlRequest WriteRequest{false, true, true};
+	WriteRequest.SetPath(Settings.Path);
+	WriteRequest.SetPostData(Snappy::Compress(PendingRequest));
+	auto WriteResult{Curl.Post(WriteRequest)};
+	if (LogPrometheusError(WriteResult, Log, Write))
+	{
+		return WriteResult.IsTransientFailure() ? SendResult::Retry : SendResult::Rejected;
+	}
+	return SendResult::Delivered;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include "config.hpp"
+#include "config_constants.hpp"
+#include "curlclient.hpp"
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+#include "prometheustranslator.hpp"
+#include "sink.hpp"
+
+/// @brief Sends performance data to a Prometheus remote-write receiver (Prometheus, VictoriaMetrics, Mimir, ...)
+class PrometheusClient : public BatchingSink
+{
+private:
+	const PrometheusConfiguration Settings;
+	CurlClient Curl;
+	PrometheusTranslator Translator;
+	std::string PendingRequest{}; // encoded WriteRequest, series are appended as they are translated
+
+protected:
+	virtual bool Connect() override { return true; } // remote-write has no standard health endpoint, failures surface on the first write
+	virtual size_t AppendRecord(const NagiosPerformanceRecord &NagiosData) override { return Translator.TranslateNagiosData(PendingRequest, NagiosData); }
+	virtual SendResult SendPending() override;
+	virtual void ClearPending() override { PendingRequest.clear(); } // keeps capacity, the next batch is usually about the same size
+
+public:
+	PrometheusClient(ILogWriter &Log, const PrometheusConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap);
+	virtual ~PrometheusClient() = default;
+
+	virtual std::string_view GetName() const override { return ConfigConstants::Headers::prometheus; }
+};
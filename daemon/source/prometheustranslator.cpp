@@ -0,0 +1,168 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include "logwriter.hpp"
+#include "prometheustranslator.hpp"
+
+// https://github.com/prometheus/prometheus/blob/main/prompb/types.proto
+// WriteRequest { repeated TimeSeries timeseries = 1; }
+// TimeSeries { repeated Label labels = 1; repeated Sample samples = 2; }
+// Label { string name = 1; string value = 2; }
+// Sample { double value = 1; int64 timestamp = 2; }
+constexpr const unsigned char WireVarint{0};
+constexpr const unsigned char WireFixed64{1};
+constexpr const unsigned char WireLengthDelimited{2};
+
+constexpr const std::string_view LabelMetricName{"__name__"};
+constexpr const std::string_view LabelHost{"host"};
+constexpr const std::string_view LabelService{"service"};
+constexpr const std::string_view LabelUnit{"unit"};
+
+constexpr const std::string_view InvalidTimestamp{"Timestamp is not a number, record skipped"};
+
+// helper functions
+static void AppendVarint(std::string &Output, uint64_t Value)
+{
+	while (Value >= 0x80)
+	{
+		Output.push_back(static_cast<char>((Value & 0x7f) | 0x80));
+		Value >>= 7;
+	}
+	Output.push_back(static_cast<char>(Value));
+}
+
+static void AppendTag(std::string &Output, unsigned int Field, unsigned char WireType)
+{
+	AppendVarint(Output, (Field << 3) | WireType);
+}
+
+static void AppendLengthDelimited(std::string &Output, unsigned int Field, const std::string_view &Bytes)
+{
+	AppendTag(Output, Field, WireLengthDelimited);
+	AppendVarint(Output, Bytes.size());
+	Output.append(Bytes);
+}
+
+static void AppendLabel(std::string &Series, std::string &LabelBuffer, const std::string_view &Name, const std::string_view &Value)
+{
+	LabelBuffer.clear();
+	AppendLengthDelimited(LabelBuffer, 1, Name);
+	AppendLengthDelimited(LabelBuffer, 2, Value);
+	AppendLengthDelimited(Series, 1, LabelBuffer);
+}
+
+static void AppendSample(std::string &Series, std::string &SampleBuffer, double Value, int64_t TimestampMilliseconds)
+{
+	SampleBuffer.clear();
+	AppendTag(SampleBuffer, 1, WireFixed64);
+	uint64_t ValueBits;
+	static_assert(sizeof(ValueBits) == sizeof(Value));
+	std::memcpy(&ValueBits, &Value, sizeof(ValueBits));
+	for (size_t Byte{0}; Byte < sizeof(ValueBits); Byte++)
+	{
+		SampleBuffer.push_back(static_cast<char>((ValueBits >> (Byte * 8)) & 0xff)); // protobuf fixed64 is little endian
+	}
+	AppendTag(SampleBuffer, 2, WireVarint);
+	AppendVarint(SampleBuffer, static_cast<uint64_t>(TimestampMilliseconds));
+	AppendLengthDelimited(Series, 2, SampleBuffer);
+}
+
+// Nagios ranges such as "10:20" or "@5" are not single numbers and have no sample value
+static bool ParseSampleValue(const std::string &Text, double &Value)
+{
+	std::string_view Number{Text};
+	if (!Number.empty() && Number.front() == '+')
+	{
+		Number.remove_prefix(1);
+	}
+	if (Number.empty())
+	{
+		return false;
+	}
+	auto [End, Error]{std::from_chars(Number.data(), Number.data() + Number.size(), Value)};
+	return Error == std::errc{} && End == Number.data() + Number.size();
+}
+
+// metric names must match [a-zA-Z_:][a-zA-Z0-9_:]*
+static void AppendSanitizedMetricName(std::string &MetricName, const std::string_view &Name)
+{
+	for (const auto &Character : Name)
+	{
+		bool Valid{(Character >= 'a' && Character <= 'z') || (Character >= 'A' && Character <= 'Z') || (Character >= '0' && Character <= '9') || Character == '_' || Character == ':'};
+		MetricName.push_back(Valid ? Character : '_');
+	}
+	if (!MetricName.empty() && MetricName.front() >= '0' && MetricName.front() <= '9')
+	{
+		MetricName.insert(MetricName.begin(), '_');
+	}
+}
+
+// private functions
+size_t PrometheusTranslator::AppendSeries(std::string &WriteRequest, const std::string_view &Suffix, const std::string &Value, const NagiosPerformanceRecord &NagiosData, const std::string &Unit, int64_t TimestampMilliseconds)
+{
+	double SampleValue;
+	if (!ParseSampleValue(Value, SampleValue))
+	{
+		return 0;
+	}
+	size_t BaseNameLength{MetricName.size()};
+	MetricName.append(Suffix);
+
+	// remote-write receivers expect labels sorted by name
+	SeriesBuffer.clear();
+	AppendLabel(SeriesBuffer, LabelBuffer, LabelMetricName, MetricName);
+	AppendLabel(SeriesBuffer, LabelBuffer, LabelHost, NagiosData.HostName);
+	if (!NagiosData.ServiceName.empty())
+	{
+		AppendLabel(SeriesBuffer, LabelBuffer, LabelService, NagiosData.ServiceName);
+	}
+	if (!Unit.empty())
+	{
+		AppendLabel(SeriesBuffer, LabelBuffer, LabelUnit, Unit);
+	}
+	AppendSample(SeriesBuffer, LabelBuffer, SampleValue, TimestampMilliseconds);
+	AppendLengthDelimited(WriteRequest, 1, SeriesBuffer);
+
+	MetricName.resize(BaseNameLength);
+	return 1;
+}
+
+// public functions
+PrometheusTranslator::PrometheusTranslator(ILogWriter &Log, const std::string_view &MetricPrefix, const std::map<const std::string, const std::string> TranslationMap)
+	 : Log{Log}, MetricPrefix{MetricPrefix}, UnitTranslationMap{std::move(TranslationMap)}
+{
+}
+
+size_t PrometheusTranslator::TranslateNagiosData(std::string &WriteRequest, const NagiosPerformanceRecord &NagiosData)
+{
+	int64_t TimestampSeconds{0};
+	auto [End, Error]{std::from_chars(NagiosData.Timestamp.data(), NagiosData.Timestamp.data() + NagiosData.Timestamp.size(), TimestampSeconds)};
+	if (Error != std::errc{} || End != NagiosData.Timestamp.data() + NagiosData.Timestamp.size())
+	{
+		Log.WriteErrorStructured({.Host = NagiosData.HostName, .Service = NagiosData.ServiceName}, InvalidTimestamp, NagiosData.Timestamp);
+		return 0;
+	}
+	int64_t TimestampMilliseconds{TimestampSeconds * 1000};
+
+	size_t SeriesCount{0};
+	for (const auto &PerfData : NagiosData.PerfData)
+	{
+		auto UnitSearch{UnitTranslationMap.find(PerfData.Unit)};
+		const std::string &Unit{UnitSearch == UnitTranslationMap.end() ? PerfData.Unit : UnitSearch->second};
+		MetricName.assign(MetricPrefix);
+		AppendSanitizedMetricName(MetricName, PerfData.Label);
+		if (MetricName.empty())
+		{
+			continue;
+		}
+		SeriesCount += AppendSeries(WriteRequest, "", PerfData.Value, NagiosData, Unit, TimestampMilliseconds);
+		SeriesCount += AppendSeries(WriteRequest, "_warn", PerfData.Warn, NagiosData, Unit, TimestampMilliseconds);
+		SeriesCount += AppendSeries(WriteRequest, "_crit", PerfData.Crit, NagiosData, Unit, TimestampMilliseconds);
+		SeriesCount += AppendSeries(WriteRequest, "_min", PerfData.Min, NagiosData, Unit, TimestampMilliseconds);
+		SeriesCount += AppendSeries(WriteRequest, "_max", PerfData.Max, NagiosData, Unit, TimestampMilliseconds);
+	}
+	return SeriesCount;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+
+/// @brief Maps Nagios performance records to Prometheus remote-write time series, encoded directly as WriteRequest protobuf fields
+class PrometheusTranslator
+{
+private:
+	ILogWriter &Log;
+	const std::string MetricPrefix;
+	const std::map<const std::string, const std::string> UnitTranslationMap;
+	std::string SeriesBuffer{}; // reused between series to avoid reallocating
+	std::string LabelBuffer{};
+	std::string MetricName{};
+	size_t AppendSeries(std::string &WriteRequest, const std::string_view &Suffix, const std::string &Value, const NagiosPerformanceRecord &NagiosData, const std::string &Unit, int64_t TimestampMilliseconds);
+
+public:
+	PrometheusTranslator(ILogWriter &Log, const std::string_view &MetricPrefix, const std::map<const std::string, const std::string> TranslationMap);
+	PrometheusTranslator(const PrometheusTranslator &) = delete;
+	PrometheusTranslator &operator=(const PrometheusTranslator &) = delete;
+	PrometheusTranslator(PrometheusTranslator &&) = delete;
+	PrometheusTranslator &operator=(PrometheusTranslator &&) = delete;
+	~PrometheusTranslator() = default;
+
+	/// @brief Appends one TimeSeries per numeric value of each performance item: the value itself and its warn, crit, min and max siblings
+	/// @param WriteRequest Encoded WriteRequest message that the series are appended to
+	/// @param NagiosData Parsed record
+	/// @return Number of series appended
+	size_t TranslateNagiosData(std::string &WriteRequest, const NagiosPerformanceRecord &NagiosData);
+};
@@ -0,0 +1,188 @@
+#include <charconv>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "allocstats.hpp"
+#include "config_constants.hpp"
+#include "influxclient.hpp"
+#include "logwriter.hpp"
+#include "metrics.hpp"
+#include "prometheusclient.hpp"
+#include "sink.hpp"
+#include "udpclient.hpp"
+
+// log messages
+constexpr const std::string_view SinkUnavailable{"Sink unavailable, saving its records to the failed writes log this cycle"};
+constexpr const std::string_view SinkRetaining{"Sink delivery failed, retaining records for retry"};
+constexpr const std::string_view SinkSavingUndelivered{"Sink saving undelivered records to failed writes log"};
+
+// private functions
+void BatchingSink::Reset()
+{
+	ClearPending();
+	PendingSourceLines.clear();
+	PendingTimestamps.clear();
+	PendingRecords = 0;
+	PendingPoints = 0;
+}
+
+void BatchingSink::SaveUndelivered()
+{
+	if (PendingRecords > 0)
+	{
+		Log.WriteWarnLazy(SinkSavingUndelivered, GetName(), PendingRecords);
+	}
+	for (const auto &SourceLine : PendingSourceLines)
+	{
+		Log.WriteUploadError(SourceLine);
+	}
+	Reset();
+}
+
+// public functions
+BatchingSink::BatchingSink(ILogWriter &Log, const size_t BatchSize, const size_t MaxPending, const bool RetainSourceLines)
+	 : Log{Log}, BatchSize{BatchSize > 0 ? BatchSize : 1}, MaxPending{MaxPending}, RetainSourceLines{RetainSourceLines}
+{
+}
+
+bool BatchingSink::Open()
+{
+	Available = Connect();
+	if (!Available)
+	{
+		Log.WriteWarnAnnotated(SinkUnavailable, GetName());
+	}
+	return Available;
+}
+
+void BatchingSink::Submit(const SinkBatch &Batch)
+{
+	AllocationScope TranslateScope{AllocationStage::Translate};
+	if (!Available)
+	{
+		// the spool is still read while another sink is up, so this one's records go where a failed write would
+		if (RetainSourceLines)
+		{
+			for (const auto &Record : Batch)
+			{
+				Log.WriteUploadError(Record.SourceLine);
+			}
+		}
+		return;
+	}
+	for (const auto &[Record, SourceLine] : Batch)
+	{
+		size_t Points{AppendRecord(Record)};
+		if (Points == 0)
+		{
+			continue;
+		}
+		PendingRecords++;
+		PendingPoints += Points;
+		std::time_t RecordTime{0};
+		std::from_chars(Record.Timestamp.data(), Record.Timestamp.data() + Record.Timestamp.size(), RecordTime); // the parser already rejected non-numeric timestamps
+		PendingTimestamps.push_back(RecordTime);
+		if (RetainSourceLines)
+		{
+			PendingSourceLines.push_back(SourceLine);
+		}
+		// after a failure, only the reader's backpressure retries, so a down destination is not hit once per record
+		if ((PendingPoints >= BatchSize * BatchScale || PendingFull()) && !LastSendFailed)
+		{
+			Flush();
+		}
+	}
+}
+
+bool BatchingSink::Flush()
+{
+	if (PendingRecords == 0)
+	{
+		LastSendFailed = false;
+		return true;
+	}
+	SendResult Result;
+	{
+		MetricTimer FlushTimer{MetricHistograms::SinkFlushMicroseconds};
+		AllocationScope SendScope{AllocationStage::Send};
+		Result = SendPending();
+	}
+	if (Result == SendResult::Delivered)
+	{
+		MetricsRegistry::Get().Increment(MetricCounters::SinkPointsDelivered, PendingPoints);
+		LastSendFailed = false;
+		if (AckCallback)
+		{
+			AckCallback(SinkAcknowledgement{.SinkName = GetName(), .Records = PendingRecords, .Points = PendingPoints, .RecordTimestamps = PendingTimestamps});
+		}
+		Reset();
+		return true;
+	}
+	MetricsRegistry::Get().Increment(MetricCounters::SinkFlushFailures);
+	if (Result == SendResult::Rejected)
+	{
+		// the destination answered, so there is no outage to wait out, and holding these back would stall the reader for good
+		LastSendFailed = false;
+		SaveUndelivered();
+		return true;
+	}
+	LastSendFailed = true;
+	if (MaxPending == 0)
+	{
+		SaveUndelivered();
+	}
+	else
+	{
+		Log.WriteWarnLazy(SinkRetaining, GetName(), PendingRecords);
+	}
+	return false;
+}
+
+void BatchingSink::FlushOrSave()
+{
+	if (!Flush())
+	{
+		SaveUndelivered();
+	}
+}
+
+void BatchingSink::Close()
+{
+	FlushOrSave();
+}
+
+SinkHealth BatchingSink::GetHealth() const
+{
+	if (!Available)
+	{
+		return SinkHealth::Unavailable;
+	}
+	return LastSendFailed ? SinkHealth::Degraded : SinkHealth::Healthy;
+}
+
+std::string GetThresholdSnapshotPath(const std::string_view &SinkName)
+{
+	std::filesystem::path SnapshotPath{ConfigConstants::StateRootPath};
+	SnapshotPath /= std::string{SinkName}.append(ConfigConstants::ThresholdSnapshotExtension);
+	return SnapshotPath.string();
+}
+
+std::vector<std::unique_ptr<ISink>> SinkFactory::CreateSinks(ILogWriter &Log, Configuration &Config)
+{
+	std::vector<std::unique_ptr<ISink>> Sinks{};
+	if (Config.Influx.Enabled)
+	{
+		Sinks.emplace_back(std::make_unique<InfluxClient>(Log, Config.Influx, Config.UnitConversionMap));
+	}
+	if (Config.InfluxUdp.Enabled)
+	{
+		Sinks.emplace_back(std::make_unique<InfluxUdpClient>(Log, Config.InfluxUdp, Config.UnitConversionMap));
+	}
+	if (Config.Prometheus.Enabled)
+	{
+		Sinks.emplace_back(std::make_unique<PrometheusClient>(Log, Config.Prometheus, Config.UnitConversionMap));
+	}
+	return Sinks;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <functional>
+#include <ctime>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.hpp"
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+
+/// @brief A parsed record and the spool line it came from, kept together so sinks can save lines that they fail to deliver
+struct SinkRecord
+{
+	NagiosPerformanceRecord Record;
+	std::string SourceLine;
+};
+
+using SinkBatch = std::vector<SinkRecord>;
+
+struct SinkAcknowledgement
+{
+	std::string_view SinkName;
+	size_t Records;
+	size_t Points;
+	std::span<const std::time_t> RecordTimestamps; // Nagios timestamps of the delivered records, valid only during the callback
+};
+
+using SinkAckCallback = std::function<void(const SinkAcknowledgement &)>;
+
+/// @brief Outcome of sending a sink's pending request
+enum class SendResult
+{
+	Delivered,
+	Retry,	 // may succeed later: transport errors, 5xx, 408 and 429
+	Rejected // refused for good, such as 400 for a malformed line or 401 for a revoked token, so retrying cannot help
+};
+
+enum class SinkHealth
+{
+	Healthy,
+	Degraded,	// reachable, but the last delivery failed and the sink holds undelivered data
+	Unavailable // the last Open() failed
+};
+
+/// @brief An output that performance data is delivered to
+class ISink
+{
+protected:
+	SinkAckCallback AckCallback{};
+
+public:
+	ISink() = default;
+	virtual ~ISink() = default;
+	ISink(const ISink &) = delete;
+	ISink &operator=(const ISink &) = delete;
+	ISink(ISink &&) = delete;
+	ISink &operator=(ISink &&) = delete;
+
+	/// @brief Name of the sink's configuration table, used in logs
+	virtual std::string_view GetName() const = 0;
+
+	/// @brief Prepares the sink for a collection cycle, such as checking connectivity. A sink that fails still takes
+	/// Submit() calls for the cycle, and saves what it is given to the failed writes log instead of sending it.
+	/// @return True if the sink can deliver data
+	virtual bool Open() = 0;
+
+	/// @brief Hands the sink a batch of records. The sink sends them whenever its own batch fills.
+	virtual void Submit(const SinkBatch &Batch) = 0;
+
+	/// @brief Sends everything the sink holds
+	/// @return True if nothing remains undelivered
+	virtual bool Flush() = 0;
+
+	/// @brief Flushes, then gives up on anything undelivered by saving it to the failed writes log. Called at the end of
+	/// every collection cycle, before the spool files the records came from are deleted.
+	virtual void FlushOrSave() = 0;
+
+	/// @brief Like FlushOrSave, and also persists the sink's own state. Call before destroying the sink.
+	virtual void Close() = 0;
+
+	virtual SinkHealth GetHealth() const = 0;
+
+	/// @brief A saturated sink cannot take more data until a Flush() succeeds. The reader stage stops reading while any sink is saturated.
+	virtual bool Saturated() const = 0;
+
+	/// @brief Records accepted but not yet delivered
+	virtual size_t GetPendingRecords() const = 0;
+
+	/// @brief Multiplies the points per request and the records retained before applying backpressure, for catching up
+	/// on a spool backlog. 1 restores the configured sizes.
+	virtual void SetBatchScale(const size_t Scale) = 0;
+
+	/// @brief Sets a function to call each time the sink's destination accepts data
+	void SetAckCallback(SinkAckCallback Callback) { AckCallback = std::move(Callback); }
+};
+
+/// @brief Common batching and retention for sinks. Derived classes encode records into their own pending request and send it on demand.
+class BatchingSink : public ISink
+{
+private:
+	std::vector<std::string> PendingSourceLines{};
+	std::vector<std::time_t> PendingTimestamps{};
+	size_t PendingRecords{0};
+	size_t PendingPoints{0};
+	bool Available{false};
+	bool LastSendFailed{false};
+	size_t BatchScale{1};
+	void Reset();
+	void SaveUndelivered();
+
+protected:
+	ILogWriter &Log;
+	const size_t BatchSize;			  // points per request
+	const size_t MaxPending;		  // records retained after failures before applying backpressure, 0 saves failures to the log instead
+	const bool RetainSourceLines; // false for sinks that never save failures
+
+	/// @brief Checks the destination
+	virtual bool Connect() = 0;
+
+	/// @brief Encodes a record into the pending request
+	/// @return Number of points added
+	virtual size_t AppendRecord(const NagiosPerformanceRecord &Record) = 0;
+
+	/// @brief Sends the pending request. Must leave it intact on failure so it can be retried.
+	virtual SendResult SendPending() = 0;
+
+	/// @brief Discards the pending request after delivery or after giving up
+	virtual void ClearPending() = 0;
+
+	/// @brief Asks for a flush before BatchSize points are pending, for sinks whose requests fill up by size instead
+	virtual bool PendingFull() const { return false; }
+
+public:
+	BatchingSink(ILogWriter &Log, const size_t BatchSize, const size_t MaxPending, const bool RetainSourceLines = true);
+	virtual ~BatchingSink() = default;
+
+	virtual bool Open() override final;
+	virtual void Submit(const SinkBatch &Batch) override;
+	virtual bool Flush() override;
+	virtual void FlushOrSave() override;
+	virtual void Close() override;
+	virtual SinkHealth GetHealth() const override;
+	virtual bool Saturated() const override { return Available && MaxPending > 0 && PendingRecords >= MaxPending * BatchScale; }
+	virtual size_t GetPendingRecords() const override { return PendingRecords; }
+	virtual void SetBatchScale(const size_t Scale) override { BatchScale = Scale > 0 ? Scale : 1; }
+};
+
+/// @brief Location of a sink's threshold suppression snapshot
+std::string GetThresholdSnapshotPath(const std::string_view &SinkName);
+
+class SinkFactory
+{
+private:
+	SinkFactory() = default;
+
+public:
+	/// @brief Creates every sink enabled in the configuration
+	static std::vector<std::unique_ptr<ISink>> CreateSinks(ILogWriter &Log, Configuration &Config);
+};
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <string_view>
+#include "siphash.hpp"
+
+// https://www.aumasson.jp/siphash/siphash.pdf
+constexpr const int CompressionRounds{2};
+constexpr const int FinalizationRounds{4};
+
+// helper functions
+static constexpr uint64_t RotateLeft(const uint64_t Value, const int Bits)
+{
+	return (Value << Bits) | (Value >> (64 - Bits));
+}
+
+static void Round(uint64_t &V0, uint64_t &V1, uint64_t &V2, uint64_t &V3)
+{
+	V0 += V1;
+	V1 = RotateLeft(V1, 13);
+	V1 ^= V0;
+	V0 = RotateLeft(V0, 32);
+	V2 += V3;
+	V3 = RotateLeft(V3, 16);
+	V3 ^= V2;
+	V0 += V3;
+	V3 = RotateLeft(V3, 21);
+	V3 ^= V0;
+	V2 += V1;
+	V1 = RotateLeft(V1, 17);
+	V1 ^= V2;
+	V2 = RotateLeft(V2, 32);
+}
+
+// public functions
+uint64_t SipHash::Hash24(const Key &Secret, const std::string_view &Input)
+{
+	uint64_t V0{Secret[0] ^ 0x736f6d6570736575ULL};
+	uint64_t V1{Secret[1] ^ 0x646f72616e646f6dULL};
+	uint64_t V2{Secret[0] ^ 0x6c7967656e657261ULL};
+	uint64_t V3{Secret[1] ^ 0x7465646279746573ULL};
+
+	const size_t FullWords{Input.size() / 8};
+	for (size_t Word{0}; Word < FullWords; Word++)
+	{
+		uint64_t Message{0};
+		for (size_t Byte{0}; Byte < 8; Byte++)
+		{
+			Message |= uint64_t{static_cast<unsigned char>(Input[Word * 8 + Byte])} << (8 * Byte);
+		}
+		V3 ^= Message;
+		for (int Pass{0}; Pass < CompressionRounds; Pass++)
+		{
+			Round(V0, V1, V2, V3);
+		}
+		V0 ^= Message;
+	}
+
+	uint64_t Last{uint64_t{Input.size() & 0xff} << 56};
+	for (size_t Byte{FullWords * 8}; Byte < Input.size(); Byte++)
+	{
+		Last |= uint64_t{static_cast<unsigned char>(Input[Byte])} << (8 * (Byte - FullWords * 8));
+	}
+	V3 ^= Last;
+	for (int Pass{0}; Pass < CompressionRounds; Pass++)
+	{
+		Round(V0, V1, V2, V3);
+	}
+	V0 ^= Last;
+
+	V2 ^= 0xff;
+	for (int Pass{0}; Pass < FinalizationRounds; Pass++)
+	{
+		Round(V0, V1, V2, V3);
+	}
+	return V0 ^ V1 ^ V2 ^ V3;
+}
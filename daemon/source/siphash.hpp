@@ -0,0 +1,15 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace SipHash
+{
+	using Key = std::array<uint64_t, 2>;
+
+	/// @brief SipHash-2-4, a keyed hash that cannot be reversed or predicted without the key
+	/// @param Input Bytes to hash
+	/// @return 64-bit hash, identical to the reference implementation with the key bytes read little-endian
+	uint64_t Hash24(const Key &Secret, const std::string_view &Input);
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "snappy.hpp"
+
+// https://github.com/google/snappy/blob/main/format_description.txt
+constexpr const size_t BlockSize{1 << 16};	// copies may not reach back further than 64KiB, so match within blocks of that size
+constexpr const size_t HashTableBits{14};
+constexpr const size_t HashTableSize{1 << HashTableBits};
+constexpr const size_t MinimumMatch{4};
+constexpr const size_t InputMargin{15};		// stop looking for matches this close to the end of a block, the tail is always a literal
+constexpr const unsigned char TagLiteral{0x00};
+constexpr const unsigned char TagCopy1{0x01};
+constexpr const unsigned char TagCopy2{0x02};
+
+// helper functions
+static uint32_t Load32(const char *Pointer)
+{
+	uint32_t Value;
+	std::memcpy(&Value, Pointer, sizeof(Value));
+	return Value;
+}
+
+static uint32_t HashBytes(uint32_t Bytes)
+{
+	return (Bytes * 0x1e35a7bd) >> (32 - HashTableBits);
+}
+
+static void AppendVarint(std::string &Output, size_t Value)
+{
+	while (Value >= 0x80)
+	{
+		Output.push_back(static_cast<char>((Value & 0x7f) | 0x80));
+		Value >>= 7;
+	}
+	Output.push_back(static_cast<char>(Value));
+}
+
+static void EmitLiteral(std::string &Output, const char *Literal, size_t Length)
+{
+	size_t Encoded{Length - 1};
+	if (Encoded < 60)
+	{
+		Output.push_back(static_cast<char>(TagLiteral | (Encoded << 2)));
+	}
+	else
+	{
+		size_t ExtraBytes{0};
+		for (size_t Remaining{Encoded}; Remaining > 0; Remaining >>= 8)
+		{
+			ExtraBytes++;
+		}
+		Output.push_back(static_cast<char>(TagLiteral | ((59 + ExtraBytes) << 2)));
+		for (size_t Byte{0}; Byte < ExtraBytes; Byte++)
+		{
+			Output.push_back(static_cast<char>((Encoded >> (Byte * 8)) & 0xff));
+		}
+	}
+	Output.append(Literal, Length);
+}
+
+static void EmitCopyAtMost64(std::string &Output, size_t Offset, size_t Length)
+{
+	if (Length < 12 && Offset < 2048)
+	{
+		Output.push_back(static_cast<char>(TagCopy1 | ((Length - 4) << 2) | ((Offset >> 8) << 5)));
+		Output.push_back(static_cast<char>(Offset & 0xff));
+	}
+	else
+	{
+		Output.push_back(static_cast<char>(TagCopy2 | ((Length - 1) << 2)));
+		Output.push_back(static_cast<char>(Offset & 0xff));
+		Output.push_back(static_cast<char>((Offset >> 8) & 0xff));
+	}
+}
+
+static void EmitCopy(std::string &Output, size_t Offset, size_t Length)
+{
+	// split long matches so that the last piece never drops below the 4 byte minimum of a 1-byte-offset copy
+	while (Length >= 68)
+	{
+		EmitCopyAtMost64(Output, Offset, 64);
+		Length -= 64;
+	}
+	if (Length > 64)
+	{
+		EmitCopyAtMost64(Output, Offset, 60);
+		Length -= 60;
+	}
+	EmitCopyAtMost64(Output, Offset, Length);
+}
+
+static void CompressBlock(std::string &Output, const char *Block, size_t Length, std::vector<uint16_t> &HashTable)
+{
+	size_t NextEmit{0};
+	if (Length >= InputMargin + MinimumMatch)
+	{
+		std::fill(HashTable.begin(), HashTable.end(), 0);
+		const size_t MatchLimit{Length - InputMargin};
+		size_t Position{1};
+		while (Position < MatchLimit)
+		{
+			uint32_t Current{Load32(Block + Position)};
+			uint32_t Hash{HashBytes(Current)};
+			size_t Candidate{HashTable[Hash]};
+			HashTable[Hash] = static_cast<uint16_t>(Position);
+			if (Candidate >= Position || Load32(Block + Candidate) != Current)
+			{
+				Position++;
+				continue;
+			}
+
+			if (Position > NextEmit)
+			{
+				EmitLiteral(Output, Block + NextEmit, Position - NextEmit);
+			}
+			size_t MatchLength{MinimumMatch};
+			while (Position + MatchLength < Length && Block[Candidate + MatchLength] == Block[Position + MatchLength])
+			{
+				MatchLength++;
+			}
+			EmitCopy(Output, Position - Candidate, MatchLength);
+			Position += MatchLength;
+			NextEmit = Position;
+		}
+	}
+	if (NextEmit < Length)
+	{
+		EmitLiteral(Output, Block + NextEmit, Length - NextEmit);
+	}
+}
+
+std::string Snappy::Compress(const std::string_view &Input)
+{
+	std::string Output{};
+	Output.reserve(32 + Input.size() + Input.size() / 6); // worst case for incompressible input
+	AppendVarint(Output, Input.size());
+	std::vector<uint16_t> HashTable(HashTableSize, 0);
+	for (size_t BlockStart{0}; BlockStart < Input.size(); BlockStart += BlockSize)
+	{
+		size_t Length{std::min(BlockSize, Input.size() - BlockStart)};
+		CompressBlock(Output, Input.data() + BlockStart, Length, HashTable);
+	}
+	return Output;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Snappy
+{
+	/// @brief Compresses a buffer into the raw snappy block format (no framing), as required by Prometheus remote-write
+	/// @param Input Uncompressed bytes
+	/// @return Compressed bytes, prefixed with the uncompressed length as a varint
+	std::string Compress(const std::string_view &Input);
+}
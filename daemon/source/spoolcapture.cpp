@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "config_constants.hpp"
+#include "metrics.hpp"
+#include "spoolcapture.hpp"
+
+// capture logging constants
+constexpr const std::string_view CaptureStarted{"Capturing anonymised spool files, archive size in bytes"};
+constexpr const std::string_view CaptureDirectoryFailed{"Unable to create capture directory"};
+constexpr const std::string_view CaptureKeyInvalid{"Capture key must be 32 hexadecimal digits, capture disabled"};
+constexpr const std::string_view CaptureKeyFailed{"Unable to read or create capture key, capture disabled"};
+constexpr const std::string_view CaptureKeyCreated{"Generated capture key"};
+constexpr const std::string_view CaptureWriteFailed{"Unable to write capture file"};
+constexpr const std::string_view CaptureEvictFailed{"Unable to delete capture file"};
+
+constexpr const size_t KeyHexDigits{32};
+
+// helper functions
+static int GetHexDigitValue(const char Digit)
+{
+	if (Digit >= '0' && Digit <= '9')
+	{
+		return Digit - '0';
+	}
+	if (Digit >= 'a' && Digit <= 'f')
+	{
+		return Digit - 'a' + 10;
+	}
+	if (Digit >= 'A' && Digit <= 'F')
+	{
+		return Digit - 'A' + 10;
+	}
+	return -1;
+}
+
+// the 16 key bytes in order, read as two little-endian words like the SipHash reference implementation
+static bool ParseHexKey(const std::string_view &Text, SipHash::Key &Key)
+{
+	if (Text.size() != KeyHexDigits)
+	{
+		return false;
+	}
+	Key = {0, 0};
+	for (size_t Byte{0}; Byte < KeyHexDigits / 2; Byte++)
+	{
+		int High{GetHexDigitValue(Text[Byte * 2])};
+		int Low{GetHexDigitValue(Text[Byte * 2 + 1])};
+		if (High < 0 || Low < 0)
+		{
+			return false;
+		}
+		Key[Byte / 8] |= uint64_t(High << 4 | Low) << (8 * (Byte % 8));
+	}
+	return true;
+}
+
+static std::string FormatHexKey(const SipHash::Key &Key)
+{
+	constexpr const char Digits[]{"0123456789abcdef"};
+	std::string Text{};
+	for (size_t Byte{0}; Byte < KeyHexDigits / 2; Byte++)
+	{
+		auto Value{static_cast<unsigned>(Key[Byte / 8] >> (8 * (Byte % 8))) & 0xff};
+		Text.push_back(Digits[Value >> 4]);
+		Text.push_back(Digits[Value & 0xf]);
+	}
+	return Text;
+}
+
+static bool IsDigitsOnly(const std::string_view &Text)
+{
+	return !Text.empty() && std::all_of(Text.begin(), Text.end(), [](const char c)
+													{ return c >= '0' && c <= '9'; });
+}
+
+// private functions
+// the key lives outside the archive directory, so copying the archive elsewhere does not hand out the key with it
+bool SpoolCapture::LoadKey()
+{
+	if (!Settings.Key.empty())
+	{
+		if (!ParseHexKey(Settings.Key, Key))
+		{
+			Log.WriteError(CaptureKeyInvalid);
+			return false;
+		}
+		return true;
+	}
+
+	std::filesystem::path KeyPath{ConfigConstants::StateRootPath};
+	KeyPath /= ConfigConstants::CaptureKeyFileName;
+	char Text[KeyHexDigits]{};
+	std::FILE *KeyFile{std::fopen(KeyPath.c_str(), "r")};
+	if (KeyFile != nullptr)
+	{
+		size_t Read{std::fread(Text, 1, sizeof(Text), KeyFile)};
+		std::fclose(KeyFile);
+		if (!ParseHexKey(std::string_view{Text, Read}, Key))
+		{
+			Log.WriteErrorStructured({.FilePath = KeyPath.native()}, CaptureKeyInvalid, KeyPath.native());
+			return false;
+		}
+		return true;
+	}
+
+	std::random_device Entropy{};
+	for (auto &Word : Key)
+	{
+		Word = uint64_t{Entropy()} << 32 | Entropy();
+	}
+	std::error_code FSErrorCode{};
+	std::filesystem::create_directories(KeyPath.parent_path(), FSErrorCode);
+	std::string Formatted{FormatHexKey(Key)};
+	Formatted.push_back('\n');
+	int Descriptor{::open(KeyPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600)};
+	bool Written{Descriptor >= 0 && ::write(Descriptor, Formatted.data(), Formatted.size()) == static_cast<ssize_t>(Formatted.size())};
+	int ErrorNumber{errno};
+	if (Descriptor >= 0)
+	{
+		Written = ::close(Descriptor) == 0 && Written;
+	}
+	if (!Written)
+	{
+		Log.WriteErrorStructured({.FilePath = KeyPath.native(), .ErrorNumber = ErrorNumber}, CaptureKeyFailed, KeyPath.native(), std::strerror(ErrorNumber));
+		return false;
+	}
+	Log.WriteInfoLazy(CaptureKeyCreated, KeyPath.native());
+	return true;
+}
+
+void SpoolCapture::IndexArchive()
+{
+	std::error_code FSErrorCode{};
+	for (auto Entry{std::filesystem::directory_iterator(Settings.Directory, FSErrorCode)}; !FSErrorCode && Entry != std::filesystem::directory_iterator{}; Entry.increment(FSErrorCode))
+	{
+		std::string Name{Entry->path().filename().string()};
+		if (!Entry->is_regular_file(FSErrorCode))
+		{
+			continue;
+		}
+		if (Name.starts_with('.'))
+		{
+			if (Name.ends_with(".tmp")) // left behind by a write that did not finish
+			{
+				std::filesystem::remove(Entry->path(), FSErrorCode);
+			}
+			continue;
+		}
+		uintmax_t Size{Entry->file_size(FSErrorCode)};
+		ArchivedFiles.emplace_back(std::move(Name), Size);
+		ArchivedBytes += Size;
+	}
+	std::sort(ArchivedFiles.begin(), ArchivedFiles.end());
+}
+
+void SpoolCapture::AppendAnonymisedName(const std::string_view &Name)
+{
+	const uint64_t Seed{SipHash::Hash24(Key, Name)};
+	uint64_t Stream{Seed};
+	for (size_t Position{0}; Position < Name.size(); Position++)
+	{
+		if (Position > 0 && Position % 8 == 0) // eight characters per hash, then the next block of the stream
+		{
+			uint64_t Block[2]{Seed, Position / 8};
+			char Bytes[sizeof(Block)];
+			std::memcpy(Bytes, Block, sizeof(Block));
+			Stream = SipHash::Hash24(Key, std::string_view{Bytes, sizeof(Bytes)});
+		}
+		const unsigned Random{static_cast<unsigned>(Stream >> (8 * (Position % 8))) & 0xff};
+		const char c{Name[Position]};
+		if (c >= 'a' && c <= 'z')
+		{
+			Anonymised.push_back(static_cast<char>('a' + Random % 26));
+		}
+		else if (c >= 'A' && c <= 'Z')
+		{
+			Anonymised.push_back(static_cast<char>('A' + Random % 26));
+		}
+		else if (c >= '0' && c <= '9')
+		{
+			Anonymised.push_back(static_cast<char>('0' + Random % 10));
+		}
+		else
+		{
+			Anonymised.push_back(c);
+		}
+	}
+}
+
+// $TIMET$, then host, service (or host check command) and perfdata separated by tabs, see NagiosPerfDataParser
+void SpoolCapture::AppendAnonymisedLine(const std::string_view &Line)
+{
+	size_t Field{0};
+	size_t Start{0};
+	while (Start <= Line.size())
+	{
+		size_t End{std::min(Line.find('\t', Start), Line.size())};
+		std::string_view Value{Line.substr(Start, End - Start)};
+		if (Field == 0 && IsDigitsOnly(Value))
+		{
+			Anonymised.append(Value);
+		}
+		else if (Field == 3)
+		{
+			// items are separated by spaces, and everything after the first = (value, unit, thresholds) is kept
+			size_t ItemStart{0};
+			while (ItemStart <= Value.size())
+			{
+				size_t ItemEnd{std::min(Value.find(' ', ItemStart), Value.size())};
+				std::string_view Item{Value.substr(ItemStart, ItemEnd - ItemStart)};
+				size_t Equals{std::min(Item.find('='), Item.size())};
+				AppendAnonymisedName(Item.substr(0, Equals));
+				Anonymised.append(Item.substr(Equals));
+				if (ItemEnd < Value.size())
+				{
+					Anonymised.push_back(' ');
+				}
+				ItemStart = ItemEnd + 1;
+			}
+		}
+		else
+		{
+			AppendAnonymisedName(Value);
+		}
+		if (End < Line.size())
+		{
+			Anonymised.push_back('\t');
+		}
+		Start = End + 1;
+		Field++;
+	}
+}
+
+void SpoolCapture::EvictOldest()
+{
+	while (ArchivedBytes > Settings.MaxBytes && !ArchivedFiles.empty())
+	{
+		auto &[Name, Size]{ArchivedFiles.front()};
+		std::filesystem::path Path{Settings.Directory};
+		Path /= Name;
+		std::error_code FSErrorCode{};
+		if (!std::filesystem::remove(Path, FSErrorCode) && FSErrorCode)
+		{
+			Log.WriteErrorStructured({.FilePath = Path.native(), .ErrorNumber = FSErrorCode.value()}, CaptureEvictFailed, Path.native(), FSErrorCode.message());
+		}
+		MetricsRegistry::Get().Increment(MetricCounters::CaptureFilesEvicted);
+		ArchivedBytes -= std::min(ArchivedBytes, Size);
+		ArchivedFiles.pop_front();
+	}
+}
+
+// public functions
+bool SpoolCapture::Start()
+{
+	std::error_code FSErrorCode{};
+	std::filesystem::create_directories(Settings.Directory, FSErrorCode);
+	if (FSErrorCode)
+	{
+		Log.WriteErrorStructured({.FilePath = Settings.Directory, .ErrorNumber = FSErrorCode.value()}, CaptureDirectoryFailed, Settings.Directory, FSErrorCode.message());
+		return false;
+	}
+	if (!LoadKey())
+	{
+		return false;
+	}
+	IndexArchive();
+	EvictOldest();
+	Log.WriteInfoLazy(CaptureStarted, Settings.Directory, LogJoin(ArchivedBytes, Settings.MaxBytes));
+	return true;
+}
+
+void SpoolCapture::Archive(const std::string &FileName, const std::string_view &Contents, const std::filesystem::file_time_type Modified)
+{
+	if (Contents.empty())
+	{
+		return;
+	}
+	Anonymised.clear();
+	Anonymised.reserve(Contents.size());
+	size_t Start{0};
+	while (Start < Contents.size())
+	{
+		size_t End{std::min(Contents.find('\n', Start), Contents.size())};
+		AppendAnonymisedLine(Contents.substr(Start, End - Start));
+		if (End < Contents.size())
+		{
+			Anonymised.push_back('\n');
+		}
+		Start = End + 1;
+	}
+
+	auto ModifiedMilliseconds{std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::file_clock::to_sys(Modified).time_since_epoch()).count()};
+	char Prefix[32];
+	std::snprintf(Prefix, sizeof(Prefix), "%015lld-", static_cast<long long>(ModifiedMilliseconds));
+	std::string Name{Prefix + std::filesystem::path{FileName}.filename().string()};
+	std::filesystem::path Path{Settings.Directory};
+	Path /= Name;
+	std::filesystem::path TemporaryPath{Settings.Directory};
+	TemporaryPath /= "." + Name + ".tmp"; // replay skips dot files, so it never sees a partial copy
+
+	errno = 0;
+	std::FILE *File{std::fopen(TemporaryPath.c_str(), "w")};
+	bool Written{File != nullptr && std::fwrite(Anonymised.data(), 1, Anonymised.size(), File) == Anonymised.size()};
+	if (File != nullptr)
+	{
+		Written = std::fclose(File) == 0 && Written;
+	}
+	Written = Written && std::rename(TemporaryPath.c_str(), Path.c_str()) == 0;
+	if (!Written)
+	{
+		int ErrorNumber{errno};
+		Log.WriteErrorStructured({.FilePath = Path.native(), .ErrorNumber = ErrorNumber}, CaptureWriteFailed, Path.native(), std::strerror(ErrorNumber));
+		std::remove(TemporaryPath.c_str());
+		return;
+	}
+	MetricsRegistry::Get().Increment(MetricCounters::CaptureFilesArchived);
+	ArchivedFiles.emplace_back(std::move(Name), Anonymised.size());
+	ArchivedBytes += Anonymised.size();
+	EvictOldest();
+}
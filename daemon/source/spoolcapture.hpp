@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "config.hpp"
+#include "logwriter.hpp"
+#include "siphash.hpp"
+
+/// @brief Copies the spool files the daemon reads into a size-bounded archive, with host, service and label names anonymised,
+/// so production traffic can be replayed against a test setup. Each name is replaced by a keyed hash of itself that keeps its
+/// length and the position of every lowercase letter, uppercase letter and digit; all other characters (spaces, quotes,
+/// backslashes, punctuation) are kept, so the escaping the translators face is unchanged. The same name always gets the same
+/// replacement under the same key. Timestamps, values, units and thresholds are copied as they are.
+/// Archive files are named <modification time in ms>-<spool file name>, and the oldest are deleted once the archive is full.
+class SpoolCapture
+{
+private:
+	ILogWriter &Log;
+	const CaptureConfiguration Settings;
+	SipHash::Key Key{};
+	std::deque<std::pair<std::string, uintmax_t>> ArchivedFiles{}; // oldest first
+	uintmax_t ArchivedBytes{0};
+	std::string Anonymised{};
+
+	bool LoadKey();
+	void IndexArchive();
+	void AppendAnonymisedName(const std::string_view &Name);
+	void AppendAnonymisedLine(const std::string_view &Line);
+	void EvictOldest();
+
+public:
+	SpoolCapture(ILogWriter &Log, const CaptureConfiguration &Settings) : Log{Log}, Settings{Settings} {}
+	SpoolCapture(const SpoolCapture &) = delete;
+	SpoolCapture &operator=(const SpoolCapture &) = delete;
+	SpoolCapture(SpoolCapture &&) = delete;
+	SpoolCapture &operator=(SpoolCapture &&) = delete;
+
+	/// @brief Creates the archive directory and loads or generates the key
+	/// @return False if capture cannot run, which has been logged
+	bool Start();
+
+	/// @brief Writes an anonymised copy of a spool file that was just read. Failures are logged and do not affect processing.
+	/// @param FileName Path of the spool file, only its last component is kept
+	/// @param Contents The bytes read from it
+	/// @param Modified Its modification time, which orders the archive and paces replay
+	void Archive(const std::string &FileName, const std::string_view &Contents, const std::filesystem::file_time_type Modified);
+};
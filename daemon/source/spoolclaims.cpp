@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "metrics.hpp"
+#include "spoolclaims.hpp"
+
+constexpr const std::string_view ClaimsDirectoryName{".claims"};
+
+// claims logging constants
+constexpr const std::string_view ClaimDirectoryFailed{"Unable to create spool claim directory"};
+constexpr const std::string_view LeaseRenewalFailed{"Unable to renew spool claim lease"};
+constexpr const std::string_view ClaimFailed{"Unable to claim spool file"};
+constexpr const std::string_view ClaimLost{"Spool file claimed by another daemon"};
+constexpr const std::string_view ClaimsExpired{"Returning the claims of a daemon whose lease expired to the spool, worker and seconds since renewal"};
+constexpr const std::string_view ReleaseFailed{"Unable to return claim to the spool"};
+constexpr const std::string_view ClaimsReturned{"Returned this daemon's unfinished claims to the spool, worker and files"};
+
+// helper functions
+static bool GetModifiedTime(const std::string &Path, int64_t &Seconds)
+{
+	struct statx Metadata{};
+	if (::statx(AT_FDCWD, Path.c_str(), AT_NO_AUTOMOUNT, STATX_MTIME, &Metadata) != 0)
+	{
+		return false;
+	}
+	Seconds = Metadata.stx_mtime.tv_sec;
+	return true;
+}
+
+// private functions
+bool SpoolClaims::RenewLease()
+{
+	// with both times left to UTIME_NOW, NFS sets them from the server's clock, which every daemon shares
+	if (::utimensat(AT_FDCWD, WorkerDirectory.c_str(), nullptr, 0) == 0)
+	{
+		return true;
+	}
+	int ErrorNumber{errno};
+	if (ErrorNumber == ENOENT) // first run, or another daemon took this one for dead and removed it
+	{
+		std::error_code ErrorCode{};
+		std::filesystem::create_directory(ClaimsDirectory, ErrorCode);
+		if (!ErrorCode)
+		{
+			std::filesystem::create_directory(WorkerDirectory, ErrorCode);
+		}
+		if (ErrorCode && ErrorCode.value() != ENOENT) // no spool directory yet, Prepare does not read it then
+		{
+			Log.WriteErrorStructured({.FilePath = WorkerDirectory, .ErrorNumber = ErrorCode.value()}, ClaimDirectoryFailed, WorkerDirectory, ErrorCode.message());
+		}
+		return !ErrorCode;
+	}
+	Log.WriteErrorStructured({.FilePath = WorkerDirectory, .ErrorNumber = ErrorNumber}, LeaseRenewalFailed, WorkerDirectory, std::strerror(ErrorNumber));
+	return false;
+}
+
+size_t SpoolClaims::Release(const std::string &ReleasedWorker)
+{
+	const std::string ReleasedDirectory{ClaimsDirectory + "/" + ReleasedWorker};
+	size_t Released{0};
+	std::error_code ErrorCode{};
+	for (const auto &direntry : std::filesystem::directory_iterator(ReleasedDirectory, ErrorCode))
+	{
+		const std::string Name{direntry.path().filename().string()};
+		const std::string Target{SpoolDirectory + "/" + Name};
+		if (std::rename(direntry.path().c_str(), Target.c_str()) == 0)
+		{
+			Released++;
+		}
+		else if (int ErrorNumber{errno}; ErrorNumber != ENOENT) // another daemon returned it first
+		{
+			Log.WriteErrorStructured({.FilePath = direntry.path().string(), .ErrorNumber = ErrorNumber}, ReleaseFailed, direntry.path().string(), std::strerror(ErrorNumber));
+		}
+	}
+	::rmdir(ReleasedDirectory.c_str()); // fails, harmlessly, if its daemon came back and claimed more
+	MetricsRegistry::Get().Increment(MetricCounters::SpoolClaimsReleased, Released);
+	return Released;
+}
+
+void SpoolClaims::ReleaseOwn()
+{
+	if (size_t Released{Release(Worker)}; Released > 0)
+	{
+		Log.WriteInfoLazy(ClaimsReturned, Worker, Released);
+	}
+}
+
+void SpoolClaims::RunLeaseKeeper(std::stop_token StopToken)
+{
+	const auto RenewalInterval{std::max(std::chrono::seconds{1}, Expiry / 4)};
+	while (!StopToken.stop_requested())
+	{
+		{
+			std::unique_lock LeaseLock{LeaseMutex};
+			LeaseCondition.wait_for(LeaseLock, StopToken, RenewalInterval, []
+											{ return false; });
+		}
+		if (!StopToken.stop_requested())
+		{
+			RenewLease();
+		}
+	}
+}
+
+// public functions
+SpoolClaims::SpoolClaims(ILogWriter &Log, const std::string &SpoolDirectory, const std::string &Worker, const std::chrono::seconds Expiry)
+	 : Log{Log}, SpoolDirectory{SpoolDirectory}, ClaimsDirectory{SpoolDirectory + "/" + std::string{ClaimsDirectoryName}}, Worker{Worker},
+		WorkerDirectory{ClaimsDirectory + "/" + Worker}, Expiry{Expiry}, Claimed{Log, WorkerDirectory}
+{
+	ReleaseOwn(); // left by a crash; back in the spool they are read in order with everything else
+	LeaseKeeper = std::jthread([this](std::stop_token StopToken)
+										{ RunLeaseKeeper(StopToken); });
+}
+
+SpoolClaims::~SpoolClaims()
+{
+	LeaseKeeper.request_stop();
+	LeaseKeeper.join();
+	ReleaseOwn(); // the next run may use another name, or not share the spool at all
+}
+
+bool SpoolClaims::Prepare()
+{
+	if (::access(SpoolDirectory.c_str(), F_OK) != 0 && errno == ENOENT)
+	{
+		return true; // nothing to claim until Nagios creates it
+	}
+	int64_t Now{0};
+	if (!RenewLease() || !GetModifiedTime(WorkerDirectory, Now))
+	{
+		return false;
+	}
+	std::error_code ErrorCode{};
+	for (const auto &direntry : std::filesystem::directory_iterator(ClaimsDirectory, ErrorCode))
+	{
+		const std::string Name{direntry.path().filename().string()};
+		int64_t Renewed{0};
+		if (Name == Worker || !direntry.is_directory(ErrorCode) || !GetModifiedTime(direntry.path().string(), Renewed))
+		{
+			continue;
+		}
+		if (Now - Renewed > Expiry.count())
+		{
+			Log.WriteWarnLazy(ClaimsExpired, Name, Now - Renewed);
+			Release(Name);
+		}
+	}
+	return true;
+}
+
+std::vector<PendingFile> SpoolClaims::GetClaimedFiles(const size_t Limit)
+{
+	return Claimed.Scan(Limit);
+}
+
+bool SpoolClaims::Claim(PendingFile &File)
+{
+	const std::string Target{WorkerDirectory + File.FileName.substr(File.FileName.find_last_of('/'))};
+	for (int Attempt{0}; Attempt < 2; Attempt++)
+	{
+		if (std::rename(File.FileName.c_str(), Target.c_str()) == 0)
+		{
+			File.FileName = Target;
+			return true;
+		}
+		int ErrorNumber{errno};
+		if (ErrorNumber != ENOENT)
+		{
+			Log.WriteErrorStructured({.FilePath = File.FileName, .ErrorNumber = ErrorNumber}, ClaimFailed, File.FileName, std::strerror(ErrorNumber));
+			return false;
+		}
+		if (::access(WorkerDirectory.c_str(), F_OK) == 0 || !RenewLease()) // the file is gone, not this daemon's directory
+		{
+			break;
+		}
+	}
+	MetricsRegistry::Get().Increment(MetricCounters::SpoolClaimsLost);
+	Log.WriteDebugLazy(ClaimLost, File.FileName);
+	return false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "logwriter.hpp"
+#include "spoolscanner.hpp"
+
+/// @brief Lets several daemons, on one host or on hosts mounting it over NFS or CephFS, drain one spool directory without
+/// reading the same file twice. A daemon claims a file by renaming it into its own directory, <spool>/.claims/<worker>,
+/// which only one of them can do, and reads and deletes it there. A background thread keeps that directory's modification
+/// time current as the daemon's lease. Files in a directory whose lease has expired, left by a daemon that stopped or lost
+/// the mount, are renamed back into the spool for any daemon to claim. Leases are compared in the file system's clock, so
+/// hosts need not agree on the time. A daemon also returns its own claims when it starts and when it stops or reloads, so
+/// none are stranded if it comes back under another name or without sharing.
+class SpoolClaims
+{
+private:
+	ILogWriter &Log;
+	const std::string SpoolDirectory;
+	const std::string ClaimsDirectory;
+	const std::string Worker;
+	const std::string WorkerDirectory;
+	const std::chrono::seconds Expiry;
+	SpoolScanner Claimed; // this daemon's directory, for claims an earlier cycle or run did not finish
+
+	bool RenewLease();
+	size_t Release(const std::string &ReleasedWorker);
+	void ReleaseOwn();
+
+	std::mutex LeaseMutex{};
+	std::condition_variable_any LeaseCondition{};
+	std::jthread LeaseKeeper{}; // keep last so that it starts after and stops before everything it touches
+	void RunLeaseKeeper(std::stop_token StopToken);
+
+public:
+	/// @param Worker This daemon's name among those sharing the spool, unique to each of them
+	/// @param Expiry How long a lease lasts without renewal before its claims are returned to the spool
+	SpoolClaims(ILogWriter &Log, const std::string &SpoolDirectory, const std::string &Worker, const std::chrono::seconds Expiry);
+	~SpoolClaims();
+	SpoolClaims(const SpoolClaims &) = delete;
+	SpoolClaims &operator=(const SpoolClaims &) = delete;
+	SpoolClaims(SpoolClaims &&) = delete;
+	SpoolClaims &operator=(SpoolClaims &&) = delete;
+
+	/// @brief Creates this daemon's claim directory if needed, renews its lease and returns expired claims to the spool.
+	/// Call at the start of every collection cycle.
+	/// @return False if this daemon cannot claim files now, in which case it must not read the spool this cycle
+	bool Prepare();
+
+	/// @brief Files claimed before and not yet deleted, oldest first, such as those a read error left behind
+	/// @param Limit Returns only the oldest Limit files, 0 for all of them
+	std::vector<PendingFile> GetClaimedFiles(const size_t Limit);
+
+	/// @brief Claimed files the last GetClaimedFiles left for a later cycle because of its limit
+	size_t GetUnclaimedFileCount() const { return Claimed.GetUnclaimedFileCount(); }
+
+	/// @brief Drops a deleted claim from the index of this daemon's directory, see SpoolScanner::Forget
+	void Forget(const std::string_view &Path) { Claimed.Forget(Path); }
+
+	/// @brief Moves File into this daemon's claim directory and updates its name to match
+	/// @return False if another daemon claimed it first, or it could not be moved
+	bool Claim(PendingFile &File);
+};
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include "metrics.hpp"
+#include "spoolscanner.hpp"
+
+// scanner logging constants
+constexpr const std::string_view SpoolOpenFailed{"Unable to open spool directory"};
+constexpr const std::string_view SpoolListFailed{"Unable to list spool directory"};
+constexpr const std::string_view SpoolStatFailed{"Unable to read spool file metadata"};
+
+// struct linux_dirent64: d_ino, d_off, d_reclen, d_type, then the name
+constexpr const size_t DirentInodeOffset{0};
+constexpr const size_t DirentLengthOffset{16};
+constexpr const size_t DirentTypeOffset{18};
+constexpr const size_t DirentNameOffset{19};
+
+// helper functions
+static int64_t GetSortTime(const std::string_view &Name, const std::filesystem::file_time_type Modified)
+{
+	int64_t Timestamp{0};
+	auto [End, ErrorCode]{std::from_chars(Name.data(), Name.data() + Name.size(), Timestamp)};
+	if (ErrorCode == std::errc{} && End != Name.data())
+	{
+		return Timestamp;
+	}
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::file_clock::to_sys(Modified).time_since_epoch()).count();
+}
+
+// private functions
+bool SpoolScanner::Fetch(const int DirectoryDescriptor, const std::string &Name, IndexedFile &File)
+{
+	struct statx Metadata{};
+	MetricsRegistry::Get().Increment(MetricCounters::SpoolEntriesStatted);
+	if (::statx(DirectoryDescriptor, Name.c_str(), AT_NO_AUTOMOUNT, STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME, &Metadata) != 0)
+	{
+		int ErrorNumber{errno};
+		if (ErrorNumber != ENOENT) // deleted since it was listed
+		{
+			std::string Path{Directory + "/" + Name};
+			Log.WriteErrorStructured({.FilePath = Path, .ErrorNumber = ErrorNumber}, SpoolStatFailed, Path, std::strerror(ErrorNumber));
+		}
+		return false;
+	}
+	std::chrono::system_clock::time_point ModifiedTime{std::chrono::duration_cast<std::chrono::system_clock::duration>(
+		 std::chrono::seconds{Metadata.stx_mtime.tv_sec} + std::chrono::nanoseconds{Metadata.stx_mtime.tv_nsec})};
+	File.Inode = Metadata.stx_ino;
+	File.Size = Metadata.stx_size;
+	File.Modified = std::chrono::file_clock::from_sys(ModifiedTime);
+	File.SortTime = GetSortTime(Name, File.Modified);
+	File.Regular = S_ISREG(Metadata.stx_mode);
+	return true;
+}
+
+// public functions
+void SpoolScanner::Forget(const std::string_view &Path)
+{
+	const size_t Separator{Path.find_last_of('/')};
+	Index.erase(std::string{Separator == std::string_view::npos ? Path : Path.substr(Separator + 1)});
+}
+
+std::vector<PendingFile> SpoolScanner::Scan(const size_t Limit, const std::function<bool(PendingFile &File)> &Claim)
+{
+	std::vector<PendingFile> Claimed{};
+	Unclaimed = 0;
+	int DirectoryDescriptor{::open(Directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+	if (DirectoryDescriptor < 0)
+	{
+		int ErrorNumber{errno};
+		if (ErrorNumber != ENOENT) // Nagios has not created it yet
+		{
+			Log.WriteErrorStructured({.FilePath = Directory, .ErrorNumber = ErrorNumber}, SpoolOpenFailed, Directory, std::strerror(ErrorNumber));
+		}
+		return Claimed;
+	}
+
+	Generation++;
+	std::vector<const std::pair<const std::string, IndexedFile> *> Listed{};
+	size_t Entries{0};
+	long Read{0};
+	while ((Read = ::syscall(SYS_getdents64, DirectoryDescriptor, Buffer.data(), Buffer.size())) > 0)
+	{
+		for (size_t Offset{0}; Offset < static_cast<size_t>(Read);)
+		{
+			const char *Entry{Buffer.data() + Offset};
+			uint64_t Inode{0};
+			unsigned short Length{0};
+			std::memcpy(&Inode, Entry + DirentInodeOffset, sizeof(Inode));
+			std::memcpy(&Length, Entry + DirentLengthOffset, sizeof(Length));
+			const auto Type{static_cast<unsigned char>(Entry[DirentTypeOffset])};
+			std::string_view Name{Entry + DirentNameOffset};
+			Offset += Length;
+			// symbolic links and unknown types are resolved by statx, like directory_iterator's is_regular_file()
+			if (Name == "." || Name == ".." || (Type != DT_REG && Type != DT_LNK && Type != DT_UNKNOWN))
+			{
+				continue;
+			}
+			Entries++;
+			auto [Indexed, Added]{Index.try_emplace(std::string{Name})};
+			if ((Added || Indexed->second.Inode != Inode) && !Fetch(DirectoryDescriptor, Indexed->first, Indexed->second))
+			{
+				Index.erase(Indexed);
+				continue;
+			}
+			Indexed->second.Inode = Inode; // statx reports the target of a link, getdents64 the link
+			Indexed->second.Generation = Generation;
+			if (Indexed->second.Regular)
+			{
+				Listed.push_back(&*Indexed);
+			}
+		}
+	}
+	if (Read < 0)
+	{
+		int ErrorNumber{errno};
+		Log.WriteErrorStructured({.FilePath = Directory, .ErrorNumber = ErrorNumber}, SpoolListFailed, Directory, std::strerror(ErrorNumber));
+	}
+	::close(DirectoryDescriptor);
+	MetricsRegistry::Get().Increment(MetricCounters::SpoolEntriesListed, Entries);
+
+	// anything not listed this time has been deleted, whether by this daemon or not
+	std::erase_if(Index, [this](const auto &Indexed)
+					  { return Indexed.second.Generation != Generation; });
+
+	const size_t Wanted{Limit > 0 ? std::min(Limit, Listed.size()) : Listed.size()};
+	auto Oldest{[](const auto &Left, const auto &Right)
+					{ return Left->second.SortTime < Right->second.SortTime || (Left->second.SortTime == Right->second.SortTime && Left->first < Right->first); }};
+	if (Wanted < Listed.size() && !Claim) // a claim can fail, and then the files after the first Wanted are needed in order too
+	{
+		std::partial_sort(Listed.begin(), Listed.begin() + static_cast<std::ptrdiff_t>(Wanted), Listed.end(), Oldest);
+	}
+	else
+	{
+		std::sort(Listed.begin(), Listed.end(), Oldest);
+	}
+	Claimed.reserve(Wanted);
+	size_t Position{0};
+	for (; Position < Listed.size() && Claimed.size() < Wanted; Position++)
+	{
+		const auto &[Name, File]{*Listed[Position]};
+		PendingFile Next{Directory + "/" + Name, File.Size, File.Modified};
+		if (!Claim || Claim(Next))
+		{
+			Claimed.push_back(std::move(Next));
+		}
+	}
+	Unclaimed = Listed.size() - Position;
+	return Claimed;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "logwriter.hpp"
+
+struct PendingFile
+{
+	PendingFile(std::string FileName, size_t FileSize, std::filesystem::file_time_type Modified) : FileName{FileName}, FileSize{FileSize}, Modified{Modified} {}
+	std::string FileName;
+	size_t FileSize;
+	std::filesystem::file_time_type Modified;
+};
+
+/// @brief Lists the spool directory with getdents64 and fetches each new file's size and modification time with one
+/// statx call. Files it has seen before, matched by name and inode, come from an index kept across cycles, so a large
+/// backlog is not stat()ed again every cycle. Meant for spools that receive whole files by rename, as Nagios' are.
+class SpoolScanner
+{
+private:
+	struct IndexedFile
+	{
+		uint64_t Inode{0};
+		size_t Size{0};
+		std::filesystem::file_time_type Modified{};
+		int64_t SortTime{0}; // $TIMET$ from the name, or the modification time
+		bool Regular{false};
+		uint64_t Generation{0}; // the last scan that listed it
+	};
+
+	ILogWriter &Log;
+	const std::string Directory;
+	std::unordered_map<std::string, IndexedFile> Index{};
+	uint64_t Generation{0};
+	size_t Unclaimed{0};
+	std::array<char, 65536> Buffer{};
+	bool Fetch(const int DirectoryDescriptor, const std::string &Name, IndexedFile &File);
+
+public:
+	SpoolScanner(ILogWriter &Log, const std::string &Directory) : Log{Log}, Directory{Directory} {}
+	~SpoolScanner() = default;
+	SpoolScanner(const SpoolScanner &) = delete;
+	SpoolScanner &operator=(const SpoolScanner &) = delete;
+	SpoolScanner(SpoolScanner &&) = delete;
+	SpoolScanner &operator=(SpoolScanner &&) = delete;
+
+	const std::string &GetDirectory() const { return Directory; }
+
+	/// @brief Lists the regular files in the directory, oldest first by the $TIMET$ their names start with, or by
+	/// modification time for names without one
+	/// @param Limit Claims only the oldest Limit files, 0 for all of them
+	/// @param Claim Called on each file, in order, before it is claimed, for spools shared with other daemons. A file it
+	/// returns false for is skipped and does not count against Limit; it may change the file's name.
+	/// @return The claimed files, with full paths
+	std::vector<PendingFile> Scan(const size_t Limit, const std::function<bool(PendingFile &File)> &Claim = nullptr);
+
+	/// @brief Drops a file from the index once it has been deleted, so a new file that reuses its name and inode is fetched
+	/// @param Path The file's full path, or just its name
+	void Forget(const std::string_view &Path);
+
+	/// @brief Files the last scan left for a later cycle because of its limit
+	size_t GetUnclaimedFileCount() const { return Unclaimed; }
+};
@@ -0,0 +1,724 @@
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <netdb.h>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+#include "allocstats.hpp"
+#include "metrics.hpp"
+#include "statusserver.hpp"
+
+constexpr const size_t MaxRequestBytes{8192};
+constexpr const std::time_t IdleConnectionSeconds{10};
+constexpr const int MaxEvents{32};
+constexpr const int PollIntervalMilliseconds{1000}; // idle connections are swept at least this often
+constexpr const std::string_view MetricPrefix{"xlatnagiosdatad_"};
+constexpr const std::pair<double, std::string_view> Quantiles[]{{0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}};
+
+// log messages
+constexpr const std::string_view ResolveStatusHost{"Resolving status endpoint address"};
+constexpr const std::string_view OpeningStatusListener{"Opening status endpoint listener"};
+constexpr const std::string_view StatusListening{"Status endpoint listening"};
+constexpr const std::string_view AcceptingStatusConnection{"Accepting status endpoint connection"};
+constexpr const std::string_view StatusRequest{"Status endpoint request"};
+
+// helper functions
+static void AppendNumber(std::string &Target, const uint64_t Value)
+{
+	char Digits[24];
+	auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value)};
+	Target.append(Digits, End);
+}
+
+static void AppendSeconds(std::string &Target, const uint64_t Value, const uint64_t NanosecondsPerUnit)
+{
+	char Digits[32];
+	auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), static_cast<double>(Value) * static_cast<double>(NanosecondsPerUnit) / 1e9)};
+	Target.append(Digits, End);
+}
+
+static void AppendJsonString(std::string &Target, const std::string_view &Value)
+{
+	Target.push_back('"');
+	for (const char c : Value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			Target.push_back('\\');
+			Target.push_back(c);
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			constexpr const char Hex[]{"0123456789abcdef"};
+			Target.append("\\u00").append(1, Hex[(c >> 4) & 0xF]).append(1, Hex[c & 0xF]);
+		}
+		else
+		{
+			Target.push_back(c);
+		}
+	}
+	Target.push_back('"');
+}
+
+static void AppendMetricHeader(std::string &Target, const std::string_view &Name, const std::string_view &Help, const std::string_view &Type)
+{
+	Target.append("# HELP ").append(MetricPrefix).append(Name).append(1, ' ').append(Help).append(1, '\n');
+	Target.append("# TYPE ").append(MetricPrefix).append(Name).append(1, ' ').append(Type).append(1, '\n');
+}
+
+[[maybe_unused]] static void AppendDecimal(std::string &Target, const double Value)
+{
+	char Digits[32];
+	auto [End, ErrorCode]{std::to_chars(Digits, Digits + sizeof(Digits), Value)};
+	Target.append(Digits, End);
+}
+
+// only in builds with ALLOC_STATS=1, see allocstats.hpp
+[[maybe_unused]] static void AppendAllocationMetrics(std::string &Body)
+{
+	auto Report{AllocationStats::GetReport()};
+	Report.pop_back(); // the total, which Prometheus can sum for itself
+	AppendMetricHeader(Body, "alloc_total", "Heap allocations made by each pipeline stage", "counter");
+	for (const auto &Stage : Report)
+	{
+		Body.append(MetricPrefix).append("alloc_total{stage=\"").append(Stage.Name).append("\"} ");
+		AppendNumber(Body, Stage.Counted.Allocations);
+		Body.append(1, '\n');
+	}
+	AppendMetricHeader(Body, "alloc_bytes_total", "Bytes requested from the heap by each pipeline stage", "counter");
+	for (const auto &Stage : Report)
+	{
+		Body.append(MetricPrefix).append("alloc_bytes_total{stage=\"").append(Stage.Name).append("\"} ");
+		AppendNumber(Body, Stage.Counted.Bytes);
+		Body.append(1, '\n');
+	}
+	const std::pair<std::string_view, double AllocationStats::StageReport::*> Ratios[]{
+		 {"alloc_per_line", &AllocationStats::StageReport::AllocationsPerLine},
+		 {"alloc_bytes_per_line", &AllocationStats::StageReport::BytesPerLine},
+		 {"alloc_per_point", &AllocationStats::StageReport::AllocationsPerPoint},
+		 {"alloc_bytes_per_point", &AllocationStats::StageReport::BytesPerPoint}};
+	for (const auto &[Name, Ratio] : Ratios)
+	{
+		AppendMetricHeader(Body, Name, "Heap allocations or bytes of each pipeline stage since start, divided by lines read or points translated", "gauge");
+		for (const auto &Stage : Report)
+		{
+			Body.append(MetricPrefix).append(Name).append("{stage=\"").append(Stage.Name).append("\"} ");
+			AppendDecimal(Body, Stage.*Ratio);
+			Body.append(1, '\n');
+		}
+	}
+}
+
+static std::string_view GetHealthName(const SinkHealth Health)
+{
+	switch (Health)
+	{
+	case SinkHealth::Healthy:
+		return "healthy";
+	case SinkHealth::Degraded:
+		return "degraded";
+	default:
+		return "unavailable";
+	}
+}
+
+struct SpoolBacklog
+{
+	uint64_t Files{0};
+	uint64_t Bytes{0};
+	std::time_t OldestModified{0};
+};
+
+// scanned on every request, so the numbers are never older than the request asking for them
+static SpoolBacklog ScanSpoolDirectory(const std::string &SpoolDirectory)
+{
+	SpoolBacklog Backlog{};
+	std::error_code FSErrorCode{};
+	for (const auto &direntry : std::filesystem::directory_iterator(SpoolDirectory, FSErrorCode))
+	{
+		if (!direntry.is_regular_file(FSErrorCode))
+		{
+			continue;
+		}
+		auto Size{direntry.file_size(FSErrorCode)};
+		auto Modified{direntry.last_write_time(FSErrorCode)};
+		if (FSErrorCode)
+		{
+			continue; // collected while we looked
+		}
+		auto ModifiedTime{std::chrono::system_clock::to_time_t(std::chrono::file_clock::to_sys(Modified))};
+		Backlog.Files++;
+		Backlog.Bytes += Size;
+		if (Backlog.OldestModified == 0 || ModifiedTime < Backlog.OldestModified)
+		{
+			Backlog.OldestModified = ModifiedTime;
+		}
+	}
+	return Backlog;
+}
+
+static std::string MakeResponse(const std::string_view &Status, const std::string_view &ContentType, const std::string &Body)
+{
+	std::string Response{"HTTP/1.1 "};
+	Response.append(Status).append("\r\nContent-Type: ").append(ContentType).append("\r\nContent-Length: ");
+	AppendNumber(Response, Body.size());
+	Response.append("\r\nConnection: close\r\n\r\n").append(Body);
+	return Response;
+}
+
+// DaemonStatus
+void DaemonStatus::SetSpoolDirectory(const std::string &Directory)
+{
+	std::scoped_lock StatusLock{StatusMutex};
+	SpoolDirectory = Directory;
+}
+
+void DaemonStatus::UpdateSinks(const std::vector<std::unique_ptr<ISink>> &CurrentSinks)
+{
+	std::vector<SinkStatus> Updated{};
+	Updated.reserve(CurrentSinks.size());
+	std::scoped_lock StatusLock{StatusMutex};
+	for (const auto &Sink : CurrentSinks)
+	{
+		SinkStatus &Entry{Updated.emplace_back()};
+		Entry.Name = Sink->GetName();
+		for (const auto &Previous : Sinks)
+		{
+			if (Previous.Name == Entry.Name)
+			{
+				Entry.LastSuccess = Previous.LastSuccess;
+				Entry.PointsDelivered = Previous.PointsDelivered;
+				break;
+			}
+		}
+		Entry.Health = Sink->GetHealth();
+		Entry.PendingRecords = Sink->GetPendingRecords();
+	}
+	Sinks = std::move(Updated);
+}
+
+void DaemonStatus::RecordAcknowledgement(const SinkAcknowledgement &Acknowledgement)
+{
+	std::scoped_lock StatusLock{StatusMutex};
+	for (auto &Entry : Sinks)
+	{
+		if (Entry.Name == Acknowledgement.SinkName)
+		{
+			Entry.LastSuccess = std::time(nullptr);
+			Entry.PointsDelivered += Acknowledgement.Points;
+			return;
+		}
+	}
+	SinkStatus &Entry{Sinks.emplace_back()}; // acknowledged before the first UpdateSinks()
+	Entry.Name = Acknowledgement.SinkName;
+	Entry.LastSuccess = std::time(nullptr);
+	Entry.PointsDelivered = Acknowledgement.Points;
+}
+
+std::vector<SinkStatus> DaemonStatus::GetSinks() const
+{
+	std::scoped_lock StatusLock{StatusMutex};
+	return Sinks;
+}
+
+std::string DaemonStatus::GetSpoolDirectory() const
+{
+	std::scoped_lock StatusLock{StatusMutex};
+	return SpoolDirectory;
+}
+
+// private functions
+bool StatusServer::Listen()
+{
+	if (!Settings.SocketPath.empty())
+	{
+		sockaddr_un Address{};
+		Address.sun_family = AF_UNIX;
+		if (Settings.SocketPath.size() >= sizeof(Address.sun_path))
+		{
+			Log.WriteErrorAnnotated(OpeningStatusListener, Settings.SocketPath, std::strerror(ENAMETOOLONG));
+			return false;
+		}
+		std::memcpy(Address.sun_path, Settings.SocketPath.c_str(), Settings.SocketPath.size());
+		struct stat Existing{};
+		if (::lstat(Settings.SocketPath.c_str(), &Existing) == 0)
+		{
+			if (!S_ISSOCK(Existing.st_mode)) // a mistyped path must not cost someone a file
+			{
+				Log.WriteErrorStructured({.FilePath = Settings.SocketPath, .ErrorNumber = EEXIST}, OpeningStatusListener, Settings.SocketPath, std::strerror(EEXIST));
+				return false;
+			}
+			// only a socket nobody listens on is stale; a live one belongs to another instance using the same path
+			int Probe{::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+			int ProbeError{Probe < 0 ? errno : 0};
+			if (Probe >= 0)
+			{
+				ProbeError = ::connect(Probe, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) == 0 || errno == EAGAIN ? EADDRINUSE : errno;
+				::close(Probe);
+			}
+			if (ProbeError == ECONNREFUSED)
+			{
+				::unlink(Settings.SocketPath.c_str()); // left behind by a previous run
+			}
+			else if (ProbeError != ENOENT) // removed since, so the path is free
+			{
+				Log.WriteErrorStructured({.FilePath = Settings.SocketPath, .ErrorNumber = ProbeError}, OpeningStatusListener, Settings.SocketPath, std::strerror(ProbeError));
+				return false;
+			}
+		}
+		int Candidate{::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+		if (Candidate < 0 || ::bind(Candidate, reinterpret_cast<sockaddr *>(&Address), sizeof(Address)) != 0 || ::listen(Candidate, SOMAXCONN) != 0)
+		{
+			int ErrorNumber{errno};
+			if (Candidate >= 0)
+			{
+				::close(Candidate);
+			}
+			Log.WriteErrorStructured({.FilePath = Settings.SocketPath, .ErrorNumber = ErrorNumber}, OpeningStatusListener, Settings.SocketPath, std::strerror(ErrorNumber));
+			return false;
+		}
+		ListenSocket = Candidate; // only now is the path ours to remove on shutdown
+		Log.WriteInfoAnnotated(StatusListening, Settings.SocketPath);
+		return true;
+	}
+
+	addrinfo Hints{};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+	Hints.ai_flags = AI_PASSIVE;
+	addrinfo *Addresses{nullptr};
+	std::string Port{std::to_string(Settings.Port)};
+	int ResolveResult{::getaddrinfo(Settings.HostName.c_str(), Port.c_str(), &Hints, &Addresses)};
+	if (ResolveResult != 0)
+	{
+		Log.WriteErrorAnnotated(ResolveStatusHost, Settings.HostName, ::gai_strerror(ResolveResult));
+		return false;
+	}
+	int ErrorNumber{0};
+	for (addrinfo *Address{Addresses}; Address != nullptr && ListenSocket < 0; Address = Address->ai_next)
+	{
+		int Candidate{::socket(Address->ai_family, Address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, Address->ai_protocol)};
+		if (Candidate < 0)
+		{
+			ErrorNumber = errno;
+			continue;
+		}
+		int ReuseAddress{1};
+		::setsockopt(Candidate, SOL_SOCKET, SO_REUSEADDR, &ReuseAddress, sizeof(ReuseAddress));
+		if (::bind(Candidate, Address->ai_addr, Address->ai_addrlen) == 0 && ::listen(Candidate, SOMAXCONN) == 0)
+		{
+			ListenSocket = Candidate;
+			break;
+		}
+		ErrorNumber = errno;
+		::close(Candidate);
+	}
+	::freeaddrinfo(Addresses);
+	if (ListenSocket < 0)
+	{
+		Log.WriteErrorStructured({.ErrorNumber = ErrorNumber}, OpeningStatusListener, Settings.HostName, std::strerror(ErrorNumber));
+		return false;
+	}
+	Log.WriteInfoLazy(StatusListening, LogJoin(Settings.HostName, Settings.Port));
+	return true;
+}
+
+void StatusServer::Accept()
+{
+	while (true)
+	{
+		int Socket{::accept4(ListenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+		if (Socket < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED)
+			{
+				Log.WriteErrorStructured({.ErrorNumber = errno}, AcceptingStatusConnection, std::string_view{}, std::strerror(errno));
+			}
+			return;
+		}
+		epoll_event Event{};
+		Event.events = EPOLLIN | EPOLLRDHUP;
+		Event.data.fd = Socket;
+		if (::epoll_ctl(EpollDescriptor, EPOLL_CTL_ADD, Socket, &Event) != 0)
+		{
+			::close(Socket);
+			continue;
+		}
+		Connections[Socket].LastActivity = std::time(nullptr);
+	}
+}
+
+void StatusServer::Receive(const int Socket)
+{
+	auto Found{Connections.find(Socket)};
+	if (Found == Connections.end())
+	{
+		return;
+	}
+	Connection &Client{Found->second};
+	char Buffer[2048];
+	bool PeerClosed{false};
+	while (true)
+	{
+		ssize_t Received{::recv(Socket, Buffer, sizeof(Buffer), 0)};
+		if (Received > 0)
+		{
+			Client.Request.append(Buffer, static_cast<size_t>(Received));
+			Client.LastActivity = std::time(nullptr);
+			if (Client.Request.size() > MaxRequestBytes)
+			{
+				break;
+			}
+			continue;
+		}
+		if (Received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (Received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			break;
+		}
+		PeerClosed = true; // closed by the client, or failed
+		break;
+	}
+
+	if (Client.Request.size() > MaxRequestBytes)
+	{
+		Client.Response = MakeResponse("431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+	}
+	else if (Client.Request.find("\r\n\r\n") != std::string::npos || Client.Request.find("\n\n") != std::string::npos)
+	{
+		Client.Response = Route(Client.Request);
+	}
+	else
+	{
+		if (PeerClosed)
+		{
+			CloseConnection(Socket);
+		}
+		return; // wait for the rest of the headers
+	}
+	Client.Request.clear();
+	epoll_event Event{};
+	Event.events = EPOLLOUT;
+	Event.data.fd = Socket;
+	::epoll_ctl(EpollDescriptor, EPOLL_CTL_MOD, Socket, &Event);
+	Send(Socket);
+}
+
+void StatusServer::Send(const int Socket)
+{
+	auto Found{Connections.find(Socket)};
+	if (Found == Connections.end())
+	{
+		return;
+	}
+	Connection &Client{Found->second};
+	while (Client.Sent < Client.Response.size())
+	{
+		ssize_t Written{::send(Socket, Client.Response.data() + Client.Sent, Client.Response.size() - Client.Sent, MSG_NOSIGNAL)};
+		if (Written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				return; // wait for EPOLLOUT
+			}
+			break;
+		}
+		Client.Sent += static_cast<size_t>(Written);
+		Client.LastActivity = std::time(nullptr);
+	}
+	CloseConnection(Socket);
+}
+
+void StatusServer::CloseConnection(const int Socket)
+{
+	::epoll_ctl(EpollDescriptor, EPOLL_CTL_DEL, Socket, nullptr);
+	::close(Socket);
+	Connections.erase(Socket);
+}
+
+void StatusServer::CloseIdleConnections()
+{
+	auto Now{std::time(nullptr)};
+	for (auto Entry{Connections.begin()}; Entry != Connections.end();)
+	{
+		int Socket{Entry->first};
+		bool Idle{Now - Entry->second.LastActivity > IdleConnectionSeconds};
+		++Entry;
+		if (Idle)
+		{
+			CloseConnection(Socket);
+		}
+	}
+}
+
+std::string StatusServer::Route(const std::string_view &Request) const
+{
+	auto LineEnd{Request.find_first_of("\r\n")};
+	std::string_view RequestLine{Request.substr(0, LineEnd)};
+	auto MethodEnd{RequestLine.find(' ')};
+	auto PathEnd{RequestLine.find_first_of(" ?", MethodEnd + 1)};
+	if (MethodEnd == std::string_view::npos)
+	{
+		return MakeResponse("400 Bad Request", "text/plain", "Bad request\n");
+	}
+	std::string_view Method{RequestLine.substr(0, MethodEnd)};
+	std::string_view Path{RequestLine.substr(MethodEnd + 1, PathEnd == std::string_view::npos ? std::string_view::npos : PathEnd - MethodEnd - 1)};
+	Log.WriteDebugLazy(StatusRequest, RequestLine);
+	if (Method != "GET")
+	{
+		return MakeResponse("405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+	}
+	if (Path == "/metrics")
+	{
+		return MakeResponse("200 OK", "text/plain; version=0.0.4", RenderMetrics());
+	}
+	if (Path == "/status")
+	{
+		return MakeResponse("200 OK", "application/json", RenderStatus());
+	}
+	return MakeResponse("404 Not Found", "text/plain", "Not found, try /metrics or /status\n");
+}
+
+std::string StatusServer::RenderMetrics() const
+{
+	std::string Body{};
+	Body.reserve(16384);
+	auto &Metrics{MetricsRegistry::Get()};
+	for (size_t Index{0}; Index < static_cast<size_t>(MetricCounters::Count); Index++)
+	{
+		const auto &Description{MetricsRegistry::Describe(static_cast<MetricCounters>(Index))};
+		std::string Name{Description.Name};
+		Name.append("_total");
+		AppendMetricHeader(Body, Name, Description.Help, "counter");
+		Body.append(MetricPrefix).append(Name).append(1, ' ');
+		AppendNumber(Body, Metrics.GetCounter(static_cast<MetricCounters>(Index)));
+		Body.append(1, '\n');
+	}
+	for (size_t Index{0}; Index < static_cast<size_t>(MetricHistograms::Count); Index++)
+	{
+		const auto &Description{MetricsRegistry::Describe(static_cast<MetricHistograms>(Index))};
+		auto Snapshot{Metrics.GetHistogram(static_cast<MetricHistograms>(Index))};
+		std::string Name{Description.Name};
+		Name.append("_seconds");
+		AppendMetricHeader(Body, Name, Description.Help, "summary");
+		for (const auto &[Quantile, Label] : Quantiles)
+		{
+			Body.append(MetricPrefix).append(Name).append("{quantile=\"").append(Label).append("\"} ");
+			AppendSeconds(Body, Snapshot.GetQuantile(Quantile), Description.NanosecondsPerUnit);
+			Body.append(1, '\n');
+		}
+		Body.append(MetricPrefix).append(Name).append("_sum ");
+		AppendSeconds(Body, Snapshot.Sum, Description.NanosecondsPerUnit);
+		Body.append(1, '\n').append(MetricPrefix).append(Name).append("_count ");
+		AppendNumber(Body, Snapshot.Count);
+		Body.append(1, '\n');
+	}
+
+	const auto &LagDescription{MetricsRegistry::Describe(MetricHistograms::DeliveryLagMilliseconds)};
+	AppendMetricHeader(Body, "sink_delivery_lag_seconds", "Time from a record's Nagios timestamp to this sink's destination accepting it", "summary");
+	for (const auto &[SinkName, Snapshot] : Metrics.GetSinkDeliveryLagSnapshots())
+	{
+		for (const auto &[Quantile, Label] : Quantiles)
+		{
+			Body.append(MetricPrefix).append("sink_delivery_lag_seconds{sink=\"").append(SinkName).append("\",quantile=\"").append(Label).append("\"} ");
+			AppendSeconds(Body, Snapshot.GetQuantile(Quantile), LagDescription.NanosecondsPerUnit);
+			Body.append(1, '\n');
+		}
+		Body.append(MetricPrefix).append("sink_delivery_lag_seconds_sum{sink=\"").append(SinkName).append("\"} ");
+		AppendSeconds(Body, Snapshot.Sum, LagDescription.NanosecondsPerUnit);
+		Body.append(1, '\n').append(MetricPrefix).append("sink_delivery_lag_seconds_count{sink=\"").append(SinkName).append("\"} ");
+		AppendNumber(Body, Snapshot.Count);
+		Body.append(1, '\n');
+	}
+
+	auto Sinks{Status.GetSinks()};
+	AppendMetricHeader(Body, "sink_up", "1 if the sink's last delivery succeeded", "gauge");
+	for (const auto &Sink : Sinks)
+	{
+		Body.append(MetricPrefix).append("sink_up{sink=\"").append(Sink.Name).append("\"} ").append(Sink.Health == SinkHealth::Healthy ? "1" : "0").append(1, '\n');
+	}
+	AppendMetricHeader(Body, "sink_pending_records", "Records accepted by the sink but not yet delivered", "gauge");
+	for (const auto &Sink : Sinks)
+	{
+		Body.append(MetricPrefix).append("sink_pending_records{sink=\"").append(Sink.Name).append("\"} ");
+		AppendNumber(Body, Sink.PendingRecords);
+		Body.append(1, '\n');
+	}
+	AppendMetricHeader(Body, "sink_last_success_timestamp_seconds", "Unix time the sink's destination last accepted data, 0 if never", "gauge");
+	for (const auto &Sink : Sinks)
+	{
+		Body.append(MetricPrefix).append("sink_last_success_timestamp_seconds{sink=\"").append(Sink.Name).append("\"} ");
+		AppendNumber(Body, static_cast<uint64_t>(Sink.LastSuccess));
+		Body.append(1, '\n');
+	}
+
+	auto Backlog{ScanSpoolDirectory(Status.GetSpoolDirectory())};
+	auto Now{std::time(nullptr)};
+	AppendMetricHeader(Body, "spool_files", "Files waiting in the Nagios spool directory", "gauge");
+	Body.append(MetricPrefix).append("spool_files ");
+	AppendNumber(Body, Backlog.Files);
+	AppendMetricHeader(Body.append(1, '\n'), "spool_bytes", "Bytes waiting in the Nagios spool directory", "gauge");
+	Body.append(MetricPrefix).append("spool_bytes ");
+	AppendNumber(Body, Backlog.Bytes);
+	AppendMetricHeader(Body.append(1, '\n'), "spool_oldest_file_age_seconds", "Age of the oldest file in the Nagios spool directory", "gauge");
+	Body.append(MetricPrefix).append("spool_oldest_file_age_seconds ");
+	AppendNumber(Body, Backlog.OldestModified > 0 && Now > Backlog.OldestModified ? static_cast<uint64_t>(Now - Backlog.OldestModified) : 0);
+	AppendMetricHeader(Body.append(1, '\n'), "start_time_seconds", "Unix time the daemon started", "gauge");
+	Body.append(MetricPrefix).append("start_time_seconds ");
+	AppendNumber(Body, static_cast<uint64_t>(Status.GetStarted()));
+	Body.append(1, '\n');
+	if constexpr (AllocationStats::Enabled)
+	{
+		AppendAllocationMetrics(Body);
+	}
+	return Body;
+}
+
+std::string StatusServer::RenderStatus() const
+{
+	auto Now{std::time(nullptr)};
+	auto SpoolDirectory{Status.GetSpoolDirectory()};
+	auto Backlog{ScanSpoolDirectory(SpoolDirectory)};
+	std::string Body{"{\"started\":"};
+	AppendNumber(Body, static_cast<uint64_t>(Status.GetStarted()));
+	Body.append(",\"uptime_seconds\":");
+	AppendNumber(Body, static_cast<uint64_t>(Now - Status.GetStarted()));
+	Body.append(",\"spool\":{\"directory\":");
+	AppendJsonString(Body, SpoolDirectory);
+	Body.append(",\"files\":");
+	AppendNumber(Body, Backlog.Files);
+	Body.append(",\"bytes\":");
+	AppendNumber(Body, Backlog.Bytes);
+	Body.append(",\"oldest_file_age_seconds\":");
+	AppendNumber(Body, Backlog.OldestModified > 0 && Now > Backlog.OldestModified ? static_cast<uint64_t>(Now - Backlog.OldestModified) : 0);
+	Body.append("},\"sinks\":[");
+	bool First{true};
+	for (const auto &Sink : Status.GetSinks())
+	{
+		Body.append(First ? "{\"name\":" : ",{\"name\":");
+		First = false;
+		AppendJsonString(Body, Sink.Name);
+		Body.append(",\"health\":\"").append(GetHealthName(Sink.Health)).append("\",\"pending_records\":");
+		AppendNumber(Body, Sink.PendingRecords);
+		Body.append(",\"points_delivered\":");
+		AppendNumber(Body, Sink.PointsDelivered);
+		Body.append(",\"last_success\":");
+		if (Sink.LastSuccess > 0)
+		{
+			AppendNumber(Body, static_cast<uint64_t>(Sink.LastSuccess));
+		}
+		else
+		{
+			Body.append("null");
+		}
+		Body.append(1, '}');
+	}
+	Body.append("]}\n");
+	return Body;
+}
+
+void StatusServer::Run(std::stop_token StopToken)
+{
+	epoll_event Events[MaxEvents];
+	while (!StopToken.stop_requested())
+	{
+		int Ready{::epoll_wait(EpollDescriptor, Events, MaxEvents, PollIntervalMilliseconds)};
+		for (int Index{0}; Index < Ready; Index++)
+		{
+			int Socket{Events[Index].data.fd};
+			if (Socket == WakeDescriptor)
+			{
+				continue; // the stop token is checked on the next pass
+			}
+			if (Socket == ListenSocket)
+			{
+				Accept();
+			}
+			else if (Events[Index].events & (EPOLLERR | EPOLLHUP))
+			{
+				CloseConnection(Socket);
+			}
+			else if (Events[Index].events & EPOLLOUT)
+			{
+				Send(Socket);
+			}
+			else
+			{
+				Receive(Socket);
+			}
+		}
+		CloseIdleConnections();
+	}
+}
+
+// public functions
+StatusServer::StatusServer(ILogWriter &Log, const StatusConfiguration &Settings, const DaemonStatus &Status) : Log{Log}, Settings{Settings}, Status{Status}
+{
+}
+
+StatusServer::~StatusServer()
+{
+	if (ServerThread.joinable())
+	{
+		ServerThread.request_stop();
+		uint64_t Wake{1};
+		[[maybe_unused]] auto Written{::write(WakeDescriptor, &Wake, sizeof(Wake))};
+		ServerThread.join();
+	}
+	for (const auto &[Socket, Client] : Connections)
+	{
+		::close(Socket);
+	}
+	for (int Descriptor : {ListenSocket, EpollDescriptor, WakeDescriptor})
+	{
+		if (Descriptor >= 0)
+		{
+			::close(Descriptor);
+		}
+	}
+	if (ListenSocket >= 0 && !Settings.SocketPath.empty())
+	{
+		::unlink(Settings.SocketPath.c_str());
+	}
+}
+
+bool StatusServer::Start()
+{
+	if (!Listen())
+	{
+		return false;
+	}
+	EpollDescriptor = ::epoll_create1(EPOLL_CLOEXEC);
+	WakeDescriptor = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (EpollDescriptor < 0 || WakeDescriptor < 0)
+	{
+		Log.WriteErrorStructured({.ErrorNumber = errno}, OpeningStatusListener, std::string_view{}, std::strerror(errno));
+		return false;
+	}
+	for (int Descriptor : {ListenSocket, WakeDescriptor})
+	{
+		epoll_event Event{};
+		Event.events = EPOLLIN;
+		Event.data.fd = Descriptor;
+		::epoll_ctl(EpollDescriptor, EPOLL_CTL_ADD, Descriptor, &Event);
+	}
+	ServerThread = std::jthread([this](std::stop_token StopToken)
+										 { Run(StopToken); });
+	return true;
+}
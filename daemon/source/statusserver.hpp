@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+#include "logwriter.hpp"
+#include "sink.hpp"
+
+struct SinkStatus
+{
+	std::string Name{};
+	SinkHealth Health{SinkHealth::Unavailable};
+	size_t PendingRecords{0};
+	std::time_t LastSuccess{0};
+	uint64_t PointsDelivered{0};
+};
+
+/// @brief What the daemon thread knows about its own state, published for the status server's thread
+class DaemonStatus
+{
+private:
+	mutable std::mutex StatusMutex;
+	std::vector<SinkStatus> Sinks{};
+	std::string SpoolDirectory{};
+	const std::time_t Started{std::time(nullptr)};
+
+public:
+	DaemonStatus() = default;
+	DaemonStatus(const DaemonStatus &) = delete;
+	DaemonStatus &operator=(const DaemonStatus &) = delete;
+	DaemonStatus(DaemonStatus &&) = delete;
+	DaemonStatus &operator=(DaemonStatus &&) = delete;
+
+	void SetSpoolDirectory(const std::string &Directory);
+	/// @brief Refreshes health and queue depth, keeping delivery history for sinks that keep their name across reloads
+	void UpdateSinks(const std::vector<std::unique_ptr<ISink>> &CurrentSinks);
+	void RecordAcknowledgement(const SinkAcknowledgement &Acknowledgement);
+
+	std::vector<SinkStatus> GetSinks() const;
+	std::string GetSpoolDirectory() const;
+	std::time_t GetStarted() const { return Started; }
+};
+
+/// @brief Optional HTTP endpoint on localhost or a Unix socket. Serves GET /metrics (Prometheus text format) and GET /status (JSON).
+/// One thread drives every connection through epoll; responses are small and every connection closes after its response.
+class StatusServer
+{
+private:
+	struct Connection
+	{
+		std::string Request{};
+		std::string Response{};
+		size_t Sent{0};
+		std::time_t LastActivity{0};
+	};
+
+	ILogWriter &Log;
+	const StatusConfiguration Settings;
+	const DaemonStatus &Status;
+	int ListenSocket{-1};
+	int EpollDescriptor{-1};
+	int WakeDescriptor{-1};
+	std::map<int, Connection> Connections{}; // only touched by the server thread
+
+	bool Listen();
+	void Accept();
+	void Receive(const int Socket);
+	void Send(const int Socket);
+	void CloseConnection(const int Socket);
+	void CloseIdleConnections();
+	std::string Route(const std::string_view &Request) const;
+	std::string RenderMetrics() const;
+	std::string RenderStatus() const;
+	void Run(std::stop_token StopToken);
+	std::jthread ServerThread{}; // keep last
+
+public:
+	StatusServer(ILogWriter &Log, const StatusConfiguration &Settings, const DaemonStatus &Status);
+	~StatusServer();
+	StatusServer(const StatusServer &) = delete;
+	StatusServer &operator=(const StatusServer &) = delete;
+	StatusServer(StatusServer &&) = delete;
+	StatusServer &operator=(StatusServer &&) = delete;
+
+	/// @brief Binds the listener and starts serving
+	/// @return False if the listener could not be created, which is logged
+	bool Start();
+};
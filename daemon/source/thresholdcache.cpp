@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "logwriter.hpp"
+#include "thresholdcache.hpp"
+
+constexpr const std::time_t SnapshotInterval{300};
+constexpr const int64_t IdleRefreshIntervals{2}; // a series idle this long writes its thresholds on its next point anyway, so it is forgotten
+constexpr const char FieldSeparator{'\t'}; // Nagios splits perfdata lines on tabs, so no key or value can contain one
+
+// log messages
+constexpr const std::string_view LoadedSnapshot{"Loaded threshold snapshot (file, series)"};
+constexpr const std::string_view SavingSnapshot{"Saving threshold snapshot"};
+constexpr const std::string_view MalformedSnapshotLine{"Skipped malformed threshold snapshot line"};
+constexpr const std::string_view EvictedSeries{"Forgot thresholds of idle series (file, series)"};
+
+// helper functions
+static void BuildKey(std::string &Key, const NagiosPerformanceRecord &Record, const NagiosPerformanceData &PerfData)
+{
+	Key.assign(Record.HostName).push_back(FieldSeparator);
+	Key.append(Record.ServiceName).push_back(FieldSeparator);
+	Key.append(PerfData.Label).push_back(FieldSeparator);
+	Key.append(PerfData.Unit); // the unit is a tag, so a label whose unit changes starts a new series
+}
+
+// private functions
+void ThresholdCache::Load()
+{
+	std::ifstream Snapshot{SnapshotPath};
+	if (!Snapshot)
+	{
+		return; // first run, or the snapshot was removed
+	}
+	std::string Line{};
+	while (std::getline(Snapshot, Line))
+	{
+		// host, service, label, unit, warn, crit, min, max, last emitted
+		std::string_view Fields[9]{};
+		size_t FieldCount{0};
+		std::string_view Remaining{Line};
+		while (FieldCount < 9)
+		{
+			auto End{Remaining.find(FieldSeparator)};
+			Fields[FieldCount++] = Remaining.substr(0, End);
+			if (End == std::string_view::npos)
+			{
+				break;
+			}
+			Remaining.remove_prefix(End + 1);
+		}
+		int64_t LastEmitted{0};
+		if (FieldCount != 9 || std::from_chars(Fields[8].data(), Fields[8].data() + Fields[8].size(), LastEmitted).ec != std::errc{})
+		{
+			Log.WriteWarnStructured({.FilePath = SnapshotPath}, MalformedSnapshotLine, SnapshotPath, Line);
+			continue;
+		}
+		std::string Key{Fields[0]};
+		for (size_t Field{1}; Field < 4; Field++)
+		{
+			Key.push_back(FieldSeparator);
+			Key.append(Fields[Field]);
+		}
+		Series.insert_or_assign(std::move(Key), Thresholds{.Warn = std::string{Fields[4]}, .Crit = std::string{Fields[5]}, .Min = std::string{Fields[6]}, .Max = std::string{Fields[7]}, .LastEmitted = LastEmitted});
+		Newest = std::max(Newest, LastEmitted);
+	}
+	Log.WriteInfoLazy(LoadedSnapshot, SnapshotPath, Series.size());
+}
+
+void ThresholdCache::Evict()
+{
+	const int64_t IdleSince{Newest - IdleRefreshIntervals * RefreshInterval};
+	size_t Evicted{std::erase_if(Series, [IdleSince](const auto &Entry)
+										  { return Entry.second.LastEmitted < IdleSince; })};
+	if (Evicted)
+	{
+		Log.WriteDebugLazy(EvictedSeries, SnapshotPath, Evicted);
+		Dirty = true;
+	}
+}
+
+// public functions
+ThresholdCache::ThresholdCache(ILogWriter &Log, const std::string &SnapshotPath, const int64_t RefreshInterval)
+	 : Log{Log}, SnapshotPath{SnapshotPath}, RefreshInterval{RefreshInterval}
+{
+	Load();
+	LastSaved = std::time(nullptr);
+}
+
+bool ThresholdCache::ShouldEmit(const NagiosPerformanceRecord &Record, const NagiosPerformanceData &PerfData, const int64_t Timestamp)
+{
+	BuildKey(KeyBuffer, Record, PerfData);
+	const Thresholds *Known{nullptr};
+	if (auto Pending{Staged.find(KeyBuffer)}; Pending != Staged.end())
+	{
+		Known = &Pending->second; // a later point of a series already emitted in this request
+	}
+	else if (auto Existing{Series.find(KeyBuffer)}; Existing != Series.end())
+	{
+		Known = &Existing->second;
+	}
+	if (Known != nullptr && Known->Warn == PerfData.Warn && Known->Crit == PerfData.Crit && Known->Min == PerfData.Min && Known->Max == PerfData.Max &&
+		 Timestamp - Known->LastEmitted < RefreshInterval)
+	{
+		return false;
+	}
+	Staged.insert_or_assign(KeyBuffer, Thresholds{.Warn = PerfData.Warn, .Crit = PerfData.Crit, .Min = PerfData.Min, .Max = PerfData.Max, .LastEmitted = Timestamp});
+	return true;
+}
+
+void ThresholdCache::Commit()
+{
+	if (Staged.empty())
+	{
+		return;
+	}
+	for (auto &[Key, Emitted] : Staged)
+	{
+		Newest = std::max(Newest, Emitted.LastEmitted);
+		Series.insert_or_assign(Key, std::move(Emitted));
+	}
+	Staged.clear();
+	Dirty = true;
+}
+
+void ThresholdCache::Save()
+{
+	Evict();
+	if (!Dirty)
+	{
+		return;
+	}
+	std::error_code ErrorCode{};
+	std::filesystem::create_directories(std::filesystem::path{SnapshotPath}.parent_path(), ErrorCode);
+
+	// write beside the snapshot and rename over it, so a crash mid-write never leaves a truncated snapshot
+	std::string TemporaryPath{SnapshotPath};
+	TemporaryPath.append(".tmp");
+	FILE *Snapshot{std::fopen(TemporaryPath.c_str(), "w")};
+	if (Snapshot == nullptr)
+	{
+		Log.WriteErrorStructured({.FilePath = TemporaryPath, .ErrorNumber = errno}, SavingSnapshot, TemporaryPath, std::strerror(errno));
+		return;
+	}
+	std::string Line{};
+	for (const auto &[Key, Known] : Series)
+	{
+		Line.assign(Key).push_back(FieldSeparator);
+		Line.append(Known.Warn).push_back(FieldSeparator);
+		Line.append(Known.Crit).push_back(FieldSeparator);
+		Line.append(Known.Min).push_back(FieldSeparator);
+		Line.append(Known.Max).push_back(FieldSeparator);
+		Line.append(std::to_string(Known.LastEmitted)).push_back('\n');
+		std::fputs(Line.c_str(), Snapshot);
+	}
+	bool Failed{std::ferror(Snapshot) != 0};
+	Failed = (std::fclose(Snapshot) != 0) || Failed;
+	if (Failed || std::rename(TemporaryPath.c_str(), SnapshotPath.c_str()) != 0)
+	{
+		Log.WriteErrorStructured({.FilePath = SnapshotPath, .ErrorNumber = errno}, SavingSnapshot, SnapshotPath, std::strerror(errno));
+		std::remove(TemporaryPath.c_str());
+		return;
+	}
+	Log.WriteDebugLazy(SavingSnapshot, SnapshotPath, Series.size());
+	Dirty = false;
+	LastSaved = std::time(nullptr);
+}
+
+void ThresholdCache::SaveIfDue()
+{
+	if (std::time(nullptr) - LastSaved >= SnapshotInterval)
+	{
+		Save();
+		LastSaved = std::time(nullptr); // also paces eviction when nothing changed, or a failed save
+	}
+}
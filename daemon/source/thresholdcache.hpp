@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+
+/// @brief Remembers the last warn, crit, min and max values written for each series so that unchanged values can be left out of points.
+/// Thresholds count as written only once the request carrying them is delivered, see Commit. Persists to a snapshot file so that a
+/// restart does not rewrite every series' thresholds at once, and forgets series that stopped reporting.
+class ThresholdCache
+{
+private:
+	struct Thresholds
+	{
+		std::string Warn{};
+		std::string Crit{};
+		std::string Min{};
+		std::string Max{};
+		int64_t LastEmitted{0}; // record timestamp, so the refresh interval is measured in data time even while catching up on a backlog
+	};
+
+	ILogWriter &Log;
+	const std::string SnapshotPath;
+	const int64_t RefreshInterval;
+	std::unordered_map<std::string, Thresholds> Series{};
+	std::unordered_map<std::string, Thresholds> Staged{}; // emitted into the pending request, not yet delivered
+	std::string KeyBuffer{}; // reused so lookups of known series do not allocate
+	int64_t Newest{0}; // latest committed record timestamp, the clock series age by
+	bool Dirty{false};
+	std::time_t LastSaved{0};
+
+	void Load();
+	void Evict();
+
+public:
+	ThresholdCache(ILogWriter &Log, const std::string &SnapshotPath, const int64_t RefreshInterval);
+	~ThresholdCache() = default;
+	ThresholdCache(const ThresholdCache &) = delete;
+	ThresholdCache &operator=(const ThresholdCache &) = delete;
+	ThresholdCache(ThresholdCache &&) = delete;
+	ThresholdCache &operator=(ThresholdCache &&) = delete;
+
+	/// @brief Decides whether a point needs its thresholds, and stages them to be recorded as written if so
+	/// @param Timestamp Record timestamp in seconds
+	/// @return True if the thresholds changed since they were last written, or the refresh interval has passed
+	bool ShouldEmit(const NagiosPerformanceRecord &Record, const NagiosPerformanceData &PerfData, const int64_t Timestamp);
+
+	/// @brief Records the thresholds staged since the last Commit or Discard as written. Call once their request is delivered.
+	void Commit();
+
+	/// @brief Forgets the staged thresholds, so that a request given up on does not suppress them from later points
+	void Discard() { Staged.clear(); }
+
+	/// @brief Forgets idle series and writes the snapshot file if anything changed
+	void Save();
+
+	/// @brief Writes the snapshot file if anything changed and the last save is older than the snapshot interval
+	void SaveIfDue();
+};
@@ -0,0 +1,188 @@
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <netdb.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "logwriter.hpp"
+#include "metrics.hpp"
+#include "udpclient.hpp"
+
+constexpr const size_t IPv4Overhead{28}; // 20 byte IPv4 header, 8 byte UDP header
+constexpr const size_t IPv6Overhead{48}; // 40 byte IPv6 header, 8 byte UDP header
+constexpr const size_t MinimumPayload{512};
+
+// log messages
+constexpr const std::string_view ResolveHost{"Resolving Influx UDP host"};
+constexpr const std::string_view OpeningSocket{"Opening Influx UDP socket"};
+constexpr const std::string_view SendDatagrams{"Sending Influx UDP datagrams"};
+constexpr const std::string_view LineTooLarge{"Line does not fit in a datagram, dropped"};
+
+// private functions
+bool InfluxUdpClient::OpenSocket()
+{
+	addrinfo Hints{};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_DGRAM;
+	addrinfo *Addresses{nullptr};
+	std::string Port{std::to_string(Settings.Port)};
+	int ResolveResult{::getaddrinfo(Settings.HostName.c_str(), Port.c_str(), &Hints, &Addresses)};
+	if (ResolveResult != 0)
+	{
+		Log.WriteErrorAnnotated(ResolveHost, Settings.HostName, ::gai_strerror(ResolveResult));
+		return false;
+	}
+	for (addrinfo *Address{Addresses}; Address != nullptr; Address = Address->ai_next)
+	{
+		int Candidate{::socket(Address->ai_family, Address->ai_socktype | SOCK_CLOEXEC, Address->ai_protocol)};
+		if (Candidate < 0)
+		{
+			continue;
+		}
+		if (::connect(Candidate, Address->ai_addr, Address->ai_addrlen) == 0) // connected so sendmmsg needs no per-message address
+		{
+			Socket = Candidate;
+			size_t Overhead{Address->ai_family == AF_INET6 ? IPv6Overhead : IPv4Overhead};
+			MaxPayload = Settings.Mtu > Overhead + MinimumPayload ? Settings.Mtu - Overhead : MinimumPayload;
+			break;
+		}
+		::close(Candidate);
+	}
+	::freeaddrinfo(Addresses);
+	if (Socket < 0)
+	{
+		Log.WriteErrorStructured({.ErrorNumber = errno}, OpeningSocket, Settings.HostName, std::strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+std::string &InfluxUdpClient::CurrentDatagram()
+{
+	if (DatagramsInUse == 0)
+	{
+		DatagramsInUse = 1;
+	}
+	if (Datagrams.size() < DatagramsInUse)
+	{
+		Datagrams.emplace_back().reserve(MaxPayload);
+	}
+	return Datagrams[DatagramsInUse - 1];
+}
+
+void InfluxUdpClient::SendBurst()
+{
+	if (DatagramsInUse > 0 && Datagrams[DatagramsInUse - 1].empty())
+	{
+		DatagramsInUse--;
+	}
+	if (DatagramsInUse == 0)
+	{
+		return;
+	}
+
+	std::vector<iovec> Vectors(DatagramsInUse);
+	std::vector<mmsghdr> Messages(DatagramsInUse);
+	for (size_t Index{0}; Index < DatagramsInUse; Index++)
+	{
+		Vectors[Index].iov_base = Datagrams[Index].data();
+		Vectors[Index].iov_len = Datagrams[Index].size();
+		Messages[Index] = mmsghdr{};
+		Messages[Index].msg_hdr.msg_iov = &Vectors[Index];
+		Messages[Index].msg_hdr.msg_iovlen = 1;
+	}
+
+	size_t Sent{0};
+	size_t BytesSent{0};
+	while (Sent < DatagramsInUse)
+	{
+		int Result{::sendmmsg(Socket, Messages.data() + Sent, DatagramsInUse - Sent, 0)};
+		if (Result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			// loss is acceptable on this output, count what was dropped and move on
+			MetricsRegistry::Get().Increment(MetricCounters::UdpSendErrors, DatagramsInUse - Sent);
+			Log.WriteErrorStructured({.ErrorNumber = errno}, SendDatagrams, Settings.HostName, std::strerror(errno));
+			break;
+		}
+		for (int Index{0}; Index < Result; Index++)
+		{
+			BytesSent += Messages[Sent + Index].msg_len;
+		}
+		Sent += Result;
+	}
+	MetricsRegistry::Get().Increment(MetricCounters::UdpDatagramsSent, Sent);
+	MetricsRegistry::Get().Increment(MetricCounters::UdpBytesSent, BytesSent);
+
+	for (size_t Index{0}; Index < DatagramsInUse; Index++)
+	{
+		Datagrams[Index].clear();
+	}
+	DatagramsInUse = 0;
+}
+
+// public functions
+InfluxUdpClient::InfluxUdpClient(ILogWriter &Log, const InfluxUdpConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap)
+	 : BatchingSink{Log, std::numeric_limits<size_t>::max(), 0, false}, // flushed by PendingFull() once a burst of datagrams is filled
+		Settings{Settings}, Translator{Log, Settings.MeasurementName, UnitConversionMap, Settings.Precision}
+{
+	Datagrams.reserve(Settings.Burst);
+	if (Settings.SuppressUnchangedThresholds)
+	{
+		Translator.SuppressUnchangedThresholds(GetThresholdSnapshotPath(GetName()), Settings.ThresholdRefresh);
+	}
+}
+
+InfluxUdpClient::~InfluxUdpClient()
+{
+	if (Socket >= 0)
+	{
+		::close(Socket);
+	}
+}
+
+size_t InfluxUdpClient::AppendRecord(const NagiosPerformanceRecord &NagiosData)
+{
+	size_t Points{0};
+	if (Socket < 0)
+	{
+		return Points;
+	}
+	for (const auto &Line : Translator.TranslateNagiosData(NagiosData))
+	{
+		if (Line.size() + 1 > MaxPayload)
+		{
+			MetricsRegistry::Get().Increment(MetricCounters::UdpOversizedLines);
+			Log.WriteWarnLazy(LineTooLarge, Line.size(), MaxPayload);
+			continue;
+		}
+		if (CurrentDatagram().size() + Line.size() + 1 > MaxPayload)
+		{
+			DatagramsInUse++; // a record is sent whole, so a long one may take a burst past its size
+		}
+		CurrentDatagram().append(Line).push_back('\n');
+		Points++;
+	}
+	return Points;
+}
+
+SendResult InfluxUdpClient::SendPending()
+{
+	SendBurst();
+	Translator.CommitThresholds(); // handed to the kernel is as delivered as UDP gets
+	Translator.SaveThresholdSnapshot();
+	return SendResult::Delivered; // nothing is acknowledged on UDP, so there is nothing to retry
+}
+
+void InfluxUdpClient::Close()
+{
+	BatchingSink::Close();
+	Translator.SaveThresholdSnapshot(true);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.hpp"
+#include "config_constants.hpp"
+#include "influxtranslator.hpp"
+#include "logwriter.hpp"
+#include "nagiosparser.hpp"
+#include "sink.hpp"
+
+/// @brief Fire-and-forget line protocol output to an InfluxDB UDP listener or a Telegraf socket_listener.
+/// Packs as many lines as fit into each datagram and sends datagrams in bursts with sendmmsg.
+class InfluxUdpClient : public BatchingSink
+{
+private:
+	const InfluxUdpConfiguration Settings;
+	InfluxTranslator Translator;
+	int Socket{-1};
+	size_t MaxPayload{0};
+	std::vector<std::string> Datagrams{}; // reused between bursts so their buffers keep their capacity
+	size_t DatagramsInUse{0};
+
+	bool OpenSocket();
+	std::string &CurrentDatagram();
+	void SendBurst();
+
+protected:
+	virtual bool Connect() override { return Socket >= 0 || OpenSocket(); }
+	virtual size_t AppendRecord(const NagiosPerformanceRecord &NagiosData) override;
+	virtual SendResult SendPending() override;
+	virtual void ClearPending() override {}
+	virtual bool PendingFull() const override { return DatagramsInUse > Settings.Burst; } // a full burst and the datagram it spilled into
+
+public:
+	InfluxUdpClient(ILogWriter &Log, const InfluxUdpConfiguration &Settings, std::map<const std::string, const std::string> &UnitConversionMap);
+	virtual ~InfluxUdpClient();
+
+	virtual void Close() override;
+	virtual std::string_view GetName() const override { return ConfigConstants::Headers::influxUdp; }
+};
@@ -193,6 +193,8 @@ const std::string_view Utility::BlockStringProcessor::GetNextBlock()
 		auto [EmptyBlock, StartPosition, EndPosition, BlockProcessedCharCount]{ProcessBlock()};
 		if (EmptyBlock)
 		{
+			ProcessedBlocks++; // still a block, so positional fields such as a missing warn keep their place
+			ProcessedCharacters += BlockProcessedCharCount;
 			return std::string_view{};
 		}
 		if (EndPosition >= Block.size() - 1)
@@ -212,9 +214,10 @@ std::tuple<bool, size_t, size_t, size_t> Utility::DelimitedBlockProcessor::Proce
 	auto Start{GetProcessedCharacters()};
 	size_t BlockProcessedCharCount{1}; // will always process at least 1 character, if for no other reason than to advance the position
 	auto End{FindFirstUnescaped(Block.substr(Start), Delimiter)};
-	if (End == Start)
+	if (End == 0) // a delimiter right at the start, as in the missing warn of "load=1;;5"
 	{
 		Empty = true;
+		End = Start; // consumes only the delimiter
 	}
 	else if (End != std::string::npos)
 	{
@@ -1,14 +1,81 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <getopt.h>
+#include <string>
 #include "applock.hpp"
+#include "config_constants.hpp"
 #include "daemon.hpp"
 
-int main()
+static void PrintUsage(const char *ProgramName)
 {
-	AppLock Lock{};
+	std::fprintf(stderr,
+					 "usage: %s [--config FILE] [--lock-dir DIRECTORY] [--instance NAME] [--once]\n"
+					 "  --config FILE           configuration file (default %s)\n"
+					 "  --lock-dir DIRECTORY    directory for the single-instance lock (default %s)\n"
+					 "  --instance NAME         run as one of several daemons on this host sharing a spool (see shared in [nagios]);\n"
+					 "                          each needs its own NAME of letters, digits, '-' and '_'\n"
+					 "  --once                  drain the spool directory once, print the daemon's metrics as a perfdata line and exit;\n"
+					 "                          the exit status is 1 if anything read could not be delivered\n",
+					 ProgramName, ConfigConstants::ConfigurationFile.data(), ConfigConstants::LockRootPath.data());
+}
+
+static bool IsValidInstanceName(const std::string &Name)
+{
+	return !Name.empty() && std::all_of(Name.begin(), Name.end(), [](const unsigned char Character)
+													{ return std::isalnum(Character) || Character == '-' || Character == '_'; });
+}
+
+int main(int argc, char **argv)
+{
+	std::string ConfigurationFile{ConfigConstants::ConfigurationFile};
+	std::string LockDirectory{ConfigConstants::LockRootPath};
+	std::string Instance{};
+	bool Once{false};
+
+	const option Options[]{
+		 {"config", required_argument, nullptr, 'c'},
+		 {"lock-dir", required_argument, nullptr, 'l'},
+		 {"instance", required_argument, nullptr, 'i'},
+		 {"once", no_argument, nullptr, 'o'},
+		 {"help", no_argument, nullptr, 'h'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'c':
+			ConfigurationFile = optarg;
+			break;
+		case 'l':
+			LockDirectory = optarg;
+			break;
+		case 'i':
+			Instance = optarg;
+			if (!IsValidInstanceName(Instance))
+			{
+				std::fprintf(stderr, "Invalid instance name \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		case 'o':
+			Once = true;
+			break;
+		case 'h':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	AppLock Lock{LockDirectory, Instance};
 	if (Lock())
 	{
-		N2IDaemon Daemon{};
-		Daemon.Run();
-		return 0;
+		N2IDaemon Daemon{ConfigurationFile, Once, Instance};
+		return Daemon.Run() ? 0 : 1;
 	}
 	return 1;
 }
@@ -0,0 +1,249 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <getopt.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+#include "segments.hpp"
+
+constexpr const size_t ReadBufferSize{256 * 1024};
+
+// helper functions
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr,
+					 "usage: %s [options]\n"
+					 "Selects records from the daemon's failed writes by host and time, reading only the segments whose\n"
+					 ".idx file says they may hold some, and writes them to standard output or back into a spool\n"
+					 "directory for the daemon to send again.\n"
+					 "\n"
+					 "  --directory DIRECTORY   the daemon's log directory (default /var/log/xlatnagiosdata)\n"
+					 "  --file NAME             the active failed writes file in it (default failed_writes.log)\n"
+					 "  --host NAME             select this host, repeat for more (default every host)\n"
+					 "  --from TIMET            select records stamped at or after this Unix time (default 0)\n"
+					 "  --to TIMET              select records stamped at or before this Unix time (default no limit)\n"
+					 "  --list                  only list the segments that would be read, from their indexes\n"
+					 "  --spool DIRECTORY       move the selection into this spool directory as one file instead of\n"
+					 "                          writing it to standard output\n"
+					 "  --work-dir DIRECTORY    where that file is written before moving into the spool, on the same\n"
+					 "                          filesystem (default: DIRECTORY.failedwrites, created if missing)\n",
+					 ProgramName);
+}
+
+static bool SelectRecords(const std::string &Path, const Selection &Selected, std::FILE *Output, size_t &Records)
+{
+	// zlib reads a segment that was never compressed as is
+	gzFile SegmentFile{::gzopen(Path.c_str(), "rb")};
+	if (SegmentFile == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	::gzbuffer(SegmentFile, ReadBufferSize);
+	std::string Buffer(ReadBufferSize, '\0');
+	std::string Line{};
+	bool Written{true};
+	int Read{0};
+	while (Written && (Read = ::gzread(SegmentFile, Buffer.data(), static_cast<unsigned int>(Buffer.size()))) > 0)
+	{
+		std::string_view Remaining{Buffer.data(), static_cast<size_t>(Read)};
+		for (size_t LineEnd{Remaining.find('\n')}; Written && LineEnd != std::string_view::npos; LineEnd = Remaining.find('\n'))
+		{
+			Line.append(Remaining.substr(0, LineEnd));
+			Remaining.remove_prefix(LineEnd + 1);
+			if (Selected.Matches(Line))
+			{
+				Written = std::fwrite(Line.data(), 1, Line.size(), Output) == Line.size() && std::fputc('\n', Output) != EOF;
+				Records++;
+			}
+			Line.clear();
+		}
+		Line.append(Remaining);
+	}
+	if (Written && !Line.empty() && Selected.Matches(Line)) // the active segment may end in a partial write
+	{
+		Written = std::fwrite(Line.data(), 1, Line.size(), Output) == Line.size() && std::fputc('\n', Output) != EOF;
+		Records++;
+	}
+	int ErrorNumber{0};
+	const char *ReadError{Read < 0 ? ::gzerror(SegmentFile, &ErrorNumber) : nullptr};
+	::gzclose(SegmentFile);
+	if (ReadError != nullptr)
+	{
+		std::fprintf(stderr, "Failed to read \"%s\": %s\n", Path.c_str(), ErrorNumber == Z_ERRNO ? std::strerror(errno) : ReadError);
+		return false;
+	}
+	if (!Written)
+	{
+		std::fprintf(stderr, "Failed to write the selection: %s\n", std::strerror(errno));
+	}
+	return Written;
+}
+
+int main(int argc, char **argv)
+{
+	std::string Directory{"/var/log/xlatnagiosdata"};
+	std::string FileName{"failed_writes.log"};
+	std::string SpoolDirectory{};
+	std::string WorkDirectory{};
+	Selection Selected{};
+	bool ListOnly{false};
+
+	const option Options[]{
+		 {"directory", required_argument, nullptr, 'd'},
+		 {"file", required_argument, nullptr, 'f'},
+		 {"host", required_argument, nullptr, 'h'},
+		 {"from", required_argument, nullptr, 'F'},
+		 {"to", required_argument, nullptr, 'T'},
+		 {"list", no_argument, nullptr, 'l'},
+		 {"spool", required_argument, nullptr, 'S'},
+		 {"work-dir", required_argument, nullptr, 'W'},
+		 {"help", no_argument, nullptr, 'H'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'd':
+			Directory = optarg;
+			break;
+		case 'f':
+			FileName = optarg;
+			break;
+		case 'h':
+			Selected.Hosts.emplace(optarg);
+			break;
+		case 'F':
+			Selected.From = std::strtoll(optarg, nullptr, 10);
+			break;
+		case 'T':
+			Selected.To = std::strtoll(optarg, nullptr, 10);
+			break;
+		case 'l':
+			ListOnly = true;
+			break;
+		case 'S':
+			SpoolDirectory = optarg;
+			break;
+		case 'W':
+			WorkDirectory = optarg;
+			break;
+		case 'H':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (Directory.empty() || FileName.empty() || Selected.From < 0 || Selected.To < Selected.From)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<Segment> Segments{};
+	if (!ListSegments(Directory, FileName, Segments))
+	{
+		return 1;
+	}
+	size_t Skipped{0};
+	std::vector<const Segment *> Candidates{};
+	for (const auto &Candidate : Segments)
+	{
+		if (Selected.MayContain(Candidate))
+		{
+			Candidates.push_back(&Candidate);
+		}
+		else
+		{
+			Skipped++;
+		}
+	}
+	if (ListOnly)
+	{
+		for (const auto *Candidate : Candidates)
+		{
+			if (Candidate->Indexed)
+			{
+				std::printf("%s\t%lld\t%lld\t%zu\n", Candidate->Path.c_str(), static_cast<long long>(Candidate->FirstTime),
+								static_cast<long long>(Candidate->LastTime), Candidate->Lines);
+			}
+			else
+			{
+				std::printf("%s\tnot indexed\n", Candidate->Path.c_str());
+			}
+		}
+		std::fprintf(stderr, "%zu segments to read, %zu ruled out by their index\n", Candidates.size(), Skipped);
+		return 0;
+	}
+
+	// written outside the spool and renamed in whole, the way Nagios moves its perfdata files
+	std::FILE *Output{stdout};
+	std::string WorkPath{};
+	std::string SpoolName{};
+	if (!SpoolDirectory.empty())
+	{
+		while (SpoolDirectory.size() > 1 && SpoolDirectory.back() == '/')
+		{
+			SpoolDirectory.pop_back();
+		}
+		if (WorkDirectory.empty())
+		{
+			WorkDirectory = SpoolDirectory + ".failedwrites";
+		}
+		std::error_code FSErrorCode{};
+		std::filesystem::create_directories(WorkDirectory, FSErrorCode);
+		if (FSErrorCode)
+		{
+			std::fprintf(stderr, "Failed to create \"%s\": %s\n", WorkDirectory.c_str(), FSErrorCode.message().c_str());
+			return 1;
+		}
+		SpoolName = std::to_string(std::time(nullptr)) + ".perfdata.failedwrites";
+		WorkPath = WorkDirectory + "/" + SpoolName;
+		Output = std::fopen(WorkPath.c_str(), "w");
+		if (Output == nullptr)
+		{
+			std::fprintf(stderr, "Failed to open \"%s\": %s\n", WorkPath.c_str(), std::strerror(errno));
+			return 1;
+		}
+	}
+
+	size_t Records{0};
+	bool Failed{false};
+	for (size_t Index{0}; Index < Candidates.size() && !Failed; Index++)
+	{
+		Failed = !SelectRecords(Candidates[Index]->Path, Selected, Output, Records);
+	}
+	if (Output != stdout)
+	{
+		if (std::fclose(Output) != 0 && !Failed)
+		{
+			std::fprintf(stderr, "Failed to write \"%s\": %s\n", WorkPath.c_str(), std::strerror(errno));
+			Failed = true;
+		}
+		std::string Target{SpoolDirectory + "/" + SpoolName};
+		if (Failed || Records == 0)
+		{
+			std::remove(WorkPath.c_str());
+		}
+		else if (std::rename(WorkPath.c_str(), Target.c_str()) != 0)
+		{
+			std::fprintf(stderr, "Failed to move \"%s\" to \"%s\": %s\n", WorkPath.c_str(), Target.c_str(), std::strerror(errno));
+			std::remove(WorkPath.c_str());
+			Failed = true;
+		}
+	}
+	else if (std::fflush(stdout) != 0)
+	{
+		Failed = true;
+	}
+	std::fprintf(stderr, "selected %zu records from %zu segments, %zu ruled out by their index\n", Records, Candidates.size(), Skipped);
+	return Failed ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "segments.hpp"
+
+// the daemon's file names, see FailedWritesStore
+constexpr const std::string_view IndexExtension{".idx"};
+constexpr const std::string_view CompressedExtension{".gz"};
+
+// helper functions
+static bool ReadIndex(const std::string &IndexPath, const std::string &Directory, Segment &Indexed)
+{
+	std::ifstream Index{IndexPath};
+	std::string Line{};
+	std::string DataName{};
+	while (std::getline(Index, Line))
+	{
+		size_t Separator{Line.find('=')};
+		if (Separator == std::string::npos)
+		{
+			continue;
+		}
+		std::string_view Key{std::string_view{Line}.substr(0, Separator)};
+		std::string_view Value{std::string_view{Line}.substr(Separator + 1)};
+		if (Key == "segment")
+		{
+			DataName = Value;
+		}
+		else if (Key == "first")
+		{
+			std::from_chars(Value.data(), Value.data() + Value.size(), Indexed.FirstTime);
+		}
+		else if (Key == "last")
+		{
+			std::from_chars(Value.data(), Value.data() + Value.size(), Indexed.LastTime);
+		}
+		else if (Key == "lines")
+		{
+			std::from_chars(Value.data(), Value.data() + Value.size(), Indexed.Lines);
+		}
+		else if (Key == "host")
+		{
+			Indexed.Hosts.emplace(Value);
+		}
+	}
+	if (DataName.empty())
+	{
+		return false;
+	}
+	Indexed.Path = Directory + "/" + DataName;
+	Indexed.Indexed = true;
+	return true;
+}
+
+// failed_writes.<start time>[-<sequence>].log[.gz], the sequence counting rotations within the same second
+static std::pair<std::string, long> GetSegmentOrder(const std::string &Path, const std::string &Stem)
+{
+	std::string Name{std::filesystem::path{Path}.filename().string().substr(Stem.size() + 1)};
+	Name.resize(std::min(Name.find('.'), Name.size()));
+	size_t Separator{Name.find('-')};
+	long Sequence{Separator == std::string::npos ? 0 : std::strtol(Name.c_str() + Separator + 1, nullptr, 10)};
+	return {Name.substr(0, Separator), Sequence};
+}
+
+// public functions
+bool Selection::MayContain(const Segment &Candidate) const
+{
+	if (!Candidate.Indexed)
+	{
+		return true;
+	}
+	bool TimeFiltered{From > 0 || To < std::numeric_limits<int64_t>::max()};
+	if (TimeFiltered && (Candidate.FirstTime == 0 || Candidate.LastTime < From || Candidate.FirstTime > To))
+	{
+		return false;
+	}
+	return Hosts.empty() || std::any_of(Hosts.begin(), Hosts.end(), [&Candidate](const std::string &Host)
+													{ return Candidate.Hosts.contains(Host); });
+}
+
+bool Selection::Matches(const std::string_view &Record) const
+{
+	size_t TimeEnd{Record.find('\t')};
+	if (TimeEnd == std::string_view::npos)
+	{
+		return false;
+	}
+	int64_t RecordTime{0};
+	bool Timed{std::from_chars(Record.data(), Record.data() + TimeEnd, RecordTime).ec == std::errc{}};
+	if (Timed ? RecordTime < From || RecordTime > To : From > 0 || To < std::numeric_limits<int64_t>::max())
+	{
+		return false;
+	}
+	size_t HostEnd{Record.find('\t', TimeEnd + 1)};
+	std::string_view Host{Record.substr(TimeEnd + 1, HostEnd == std::string_view::npos ? std::string_view::npos : HostEnd - TimeEnd - 1)};
+	return Hosts.empty() || Hosts.contains(std::string{Host});
+}
+
+bool ListSegments(const std::string &Directory, const std::string &FileName, std::vector<Segment> &Segments)
+{
+	const std::string Stem{std::filesystem::path{FileName}.stem().string()};
+	const std::string Extension{std::filesystem::path{FileName}.extension().string()};
+	std::vector<std::string> DataPaths{};
+	std::error_code FSErrorCode{};
+	for (auto Entry{std::filesystem::directory_iterator(Directory, FSErrorCode)}; !FSErrorCode && Entry != std::filesystem::directory_iterator{}; Entry.increment(FSErrorCode))
+	{
+		std::string Name{Entry->path().filename().string()};
+		if (Name == FileName || !Name.starts_with(Stem + ".") || !Entry->is_regular_file(FSErrorCode))
+		{
+			continue;
+		}
+		Segment Indexed{};
+		if (Name.ends_with(IndexExtension) && ReadIndex(Entry->path().string(), Directory, Indexed))
+		{
+			Segments.push_back(std::move(Indexed));
+		}
+		else if (Name.ends_with(Extension) || Name.ends_with(Extension + std::string{CompressedExtension}))
+		{
+			DataPaths.push_back(Entry->path().string());
+		}
+	}
+	if (FSErrorCode)
+	{
+		std::fprintf(stderr, "Failed to read \"%s\": %s\n", Directory.c_str(), FSErrorCode.message().c_str());
+		return false;
+	}
+
+	// closed segments the daemon has not indexed yet. if it stopped between compressing a segment and removing the plain
+	// copy, only the indexed one of the two is read, or the plain one if neither is indexed
+	auto Listed{[&Segments](const std::string &Path)
+					{ return std::any_of(Segments.begin(), Segments.end(), [&Path](const Segment &Known)
+											  { return Known.Path == Path; }); }};
+	for (const auto &Path : DataPaths)
+	{
+		bool Compressed{Path.ends_with(CompressedExtension)};
+		std::string PlainPath{Compressed ? Path.substr(0, Path.size() - CompressedExtension.size()) : Path};
+		bool Duplicate{Compressed ? Listed(PlainPath) || std::find(DataPaths.begin(), DataPaths.end(), PlainPath) != DataPaths.end()
+										  : Listed(Path + std::string{CompressedExtension})};
+		if (Listed(Path) || Duplicate)
+		{
+			continue;
+		}
+		Segments.push_back(Segment{.Path = Path});
+	}
+	std::sort(Segments.begin(), Segments.end(), [&Stem](const Segment &Left, const Segment &Right)
+				 { return GetSegmentOrder(Left.Path, Stem) < GetSegmentOrder(Right.Path, Stem); });
+
+	std::string ActivePath{Directory + "/" + FileName};
+	if (std::filesystem::is_regular_file(ActivePath, FSErrorCode))
+	{
+		Segments.push_back(Segment{.Path = ActivePath});
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief One segment of the daemon's failed-writes store, with what its .idx file says about it. Segments the daemon has
+/// not indexed yet, and the active failed_writes.log, have no index and are always read.
+struct Segment
+{
+	std::string Path{};
+	bool Indexed{false};
+	int64_t FirstTime{0}; // 0 if no record in the segment starts with a $TIMET$
+	int64_t LastTime{0};
+	size_t Lines{0};
+	std::set<std::string> Hosts{};
+};
+
+/// @brief The records to select. Empty Hosts selects every host.
+struct Selection
+{
+	std::set<std::string> Hosts{};
+	int64_t From{0};
+	int64_t To{std::numeric_limits<int64_t>::max()};
+
+	/// @return False only if the segment's index rules out every record in it
+	bool MayContain(const Segment &Candidate) const;
+	/// @param Record A failed write as the daemon saved it: $TIMET$, host, service and perfdata separated by tabs
+	bool Matches(const std::string_view &Record) const;
+};
+
+/// @brief Lists the segments of FileName (e.g. failed_writes.log) in Directory, oldest first and the active one last
+/// @return False if the directory could not be read, which has been reported
+bool ListSegments(const std::string &Directory, const std::string &FileName, std::vector<Segment> &Segments);
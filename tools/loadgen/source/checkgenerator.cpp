@@ -0,0 +1,137 @@
+#include <array>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "checkgenerator.hpp"
+
+constexpr const std::array<std::string_view, 12> ServiceNames{"CPU Load", "Disk Usage", "PING", "Memory", "HTTP", "Swap", "Network", "Current Users", "SSH", "Total Processes", "NTP Offset", "Interface"};
+constexpr const std::array<std::string_view, 12> PlainLabels{"load1", "load5", "load15", "rta", "pl", "used", "free", "/var", "/home", "time", "size", "offset"};
+constexpr const std::array<std::string_view, 6> EscapedLabels{"disk\\ used", "C:\\ Label", "if\\,eth", "q\\=", "/srv/data\\ ", "total\\ time"};
+
+// private functions
+uint32_t CheckGenerator::NextRandom()
+{
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
+
+bool CheckGenerator::Chance(const double Rate)
+{
+	return Rate > 0 && static_cast<double>(NextRandom() % 1000000) < Rate * 1000000.0;
+}
+
+CheckGenerator::ServiceTemplate CheckGenerator::MakeTemplate(std::string Description)
+{
+	ServiceTemplate Template{std::move(Description), {}};
+	size_t Range{Profile.MaxItems > Profile.MinItems ? Profile.MaxItems - Profile.MinItems + 1 : 1};
+	size_t Items{Profile.MinItems + NextRandom() % Range};
+	for (size_t Item{0}; Item < Items; Item++)
+	{
+		PerfItem &NewItem{Template.Items.emplace_back()};
+		if (Chance(Profile.EscapeRate))
+		{
+			NewItem.Label = EscapedLabels[NextRandom() % EscapedLabels.size()];
+		}
+		else
+		{
+			NewItem.Label = PlainLabels[NextRandom() % PlainLabels.size()];
+		}
+		NewItem.Label.append(std::to_string(Item)); // labels within a check must differ or they collapse into one series
+		NewItem.Unit = Profile.Units.empty() ? std::string{} : Profile.Units[NextRandom() % Profile.Units.size()];
+		NewItem.Thresholds = NextRandom() % 4 != 0;
+	}
+	return Template;
+}
+
+void CheckGenerator::AppendPerfData(std::string &Line, const ServiceTemplate &Template)
+{
+	bool First{true};
+	for (const auto &Item : Template.Items)
+	{
+		if (!First)
+		{
+			Line.push_back(' ');
+		}
+		First = false;
+		Line.append(Item.Label).append(1, '=').append(std::to_string(NextRandom() % 1000));
+		if (NextRandom() % 2 == 0)
+		{
+			Line.append(1, '.').append(std::to_string(NextRandom() % 100));
+		}
+		Line.append(Item.Unit);
+		if (Item.Thresholds)
+		{
+			Line.append(";800;900;0;1000");
+		}
+	}
+}
+
+void CheckGenerator::AppendMalformedLine(std::string &Line, const std::time_t Now)
+{
+	switch (NextRandom() % 4)
+	{
+	case 0: // a timestamp the parser rejects
+		Line.append("not-a-time\t").append(HostNames[0]).append("\tPING\trta=1ms");
+		break;
+	case 1: // cut short before the perfdata
+		Line.append(std::to_string(Now)).append(1, '\t').append(HostNames[0]);
+		break;
+	case 2: // perfdata that parses into nothing usable
+		Line.append(std::to_string(Now)).append(1, '\t').append(HostNames[0]).append("\tPING\t===;;; =;");
+		break;
+	default: // control characters the collector strips
+		Line.append(std::to_string(Now)).append(1, '\t').append(HostNames[0]).append("\tPING\trta=\x01\x02" "1ms;\x7f" "5;10");
+		break;
+	}
+}
+
+// public functions
+CheckGenerator::CheckGenerator(const LoadProfile &Profile) : Profile{Profile}, State{Profile.Seed != 0 ? Profile.Seed : 1}
+{
+	for (size_t Host{0}; Host < Profile.Hosts; Host++)
+	{
+		HostNames.push_back("host-" + std::to_string(Host) + ".example.com");
+	}
+	HostCheck.Description = "check-host-alive";
+	HostCheck.Items = {{"rta", "ms", true}, {"pl", "%", true}};
+	for (size_t Service{0}; Service < Profile.ServicesPerHost; Service++)
+	{
+		std::string Description{ServiceNames[Service % ServiceNames.size()]};
+		if (Service >= ServiceNames.size())
+		{
+			Description.append(1, ' ').append(std::to_string(Service / ServiceNames.size()));
+		}
+		Services.push_back(MakeTemplate(std::move(Description)));
+	}
+}
+
+bool CheckGenerator::AppendNextLine(std::string &Line, const std::time_t Now)
+{
+	size_t ChecksPerHost{1 + Profile.ServicesPerHost};
+	size_t Check{NextCheck};
+	NextCheck = (NextCheck + 1) % GetChecksPerRound();
+	bool IsHostCheck{Check % ChecksPerHost == 0};
+	if (Chance(Profile.MalformedRate))
+	{
+		AppendMalformedLine(Line, Now);
+		return IsHostCheck;
+	}
+	const ServiceTemplate &Template{IsHostCheck ? HostCheck : Services[Check % ChecksPerHost - 1]};
+	Line.append(std::to_string(Now)).append(1, '\t').append(HostNames[Check / ChecksPerHost]).append(1, '\t');
+	Line.append(Template.Description).append(1, '\t');
+	AppendPerfData(Line, Template);
+	return IsHostCheck;
+}
+
+size_t CheckGenerator::GetSeriesCount() const
+{
+	size_t ItemsPerHost{HostCheck.Items.size()};
+	for (const auto &Service : Services)
+	{
+		ItemsPerHost += Service.Items.size();
+	}
+	return Profile.Hosts * ItemsPerHost;
+}
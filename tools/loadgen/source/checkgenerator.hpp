@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/// @brief The shape of the Nagios installation being imitated
+struct LoadProfile
+{
+	size_t Hosts{100};
+	size_t ServicesPerHost{10};
+	size_t MinItems{1}; // perfdata items per check, drawn once per service so every series stays stable
+	size_t MaxItems{6};
+	double EscapeRate{0.05};	  // fraction of labels with escaped spaces, commas or equals signs
+	double MalformedRate{0.0}; // fraction of lines the daemon should reject or partly discard
+	std::vector<std::string> Units{"", "%", "ms", "s", "B", "KB", "MB", "c"};
+	uint32_t Seed{1};
+};
+
+/// @brief Produces perfdata lines in the templates the install target documents:
+/// host checks as $TIMET$\t$HOSTNAME$\t$HOSTCHECKCOMMAND$\t$HOSTPERFDATA$ and
+/// service checks as $TIMET$\t$HOSTNAME$\t$SERVICEDESC$\t$SERVICEPERFDATA$.
+/// Checks come round-robin, each host's host check followed by its services, like a Nagios scheduler with every check on the same interval.
+class CheckGenerator
+{
+private:
+	struct PerfItem
+	{
+		std::string Label;
+		std::string Unit;
+		bool Thresholds;
+	};
+	struct ServiceTemplate
+	{
+		std::string Description;
+		std::vector<PerfItem> Items;
+	};
+
+	const LoadProfile Profile;
+	uint32_t State;
+	size_t NextCheck{0};
+	std::vector<std::string> HostNames{};
+	ServiceTemplate HostCheck{};
+	std::vector<ServiceTemplate> Services{};
+
+	uint32_t NextRandom();
+	bool Chance(const double Rate);
+	ServiceTemplate MakeTemplate(std::string Description);
+	void AppendPerfData(std::string &Line, const ServiceTemplate &Template);
+	void AppendMalformedLine(std::string &Line, const std::time_t Now);
+
+public:
+	explicit CheckGenerator(const LoadProfile &Profile);
+	CheckGenerator(const CheckGenerator &) = delete;
+	CheckGenerator &operator=(const CheckGenerator &) = delete;
+	CheckGenerator(CheckGenerator &&) = delete;
+	CheckGenerator &operator=(CheckGenerator &&) = delete;
+
+	/// @brief Appends the next check's line, without a newline
+	/// @return True for a host check, false for a service check
+	bool AppendNextLine(std::string &Line, const std::time_t Now);
+
+	/// @brief Distinct host, service and label combinations, the number of series a sink will see
+	size_t GetSeriesCount() const;
+	size_t GetChecksPerRound() const { return Profile.Hosts * (1 + Profile.ServicesPerHost); }
+};
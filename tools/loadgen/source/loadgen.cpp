@@ -0,0 +1,241 @@
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <getopt.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "checkgenerator.hpp"
+#include "spoolwriter.hpp"
+
+constexpr const size_t MaxBurst{10000}; // lines written between clock checks when unpaced or catching up
+
+static volatile std::sig_atomic_t StopRequested{0};
+
+// helper functions
+static void RequestStop(int)
+{
+	StopRequested = 1;
+}
+
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr,
+					 "usage: %s --spool DIRECTORY [options]\n"
+					 "Writes synthetic Nagios host and service perfdata files into DIRECTORY while the daemon drains it.\n"
+					 "\n"
+					 "  --spool DIRECTORY       spool directory the daemon reads (required)\n"
+					 "  --work-dir DIRECTORY    where files are written before moving into the spool, on the same\n"
+					 "                          filesystem (default: DIRECTORY.loadgen, created if missing)\n"
+					 "  --hosts N               hosts (default 100)\n"
+					 "  --services N            services per host, in addition to the host check (default 10)\n"
+					 "  --items MIN[-MAX]       perfdata items per service check (default 1-6)\n"
+					 "  --escape-rate FRACTION  labels with escaped spaces, commas or equals signs (default 0.05)\n"
+					 "  --units LIST            comma-separated units to draw from, empty entries allowed\n"
+					 "                          (default \",%%,ms,s,B,KB,MB,c\")\n"
+					 "  --malformed-rate FRACTION  lines the daemon should reject (default 0)\n"
+					 "  --rotate SECONDS        how often files move into the spool, like Nagios'\n"
+					 "                          perfdata_file_processing_interval (default 15)\n"
+					 "  --rate LINES            target lines per second, 0 for as fast as possible (default 1000)\n"
+					 "  --duration SECONDS      stop after this long, 0 to run until interrupted (default 0)\n"
+					 "  --lines N               stop after this many lines, 0 for no limit (default 0)\n"
+					 "  --seed N                random seed, the same seed gives the same hosts, services and labels (default 1)\n",
+					 ProgramName);
+}
+
+static std::vector<std::string> SplitList(const std::string_view &List)
+{
+	std::vector<std::string> Parts{};
+	size_t Start{0};
+	while (true)
+	{
+		size_t End{List.find(',', Start)};
+		Parts.emplace_back(List.substr(Start, End == std::string_view::npos ? std::string_view::npos : End - Start));
+		if (End == std::string_view::npos)
+		{
+			return Parts;
+		}
+		Start = End + 1;
+	}
+}
+
+static size_t CountSpoolFiles(const std::string &SpoolDirectory)
+{
+	std::error_code FSErrorCode{};
+	size_t Files{0};
+	for (auto Entry{std::filesystem::directory_iterator(SpoolDirectory, FSErrorCode)}; !FSErrorCode && Entry != std::filesystem::directory_iterator{}; Entry.increment(FSErrorCode))
+	{
+		Files++;
+	}
+	return Files;
+}
+
+int main(int argc, char **argv)
+{
+	LoadProfile Profile{};
+	std::string SpoolDirectory{};
+	std::string WorkDirectory{};
+	double Rotate{15};
+	double Rate{1000};
+	double Duration{0};
+	unsigned long long LineLimit{0};
+
+	const option Options[]{
+		 {"spool", required_argument, nullptr, 'S'},
+		 {"work-dir", required_argument, nullptr, 'W'},
+		 {"hosts", required_argument, nullptr, 'h'},
+		 {"services", required_argument, nullptr, 's'},
+		 {"items", required_argument, nullptr, 'i'},
+		 {"escape-rate", required_argument, nullptr, 'e'},
+		 {"units", required_argument, nullptr, 'u'},
+		 {"malformed-rate", required_argument, nullptr, 'm'},
+		 {"rotate", required_argument, nullptr, 'r'},
+		 {"rate", required_argument, nullptr, 'R'},
+		 {"duration", required_argument, nullptr, 'd'},
+		 {"lines", required_argument, nullptr, 'l'},
+		 {"seed", required_argument, nullptr, 'x'},
+		 {"help", no_argument, nullptr, 'H'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'S':
+			SpoolDirectory = optarg;
+			break;
+		case 'W':
+			WorkDirectory = optarg;
+			break;
+		case 'h':
+			Profile.Hosts = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 's':
+			Profile.ServicesPerHost = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'i':
+		{
+			char *End{nullptr};
+			Profile.MinItems = std::strtoul(optarg, &End, 10);
+			Profile.MaxItems = *End == '-' ? std::strtoul(End + 1, nullptr, 10) : Profile.MinItems;
+			break;
+		}
+		case 'e':
+			Profile.EscapeRate = std::strtod(optarg, nullptr);
+			break;
+		case 'u':
+			Profile.Units = SplitList(optarg);
+			break;
+		case 'm':
+			Profile.MalformedRate = std::strtod(optarg, nullptr);
+			break;
+		case 'r':
+			Rotate = std::strtod(optarg, nullptr);
+			break;
+		case 'R':
+			Rate = std::strtod(optarg, nullptr);
+			break;
+		case 'd':
+			Duration = std::strtod(optarg, nullptr);
+			break;
+		case 'l':
+			LineLimit = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 'x':
+			Profile.Seed = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 10));
+			break;
+		case 'H':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (SpoolDirectory.empty() || Profile.Hosts == 0 || Profile.MinItems == 0 || Profile.MaxItems < Profile.MinItems || Rotate <= 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	while (SpoolDirectory.size() > 1 && SpoolDirectory.back() == '/')
+	{
+		SpoolDirectory.pop_back();
+	}
+	if (WorkDirectory.empty())
+	{
+		WorkDirectory = SpoolDirectory + ".loadgen";
+	}
+	std::error_code FSErrorCode{};
+	std::filesystem::create_directories(SpoolDirectory, FSErrorCode);
+	std::filesystem::create_directories(WorkDirectory, FSErrorCode);
+	if (FSErrorCode)
+	{
+		std::fprintf(stderr, "Failed to create \"%s\": %s\n", WorkDirectory.c_str(), FSErrorCode.message().c_str());
+		return 1;
+	}
+
+	std::signal(SIGINT, RequestStop);
+	std::signal(SIGTERM, RequestStop);
+
+	CheckGenerator Generator{Profile};
+	SpoolWriter Writer{SpoolDirectory, WorkDirectory};
+	std::fprintf(stderr, "%zu hosts, %zu checks per round, %zu series, target %.0f lines/s, rotating every %.1f s into %s\n",
+					 Profile.Hosts, Generator.GetChecksPerRound(), Generator.GetSeriesCount(), Rate, Rotate, SpoolDirectory.c_str());
+
+	using Clock = std::chrono::steady_clock;
+	const auto Started{Clock::now()};
+	auto NextRotation{Started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Rotate))};
+	auto NextReport{Started + std::chrono::seconds(1)};
+	unsigned long long LinesWritten{0};
+	unsigned long long LinesAtLastReport{0};
+	std::string Line{};
+	bool Failed{false};
+	while (!StopRequested && !Failed)
+	{
+		auto Now{Clock::now()};
+		double Elapsed{std::chrono::duration<double>(Now - Started).count()};
+		if ((Duration > 0 && Elapsed >= Duration) || (LineLimit > 0 && LinesWritten >= LineLimit))
+		{
+			break;
+		}
+		unsigned long long Due{Rate > 0 ? static_cast<unsigned long long>(Rate * Elapsed) : LinesWritten + MaxBurst};
+		if (LineLimit > 0 && Due > LineLimit)
+		{
+			Due = LineLimit;
+		}
+		std::time_t Timestamp{std::time(nullptr)};
+		for (size_t Burst{0}; LinesWritten < Due && Burst < MaxBurst && !Failed; Burst++)
+		{
+			Line.clear();
+			bool HostCheck{Generator.AppendNextLine(Line, Timestamp)};
+			Failed = !Writer.Write(HostCheck, Line);
+			LinesWritten++;
+		}
+		if (Now >= NextRotation)
+		{
+			Failed = !Writer.Rotate(Timestamp) || Failed;
+			NextRotation += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Rotate));
+		}
+		if (Now >= NextReport)
+		{
+			std::fprintf(stderr, "%8.1f s  %12llu lines  %8llu lines/s  %8llu files delivered  %6zu files waiting in spool\n",
+							 Elapsed, LinesWritten, LinesWritten - LinesAtLastReport, static_cast<unsigned long long>(Writer.GetFilesDelivered()), CountSpoolFiles(SpoolDirectory));
+			LinesAtLastReport = LinesWritten;
+			NextReport += std::chrono::seconds(1);
+		}
+		if (Rate > 0 && LinesWritten >= Due)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	Failed = !Writer.Rotate(std::time(nullptr)) || Failed;
+	double Elapsed{std::chrono::duration<double>(Clock::now() - Started).count()};
+	std::fprintf(stderr, "wrote %llu lines (%llu bytes) in %.1f s, %.0f lines/s, %llu files\n", LinesWritten, static_cast<unsigned long long>(Writer.GetBytesWritten()),
+					 Elapsed, Elapsed > 0 ? static_cast<double>(LinesWritten) / Elapsed : 0, static_cast<unsigned long long>(Writer.GetFilesDelivered()));
+	return Failed ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "spoolwriter.hpp"
+
+// private functions
+bool SpoolWriter::Deliver(WorkingFile &Working, const std::time_t Now)
+{
+	if (Working.File == nullptr)
+	{
+		return true;
+	}
+	bool Delivered{std::fclose(Working.File) == 0};
+	Working.File = nullptr;
+	if (!Delivered)
+	{
+		std::fprintf(stderr, "Failed to write \"%s\": %s\n", Working.Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::string Target{SpoolDirectory + "/" + std::to_string(Now) + std::string{Working.Suffix}};
+	for (int Collision{1}; ::access(Target.c_str(), F_OK) == 0; Collision++) // rotating more than once a second
+	{
+		Target = SpoolDirectory + "/" + std::to_string(Now) + "-" + std::to_string(Collision) + std::string{Working.Suffix};
+	}
+	if (std::rename(Working.Path.c_str(), Target.c_str()) != 0)
+	{
+		std::fprintf(stderr, "Failed to move \"%s\" to \"%s\": %s\n", Working.Path.c_str(), Target.c_str(), std::strerror(errno));
+		return false;
+	}
+	Working.Lines = 0;
+	FilesDelivered++;
+	return true;
+}
+
+// public functions
+SpoolWriter::SpoolWriter(const std::string &SpoolDirectory, const std::string &WorkDirectory) : SpoolDirectory{SpoolDirectory}
+{
+	HostFile.Path = WorkDirectory + "/host-perfdata";
+	HostFile.Suffix = ".perfdata.host";
+	ServiceFile.Path = WorkDirectory + "/service-perfdata";
+	ServiceFile.Suffix = ".perfdata.service";
+}
+
+SpoolWriter::~SpoolWriter()
+{
+	for (auto *Working : {&HostFile, &ServiceFile})
+	{
+		if (Working->File != nullptr)
+		{
+			std::fclose(Working->File);
+		}
+	}
+}
+
+bool SpoolWriter::Write(const bool HostCheck, const std::string_view &Line)
+{
+	WorkingFile &Working{HostCheck ? HostFile : ServiceFile};
+	if (Working.File == nullptr)
+	{
+		Working.File = std::fopen(Working.Path.c_str(), "a");
+		if (Working.File == nullptr)
+		{
+			std::fprintf(stderr, "Failed to open \"%s\": %s\n", Working.Path.c_str(), std::strerror(errno));
+			return false;
+		}
+	}
+	if (std::fwrite(Line.data(), 1, Line.size(), Working.File) != Line.size() || std::fputc('\n', Working.File) == EOF)
+	{
+		std::fprintf(stderr, "Failed to write \"%s\": %s\n", Working.Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	Working.Lines++;
+	BytesWritten += Line.size() + 1;
+	return true;
+}
+
+bool SpoolWriter::Rotate(const std::time_t Now)
+{
+	bool HostDelivered{Deliver(HostFile, Now)};
+	return Deliver(ServiceFile, Now) && HostDelivered;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+/// @brief Writes host and service perfdata the way Nagios does: append to a working file outside the spool directory,
+/// then move it in whole at each rotation, named $TIMET$.perfdata.host or $TIMET$.perfdata.service
+class SpoolWriter
+{
+private:
+	struct WorkingFile
+	{
+		std::string Path{};
+		std::string_view Suffix{};
+		std::FILE *File{nullptr};
+		size_t Lines{0};
+	};
+
+	const std::string SpoolDirectory;
+	WorkingFile HostFile{};
+	WorkingFile ServiceFile{};
+	uint64_t FilesDelivered{0};
+	uint64_t BytesWritten{0};
+
+	bool Deliver(WorkingFile &Working, const std::time_t Now);
+
+public:
+	/// @param WorkDirectory Holds the files being written. Must be on the same filesystem as SpoolDirectory so the move is a rename.
+	SpoolWriter(const std::string &SpoolDirectory, const std::string &WorkDirectory);
+	~SpoolWriter();
+	SpoolWriter(const SpoolWriter &) = delete;
+	SpoolWriter &operator=(const SpoolWriter &) = delete;
+	SpoolWriter(SpoolWriter &&) = delete;
+	SpoolWriter &operator=(SpoolWriter &&) = delete;
+
+	/// @return False if the line could not be written, which has been reported
+	bool Write(const bool HostCheck, const std::string_view &Line);
+
+	/// @brief Moves every non-empty working file into the spool directory
+	/// @return False if a file could not be moved, which has been reported
+	bool Rotate(const std::time_t Now);
+
+	uint64_t GetFilesDelivered() const { return FilesDelivered; }
+	uint64_t GetBytesWritten() const { return BytesWritten; }
+};
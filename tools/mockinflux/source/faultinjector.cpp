@@ -0,0 +1,62 @@
+#include <chrono>
+#include <mutex>
+#include <random>
+#include "faultinjector.hpp"
+
+// private functions
+double FaultInjector::NextUniform()
+{
+	std::scoped_lock Lock{RandomLock};
+	return std::uniform_real_distribution<double>{0.0, 1.0}(Random);
+}
+
+// public functions
+FaultInjector::FaultInjector(const FaultProfile &Profile) : Profile{Profile}, Random{Profile.Seed}
+{
+}
+
+std::chrono::milliseconds FaultInjector::NextLatency()
+{
+	if (Profile.MaxLatency <= Profile.MinLatency)
+	{
+		return Profile.MinLatency;
+	}
+	std::scoped_lock Lock{RandomLock};
+	return std::chrono::milliseconds{std::uniform_int_distribution<std::chrono::milliseconds::rep>{Profile.MinLatency.count(), Profile.MaxLatency.count()}(Random)};
+}
+
+Fault FaultInjector::NextWriteFault()
+{
+	if (Outage)
+	{
+		return Fault::ServerError;
+	}
+	double Draw{NextUniform()};
+	if ((Draw -= Profile.ResetRate) < 0)
+	{
+		return Fault::Reset;
+	}
+	if ((Draw -= Profile.ThrottleRate) < 0)
+	{
+		return Fault::Throttle;
+	}
+	if ((Draw -= Profile.ErrorRate) < 0)
+	{
+		return Fault::ServerError;
+	}
+	if ((Draw -= Profile.PartialRate) < 0)
+	{
+		return Fault::PartialWrite;
+	}
+	return Fault::None;
+}
+
+size_t FaultInjector::PickLine(const size_t Lines)
+{
+	if (Lines < 2)
+	{
+		return 0;
+	}
+	std::scoped_lock Lock{RandomLock};
+	return std::uniform_int_distribution<size_t>{0, Lines - 1}(Random);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+/// @brief How often and how badly the mock misbehaves. Rates are fractions of write requests; a request gets at most one fault.
+struct FaultProfile
+{
+	std::chrono::milliseconds MinLatency{0}; // added to every response, drawn uniformly between the two
+	std::chrono::milliseconds MaxLatency{0};
+	double ResetRate{0.0};		 // connection reset after the request is read, nothing written
+	double ThrottleRate{0.0};	 // 429 with Retry-After, nothing written
+	double ErrorRate{0.0};		 // ErrorStatus, nothing written
+	double PartialRate{0.0};	 // 400 partial write, one line dropped and the rest written
+	int ErrorStatus{500};
+	unsigned RetryAfter{1}; // seconds
+	uint32_t Seed{1};
+};
+
+enum class Fault
+{
+	None,
+	Reset,
+	Throttle,
+	ServerError,
+	PartialWrite
+};
+
+/// @brief Draws latency and faults for each request. Safe to share between connection threads.
+class FaultInjector
+{
+private:
+	const FaultProfile Profile;
+	std::mutex RandomLock{};
+	std::mt19937 Random;
+	std::atomic<bool> Outage{false};
+
+	double NextUniform();
+
+public:
+	explicit FaultInjector(const FaultProfile &Profile);
+	FaultInjector(const FaultInjector &) = delete;
+	FaultInjector &operator=(const FaultInjector &) = delete;
+	FaultInjector(FaultInjector &&) = delete;
+	FaultInjector &operator=(FaultInjector &&) = delete;
+
+	std::chrono::milliseconds NextLatency();
+
+	/// @brief Picks the fault for one write request. During an outage every write gets ErrorStatus.
+	Fault NextWriteFault();
+
+	/// @return A line index in [0, Lines) for a partial write to drop
+	size_t PickLine(const size_t Lines);
+
+	/// @brief Starts or ends a simulated outage, so retry and recovery can be watched on demand. Call from one thread only.
+	/// @return True if an outage started
+	bool ToggleOutage()
+	{
+		bool Started{!Outage};
+		Outage = Started;
+		return Started;
+	}
+
+	const FaultProfile &GetProfile() const { return Profile; }
+};
@@ -0,0 +1,250 @@
+#include <string>
+#include <string_view>
+#include "lineprotocol.hpp"
+
+// rejection reasons, worded after InfluxDB's own
+constexpr const char *MissingMeasurement{"missing measurement"};
+constexpr const char *MissingTagKey{"missing tag key"};
+constexpr const char *MissingTagValue{"missing tag value"};
+constexpr const char *MissingFields{"missing fields"};
+constexpr const char *MissingFieldKey{"missing field key"};
+constexpr const char *MissingFieldValue{"missing field value"};
+constexpr const char *UnterminatedString{"unbalanced quotes"};
+constexpr const char *InvalidBoolean{"invalid boolean"};
+constexpr const char *InvalidInteger{"invalid integer"};
+constexpr const char *InvalidUnsigned{"invalid unsigned integer"};
+constexpr const char *InvalidNumber{"invalid number"};
+constexpr const char *InvalidTimestamp{"bad timestamp"};
+constexpr const char *TrailingBackslash{"trailing backslash"};
+
+// helper functions
+static bool IsDigit(const char Character)
+{
+	return Character >= '0' && Character <= '9';
+}
+
+static bool IsSpace(const char Character)
+{
+	return Character == ' ' || Character == '\t';
+}
+
+// advances Position to the first unescaped character in Terminators, or the end of the line
+static bool ScanEscaped(const std::string_view &Line, size_t &Position, const std::string_view &Terminators)
+{
+	while (Position < Line.size() && Terminators.find(Line[Position]) == std::string_view::npos)
+	{
+		if (Line[Position] == '\\')
+		{
+			if (++Position == Line.size())
+			{
+				return false;
+			}
+		}
+		Position++;
+	}
+	return true;
+}
+
+static size_t SkipDigits(const std::string_view &Value, size_t Position)
+{
+	while (Position < Value.size() && IsDigit(Value[Position]))
+	{
+		Position++;
+	}
+	return Position;
+}
+
+static bool IsFloat(const std::string_view &Value)
+{
+	size_t Position{0};
+	if (Position < Value.size() && (Value[Position] == '-' || Value[Position] == '+'))
+	{
+		Position++;
+	}
+	size_t IntegerEnd{SkipDigits(Value, Position)};
+	bool Digits{IntegerEnd > Position};
+	Position = IntegerEnd;
+	if (Position < Value.size() && Value[Position] == '.')
+	{
+		size_t FractionEnd{SkipDigits(Value, Position + 1)};
+		Digits = Digits || FractionEnd > Position + 1;
+		Position = FractionEnd;
+	}
+	if (!Digits)
+	{
+		return false;
+	}
+	if (Position < Value.size() && (Value[Position] == 'e' || Value[Position] == 'E'))
+	{
+		Position++;
+		if (Position < Value.size() && (Value[Position] == '-' || Value[Position] == '+'))
+		{
+			Position++;
+		}
+		size_t ExponentEnd{SkipDigits(Value, Position)};
+		if (ExponentEnd == Position)
+		{
+			return false;
+		}
+		Position = ExponentEnd;
+	}
+	return Position == Value.size();
+}
+
+static bool IsInteger(const std::string_view &Value, const bool AllowSign)
+{
+	size_t Position{AllowSign && !Value.empty() && Value[0] == '-' ? 1u : 0u};
+	return Position < Value.size() && SkipDigits(Value, Position) == Value.size();
+}
+
+static const char *CheckFieldValue(const std::string_view &Value)
+{
+	if (Value.empty())
+	{
+		return MissingFieldValue;
+	}
+	if (Value == "t" || Value == "T" || Value == "true" || Value == "True" || Value == "TRUE" ||
+		 Value == "f" || Value == "F" || Value == "false" || Value == "False" || Value == "FALSE")
+	{
+		return nullptr;
+	}
+	switch (Value.back())
+	{
+	case 'i':
+		return IsInteger(Value.substr(0, Value.size() - 1), true) ? nullptr : InvalidInteger;
+	case 'u':
+		return IsInteger(Value.substr(0, Value.size() - 1), false) ? nullptr : InvalidUnsigned;
+	default:
+		if (!IsDigit(Value.back()) && Value.back() != '.')
+		{
+			return IsDigit(Value.front()) || Value.front() == '-' ? InvalidNumber : InvalidBoolean;
+		}
+		return IsFloat(Value) ? nullptr : InvalidNumber;
+	}
+}
+
+// public functions
+const char *CheckLineProtocolLine(const std::string_view &Line)
+{
+	size_t Position{0};
+	if (!ScanEscaped(Line, Position, ", "))
+	{
+		return TrailingBackslash;
+	}
+	if (Position == 0)
+	{
+		return MissingMeasurement;
+	}
+
+	while (Position < Line.size() && Line[Position] == ',')
+	{
+		size_t KeyStart{++Position};
+		if (!ScanEscaped(Line, Position, "=, "))
+		{
+			return TrailingBackslash;
+		}
+		if (Position == KeyStart || Position == Line.size() || Line[Position] != '=')
+		{
+			return MissingTagKey;
+		}
+		size_t ValueStart{++Position};
+		if (!ScanEscaped(Line, Position, "=, "))
+		{
+			return TrailingBackslash;
+		}
+		if (Position == ValueStart || (Position < Line.size() && Line[Position] == '='))
+		{
+			return MissingTagValue;
+		}
+	}
+
+	while (Position < Line.size() && IsSpace(Line[Position]))
+	{
+		Position++;
+	}
+	if (Position == Line.size())
+	{
+		return MissingFields;
+	}
+
+	while (true)
+	{
+		size_t KeyStart{Position};
+		if (!ScanEscaped(Line, Position, "=, "))
+		{
+			return TrailingBackslash;
+		}
+		if (Position == KeyStart || Position == Line.size() || Line[Position] != '=')
+		{
+			return MissingFieldKey;
+		}
+		size_t ValueStart{++Position};
+		if (Position < Line.size() && Line[Position] == '"')
+		{
+			Position++;
+			if (!ScanEscaped(Line, Position, "\"") || Position == Line.size())
+			{
+				return UnterminatedString;
+			}
+			Position++;
+			if (Position < Line.size() && Line[Position] != ',' && !IsSpace(Line[Position]))
+			{
+				return InvalidNumber;
+			}
+		}
+		else
+		{
+			while (Position < Line.size() && Line[Position] != ',' && !IsSpace(Line[Position]))
+			{
+				Position++;
+			}
+			if (const char *Error{CheckFieldValue(Line.substr(ValueStart, Position - ValueStart))}; Error != nullptr)
+			{
+				return Error;
+			}
+		}
+		if (Position == Line.size() || Line[Position] != ',')
+		{
+			break;
+		}
+		Position++;
+	}
+
+	while (Position < Line.size() && IsSpace(Line[Position]))
+	{
+		Position++;
+	}
+	size_t TimestampStart{Position};
+	while (Position < Line.size() && !IsSpace(Line[Position]))
+	{
+		Position++;
+	}
+	std::string_view Timestamp{Line.substr(TimestampStart, Position - TimestampStart)};
+	if (!Timestamp.empty() && !IsInteger(Timestamp, true))
+	{
+		return InvalidTimestamp;
+	}
+	while (Position < Line.size() && IsSpace(Line[Position]))
+	{
+		Position++;
+	}
+	return Position == Line.size() ? nullptr : InvalidTimestamp;
+}
+
+LineProtocolSummary CheckLineProtocol(const std::string_view &Body)
+{
+	LineProtocolSummary Summary{};
+	ForEachLineProtocolLine(Body, [&Summary](const std::string_view &Line)
+									{
+		const char *Error{CheckLineProtocolLine(Line)};
+		if (Error == nullptr)
+		{
+			Summary.Points++;
+			return;
+		}
+		if (Summary.Rejected++ == 0)
+		{
+			Summary.FirstError.append("unable to parse '").append(Line.substr(0, 256)).append("': ").append(Error);
+		} });
+	return Summary;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/// @brief What a write body amounted to, as InfluxDB would count it
+struct LineProtocolSummary
+{
+	size_t Points{0};	  // lines that parsed
+	size_t Rejected{0}; // lines that did not
+	std::string FirstError{};
+};
+
+/// @brief Checks one line of InfluxDB line protocol: measurement[,tag=value...] field=value[,field=value...] [timestamp]
+/// @return nullptr if the line is valid, otherwise the reason it is not
+const char *CheckLineProtocolLine(const std::string_view &Line);
+
+/// @brief Checks every line of a write body. Blank lines and # comments are skipped, as InfluxDB does.
+LineProtocolSummary CheckLineProtocol(const std::string_view &Body);
+
+/// @brief Calls Visit(Line) for every line CheckLineProtocol would count or reject
+template <typename Visitor>
+void ForEachLineProtocolLine(const std::string_view &Body, Visitor &&Visit)
+{
+	size_t Start{0};
+	while (Start < Body.size())
+	{
+		size_t End{Body.find('\n', Start)};
+		if (End == std::string_view::npos)
+		{
+			End = Body.size();
+		}
+		std::string_view Line{Body.substr(Start, End - Start)};
+		Start = End + 1;
+		if (!Line.empty() && Line.back() == '\r')
+		{
+			Line.remove_suffix(1);
+		}
+		size_t First{Line.find_first_not_of(" \t")};
+		if (First == std::string_view::npos || Line[First] == '#')
+		{
+			continue;
+		}
+		Visit(Line.substr(First));
+	}
+}
@@ -0,0 +1,257 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <string>
+#include <string_view>
+#include "faultinjector.hpp"
+#include "mockserver.hpp"
+
+constexpr const int AcceptTimeoutMilliseconds{100};
+
+static volatile std::sig_atomic_t StopRequested{0};
+static volatile std::sig_atomic_t OutageToggles{0};
+
+// helper functions
+static void RequestStop(int)
+{
+	StopRequested = 1;
+}
+
+static void RequestOutageToggle(int)
+{
+	OutageToggles = OutageToggles + 1;
+}
+
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr,
+					 "usage: %s [options]\n"
+					 "Serves enough of the InfluxDB 1.x and 2.x HTTP APIs for xlatnagiosdatad to write to, counting points instead of storing them.\n"
+					 "SIGUSR1 starts or ends an outage in which every write gets the --error-status response.\n"
+					 "\n"
+					 "  --host ADDRESS           address to listen on (default 127.0.0.1)\n"
+					 "  --port PORT              port to listen on (default 8086)\n"
+					 "  --database NAME          1.x database that exists at start, repeatable\n"
+					 "  --bucket NAME            2.x bucket that exists at start, repeatable\n"
+					 "  --org NAME               2.x organization requests must name (default: any)\n"
+					 "  --auto-create            writes to a missing database or bucket create it instead of getting 404\n"
+					 "  --token TOKEN            require \"Authorization: Token TOKEN\" on everything but /ping and /health\n"
+					 "  --latency MIN[-MAX]      milliseconds added to every response (default 0)\n"
+					 "  --reset-rate FRACTION    writes answered by resetting the connection (default 0)\n"
+					 "  --throttle-rate FRACTION writes answered with 429 and Retry-After (default 0)\n"
+					 "  --retry-after SECONDS    Retry-After sent with a 429 (default 1)\n"
+					 "  --error-rate FRACTION    writes answered with --error-status (default 0)\n"
+					 "  --error-status CODE      status for injected errors and outages (default 500)\n"
+					 "  --partial-rate FRACTION  writes answered with a 400 partial write, one point dropped (default 0)\n"
+					 "  --seed N                 random seed for latency and faults (default 1)\n"
+					 "  --max-body BYTES         largest write body accepted, before or after gzip (default 67108864)\n"
+					 "  --report SECONDS         how often to print throughput, 0 for never (default 1)\n"
+					 "  --summary FILE           write the final totals to FILE as JSON on exit\n"
+					 "  --duration SECONDS       stop after this long, 0 to run until interrupted (default 0)\n"
+					 "  --verbose                print every request\n",
+					 ProgramName);
+}
+
+static void PrintReport(const double Elapsed, const MockTotals &Totals, const MockTotals &Previous, const double Interval)
+{
+	std::fprintf(stderr, "%8.1f s  %8.0f req/s  %10.0f points/s  %8.2f MB/s  %12llu points  %6llu rejected  %4llu resets  %4llu 429  %4llu 5xx  %4llu partial  %4llu other 4xx\n",
+					 Elapsed, static_cast<double>(Totals.Requests - Previous.Requests) / Interval, static_cast<double>(Totals.Points - Previous.Points) / Interval,
+					 static_cast<double>(Totals.BodyBytes - Previous.BodyBytes) / Interval / 1e6, static_cast<unsigned long long>(Totals.Points),
+					 static_cast<unsigned long long>(Totals.RejectedPoints), static_cast<unsigned long long>(Totals.Resets), static_cast<unsigned long long>(Totals.Throttled),
+					 static_cast<unsigned long long>(Totals.ServerErrors), static_cast<unsigned long long>(Totals.PartialWrites), static_cast<unsigned long long>(Totals.BadRequests));
+}
+
+static bool WriteSummary(const std::string &Path, const double Elapsed, const MockTotals &Totals)
+{
+	std::FILE *Summary{std::fopen(Path.c_str(), "w")};
+	if (Summary == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::fprintf(Summary,
+					 "{\"elapsed_seconds\":%.3f,\"connections\":%llu,\"requests\":%llu,\"writes\":%llu,\"points\":%llu,\"rejected_points\":%llu,"
+					 "\"body_bytes\":%llu,\"resets\":%llu,\"throttled\":%llu,\"server_errors\":%llu,\"partial_writes\":%llu,\"bad_requests\":%llu}\n",
+					 Elapsed, static_cast<unsigned long long>(Totals.Connections), static_cast<unsigned long long>(Totals.Requests), static_cast<unsigned long long>(Totals.Writes),
+					 static_cast<unsigned long long>(Totals.Points), static_cast<unsigned long long>(Totals.RejectedPoints), static_cast<unsigned long long>(Totals.BodyBytes),
+					 static_cast<unsigned long long>(Totals.Resets), static_cast<unsigned long long>(Totals.Throttled), static_cast<unsigned long long>(Totals.ServerErrors),
+					 static_cast<unsigned long long>(Totals.PartialWrites), static_cast<unsigned long long>(Totals.BadRequests));
+	if (std::fclose(Summary) != 0)
+	{
+		std::fprintf(stderr, "Failed to write \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	MockSettings Settings{};
+	FaultProfile Profile{};
+	double Report{1};
+	double Duration{0};
+	std::string SummaryPath{};
+
+	const option Options[]{
+		 {"host", required_argument, nullptr, 'a'},
+		 {"port", required_argument, nullptr, 'p'},
+		 {"database", required_argument, nullptr, 'D'},
+		 {"bucket", required_argument, nullptr, 'B'},
+		 {"org", required_argument, nullptr, 'o'},
+		 {"auto-create", no_argument, nullptr, 'A'},
+		 {"token", required_argument, nullptr, 't'},
+		 {"latency", required_argument, nullptr, 'l'},
+		 {"reset-rate", required_argument, nullptr, 'c'},
+		 {"throttle-rate", required_argument, nullptr, 'T'},
+		 {"retry-after", required_argument, nullptr, 'y'},
+		 {"error-rate", required_argument, nullptr, 'e'},
+		 {"error-status", required_argument, nullptr, 'E'},
+		 {"partial-rate", required_argument, nullptr, 'P'},
+		 {"seed", required_argument, nullptr, 'x'},
+		 {"max-body", required_argument, nullptr, 'm'},
+		 {"report", required_argument, nullptr, 'r'},
+		 {"summary", required_argument, nullptr, 's'},
+		 {"duration", required_argument, nullptr, 'd'},
+		 {"verbose", no_argument, nullptr, 'v'},
+		 {"help", no_argument, nullptr, 'H'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'a':
+			Settings.Host = optarg;
+			break;
+		case 'p':
+			Settings.Port = optarg;
+			break;
+		case 'D':
+			Settings.Databases.emplace_back(optarg);
+			break;
+		case 'B':
+			Settings.Buckets.emplace_back(optarg);
+			break;
+		case 'o':
+			Settings.Organization = optarg;
+			break;
+		case 'A':
+			Settings.AutoCreate = true;
+			break;
+		case 't':
+			Settings.Token = optarg;
+			break;
+		case 'l':
+		{
+			char *End{nullptr};
+			Profile.MinLatency = std::chrono::milliseconds{std::strtoul(optarg, &End, 10)};
+			Profile.MaxLatency = *End == '-' ? std::chrono::milliseconds{std::strtoul(End + 1, nullptr, 10)} : Profile.MinLatency;
+			break;
+		}
+		case 'c':
+			Profile.ResetRate = std::strtod(optarg, nullptr);
+			break;
+		case 'T':
+			Profile.ThrottleRate = std::strtod(optarg, nullptr);
+			break;
+		case 'y':
+			Profile.RetryAfter = static_cast<unsigned>(std::strtoul(optarg, nullptr, 10));
+			break;
+		case 'e':
+			Profile.ErrorRate = std::strtod(optarg, nullptr);
+			break;
+		case 'E':
+			Profile.ErrorStatus = static_cast<int>(std::strtol(optarg, nullptr, 10));
+			break;
+		case 'P':
+			Profile.PartialRate = std::strtod(optarg, nullptr);
+			break;
+		case 'x':
+			Profile.Seed = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 10));
+			break;
+		case 'm':
+			Settings.MaxBodyBytes = std::strtoull(optarg, nullptr, 10);
+			break;
+		case 'r':
+			Report = std::strtod(optarg, nullptr);
+			break;
+		case 's':
+			SummaryPath = optarg;
+			break;
+		case 'd':
+			Duration = std::strtod(optarg, nullptr);
+			break;
+		case 'v':
+			Settings.LogRequests = true;
+			break;
+		case 'H':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (Profile.MaxLatency < Profile.MinLatency || Profile.ErrorStatus < 400 || Profile.ErrorStatus > 599 ||
+		 Profile.ResetRate + Profile.ThrottleRate + Profile.ErrorRate + Profile.PartialRate > 1.0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::signal(SIGINT, RequestStop);
+	std::signal(SIGTERM, RequestStop);
+	std::signal(SIGUSR1, RequestOutageToggle);
+
+	FaultInjector Faults{Profile};
+	MockInfluxServer Server{Settings, Faults};
+	if (!Server.Start())
+	{
+		return 1;
+	}
+	std::fprintf(stderr, "listening on %s:%s, latency %lld-%lld ms, faults: %.3f reset, %.3f throttle, %.3f error (%d), %.3f partial\n",
+					 Settings.Host.c_str(), Settings.Port.c_str(), static_cast<long long>(Profile.MinLatency.count()), static_cast<long long>(Profile.MaxLatency.count()),
+					 Profile.ResetRate, Profile.ThrottleRate, Profile.ErrorRate, Profile.ErrorStatus, Profile.PartialRate);
+
+	using Clock = std::chrono::steady_clock;
+	const auto Started{Clock::now()};
+	auto NextReport{Started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Report))};
+	MockTotals Previous{};
+	std::sig_atomic_t OutageTogglesSeen{0};
+	while (!StopRequested)
+	{
+		Server.AcceptConnections(AcceptTimeoutMilliseconds);
+		auto Now{Clock::now()};
+		double Elapsed{std::chrono::duration<double>(Now - Started).count()};
+		if (Duration > 0 && Elapsed >= Duration)
+		{
+			break;
+		}
+		while (OutageTogglesSeen != OutageToggles)
+		{
+			OutageTogglesSeen++;
+			std::fprintf(stderr, "%8.1f s  outage %s\n", Elapsed, Faults.ToggleOutage() ? "started" : "ended");
+		}
+		if (Report > 0 && Now >= NextReport)
+		{
+			MockTotals Totals{Server.GetTotals()};
+			PrintReport(Elapsed, Totals, Previous, Report);
+			Previous = Totals;
+			NextReport += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Report));
+		}
+	}
+
+	double Elapsed{std::chrono::duration<double>(Clock::now() - Started).count()};
+	MockTotals Totals{Server.GetTotals()};
+	std::fprintf(stderr, "received %llu points in %llu writes (%llu bytes), %llu rejected, in %.1f s\n", static_cast<unsigned long long>(Totals.Points),
+					 static_cast<unsigned long long>(Totals.Writes), static_cast<unsigned long long>(Totals.BodyBytes), static_cast<unsigned long long>(Totals.RejectedPoints), Elapsed);
+	if (!SummaryPath.empty() && !WriteSummary(SummaryPath, Elapsed, Totals))
+	{
+		return 1;
+	}
+	return 0;
+}
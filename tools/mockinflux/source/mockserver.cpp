@@ -0,0 +1,891 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#include "lineprotocol.hpp"
+#include "mockserver.hpp"
+
+constexpr const size_t MaxHeaderBytes{64 * 1024};
+constexpr const size_t ReceiveChunk{64 * 1024};
+constexpr const int ReceiveTimeoutMilliseconds{250}; // how quickly an idle connection notices shutdown
+constexpr const std::string_view HeaderEnd{"\r\n\r\n"};
+constexpr const std::string_view VersionHeaders{"X-Influxdb-Version: mock\r\nX-Influxdb-Build: OSS\r\n"};
+
+// helper functions
+static std::string_view GetReason(const int Status)
+{
+	switch (Status)
+	{
+	case 100:
+		return "Continue";
+	case 200:
+		return "OK";
+	case 204:
+		return "No Content";
+	case 400:
+		return "Bad Request";
+	case 401:
+		return "Unauthorized";
+	case 404:
+		return "Not Found";
+	case 405:
+		return "Method Not Allowed";
+	case 413:
+		return "Request Entity Too Large";
+	case 415:
+		return "Unsupported Media Type";
+	case 429:
+		return "Too Many Requests";
+	case 431:
+		return "Request Header Fields Too Large";
+	case 500:
+		return "Internal Server Error";
+	case 502:
+		return "Bad Gateway";
+	case 503:
+		return "Service Unavailable";
+	case 504:
+		return "Gateway Timeout";
+	default:
+		return "Status";
+	}
+}
+
+static void AppendJsonString(std::string &Target, const std::string_view &Value)
+{
+	Target.push_back('"');
+	for (const char c : Value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			Target.push_back('\\');
+			Target.push_back(c);
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			constexpr const char Hex[]{"0123456789abcdef"};
+			Target.append("\\u00").append(1, Hex[(c >> 4) & 0xF]).append(1, Hex[c & 0xF]);
+		}
+		else
+		{
+			Target.push_back(c);
+		}
+	}
+	Target.push_back('"');
+}
+
+static bool EqualsIgnoreCase(const std::string_view &Left, const std::string_view &Right)
+{
+	return Left.size() == Right.size() && std::equal(Left.begin(), Left.end(), Right.begin(), [](const char a, const char b)
+																							 { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); });
+}
+
+static std::string_view Trim(std::string_view Value)
+{
+	while (!Value.empty() && (Value.front() == ' ' || Value.front() == '\t' || Value.front() == '\r' || Value.front() == '\n'))
+	{
+		Value.remove_prefix(1);
+	}
+	while (!Value.empty() && (Value.back() == ' ' || Value.back() == '\t' || Value.back() == '\r' || Value.back() == '\n'))
+	{
+		Value.remove_suffix(1);
+	}
+	return Value;
+}
+
+static std::string DecodeUrlComponent(const std::string_view &Encoded)
+{
+	std::string Decoded{};
+	Decoded.reserve(Encoded.size());
+	for (size_t i{0}; i < Encoded.size(); i++)
+	{
+		if (Encoded[i] == '+')
+		{
+			Decoded.push_back(' ');
+		}
+		else if (Encoded[i] == '%' && i + 2 < Encoded.size())
+		{
+			unsigned Value{0};
+			auto [End, ErrorCode]{std::from_chars(Encoded.data() + i + 1, Encoded.data() + i + 3, Value, 16)};
+			if (ErrorCode == std::errc{} && End == Encoded.data() + i + 3)
+			{
+				Decoded.push_back(static_cast<char>(Value));
+				i += 2;
+			}
+			else
+			{
+				Decoded.push_back('%');
+			}
+		}
+		else
+		{
+			Decoded.push_back(Encoded[i]);
+		}
+	}
+	return Decoded;
+}
+
+static std::optional<std::string> GetParameter(const std::string_view &Query, const std::string_view &Name)
+{
+	size_t Start{0};
+	while (Start <= Query.size())
+	{
+		size_t End{Query.find('&', Start)};
+		if (End == std::string_view::npos)
+		{
+			End = Query.size();
+		}
+		std::string_view Pair{Query.substr(Start, End - Start)};
+		size_t Equals{Pair.find('=')};
+		if (DecodeUrlComponent(Pair.substr(0, Equals)) == Name)
+		{
+			return Equals == std::string_view::npos ? std::string{} : DecodeUrlComponent(Pair.substr(Equals + 1));
+		}
+		Start = End + 1;
+	}
+	return std::nullopt;
+}
+
+// the name in CREATE DATABASE "name" or CREATE DATABASE name WITH ...
+static std::string GetStatementName(std::string_view Rest)
+{
+	Rest = Trim(Rest);
+	if (!Rest.empty() && Rest.front() == '"')
+	{
+		std::string Name{};
+		for (size_t i{1}; i < Rest.size() && Rest[i] != '"'; i++)
+		{
+			if (Rest[i] == '\\' && i + 1 < Rest.size())
+			{
+				i++;
+			}
+			Name.push_back(Rest[i]);
+		}
+		return Name;
+	}
+	return std::string{Rest.substr(0, Rest.find_first_of(" \t;"))};
+}
+
+static bool StartsWithWords(const std::string_view &Statement, const std::string_view &Words, std::string_view &Rest)
+{
+	if (Statement.size() < Words.size() || !EqualsIgnoreCase(Statement.substr(0, Words.size()), Words) ||
+		 (Statement.size() > Words.size() && Statement[Words.size()] != ' ' && Statement[Words.size()] != '\t'))
+	{
+		return false;
+	}
+	Rest = Statement.substr(Words.size());
+	return true;
+}
+
+static bool Inflate(const std::string &Compressed, std::string &Inflated, const size_t Limit)
+{
+	z_stream Stream{};
+	if (inflateInit2(&Stream, 16 + MAX_WBITS) != Z_OK)
+	{
+		return false;
+	}
+	Stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(Compressed.data()));
+	Stream.avail_in = static_cast<uInt>(Compressed.size());
+	char Chunk[ReceiveChunk];
+	int Result{Z_OK};
+	while (Result == Z_OK)
+	{
+		Stream.next_out = reinterpret_cast<Bytef *>(Chunk);
+		Stream.avail_out = sizeof(Chunk);
+		Result = inflate(&Stream, Z_NO_FLUSH);
+		Inflated.append(Chunk, sizeof(Chunk) - Stream.avail_out);
+		if (Inflated.size() > Limit || (Result == Z_BUF_ERROR && Stream.avail_in == 0))
+		{
+			break;
+		}
+	}
+	inflateEnd(&Stream);
+	return Result == Z_STREAM_END;
+}
+
+static bool SendAll(const int Socket, const std::string_view &Data)
+{
+	size_t Sent{0};
+	while (Sent < Data.size())
+	{
+		ssize_t Written{::send(Socket, Data.data() + Sent, Data.size() - Sent, MSG_NOSIGNAL)};
+		if (Written < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+			{
+				continue;
+			}
+			return false;
+		}
+		Sent += static_cast<size_t>(Written);
+	}
+	return true;
+}
+
+// sleeps in short steps so shutdown is not held up by a long injected delay
+static void Delay(std::stop_token &Stop, std::chrono::milliseconds Remaining)
+{
+	constexpr const std::chrono::milliseconds Step{100};
+	while (Remaining.count() > 0 && !Stop.stop_requested())
+	{
+		auto Sleep{std::min(Remaining, Step)};
+		std::this_thread::sleep_for(Sleep);
+		Remaining -= Sleep;
+	}
+}
+
+// HttpRequest
+std::string_view MockInfluxServer::HttpRequest::GetHeader(const std::string_view &Name) const
+{
+	for (const auto &[HeaderName, Value] : Headers)
+	{
+		if (HeaderName == Name)
+		{
+			return Value;
+		}
+	}
+	return std::string_view{};
+}
+
+// private functions
+void MockInfluxServer::Serve(std::stop_token Stop, int Socket, std::atomic<bool> &Finished)
+{
+	std::string Buffer{};
+	while (!Stop.stop_requested())
+	{
+		HttpRequest Request{};
+		ReadResult Result{ReadRequest(Stop, Socket, Buffer, Request)};
+		if (Result == ReadResult::Closed)
+		{
+			break;
+		}
+		RequestCount++;
+		HttpResponse Response{};
+		switch (Result)
+		{
+		case ReadResult::HeadersTooLarge:
+			Response = Fail(431, "request headers too large", false);
+			Request.KeepAlive = false;
+			break;
+		case ReadResult::BodyTooLarge:
+			Response = Fail(413, "request body too large", Request.Path.starts_with("/api/v2/"));
+			Request.KeepAlive = false;
+			break;
+		case ReadResult::Malformed:
+			Response = Fail(400, "malformed request", false);
+			Request.KeepAlive = false;
+			break;
+		default:
+			Response = Route(Request);
+			break;
+		}
+
+		if (Response.Status >= 400 && Response.Status < 500 && !Response.Injected)
+		{
+			BadRequestCount++;
+		}
+		Delay(Stop, Faults.NextLatency());
+		if (Settings.LogRequests)
+		{
+			std::fprintf(stderr, "%s %s%s%s -> %s%d, %zu points\n", Request.Method.c_str(), Request.Path.c_str(), Request.Query.empty() ? "" : "?",
+							 Request.Query.c_str(), Response.Reset ? "reset " : "", Response.Reset ? 0 : Response.Status, Response.Points);
+		}
+		if (Response.Reset)
+		{
+			linger Linger{.l_onoff = 1, .l_linger = 0}; // close with RST instead of FIN
+			::setsockopt(Socket, SOL_SOCKET, SO_LINGER, &Linger, sizeof(Linger));
+			break;
+		}
+
+		std::string Head{"HTTP/1.1 "};
+		Head.append(std::to_string(Response.Status)).append(1, ' ').append(GetReason(Response.Status)).append("\r\n").append(VersionHeaders).append(Response.ExtraHeaders);
+		if (Response.Status != 204)
+		{
+			Head.append("Content-Type: application/json\r\nContent-Length: ").append(std::to_string(Request.Method == "HEAD" ? 0 : Response.Body.size())).append("\r\n");
+		}
+		Head.append(Request.KeepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+		if (Request.Method != "HEAD" && Response.Status != 204)
+		{
+			Head.append(Response.Body);
+		}
+		if (!SendAll(Socket, Head) || !Request.KeepAlive)
+		{
+			break;
+		}
+	}
+	::close(Socket);
+	Finished = true;
+}
+
+MockInfluxServer::ReadResult MockInfluxServer::ReadRequest(std::stop_token &Stop, int Socket, std::string &Buffer, HttpRequest &Request)
+{
+	char Chunk[ReceiveChunk];
+	auto ReceiveMore{[&]() -> bool
+						  {
+							  while (!Stop.stop_requested())
+							  {
+								  ssize_t Received{::recv(Socket, Chunk, sizeof(Chunk), 0)};
+								  if (Received > 0)
+								  {
+									  Buffer.append(Chunk, static_cast<size_t>(Received));
+									  return true;
+								  }
+								  if (Received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+								  {
+									  return false;
+								  }
+							  }
+							  return false;
+						  }};
+
+	size_t HeadersEnd{0};
+	while ((HeadersEnd = Buffer.find(HeaderEnd)) == std::string::npos)
+	{
+		if (Buffer.size() > MaxHeaderBytes)
+		{
+			return ReadResult::HeadersTooLarge;
+		}
+		if (!ReceiveMore())
+		{
+			return ReadResult::Closed;
+		}
+	}
+
+	std::string_view Head{std::string_view{Buffer}.substr(0, HeadersEnd)};
+	size_t LineEnd{Head.find("\r\n")};
+	std::string_view RequestLine{Head.substr(0, LineEnd)};
+	size_t MethodEnd{RequestLine.find(' ')};
+	size_t TargetEnd{RequestLine.rfind(' ')};
+	if (MethodEnd == std::string_view::npos || TargetEnd <= MethodEnd)
+	{
+		return ReadResult::Malformed;
+	}
+	Request.Method = RequestLine.substr(0, MethodEnd);
+	std::string_view Target{RequestLine.substr(MethodEnd + 1, TargetEnd - MethodEnd - 1)};
+	size_t QueryStart{Target.find('?')};
+	Request.Path = Target.substr(0, QueryStart);
+	if (QueryStart != std::string_view::npos)
+	{
+		Request.Query = Target.substr(QueryStart + 1);
+	}
+	Request.KeepAlive = RequestLine.substr(TargetEnd + 1) != "HTTP/1.0";
+	while (LineEnd != std::string_view::npos)
+	{
+		size_t Start{LineEnd + 2};
+		LineEnd = Head.find("\r\n", Start);
+		std::string_view Line{Head.substr(Start, LineEnd == std::string_view::npos ? std::string_view::npos : LineEnd - Start)};
+		size_t Colon{Line.find(':')};
+		if (Colon == std::string_view::npos)
+		{
+			return ReadResult::Malformed;
+		}
+		std::string Name{Line.substr(0, Colon)};
+		std::transform(Name.begin(), Name.end(), Name.begin(), [](const char c)
+							{ return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		Request.Headers.emplace_back(std::move(Name), Trim(Line.substr(Colon + 1)));
+	}
+	std::string_view ConnectionHeader{Request.GetHeader("connection")};
+	if (EqualsIgnoreCase(ConnectionHeader, "close"))
+	{
+		Request.KeepAlive = false;
+	}
+	else if (EqualsIgnoreCase(ConnectionHeader, "keep-alive"))
+	{
+		Request.KeepAlive = true;
+	}
+	Buffer.erase(0, HeadersEnd + HeaderEnd.size());
+
+	bool Chunked{EqualsIgnoreCase(Request.GetHeader("transfer-encoding"), "chunked")};
+	size_t ContentLength{0};
+	std::string_view LengthHeader{Request.GetHeader("content-length")};
+	if (!LengthHeader.empty() && std::from_chars(LengthHeader.data(), LengthHeader.data() + LengthHeader.size(), ContentLength).ec != std::errc{})
+	{
+		return ReadResult::Malformed;
+	}
+	if (ContentLength > Settings.MaxBodyBytes)
+	{
+		return ReadResult::BodyTooLarge;
+	}
+	if ((Chunked || ContentLength > 0) && EqualsIgnoreCase(Request.GetHeader("expect"), "100-continue") && !SendAll(Socket, "HTTP/1.1 100 Continue\r\n\r\n"))
+	{
+		return ReadResult::Closed;
+	}
+
+	if (!Chunked)
+	{
+		while (Buffer.size() < ContentLength)
+		{
+			if (!ReceiveMore())
+			{
+				return ReadResult::Closed;
+			}
+		}
+		Request.Body = Buffer.substr(0, ContentLength);
+		Buffer.erase(0, ContentLength);
+		return ReadResult::Complete;
+	}
+
+	while (true)
+	{
+		size_t SizeEnd{0};
+		while ((SizeEnd = Buffer.find("\r\n")) == std::string::npos)
+		{
+			if (!ReceiveMore())
+			{
+				return ReadResult::Closed;
+			}
+		}
+		size_t ChunkSize{0};
+		if (std::from_chars(Buffer.data(), Buffer.data() + SizeEnd, ChunkSize, 16).ec != std::errc{})
+		{
+			return ReadResult::Malformed;
+		}
+		if (Request.Body.size() + ChunkSize > Settings.MaxBodyBytes)
+		{
+			return ReadResult::BodyTooLarge;
+		}
+		while (Buffer.size() < SizeEnd + 2 + ChunkSize + 2)
+		{
+			if (!ReceiveMore())
+			{
+				return ReadResult::Closed;
+			}
+		}
+		if (ChunkSize == 0)
+		{
+			size_t TrailerEnd{0};
+			while ((TrailerEnd = Buffer.find(HeaderEnd, SizeEnd)) == std::string::npos)
+			{
+				if (!ReceiveMore())
+				{
+					return ReadResult::Closed;
+				}
+			}
+			Buffer.erase(0, TrailerEnd + HeaderEnd.size());
+			return ReadResult::Complete;
+		}
+		Request.Body.append(Buffer, SizeEnd + 2, ChunkSize);
+		Buffer.erase(0, SizeEnd + 2 + ChunkSize + 2);
+	}
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Route(HttpRequest &Request)
+{
+	bool V2{Request.Path.starts_with("/api/v2/")};
+	if (Request.Path == "/ping")
+	{
+		return Ping(Request);
+	}
+	if (Request.Path == "/health")
+	{
+		return Health();
+	}
+	if (Request.Path != "/query" && Request.Path != "/write" && Request.Path != "/api/v2/write" && Request.Path != "/api/v2/buckets")
+	{
+		return Fail(404, "page not found", V2);
+	}
+	if (!Authorized(Request))
+	{
+		return Fail(401, V2 ? "unauthorized access" : "authorization failed", V2);
+	}
+	if (Request.Path == "/query")
+	{
+		return Request.Method == "GET" || Request.Method == "POST" ? Query(Request) : Fail(405, "method not allowed", false);
+	}
+	if (Request.Path == "/api/v2/buckets")
+	{
+		return Request.Method == "GET" ? ListBuckets(Request) : Fail(405, "method not allowed", true);
+	}
+	return Request.Method == "POST" ? Write(Request, V2) : Fail(405, "method not allowed", V2);
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Ping(const HttpRequest &Request)
+{
+	if (Request.Method != "GET" && Request.Method != "HEAD")
+	{
+		return Fail(405, "method not allowed", false);
+	}
+	return HttpResponse{.Status = 204};
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Health()
+{
+	return HttpResponse{.Status = 200, .Body{R"({"name":"influxdb","message":"ready for queries and writes","status":"pass","version":"mock"})"}};
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Query(const HttpRequest &Request)
+{
+	auto Statements{GetParameter(Request.Query, "q")};
+	if (!Statements && Request.Method == "POST")
+	{
+		Statements = GetParameter(Request.Body, "q");
+	}
+	if (!Statements || Trim(*Statements).empty())
+	{
+		return Fail(400, "missing required parameter \"q\"", false);
+	}
+
+	HttpResponse Response{.Status = 200, .Body{R"({"results":[)"}};
+	std::string_view Remaining{*Statements};
+	for (size_t StatementId{0}; !Trim(Remaining).empty(); StatementId++)
+	{
+		size_t End{Remaining.find(';')};
+		std::string_view Statement{Trim(Remaining.substr(0, End))};
+		Remaining = End == std::string_view::npos ? std::string_view{} : Remaining.substr(End + 1);
+		std::string_view Rest{};
+		if (StatementId > 0)
+		{
+			Response.Body.push_back(',');
+		}
+		Response.Body.append(R"({"statement_id":)").append(std::to_string(StatementId));
+		if (StartsWithWords(Statement, "SHOW DATABASES", Rest))
+		{
+			Response.Body.append(R"(,"series":[{"name":"databases","columns":["name"],"values":[)");
+			std::scoped_lock Lock{StoreLock};
+			bool First{true};
+			for (const auto &Database : Databases)
+			{
+				Response.Body.append(First ? "[" : ",[");
+				AppendJsonString(Response.Body, Database);
+				Response.Body.push_back(']');
+				First = false;
+			}
+			Response.Body.append("]}]}");
+		}
+		else if (StartsWithWords(Statement, "CREATE DATABASE", Rest) && !GetStatementName(Rest).empty())
+		{
+			std::scoped_lock Lock{StoreLock};
+			Databases.insert(GetStatementName(Rest));
+			Response.Body.push_back('}');
+		}
+		else if (StartsWithWords(Statement, "DROP DATABASE", Rest) && !GetStatementName(Rest).empty())
+		{
+			std::scoped_lock Lock{StoreLock};
+			if (auto Database{Databases.find(GetStatementName(Rest))}; Database != Databases.end())
+			{
+				Databases.erase(Database);
+			}
+			Response.Body.push_back('}');
+		}
+		else
+		{
+			std::string Message{"error parsing query: the mock supports SHOW DATABASES, CREATE DATABASE and DROP DATABASE, not: "};
+			return Fail(400, Message.append(Statement), false);
+		}
+	}
+	Response.Body.append("]}");
+	return Response;
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::ListBuckets(const HttpRequest &Request)
+{
+	auto Organization{GetParameter(Request.Query, "org")};
+	if (!Settings.Organization.empty() && Organization && *Organization != Settings.Organization)
+	{
+		return Fail(404, std::string{"organization name \""}.append(*Organization).append("\" not found"), true);
+	}
+	auto Name{GetParameter(Request.Query, "name")};
+	HttpResponse Response{.Status = 200, .Body{R"({"buckets":[)"}};
+	std::scoped_lock Lock{StoreLock};
+	size_t Id{0};
+	bool First{true};
+	for (const auto &Bucket : Buckets)
+	{
+		Id++;
+		if (Name && *Name != Bucket)
+		{
+			continue;
+		}
+		char Hex[17];
+		std::snprintf(Hex, sizeof(Hex), "%016zx", Id);
+		Response.Body.append(First ? R"({"id":")" : R"(,{"id":")").append(Hex).append(R"(","name":)");
+		AppendJsonString(Response.Body, Bucket);
+		Response.Body.append(R"(,"retentionRules":[]})");
+		First = false;
+	}
+	Response.Body.append("]}");
+	return Response;
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Write(HttpRequest &Request, const bool V2)
+{
+	BodyByteCount += Request.Body.size();
+	auto Precision{GetParameter(Request.Query, "precision").value_or(std::string{})};
+	constexpr const std::string_view V1Precisions[]{"", "n", "ns", "u", "us", "ms", "s", "m", "h"};
+	constexpr const std::string_view V2Precisions[]{"", "ns", "us", "ms", "s"};
+	if (V2 ? std::find(std::begin(V2Precisions), std::end(V2Precisions), Precision) == std::end(V2Precisions)
+			 : std::find(std::begin(V1Precisions), std::end(V1Precisions), Precision) == std::end(V1Precisions))
+	{
+		return Fail(400, std::string{"invalid precision \""}.append(Precision).append("\""), V2);
+	}
+
+	if (V2)
+	{
+		auto Organization{GetParameter(Request.Query, "org")};
+		if (!Organization && !GetParameter(Request.Query, "orgID"))
+		{
+			return Fail(400, "missing org", true);
+		}
+		if (!Settings.Organization.empty() && Organization && *Organization != Settings.Organization)
+		{
+			return Fail(404, std::string{"organization name \""}.append(*Organization).append("\" not found"), true);
+		}
+		auto Bucket{GetParameter(Request.Query, "bucket")};
+		if (!Bucket || Bucket->empty())
+		{
+			return Fail(400, "missing bucket", true);
+		}
+		if (!Exists(Buckets, *Bucket))
+		{
+			return Fail(404, std::string{"bucket \""}.append(*Bucket).append("\" not found"), true);
+		}
+	}
+	else
+	{
+		auto Database{GetParameter(Request.Query, "db")};
+		if (!Database || Database->empty())
+		{
+			return Fail(400, "database is required", false);
+		}
+		if (!Exists(Databases, *Database))
+		{
+			return Fail(404, std::string{"database not found: \""}.append(*Database).append("\""), false);
+		}
+	}
+
+	std::string_view Encoding{Request.GetHeader("content-encoding")};
+	if (EqualsIgnoreCase(Encoding, "gzip"))
+	{
+		std::string Inflated{};
+		if (!Inflate(Request.Body, Inflated, Settings.MaxBodyBytes))
+		{
+			return Fail(Inflated.size() > Settings.MaxBodyBytes ? 413 : 400, "unable to decompress request body", V2);
+		}
+		Request.Body = std::move(Inflated);
+	}
+	else if (!Encoding.empty() && !EqualsIgnoreCase(Encoding, "identity"))
+	{
+		return Fail(415, std::string{"unsupported content encoding \""}.append(Encoding).append("\""), V2);
+	}
+
+	HttpResponse Response{};
+	switch (Faults.NextWriteFault())
+	{
+	case Fault::Reset:
+		ResetCount++;
+		Response.Reset = true;
+		return Response;
+	case Fault::Throttle:
+		ThrottledCount++;
+		Response = Fail(429, "too many requests", V2);
+		Response.Injected = true;
+		Response.ExtraHeaders.append("Retry-After: ").append(std::to_string(Faults.GetProfile().RetryAfter)).append("\r\n");
+		return Response;
+	case Fault::ServerError:
+		ServerErrorCount++;
+		Response = Fail(Faults.GetProfile().ErrorStatus, "injected failure", V2);
+		Response.Injected = true;
+		return Response;
+	case Fault::PartialWrite:
+	{
+		LineProtocolSummary Summary{CheckLineProtocol(Request.Body)};
+		if (Summary.Points == 0)
+		{
+			break; // nothing to drop, let the body speak for itself
+		}
+		size_t Dropped{Faults.PickLine(Summary.Points)};
+		size_t Valid{0};
+		std::string DroppedLine{};
+		ForEachLineProtocolLine(Request.Body, [&](const std::string_view &Line)
+										{
+			if (CheckLineProtocolLine(Line) == nullptr && Valid++ == Dropped)
+			{
+				DroppedLine = Line.substr(0, 256);
+			} });
+		PartialWriteCount++;
+		WriteCount++;
+		PointCount += Summary.Points - 1;
+		RejectedPointCount += Summary.Rejected + 1;
+		Response = Fail(400, std::string{"partial write: points beyond retention policy dropped=1: '"}.append(DroppedLine).append(1, '\''), V2);
+		Response.Injected = true;
+		Response.Points = Summary.Points - 1;
+		return Response;
+	}
+	default:
+		break;
+	}
+
+	LineProtocolSummary Summary{CheckLineProtocol(Request.Body)};
+	PointCount += Summary.Points;
+	RejectedPointCount += Summary.Rejected;
+	if (Summary.Points > 0)
+	{
+		WriteCount++;
+	}
+	if (Summary.Rejected > 0)
+	{
+		Response = Fail(400, std::string{Summary.Points > 0 ? "partial write: " : ""}.append(Summary.FirstError).append(" dropped=").append(std::to_string(Summary.Rejected)), V2);
+	}
+	Response.Points = Summary.Points;
+	return Response;
+}
+
+MockInfluxServer::HttpResponse MockInfluxServer::Fail(const int Status, const std::string_view &Message, const bool V2)
+{
+	HttpResponse Response{.Status = Status};
+	if (V2)
+	{
+		std::string_view Code{Status == 401 ? "unauthorized" : Status == 404 ? "not found"
+																 : Status == 429 ? "too many requests"
+																 : Status >= 500 ? "internal error"
+																					  : "invalid"};
+		Response.Body.append(R"({"code":")").append(Code).append(R"(","message":)");
+	}
+	else
+	{
+		Response.Body.append(R"({"error":)");
+	}
+	AppendJsonString(Response.Body, Message);
+	Response.Body.push_back('}');
+	return Response;
+}
+
+bool MockInfluxServer::Authorized(const HttpRequest &Request) const
+{
+	if (Settings.Token.empty())
+	{
+		return true;
+	}
+	std::string_view Authorization{Request.GetHeader("authorization")};
+	for (const std::string_view Scheme : {"Token ", "Bearer "})
+	{
+		if (Authorization.starts_with(Scheme) && Authorization.substr(Scheme.size()) == Settings.Token)
+		{
+			return true;
+		}
+	}
+	return GetParameter(Request.Query, "p").value_or(std::string{}) == Settings.Token; // 1.x query string credentials
+}
+
+bool MockInfluxServer::Exists(std::set<std::string, std::less<>> &Names, const std::string_view &Name)
+{
+	std::scoped_lock Lock{StoreLock};
+	if (Names.find(Name) != Names.end())
+	{
+		return true;
+	}
+	if (Settings.AutoCreate)
+	{
+		Names.emplace(Name);
+		return true;
+	}
+	return false;
+}
+
+// public functions
+MockInfluxServer::MockInfluxServer(const MockSettings &Settings, FaultInjector &Faults)
+	 : Settings{Settings}, Faults{Faults}, Databases{Settings.Databases.begin(), Settings.Databases.end()}, Buckets{Settings.Buckets.begin(), Settings.Buckets.end()}
+{
+}
+
+MockInfluxServer::~MockInfluxServer()
+{
+	Connections.clear(); // each jthread is asked to stop, then joined
+	if (ListenSocket >= 0)
+	{
+		::close(ListenSocket);
+	}
+}
+
+bool MockInfluxServer::Start()
+{
+	addrinfo Hints{};
+	Hints.ai_family = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+	Hints.ai_flags = AI_PASSIVE;
+	addrinfo *Addresses{nullptr};
+	if (int Result{::getaddrinfo(Settings.Host.c_str(), Settings.Port.c_str(), &Hints, &Addresses)}; Result != 0)
+	{
+		std::fprintf(stderr, "Failed to resolve \"%s\": %s\n", Settings.Host.c_str(), ::gai_strerror(Result));
+		return false;
+	}
+	int Error{0};
+	for (addrinfo *Address{Addresses}; Address != nullptr && ListenSocket < 0; Address = Address->ai_next)
+	{
+		ListenSocket = ::socket(Address->ai_family, Address->ai_socktype | SOCK_CLOEXEC, Address->ai_protocol);
+		if (ListenSocket < 0)
+		{
+			Error = errno;
+			continue;
+		}
+		int Reuse{1};
+		::setsockopt(ListenSocket, SOL_SOCKET, SO_REUSEADDR, &Reuse, sizeof(Reuse));
+		if (::bind(ListenSocket, Address->ai_addr, Address->ai_addrlen) != 0 || ::listen(ListenSocket, SOMAXCONN) != 0)
+		{
+			Error = errno;
+			::close(ListenSocket);
+			ListenSocket = -1;
+		}
+	}
+	::freeaddrinfo(Addresses);
+	if (ListenSocket < 0)
+	{
+		std::fprintf(stderr, "Failed to listen on %s:%s: %s\n", Settings.Host.c_str(), Settings.Port.c_str(), std::strerror(Error));
+		return false;
+	}
+	return true;
+}
+
+void MockInfluxServer::AcceptConnections(const int TimeoutMilliseconds)
+{
+	Connections.remove_if([](const Connection &Finished)
+								 { return Finished.Finished.load(); });
+	pollfd Listener{.fd = ListenSocket, .events = POLLIN, .revents = 0};
+	if (::poll(&Listener, 1, TimeoutMilliseconds) <= 0)
+	{
+		return;
+	}
+	int Socket{::accept4(ListenSocket, nullptr, nullptr, SOCK_CLOEXEC)};
+	if (Socket < 0)
+	{
+		return;
+	}
+	int NoDelay{1};
+	::setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+	timeval Timeout{.tv_sec = 0, .tv_usec = ReceiveTimeoutMilliseconds * 1000};
+	::setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+	ConnectionCount++;
+	auto &Accepted{Connections.emplace_back()};
+	Accepted.Thread = std::jthread{[this, Socket, &Accepted](std::stop_token Stop)
+											 { Serve(Stop, Socket, Accepted.Finished); }};
+}
+
+MockTotals MockInfluxServer::GetTotals() const
+{
+	return MockTotals{.Connections = ConnectionCount,
+							.Requests = RequestCount,
+							.Writes = WriteCount,
+							.Points = PointCount,
+							.RejectedPoints = RejectedPointCount,
+							.BodyBytes = BodyByteCount,
+							.Resets = ResetCount,
+							.Throttled = ThrottledCount,
+							.ServerErrors = ServerErrorCount,
+							.PartialWrites = PartialWriteCount,
+							.BadRequests = BadRequestCount};
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "faultinjector.hpp"
+
+struct MockSettings
+{
+	std::string Host{"127.0.0.1"};
+	std::string Port{"8086"};
+	std::string Token{};						  // when set, every endpoint but /ping and /health requires it
+	std::string Organization{};			  // when set, 2.x requests must name it
+	std::vector<std::string> Databases{}; // 1.x databases that exist at start
+	std::vector<std::string> Buckets{};	  // 2.x buckets that exist at start
+	bool AutoCreate{false};					  // writes to a missing database or bucket create it, as 3.x does
+	size_t MaxBodyBytes{64 * 1024 * 1024};
+	bool LogRequests{false};
+};
+
+/// @brief Running totals, as of the moment they were read
+struct MockTotals
+{
+	uint64_t Connections{0};
+	uint64_t Requests{0};
+	uint64_t Writes{0};			// write requests whose points were stored, including partial writes
+	uint64_t Points{0};			// points stored
+	uint64_t RejectedPoints{0}; // lines that failed to parse or were dropped by a partial write
+	uint64_t BodyBytes{0};		// write bodies as received, before decompression
+	uint64_t Resets{0};
+	uint64_t Throttled{0};
+	uint64_t ServerErrors{0};
+	uint64_t PartialWrites{0};
+	uint64_t BadRequests{0}; // every other 4xx: malformed requests, missing databases, bad tokens
+};
+
+/// @brief InfluxDB stand-in for exercising and benchmarking InfluxClient without a database.
+/// Serves 1.x /ping, /query (SHOW, CREATE and DROP DATABASE) and /write, and 2.x /health, /api/v2/buckets and /api/v2/write.
+/// Write bodies, gzip or plain, are checked line by line and their points counted but not kept.
+/// Each connection gets its own thread, so injected latency on one does not hold up the others.
+class MockInfluxServer
+{
+private:
+	struct HttpRequest
+	{
+		std::string Method{};
+		std::string Path{};
+		std::string Query{};
+		std::vector<std::pair<std::string, std::string>> Headers{}; // names in lower case
+		std::string Body{};
+		bool KeepAlive{true};
+
+		std::string_view GetHeader(const std::string_view &Name) const;
+	};
+	struct HttpResponse
+	{
+		int Status{204};
+		std::string Body{};
+		std::string ExtraHeaders{}; // complete lines, each ending in \r\n
+		bool Reset{false};
+		bool Injected{false}; // a fault, not the request's own doing
+		size_t Points{0};
+	};
+	struct Connection
+	{
+		std::jthread Thread{};
+		std::atomic<bool> Finished{false};
+	};
+	enum class ReadResult
+	{
+		Complete,
+		Closed,
+		HeadersTooLarge,
+		BodyTooLarge,
+		Malformed
+	};
+
+	const MockSettings Settings;
+	FaultInjector &Faults;
+	int ListenSocket{-1};
+	std::mutex StoreLock{};
+	std::set<std::string, std::less<>> Databases{};
+	std::set<std::string, std::less<>> Buckets{};
+	std::list<Connection> Connections{};
+
+	std::atomic<uint64_t> ConnectionCount{0};
+	std::atomic<uint64_t> RequestCount{0};
+	std::atomic<uint64_t> WriteCount{0};
+	std::atomic<uint64_t> PointCount{0};
+	std::atomic<uint64_t> RejectedPointCount{0};
+	std::atomic<uint64_t> BodyByteCount{0};
+	std::atomic<uint64_t> ResetCount{0};
+	std::atomic<uint64_t> ThrottledCount{0};
+	std::atomic<uint64_t> ServerErrorCount{0};
+	std::atomic<uint64_t> PartialWriteCount{0};
+	std::atomic<uint64_t> BadRequestCount{0};
+
+	void Serve(std::stop_token Stop, int Socket, std::atomic<bool> &Finished);
+	ReadResult ReadRequest(std::stop_token &Stop, int Socket, std::string &Buffer, HttpRequest &Request);
+	HttpResponse Route(HttpRequest &Request);
+	HttpResponse Ping(const HttpRequest &Request);
+	HttpResponse Health();
+	HttpResponse Query(const HttpRequest &Request);
+	HttpResponse ListBuckets(const HttpRequest &Request);
+	HttpResponse Write(HttpRequest &Request, const bool V2);
+	HttpResponse Fail(const int Status, const std::string_view &Message, const bool V2);
+	bool Authorized(const HttpRequest &Request) const;
+	bool Exists(std::set<std::string, std::less<>> &Names, const std::string_view &Name);
+
+public:
+	MockInfluxServer(const MockSettings &Settings, FaultInjector &Faults);
+	~MockInfluxServer();
+	MockInfluxServer(const MockInfluxServer &) = delete;
+	MockInfluxServer &operator=(const MockInfluxServer &) = delete;
+	MockInfluxServer(MockInfluxServer &&) = delete;
+	MockInfluxServer &operator=(MockInfluxServer &&) = delete;
+
+	/// @brief Binds and listens
+	/// @return False if the listener could not be created, which has been reported
+	bool Start();
+
+	/// @brief Waits up to TimeoutMilliseconds for a connection and hands it to a new thread
+	void AcceptConnections(const int TimeoutMilliseconds);
+
+	MockTotals GetTotals() const;
+};
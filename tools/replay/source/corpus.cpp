@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "corpus.hpp"
+
+// public functions
+bool ListCorpus(const std::string &Directory, std::vector<CorpusFile> &Files)
+{
+	std::error_code FSErrorCode{};
+	for (auto Entry{std::filesystem::directory_iterator(Directory, FSErrorCode)}; !FSErrorCode && Entry != std::filesystem::directory_iterator{}; Entry.increment(FSErrorCode))
+	{
+		std::string Name{Entry->path().filename().string()};
+		size_t Separator{Name.find('-')};
+		if (Name.starts_with('.') || Separator == 0 || Separator == std::string::npos || Separator + 1 == Name.size() ||
+			 !std::all_of(Name.begin(), Name.begin() + static_cast<std::ptrdiff_t>(Separator), [](const char c)
+							  { return c >= '0' && c <= '9'; }) ||
+			 !Entry->is_regular_file(FSErrorCode))
+		{
+			continue;
+		}
+		Files.push_back(CorpusFile{Entry->path().string(), Name.substr(Separator + 1), std::strtoll(Name.c_str(), nullptr, 10)});
+	}
+	if (FSErrorCode)
+	{
+		std::fprintf(stderr, "Failed to read \"%s\": %s\n", Directory.c_str(), FSErrorCode.message().c_str());
+		return false;
+	}
+	std::sort(Files.begin(), Files.end(), [](const CorpusFile &Left, const CorpusFile &Right)
+				 { return Left.ModifiedMilliseconds < Right.ModifiedMilliseconds || (Left.ModifiedMilliseconds == Right.ModifiedMilliseconds && Left.Path < Right.Path); });
+	return true;
+}
+
+bool ReadCorpusFile(const std::string &Path, std::string &Contents)
+{
+	Contents.clear();
+	std::FILE *File{std::fopen(Path.c_str(), "r")};
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	char Chunk[65536];
+	size_t Read{0};
+	while ((Read = std::fread(Chunk, 1, sizeof(Chunk), File)) > 0)
+	{
+		Contents.append(Chunk, Read);
+	}
+	bool Failed{std::ferror(File) != 0};
+	std::fclose(File);
+	if (Failed)
+	{
+		std::fprintf(stderr, "Failed to read \"%s\": %s\n", Path.c_str(), std::strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void ShiftTimestamps(std::string &Contents, const int64_t OffsetSeconds)
+{
+	if (OffsetSeconds == 0)
+	{
+		return;
+	}
+	std::string Shifted{};
+	Shifted.reserve(Contents.size() + Contents.size() / 64);
+	std::string_view Remaining{Contents};
+	while (!Remaining.empty())
+	{
+		size_t LineEnd{std::min(Remaining.find('\n'), Remaining.size())};
+		std::string_view Line{Remaining.substr(0, LineEnd)};
+		size_t Digits{0};
+		while (Digits < Line.size() && Line[Digits] >= '0' && Line[Digits] <= '9')
+		{
+			Digits++;
+		}
+		if (Digits > 0 && Digits < 19 && Digits < Line.size() && Line[Digits] == '\t')
+		{
+			Shifted.append(std::to_string(std::strtoll(Line.data(), nullptr, 10) + OffsetSeconds));
+			Line.remove_prefix(Digits);
+		}
+		Shifted.append(Line);
+		if (LineEnd < Remaining.size())
+		{
+			Shifted.push_back('\n');
+			LineEnd++;
+		}
+		Remaining.remove_prefix(LineEnd);
+	}
+	Contents = std::move(Shifted);
+}
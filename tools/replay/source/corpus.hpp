@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief One file of a capture archive, named <modification time in ms>-<spool file name> by the daemon's capture mode
+struct CorpusFile
+{
+	std::string Path{};
+	std::string SpoolName{};
+	int64_t ModifiedMilliseconds{0};
+};
+
+/// @brief Lists the archive in the order the daemon read it. Dot files and names without a time prefix are skipped.
+/// @return False if the directory could not be read, which has been reported
+bool ListCorpus(const std::string &Directory, std::vector<CorpusFile> &Files);
+
+/// @return False if the file could not be read, which has been reported
+bool ReadCorpusFile(const std::string &Path, std::string &Contents);
+
+/// @brief Adds OffsetSeconds to the $TIMET$ at the start of every line. Lines that do not start with one are left alone.
+void ShiftTimestamps(std::string &Contents, const int64_t OffsetSeconds);
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <getopt.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "corpus.hpp"
+
+static volatile std::sig_atomic_t StopRequested{0};
+
+// helper functions
+static void RequestStop(int)
+{
+	StopRequested = 1;
+}
+
+static void PrintUsage(const char *ProgramName)
+{
+	std::fprintf(stderr,
+					 "usage: %s --corpus DIRECTORY --spool DIRECTORY [options]\n"
+					 "Feeds a capture archive written by the daemon's [capture] mode back into a spool directory, keeping\n"
+					 "the original spacing between files or a multiple of it.\n"
+					 "\n"
+					 "  --corpus DIRECTORY      capture archive to replay (required)\n"
+					 "  --spool DIRECTORY       spool directory the daemon reads (required)\n"
+					 "  --work-dir DIRECTORY    where files are written before moving into the spool, on the same\n"
+					 "                          filesystem (default: DIRECTORY.replay, created if missing)\n"
+					 "  --speed FACTOR          replay this many times faster than captured, 0 for as fast as\n"
+					 "                          possible (default 1)\n"
+					 "  --max-gap SECONDS       shorten longer pauses between captured files to this, e.g. across\n"
+					 "                          daemon restarts, 0 for no limit (default 0)\n"
+					 "  --retime                shift every $TIMET$ so the corpus starts now, keeping the spacing\n"
+					 "                          between records. without it, records keep their captured times\n"
+					 "  --loops N               replay the corpus N times, 0 to run until interrupted (default 1).\n"
+					 "                          use --retime, or later loops overwrite the points of earlier ones\n",
+					 ProgramName);
+}
+
+static size_t CountSpoolFiles(const std::string &SpoolDirectory)
+{
+	std::error_code FSErrorCode{};
+	size_t Files{0};
+	for (auto Entry{std::filesystem::directory_iterator(SpoolDirectory, FSErrorCode)}; !FSErrorCode && Entry != std::filesystem::directory_iterator{}; Entry.increment(FSErrorCode))
+	{
+		Files++;
+	}
+	return Files;
+}
+
+// written outside the spool and renamed in whole, the way Nagios moves its perfdata files
+static bool Deliver(const std::string &Contents, const std::string &SpoolName, const std::string &SpoolDirectory, const std::string &WorkDirectory)
+{
+	std::string WorkPath{WorkDirectory + "/" + SpoolName};
+	std::FILE *File{std::fopen(WorkPath.c_str(), "w")};
+	if (File == nullptr)
+	{
+		std::fprintf(stderr, "Failed to open \"%s\": %s\n", WorkPath.c_str(), std::strerror(errno));
+		return false;
+	}
+	bool Written{std::fwrite(Contents.data(), 1, Contents.size(), File) == Contents.size()};
+	Written = std::fclose(File) == 0 && Written;
+	if (!Written)
+	{
+		std::fprintf(stderr, "Failed to write \"%s\": %s\n", WorkPath.c_str(), std::strerror(errno));
+		return false;
+	}
+	std::string Target{SpoolDirectory + "/" + SpoolName};
+	for (int Collision{1}; ::access(Target.c_str(), F_OK) == 0; Collision++) // the daemon has not read the previous loop's copy yet
+	{
+		Target = SpoolDirectory + "/" + SpoolName + "-" + std::to_string(Collision);
+	}
+	if (std::rename(WorkPath.c_str(), Target.c_str()) != 0)
+	{
+		std::fprintf(stderr, "Failed to move \"%s\" to \"%s\": %s\n", WorkPath.c_str(), Target.c_str(), std::strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::string CorpusDirectory{};
+	std::string SpoolDirectory{};
+	std::string WorkDirectory{};
+	double Speed{1};
+	double MaxGap{0};
+	bool Retime{false};
+	unsigned long Loops{1};
+
+	const option Options[]{
+		 {"corpus", required_argument, nullptr, 'c'},
+		 {"spool", required_argument, nullptr, 'S'},
+		 {"work-dir", required_argument, nullptr, 'W'},
+		 {"speed", required_argument, nullptr, 's'},
+		 {"max-gap", required_argument, nullptr, 'g'},
+		 {"retime", no_argument, nullptr, 't'},
+		 {"loops", required_argument, nullptr, 'l'},
+		 {"help", no_argument, nullptr, 'H'},
+		 {nullptr, 0, nullptr, 0}};
+	int Option{0};
+	while ((Option = getopt_long(argc, argv, "", Options, nullptr)) != -1)
+	{
+		switch (Option)
+		{
+		case 'c':
+			CorpusDirectory = optarg;
+			break;
+		case 'S':
+			SpoolDirectory = optarg;
+			break;
+		case 'W':
+			WorkDirectory = optarg;
+			break;
+		case 's':
+			Speed = std::strtod(optarg, nullptr);
+			break;
+		case 'g':
+			MaxGap = std::strtod(optarg, nullptr);
+			break;
+		case 't':
+			Retime = true;
+			break;
+		case 'l':
+			Loops = std::strtoul(optarg, nullptr, 10);
+			break;
+		case 'H':
+			PrintUsage(argv[0]);
+			return 0;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (CorpusDirectory.empty() || SpoolDirectory.empty() || Speed < 0 || MaxGap < 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	while (SpoolDirectory.size() > 1 && SpoolDirectory.back() == '/')
+	{
+		SpoolDirectory.pop_back();
+	}
+	if (WorkDirectory.empty())
+	{
+		WorkDirectory = SpoolDirectory + ".replay";
+	}
+	std::error_code FSErrorCode{};
+	std::filesystem::create_directories(SpoolDirectory, FSErrorCode);
+	std::filesystem::create_directories(WorkDirectory, FSErrorCode);
+	if (FSErrorCode)
+	{
+		std::fprintf(stderr, "Failed to create \"%s\": %s\n", WorkDirectory.c_str(), FSErrorCode.message().c_str());
+		return 1;
+	}
+
+	std::vector<CorpusFile> Files{};
+	if (!ListCorpus(CorpusDirectory, Files))
+	{
+		return 1;
+	}
+	if (Files.empty())
+	{
+		std::fprintf(stderr, "No capture files in \"%s\"\n", CorpusDirectory.c_str());
+		return 1;
+	}
+
+	// the replay schedule, in seconds from the start of a loop, with long pauses shortened and the speed applied
+	std::vector<double> Schedule{};
+	double Position{0};
+	for (size_t Index{0}; Index < Files.size(); Index++)
+	{
+		if (Index > 0)
+		{
+			double Gap{static_cast<double>(Files[Index].ModifiedMilliseconds - Files[Index - 1].ModifiedMilliseconds) / 1000};
+			Gap = MaxGap > 0 ? std::min(Gap, MaxGap) : Gap;
+			Position += Speed > 0 ? Gap / Speed : 0;
+		}
+		Schedule.push_back(Position);
+	}
+	const int64_t FirstCaptured{Files.front().ModifiedMilliseconds / 1000};
+	const int64_t CapturedSpan{Files.back().ModifiedMilliseconds / 1000 - FirstCaptured + 1};
+	std::fprintf(stderr, "%zu files spanning %lld s, replaying in %.1f s per loop into %s\n",
+					 Files.size(), static_cast<long long>(CapturedSpan), Schedule.back(), SpoolDirectory.c_str());
+
+	std::signal(SIGINT, RequestStop);
+	std::signal(SIGTERM, RequestStop);
+
+	using Clock = std::chrono::steady_clock;
+	const auto Started{Clock::now()};
+	auto NextReport{Started + std::chrono::seconds(1)};
+	unsigned long long FilesDelivered{0};
+	unsigned long long FilesAtLastReport{0};
+	unsigned long long BytesDelivered{0};
+	double WorstBehind{0};
+	int64_t LastOffset{0};
+	std::string Contents{};
+	bool Failed{false};
+	for (unsigned long Loop{0}; (Loops == 0 || Loop < Loops) && !StopRequested && !Failed; Loop++)
+	{
+		const auto LoopStarted{Clock::now()};
+		int64_t Offset{0};
+		if (Retime) // later loops never reuse timestamps, even when replaying faster than captured
+		{
+			Offset = static_cast<int64_t>(std::time(nullptr)) - FirstCaptured;
+			Offset = Loop > 0 ? std::max(Offset, LastOffset + CapturedSpan) : Offset;
+			LastOffset = Offset;
+		}
+		for (size_t Index{0}; Index < Files.size() && !StopRequested && !Failed; Index++)
+		{
+			const auto Due{LoopStarted + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(Schedule[Index]))};
+			while (Clock::now() < Due && !StopRequested)
+			{
+				std::this_thread::sleep_for(std::min<Clock::duration>(Due - Clock::now(), std::chrono::milliseconds(100)));
+			}
+			WorstBehind = std::max(WorstBehind, std::chrono::duration<double>(Clock::now() - Due).count());
+			Failed = !ReadCorpusFile(Files[Index].Path, Contents);
+			if (!Failed)
+			{
+				ShiftTimestamps(Contents, Offset);
+				Failed = !Deliver(Contents, Files[Index].SpoolName, SpoolDirectory, WorkDirectory);
+				FilesDelivered++;
+				BytesDelivered += Contents.size();
+			}
+
+			auto Now{Clock::now()};
+			if (Now >= NextReport)
+			{
+				std::fprintf(stderr, "%8.1f s  loop %lu  %8llu files  %6llu files/s  %12llu bytes  %6zu files waiting in spool\n",
+								 std::chrono::duration<double>(Now - Started).count(), Loop + 1, FilesDelivered, FilesDelivered - FilesAtLastReport,
+								 BytesDelivered, CountSpoolFiles(SpoolDirectory));
+				FilesAtLastReport = FilesDelivered;
+				NextReport = Now + std::chrono::seconds(1);
+			}
+		}
+	}
+	double Elapsed{std::chrono::duration<double>(Clock::now() - Started).count()};
+	std::fprintf(stderr, "replayed %llu files (%llu bytes) in %.1f s, at worst %.3f s behind schedule\n",
+					 FilesDelivered, BytesDelivered, Elapsed, WorstBehind);
+	return Failed ? 1 : 0;
+}